@@ -90,6 +90,9 @@ TEST ?= default
 # How to run the tests (arguments for ./scripts/run-tests.sh)
 RUN_TEST_ARGS ?=
 
+# Arguments for ./test/rdb_workloads/alloc_per_op.py, which `make alloc-per-op` runs
+ALLOC_PER_OP_ARGS ?=
+
 # For each triggered rule, show one of the dependencies that caused it to be run
 SHOW_BUILD_REASON ?= 0
 
@@ -116,6 +119,12 @@ KEEP_INLINE ?= 0
 OPROFILE ?= 0
 BTREE_DEBUG ?= 0
 MALLOC_PROF ?= 0
+
+# Count calls to operator new, in the operator_new_calls stat.  `make
+# alloc-per-op` divides it and the slab_allocator stat by the operations a
+# stress workload ran, to give the allocations per operation.
+ALLOC_COUNT ?= 0
+
 SERIALIZER_DEBUG ?= 0
 MEMCACHED_STRICT ?= 0
 NO_EVENTFD ?= 0
@@ -13,6 +13,7 @@
 #include "arch/io/blocker_pool.hpp"
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/scoped.hpp"
+#include "containers/slab_allocator.hpp"
 
 #ifdef __MACH__
 #define USE_WRITEV 0
@@ -27,7 +28,7 @@ class pool_diskmgr_t;
 (blocking) IO calls to asynchronously run IO requests. */
 
 struct pool_diskmgr_action_t
-    : private blocker_pool_t::job_t {
+    : private blocker_pool_t::job_t, public slab_allocated_mixin_t {
     pool_diskmgr_action_t() { }
 
     void make_write(fd_t _fd, const void *_buf, size_t _count, int64_t _offset,
@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -11,6 +12,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
@@ -20,11 +22,22 @@
 #include "arch/timing.hpp"
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/printf_buffer.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 
+// Linux has had SO_REUSEPORT since 3.9, but older headers don't define it.
+#if defined(__linux) && !defined(SO_REUSEPORT)
+#define SO_REUSEPORT 15
+#endif
+
+// Likewise SO_BUSY_POLL, since 3.11.
+#if defined(__linux) && !defined(SO_BUSY_POLL)
+#define SO_BUSY_POLL 46
+#endif
+
 /* Network connection object */
 
 linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t) :
@@ -32,6 +45,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &host, int port, signal_t
         sock(socket(AF_INET, SOCK_STREAM, 0)),
         event_watcher(new linux_event_watcher_t(sock.get(), this)),
         read_in_progress(false), write_in_progress(false),
+        read_buffer_offset(0),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
@@ -88,6 +102,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     sock(s),
     event_watcher(new linux_event_watcher_t(sock.get(), this)),
     read_in_progress(false), write_in_progress(false),
+    read_buffer_offset(0),
     write_handler(this),
     write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
     write_coro_pool(1, &write_queue, &write_handler),
@@ -98,6 +113,21 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
 
     int res = fcntl(sock.get(), F_SETFL, O_NONBLOCK);
     guarantee_err(res == 0, "Could not make socket non-blocking");
+
+#ifdef SO_BUSY_POLL
+    /* When our event loops busy-poll, have the kernel busy-poll the device
+    queue for this client's packets too, instead of waiting for an interrupt.
+    Older kernels don't have it, and going past `net.core.busy_read` takes
+    CAP_NET_ADMIN, so it doesn't matter if it fails. */
+    int busy_poll_usecs = static_cast<int>(get_busy_poll_usecs());
+    if (busy_poll_usecs > 0) {
+        res = setsockopt(sock.get(), SOL_SOCKET, SO_BUSY_POLL,
+                         &busy_poll_usecs, sizeof(busy_poll_usecs));
+        if (res != 0) {
+            logDBG("Could not set SO_BUSY_POLL: %s", errno_string(errno).c_str());
+        }
+    }
+#endif
 }
 
 linux_tcp_conn_t::write_buffer_t * linux_tcp_conn_t::get_write_buffer() {
@@ -177,16 +207,50 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     }
 }
 
+size_t linux_tcp_conn_t::consume_read_buffer(void *buf, size_t size) {
+    size_t n = std::min(read_buffer_size(), size);
+    memcpy(buf, read_buffer.data() + read_buffer_offset, n);
+    read_buffer_offset += n;
+    if (read_buffer_offset == read_buffer.size()) {
+        read_buffer.clear();
+        read_buffer_offset = 0;
+    }
+    return n;
+}
+
+void linux_tcp_conn_t::fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    if (read_buffer_offset > 0) {
+        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_offset);
+        read_buffer_offset = 0;
+    }
+
+    size_t old_size = read_buffer.size();
+    read_buffer.resize(old_size + IO_BUFFER_SIZE);
+    size_t delta;
+    try {
+        delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
+    } catch (const tcp_conn_read_closed_exc_t &) {
+        read_buffer.resize(old_size);
+        throw;
+    }
+
+    read_buffer.resize(old_size + delta);
+}
+
 size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     rassert(size > 0);
     read_op_wrapper_t sentry(this, closer);
 
-    if (read_buffer.size()) {
+    if (read_buffer_size() == 0 && size < IO_BUFFER_SIZE) {
+        /* Callers that read a few bytes at a time (like deserializers reading
+        off a `tcp_conn_stream_t`) would otherwise make a system call for every
+        field, so we read ahead into the peek buffer. Still only _once_. */
+        fill_read_buffer();
+    }
+
+    if (read_buffer_size() > 0) {
         /* Return the data from the peek buffer */
-        size_t read_buffer_bytes = std::min(read_buffer.size(), size);
-        memcpy(buf, read_buffer.data(), read_buffer_bytes);
-        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
-        return read_buffer_bytes;
+        return consume_read_buffer(buf, size);
     } else {
         /* Go to the kernel _once_. */
         return read_internal(buf, size);
@@ -197,9 +261,7 @@ void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONL
     read_op_wrapper_t sentry(this, closer);
 
     /* First, consume any data in the peek buffer */
-    int read_buffer_bytes = std::min(read_buffer.size(), size);
-    memcpy(buf, read_buffer.data(), read_buffer_bytes);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+    size_t read_buffer_bytes = consume_read_buffer(buf, size);
     buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + read_buffer_bytes);
     size -= read_buffer_bytes;
 
@@ -214,12 +276,7 @@ void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONL
 
 void linux_tcp_conn_t::read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
-
-    size_t old_size = read_buffer.size();
-    read_buffer.resize(old_size + IO_BUFFER_SIZE);
-    size_t delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
-
-    read_buffer.resize(old_size + delta);
+    fill_read_buffer();
 }
 
 const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -227,14 +284,16 @@ const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_
     rassert(!read_in_progress);   // Is there a read already in progress?
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
-    return const_charslice(read_buffer.data(), read_buffer.data() + read_buffer.size());
+    return const_charslice(read_buffer.data() + read_buffer_offset,
+                           read_buffer.data() + read_buffer.size());
 }
 
 const_charslice linux_tcp_conn_t::peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    while (read_buffer.size() < size) {
+    while (read_buffer_size() < size) {
         read_more_buffered(closer);
     }
-    return const_charslice(read_buffer.data(), read_buffer.data() + size);
+    return const_charslice(read_buffer.data() + read_buffer_offset,
+                           read_buffer.data() + read_buffer_offset + size);
 }
 
 void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -243,7 +302,11 @@ void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_re
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
     peek(len, closer);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + len);  // INEFFICIENT
+    read_buffer_offset += len;
+    if (read_buffer_offset == read_buffer.size()) {
+        read_buffer.clear();
+        read_buffer_offset = 0;
+    }
 }
 
 void linux_tcp_conn_t::shutdown_read() {
@@ -271,19 +334,50 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
-        parent->perform_write(operation->buffer, operation->size);
-        if (operation->dealloc != NULL) {
-            parent->release_write_buffer(operation->dealloc);
-            parent->write_queue_limiter.unlock(operation->size);
+    parent->perform_queued_writes(operation);
+}
+
+void linux_tcp_conn_t::perform_queued_writes(write_queue_op_t *first) {
+    /* `write_coro_pool` has only one coroutine, so nobody else is taking
+    operations off `write_queue` while we do. */
+    gathered_write_ops.clear();
+    gathered_iovecs.clear();
+    write_queue_op_t *op = first;
+    for (;;) {
+        gathered_write_ops.push_back(op);
+        if (op->iov != NULL) {
+            gathered_iovecs.insert(gathered_iovecs.end(), op->iov, op->iov + op->iovcnt);
+        } else if (op->buffer != NULL) {
+            iovec iov;
+            iov.iov_base = const_cast<void *>(op->buffer);
+            iov.iov_len = op->size;
+            gathered_iovecs.push_back(iov);
+        }
+        if (gathered_iovecs.size() >= static_cast<size_t>(IOV_MAX) || !write_queue.available->get()) {
+            break;
         }
+        op = write_queue.pop();
     }
 
-    if (operation->cond != NULL) {
-        operation->cond->pulse();
+    if (!gathered_iovecs.empty()) {
+        perform_write(gathered_iovecs.data(), gathered_iovecs.size());
     }
-    if (operation->dealloc != NULL) {
-        parent->release_write_queue_op(operation);
+
+    for (size_t i = 0; i < gathered_write_ops.size(); ++i) {
+        op = gathered_write_ops[i];
+        /* Operations without a buffer to free belong to someone waiting on
+        `cond`, who may destroy them as soon as it's pulsed. */
+        write_buffer_t *dealloc = op->dealloc;
+        if (dealloc != NULL) {
+            release_write_buffer(dealloc);
+            write_queue_limiter.unlock(op->size);
+        }
+        if (op->cond != NULL) {
+            op->cond->pulse();
+        }
+        if (dealloc != NULL) {
+            release_write_queue_op(op);
+        }
     }
 }
 
@@ -297,6 +391,8 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->iov = NULL;
+    op->iovcnt = 0;
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
@@ -310,7 +406,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     write_queue.push(op);
 }
 
-void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+void linux_tcp_conn_t::perform_write(iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -320,8 +416,14 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    /* Skip empty buffers, so that we stop when there's nothing left. */
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        ++iov;
+        --iovcnt;
+    }
+
+    while (iovcnt > 0) {
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, IOV_MAX));
 
         if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -354,15 +456,24 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         } else if (res == 0) {
             /* This should never happen either, but it's better to write an error message than to
                crash completely. */
-            logERR("Didn't expect write() to return 0.");
+            logERR("Didn't expect writev() to return 0.");
             on_shutdown_write();
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            /* Move past what was written, which can end partway into a buffer. */
+            size_t written = res;
+            while (iovcnt > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            rassert(iovcnt > 0 || written == 0);
+            if (iovcnt > 0) {
+                iov->iov_base = reinterpret_cast<char *>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
         }
     }
 }
@@ -394,6 +505,27 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::writev(const iovec *iov, int iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* Like in `write()`, we block until the write is done, so the buffers can be
+    written straight from where they are. */
+    op.iov = iov;
+    op.iovcnt = iovcnt;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -583,6 +715,7 @@ linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
     local_addresses(bind_addresses),
     port(_port),
     bound(false),
+    reuse_port(false),
     socks(std::max<size_t>(bind_addresses.size(), 1)), // Without a bind address, we still want a socket
     last_used_socket_index(0),
     event_watchers(socks.size()),
@@ -644,6 +777,11 @@ void linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            guarantee_err(res != -1, "Could not set REUSEPORT option");
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -697,6 +835,7 @@ bool linux_nonthrowing_tcp_listener_t::bind_sockets_internal(int *port_out) {
 
         if (res != 0) {
             if (errno == EADDRINUSE || errno == EACCES) {
+                unbound_address = *addr;
                 result = false;
                 break;
             } else {
@@ -890,6 +1029,120 @@ signal_t *linux_repeated_nonthrowing_tcp_listener_t::get_bound_signal() {
     return &bound_cond;
 }
 
+static bool tcp_reuse_port = false;
+
+void set_tcp_reuse_port(bool enabled) {
+    tcp_reuse_port = enabled;
+}
+
+bool get_tcp_reuse_port() {
+    return tcp_reuse_port;
+}
+
+static bool reuse_port_supported() {
+#ifdef SO_REUSEPORT
+    scoped_fd_t sock(socket(AF_INET, SOCK_STREAM, 0));
+    guarantee_err(sock.get() != INVALID_FD, "Couldn't create socket");
+    int sockoptval = 1;
+    return setsockopt(sock.get(), SOL_SOCKET, SO_REUSEPORT,
+                      &sockoptval, sizeof(sockoptval)) == 0;
+#else
+    return false;
+#endif
+}
+
+linux_threaded_tcp_listener_t::linux_threaded_tcp_listener_t(
+        const std::set<ip_address_t> &bind_addresses, int _port,
+        const std::vector<threadnum_t> &_threads,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &_callback) :
+    threads(_threads),
+    callback(_callback),
+    port(_port),
+    next_thread(0)
+{
+    guarantee(!threads.empty());
+    const bool reuse_port = get_tcp_reuse_port() && threads.size() > 1
+        && reuse_port_supported();
+
+    if (reuse_port && port != ANY_PORT) {
+        // SO_REUSEPORT would let us share the port with anything else that set
+        // it, so first check that the port is free the way an exclusive bind
+        // does.  (Once we're listening, nobody can bind it without
+        // SO_REUSEPORT, and this check keeps other servers from joining us.)
+        linux_nonthrowing_tcp_listener_t exclusive(bind_addresses, port, noop_fun);
+        if (!exclusive.bind_sockets()) {
+            throw address_in_use_exc_t(
+                exclusive.unbound_address.as_dotted_decimal().c_str(), port);
+        }
+    }
+
+    listeners.init(reuse_port ? threads.size() : 1);
+
+    // The first listener picks the port if we were given `ANY_PORT`, so the
+    // rest have to wait for it.
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        bool success;
+        ip_address_t unbound_address;
+        begin_listening_on_thread(i, bind_addresses, reuse_port, &success,
+                                  &unbound_address);
+        if (!success) {
+            stop_listening();
+            throw address_in_use_exc_t(unbound_address.as_dotted_decimal().c_str(), port);
+        }
+    }
+}
+
+linux_threaded_tcp_listener_t::~linux_threaded_tcp_listener_t() {
+    stop_listening();
+}
+
+int linux_threaded_tcp_listener_t::get_port() const {
+    return port;
+}
+
+bool linux_threaded_tcp_listener_t::uses_reuse_port() const {
+    return listeners.size() > 1;
+}
+
+void linux_threaded_tcp_listener_t::begin_listening_on_thread(
+        size_t i, const std::set<ip_address_t> &bind_addresses, bool reuse_port,
+        bool *success_out, ip_address_t *unbound_address_out) {
+    on_thread_t thread_switcher(threads[i]);
+    boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> cb = callback;
+    if (!reuse_port) {
+        cb = boost::bind(&linux_threaded_tcp_listener_t::hand_off, this, _1);
+    }
+    listeners[i].init(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, cb));
+    listeners[i]->reuse_port = reuse_port;
+    *success_out = listeners[i]->begin_listening();
+    if (*success_out) {
+        port = listeners[i]->get_port();
+    } else {
+        *unbound_address_out = listeners[i]->unbound_address;
+    }
+}
+
+void linux_threaded_tcp_listener_t::stop_listening_on_thread(size_t i) {
+    if (listeners[i].has()) {
+        on_thread_t thread_switcher(threads[i]);
+        listeners[i].reset();
+    }
+}
+
+void linux_threaded_tcp_listener_t::stop_listening() {
+    pmap(listeners.size(), boost::bind(&linux_threaded_tcp_listener_t::stop_listening_on_thread,
+                                       this, _1));
+}
+
+void linux_threaded_tcp_listener_t::hand_off(scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn) {
+    // Copy the callback, because we might be destroyed while it runs.
+    boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> cb = callback;
+    threadnum_t thread = threads[next_thread];
+    next_thread = (next_thread + 1) % threads.size();
+    on_thread_t thread_switcher(thread);
+    cb(nconn);
+}
+
 std::vector<std::string> get_ips() {
     std::vector<std::string> ret;
 
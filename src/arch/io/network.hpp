@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -29,6 +30,7 @@
 #include "concurrency/semaphore.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "containers/intrusive_list.hpp"
+#include "containers/slab_allocator.hpp"
 #include "perfmon/types.hpp"
 
 /* linux_tcp_conn_t provides a disgusting wrapper around a TCP network connection. */
@@ -104,6 +106,11 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but it writes several buffers one after the
+    other, with as few system calls as it can.  The buffers aren't copied, so
+    they must stay valid until it returns. */
+    void writev(const iovec *iov, int iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -223,8 +230,20 @@ private:
     /* These are pulsed if and only if the read/write end of the connection has been closed. */
     cond_t read_closed, write_closed;
 
-    /* Holds data that we read from the socket but hasn't been consumed yet */
+    /* Holds data that we read from the socket but hasn't been consumed yet. The
+    unconsumed data starts at `read_buffer_offset`; what's before it is only
+    moved out of the way when we need room to read more. */
     std::vector<char> read_buffer;
+    size_t read_buffer_offset;
+
+    size_t read_buffer_size() const { return read_buffer.size() - read_buffer_offset; }
+
+    /* Copies up to `size` bytes out of `read_buffer` and returns how many. */
+    size_t consume_read_buffer(void *buf, size_t size);
+
+    /* Reads more data onto the end of `read_buffer`, making at most one call to
+    ::read(). */
+    void fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     /* Reads up to the given number of bytes, but not necessarily that many. Simple wrapper around
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
@@ -234,15 +253,22 @@ private:
     static const size_t WRITE_CHUNK_SIZE = 8 * KILOBYTE;
 
     /* Structs to avoid over-using dynamic allocation */
-    struct write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
+    struct write_buffer_t : public intrusive_list_node_t<write_buffer_t>,
+                            public slab_allocated_mixin_t {
         char buffer[WRITE_CHUNK_SIZE];
         size_t size;
     };
 
+    /* An operation with neither `buffer` nor `iov` set just waits for the
+    operations before it. */
     struct write_queue_op_t : public intrusive_list_node_t<write_queue_op_t> {
+        write_queue_op_t()
+            : dealloc(NULL), buffer(NULL), size(0), iov(NULL), iovcnt(0), cond(NULL) { }
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        const iovec *iov;
+        int iovcnt;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -297,9 +323,17 @@ private:
     certain size, we push it onto `write_queue`. */
     scoped_ptr_t<write_buffer_t> current_write_buffer;
 
+    /* Performs a queued write, along with whatever other writes are waiting in
+    `write_queue` behind it, with one call to ::writev() when they fit. */
+    void perform_queued_writes(write_queue_op_t *first);
+
     /* Used to actually perform a write. If the write end of the connection is open, then writes
-    `size` bytes from `buffer` to the socket. */
-    void perform_write(const void *buffer, size_t size);
+    the buffers in `iov` to the socket. Changes `iov` as it goes. */
+    void perform_write(iovec *iov, size_t iovcnt);
+
+    /* Scratch space for `perform_queued_writes()`, kept to avoid allocating. */
+    std::vector<write_queue_op_t *> gathered_write_ops;
+    std::vector<iovec> gathered_iovecs;
 
     scoped_ptr_t<auto_drainer_t> drainer;
 };
@@ -343,6 +377,7 @@ public:
 protected:
     friend class linux_tcp_listener_t;
     friend class linux_tcp_bound_socket_t;
+    friend class linux_threaded_tcp_listener_t;
 
     MUST_USE bool bind_sockets();
 
@@ -375,6 +410,12 @@ private:
     // Inidicates successful binding to a port
     bool bound;
 
+    // Whether to bind with SO_REUSEPORT, so other listeners can share the port
+    bool reuse_port;
+
+    // The address that was already taken, when binding fails
+    ip_address_t unbound_address;
+
     // The sockets to listen for connections on
     scoped_array_t<scoped_fd_t> socks;
 
@@ -430,6 +471,52 @@ private:
     auto_drainer_t drainer;
 };
 
+// Whether `linux_threaded_tcp_listener_t` listens with SO_REUSEPORT.  It's off
+// unless set from the command line.
+void set_tcp_reuse_port(bool enabled);
+bool get_tcp_reuse_port();
+
+/* Listens on a port from several threads at once. With `get_tcp_reuse_port()`,
+each thread gets its own listening socket, bound with SO_REUSEPORT, so the
+kernel spreads incoming connections over the threads and every connection is
+accepted on the thread that handles it; the callback is called on that thread.
+Otherwise (or on kernels without SO_REUSEPORT), the first thread accepts every
+connection on one exclusively bound socket and the callback is called on each
+of the threads in turn. Either way, it throws `address_in_use_exc_t` if anything
+else is bound to the port. Create and destroy it on the same thread. */
+class linux_threaded_tcp_listener_t {
+public:
+    linux_threaded_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
+        const std::vector<threadnum_t> &threads,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+    ~linux_threaded_tcp_listener_t();
+
+    int get_port() const;
+
+    // Whether every thread has its own socket
+    bool uses_reuse_port() const;
+
+private:
+    void begin_listening_on_thread(size_t i, const std::set<ip_address_t> &bind_addresses,
+                                   bool reuse_port, bool *success_out,
+                                   ip_address_t *unbound_address_out);
+    void stop_listening_on_thread(size_t i);
+    void stop_listening();
+
+    // With just one socket, sends a new connection to the next thread
+    void hand_off(scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn);
+
+    const std::vector<threadnum_t> threads;
+    const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> callback;
+    int port;
+
+    // One per thread, or just one without SO_REUSEPORT
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+    size_t next_thread;
+
+    DISABLE_COPYING(linux_threaded_tcp_listener_t);
+};
+
 std::vector<std::string> get_ips();
 
 #endif // ARCH_IO_NETWORK_HPP_
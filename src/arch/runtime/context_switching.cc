@@ -1,9 +1,13 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "arch/runtime/context_switching.hpp"
 
+#include <errno.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #ifndef NDEBUG
 #include <cxxabi.h>   // For __cxa_current_exception_type (see below)
 #endif
@@ -33,11 +37,16 @@ bool context_ref_t::is_nil() {
 
 artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
     : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
+    /* Allocate the stack. We map it ourselves so that pages only take memory
+    once they're touched, and so that `free_unused_space()` can give them back.
+    */
+    stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    guarantee_err(stack != MAP_FAILED, "Could not allocate a coroutine stack");
 
     /* Protect the end of the stack so that we crash when we get a stack
-    overflow instead of corrupting memory. */
+    overflow instead of corrupting memory. The stack is reused for as long as
+    its coroutine exists, so this happens once. */
     mprotect(stack, getpagesize(), PROT_NONE);
 
     /* Register our stack with Valgrind so that it understands what's going on
@@ -124,11 +133,62 @@ artificial_stack_t::~artificial_stack_t() {
 #endif
 #endif
 
-    /* Undo protections changes */
-    mprotect(stack, getpagesize(), PROT_READ | PROT_WRITE);
+    /* Release the stack we allocated, protection page and all */
+    munmap(stack, stack_size);
+}
+
+size_t artificial_stack_t::high_water_mark() {
+    rassert(!context.is_nil(), "the stack is in use");
+
+    /* The part above the page the saved stack pointer is on is in use. Below
+    it, count down to the lowest page that has been touched. */
+    const uintptr_t page_size = getpagesize();
+    const uintptr_t begin = uintptr_t(stack) + page_size;
+    const uintptr_t end = floor_aligned(uintptr_t(context.pointer), page_size);
+    size_t used = uintptr_t(stack) + stack_size - end;
+    if (end <= begin) {
+        return used;
+    }
+
+#ifdef __linux
+    const size_t chunk_pages = 64;
+    unsigned char resident[chunk_pages];
+    uintptr_t lowest_touched = end;
+    for (uintptr_t chunk = begin; chunk < end && lowest_touched == end;
+         chunk += chunk_pages * page_size) {
+        const size_t len = std::min<uintptr_t>(end - chunk, chunk_pages * page_size);
+        if (mincore(reinterpret_cast<void *>(chunk), len, resident) != 0) {
+            lowest_touched = begin;
+            break;
+        }
+        for (size_t i = 0; i < len / page_size; ++i) {
+            if (resident[i] & 1) {
+                lowest_touched = chunk + i * page_size;
+                break;
+            }
+        }
+    }
+    used += end - lowest_touched;
+#else
+    used += end - begin;
+#endif
+    return used;
+}
+
+void artificial_stack_t::free_unused_space() {
+    rassert(!context.is_nil(), "the stack is in use");
+
+    /* Everything below the page the saved stack pointer is on is dead, up to
+    the protection page. */
+    const uintptr_t page_size = getpagesize();
+    const uintptr_t begin = uintptr_t(stack) + page_size;
+    const uintptr_t end = floor_aligned(uintptr_t(context.pointer), page_size);
+    if (end <= begin) {
+        return;
+    }
 
-    /* Release the stack we allocated */
-    free(stack);
+    UNUSED int res = madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+    rassert(res == 0, "madvise failed: %s", strerror(errno));
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
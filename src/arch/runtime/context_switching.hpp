@@ -58,6 +58,16 @@ public:
     /* Returns the end of the stack */
     void* get_stack_bound() { return stack; }
 
+    /* Returns how much of the stack has been touched since it was allocated or
+    last freed by `free_unused_space()`, to the page. `context` must be switched
+    out. */
+    size_t high_water_mark();
+
+    /* Gives the memory of the stack below the stack pointer of `context` back
+    to the OS, which zero-fills it again when it's next touched. `context` must
+    be switched out. */
+    void free_unused_space();
+
 private:
     void *stack;
     size_t stack_size;
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+
 #ifndef NDEBUG
 #include <stack>   /* the data structure, not the run-time concept */
 #endif
@@ -14,16 +16,38 @@
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/timer.hpp"
 #include "config/args.hpp"
 #include "do_on_thread.hpp"
 
 #include "perfmon/perfmon.hpp"
 #include "utils.hpp"
 
+/* Reports the most stack that an idle coroutine on any thread has been found to
+have touched. */
+class perfmon_stack_high_water_t : public perfmon_counter_t {
+public:
+    void record(int64_t usage) {
+        if (usage > get()) {
+            get() = usage;
+        }
+    }
+protected:
+    int64_t combine_stats(const padded_int64_t *data) {
+        int64_t value = 0;
+        for (int i = 0; i < get_num_threads(); i++) {
+            value = std::max(value, data[i].value);
+        }
+        return value;
+    }
+};
+
 static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+static perfmon_stack_high_water_t pm_coroutine_stack_high_water;
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
     &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_coroutine_stack_high_water, "coroutine_stack_high_water",
     NULLPTR);
 
 size_t coro_stack_size = COROUTINE_STACK_SIZE; //Default, setable by command-line parameter
@@ -33,7 +57,7 @@ to operate. There is one per thread; it is constructed by the constructor for
 `coro_runtime_t` and destroyed by the destructor. If one exists, you can find
 it in `cglobals`. */
 
-struct coro_globals_t {
+struct coro_globals_t : public timer_callback_t {
 
     /* The coroutine we're currently in, if any. NULL if we are in the main context. */
     coro_t *current_coro;
@@ -44,8 +68,21 @@ struct coro_globals_t {
     /* The previous context. */
     coro_t *prev_coro;
 
-    /* A list of coro_t objects that are not in use. */
+    /* Lists of coro_t objects that are not in use. The stacks of the
+    `free_coros` (the most recently used ones) are left as they are; the stacks
+    of the `cold_coros` have been given back to the OS. */
     intrusive_list_t<coro_t> free_coros;
+    intrusive_list_t<coro_t> cold_coros;
+
+    /* Rings `COROUTINE_STACK_TRIM_INTERVAL_MS` after a coroutine is returned to
+    `free_coros`, records how much stack the idle coroutines have touched, and
+    moves those past `HOT_COROUTINE_STACKS` that sat idle the whole time to
+    `cold_coros`. NULL when it isn't running. */
+    timer_token_t *trim_timer;
+    timer_handler_t *trim_timer_handler;
+
+    /* The fewest `free_coros` there have been since `trim_timer` was started. */
+    size_t free_coros_low_water;
 
 #ifndef NDEBUG
 
@@ -72,6 +109,9 @@ struct coro_globals_t {
     coro_globals_t()
         : current_coro(NULL)
         , prev_coro(NULL)
+        , trim_timer(NULL)
+        , trim_timer_handler(NULL)
+        , free_coros_low_water(0)
 #ifndef NDEBUG
         , coro_count(0)
         , assert_no_coro_waiting_counter(0)
@@ -83,13 +123,55 @@ struct coro_globals_t {
         /* We shouldn't be shutting down from within a coroutine */
         rassert(!current_coro);
 
+        if (trim_timer != NULL) {
+            trim_timer_handler->cancel_timer(trim_timer);
+        }
+
         /* Destroy remaining coroutines */
         while (coro_t *s = free_coros.head()) {
             free_coros.remove(s);
             delete s;
         }
+        while (coro_t *s = cold_coros.head()) {
+            cold_coros.remove(s);
+            delete s;
+        }
+    }
+
+    void start_trim_timer() {
+        rassert(trim_timer == NULL);
+        free_coros_low_water = free_coros.size();
+        trim_timer_handler = &linux_thread_pool_t::thread->timer_handler;
+        trim_timer = trim_timer_handler->add_timer_internal(
+            COROUTINE_STACK_TRIM_INTERVAL_MS, this, true);
     }
 
+    void on_timer() {
+        trim_timer = NULL;
+
+        /* Only the coroutines that nothing needed since the last ring go cold,
+        so that a thread whose load hovers above `HOT_COROUTINE_STACKS` doesn't
+        give back stacks it is about to touch again. They're the ones at the
+        head of `free_coros`, since `get_coro()` takes from the tail. */
+        size_t excess = free_coros.size() > HOT_COROUTINE_STACKS
+            ? free_coros.size() - HOT_COROUTINE_STACKS : 0;
+        excess = std::min(excess, free_coros_low_water);
+
+        for (coro_t *coro = free_coros.head(); coro != NULL; coro = free_coros.next(coro)) {
+            pm_coroutine_stack_high_water.record(coro->stack.high_water_mark());
+        }
+
+        for (size_t i = 0; i < excess; ++i) {
+            coro_t *cold = free_coros.head();
+            free_coros.remove(cold);
+            cold->stack.free_unused_space();
+            cold_coros.push_back(cold);
+        }
+
+        if (free_coros.size() > HOT_COROUTINE_STACKS) {
+            start_trim_timer();
+        }
+    }
 };
 
 static __thread coro_globals_t *cglobals = NULL;
@@ -139,6 +221,14 @@ coro_t::coro_t() :
 
 void coro_t::return_coro_to_free_list(coro_t *coro) {
     cglobals->free_coros.push_back(coro);
+
+    /* After a burst of activity, most of the coroutines it needed will sit
+    idle, each holding on to whatever stack memory it touched. Keep enough of
+    them ready to absorb the next burst, and have the trim timer release the
+    stacks of the rest once they've been idle for a while. */
+    if (cglobals->trim_timer == NULL) {
+        cglobals->start_trim_timer();
+    }
 }
 
 coro_t::~coro_t() {
@@ -352,11 +442,16 @@ coro_t * coro_t::get_coro() {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
-    if (cglobals->free_coros.size() == 0) {
-        coro = new coro_t();
-    } else {
+    if (cglobals->free_coros.size() != 0) {
         coro = cglobals->free_coros.tail();
         cglobals->free_coros.remove(coro);
+        cglobals->free_coros_low_water = std::min<size_t>(cglobals->free_coros_low_water,
+                                                          cglobals->free_coros.size());
+    } else if (cglobals->cold_coros.size() != 0) {
+        coro = cglobals->cold_coros.tail();
+        cglobals->cold_coros.remove(coro);
+    } else {
+        coro = new coro_t();
     }
 
     rassert(!coro->intrusive_list_node_t<coro_t>::in_a_list());
@@ -1,8 +1,11 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "arch/runtime/event_queue.hpp"
 
+#include <inttypes.h>
 #include <string.h>
 
+#include <vector>
+
 #include "arch/runtime/thread_pool.hpp"
 #include "concurrency/cond_var.hpp"
 #include "utils.hpp"
@@ -11,6 +14,49 @@
 perfmon_duration_sampler_t pm_eventloop(secs_to_ticks(1));
 static perfmon_membership_t pm_eventloop_membership(&get_global_perfmon_collection(), &pm_eventloop, "eventloop");
 
+static int64_t busy_poll_usecs = 0;
+
+void set_busy_poll_usecs(int64_t usecs) {
+    rassert(usecs >= 0);
+    busy_poll_usecs = usecs;
+}
+
+int64_t get_busy_poll_usecs() {
+    return busy_poll_usecs;
+}
+
+/* Reports each thread's event loop separately, since a thread that never
+sleeps is using a whole CPU. */
+class eventloop_threads_perfmon_t
+    : public perfmon_perthread_t<event_queue_stats_t, std::vector<event_queue_stats_t> > {
+protected:
+    void get_thread_stat(event_queue_stats_t *stat) {
+        *stat = linux_thread_pool_t::thread->queue.get_stats();
+    }
+
+    std::vector<event_queue_stats_t> combine_stats(const event_queue_stats_t *stats) {
+        return std::vector<event_queue_stats_t>(stats, stats + get_num_threads());
+    }
+
+    scoped_ptr_t<perfmon_result_t> output_stat(const std::vector<event_queue_stats_t> &stats) {
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            scoped_ptr_t<perfmon_result_t> thread = perfmon_result_t::alloc_map_result();
+            thread->insert("busy_polls",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].busy_polls)));
+            thread->insert("busy_poll_hits",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].busy_poll_hits)));
+            thread->insert("sleeps",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].sleeps)));
+            result->insert(strprintf("thread_%zu", i), thread.release());
+        }
+        return result;
+    }
+};
+
+static eventloop_threads_perfmon_t pm_eventloop_threads;
+static perfmon_membership_t pm_eventloop_threads_membership(&get_global_perfmon_collection(), &pm_eventloop_threads, "eventloop_threads");
+
 std::string format_poll_event(int event) {
     std::string s;
     if (event & poll_event_in) {
@@ -3,6 +3,7 @@
 #define ARCH_RUNTIME_EVENT_QUEUE_HPP_
 
 #include <signal.h>
+#include <stdint.h>
 
 #include <string>
 
@@ -21,6 +22,13 @@ std::string format_poll_event(int event);
 // Queue stats (declared here so whichever queue is chosen can access it)
 extern perfmon_duration_sampler_t pm_eventloop;
 
+// How long, in microseconds, an event loop spins waiting for events and
+// messages from other threads before it blocks in the kernel.  Spinning saves
+// the latency of being woken up, at the cost of a busy CPU.  It's 0 (blocking
+// right away) unless set from the command line before the thread pool starts.
+void set_busy_poll_usecs(int64_t usecs);
+int64_t get_busy_poll_usecs();
+
 /* Pick the queue now*/
 #if !defined(__linux) || defined(NO_EPOLL)
 
@@ -53,27 +53,88 @@ epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
     guarantee_err(epoll_fd >= 0, "Could not create epoll fd");
 }
 
+int epoll_event_queue_t::wait_for_events(int timeout_ms) {
+    int res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, timeout_ms);
+
+    // epoll_wait might return with EINTR in some cases (in
+    // particular under GDB), we just need to retry.
+    if (res == -1 && errno == EINTR) {
+        // If the thread has been signalled, we already handled
+        // the signal in our signal action.
+        res = 0;
+    }
+
+    // When epoll_wait returns with EBADF, EFAULT, and EINVAL,
+    // it probably means that epoll_fd is no longer valid. There's
+    // no reason to try epoll_wait again, unless we can create a
+    // new descriptor (which we probably can't at this point).
+    guarantee_err(res != -1, "Waiting for epoll events failed");
+
+    return res;
+}
+
+int epoll_event_queue_t::busy_poll(ticks_t spin_ticks, bool *found_work_out) {
+    ++stats.busy_polls;
+    *found_work_out = false;
+
+    // Other threads stop waking us up for their messages from here on.
+    parent->set_polling(true);
+
+    ticks_t deadline = get_ticks() + spin_ticks;
+    int res;
+    for (;;) {
+        res = wait_for_events(0);
+        if (res > 0) {
+            *found_work_out = true;
+            break;
+        }
+        if (parent->poll_messages()) {
+            // Delivering the messages can give other threads messages to
+            // send, and makes it likely that more are coming.
+            parent->pump();
+            *found_work_out = true;
+            deadline = get_ticks() + spin_ticks;
+        } else if (get_ticks() >= deadline) {
+            break;
+        }
+    }
+
+    parent->set_polling(false);
+
+    if (*found_work_out) {
+        ++stats.busy_poll_hits;
+    }
+    return res;
+}
+
 void epoll_event_queue_t::run() {
     int res;
 
+    // With busy-polling on, we spin for up to `spin_ticks` before blocking. An
+    // idle thread halves it every time it spins for nothing, down to a fraction
+    // of the full time, and gets all of it back once spinning pays off.
+    const ticks_t max_spin_ticks = get_busy_poll_usecs() * THOUSAND;
+    ticks_t spin_ticks = max_spin_ticks;
+
     // Now, start the loop
     while (!parent->should_shut_down()) {
-        // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
-
-        // epoll_wait might return with EINTR in some cases (in
-        // particular under GDB), we just need to retry.
-        if (res == -1 && errno == EINTR) {
-            // If the thread has been signalled, we already handled
-            // the signal in our signal action.
-            res = 0;
+        res = 0;
+        if (max_spin_ticks > 0) {
+            bool found_work;
+            res = busy_poll(spin_ticks, &found_work);
+            if (found_work) {
+                spin_ticks = max_spin_ticks;
+            } else {
+                spin_ticks = std::max<ticks_t>(spin_ticks / 2,
+                                               max_spin_ticks / MIN_BUSY_POLL_FRACTION);
+            }
         }
 
-        // When epoll_wait returns with EBADF, EFAULT, and EINVAL,
-        // it probably means that epoll_fd is no longer valid. There's
-        // no reason to try epoll_wait again, unless we can create a
-        // new descriptor (which we probably can't at this point).
-        guarantee_err(res != -1, "Waiting for epoll events failed");
+        if (res == 0) {
+            // Grab the events from the kernel!
+            ++stats.sleeps;
+            res = wait_for_events(-1);
+        }
 
         // nevents might be used by forget_resource during the loop
         nevents = res;
@@ -11,6 +11,7 @@
 #include "arch/runtime/event_queue_types.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "config/args.hpp"
+#include "utils.hpp"
 
 // Event queue structure
 struct epoll_event_queue_t {
@@ -25,7 +26,18 @@ public:
     void adjust_resource(fd_t resource, int events, linux_event_callback_t *cb);
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
+    const event_queue_stats_t &get_stats() const { return stats; }
+
 private:
+    // Calls epoll_wait() with the given timeout and returns how many events it
+    // got.
+    int wait_for_events(int timeout_ms);
+
+    // Spins on epoll_wait() and the parent's messages until there are events
+    // or nothing has happened for `spin_ticks`.  Returns the number of events,
+    // and sets `*found_work_out` if there were any events or messages.
+    int busy_poll(ticks_t spin_ticks, bool *found_work_out);
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
@@ -36,6 +48,8 @@ private:
     epoll_event events[MAX_IO_EVENT_PROCESSING_BATCH_SIZE];
     int nevents;
 
+    event_queue_stats_t stats;
+
 #ifndef NDEBUG
     /* In debug mode, check to make sure epoll() doesn't give us events that
     we didn't ask for. The ints stored here are combinations of poll_event_in
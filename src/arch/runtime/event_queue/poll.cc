@@ -99,6 +99,7 @@ void poll_event_queue_t::run() {
 
     // Now, start the loop
     while (!parent->should_shut_down()) {
+        ++stats.sleeps;
         // Grab the events from the kernel!
 #ifndef RDB_TIMER_PROVIDER
 #error "RDB_TIMER_PROVIDER not defined."
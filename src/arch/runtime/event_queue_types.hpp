@@ -3,6 +3,7 @@
 #define ARCH_RUNTIME_EVENT_QUEUE_TYPES_HPP_
 
 #include <signal.h>
+#include <stdint.h>
 
 // Types that are used, in particular, by poll.hpp and epoll.hpp.
 
@@ -15,9 +16,27 @@ struct linux_event_callback_t {
 struct linux_queue_parent_t {
     virtual void pump() = 0;
     virtual bool should_shut_down() = 0;
+
+    // For busy-polling.  While the queue says it's polling, other threads
+    // don't wake it up for the messages they send it, so it has to look for
+    // them with `poll_messages()`, which delivers them and returns true if
+    // there were any.
+    virtual void set_polling(bool polling) = 0;
+    virtual bool poll_messages() = 0;
     virtual ~linux_queue_parent_t() {}
 };
 
+// Counts how a thread's event loop has waited for events, for perfmon.  Only
+// the thread itself changes them.
+struct event_queue_stats_t {
+    event_queue_stats_t() : busy_polls(0), busy_poll_hits(0), sleeps(0) { }
+
+    // The times it spun, and how many of those it found something to do.
+    int64_t busy_polls;
+    int64_t busy_poll_hits;
+    // The times it blocked in the kernel.
+    int64_t sleeps;
+};
 
 #endif  // ARCH_RUNTIME_EVENT_QUEUE_TYPES_HPP_
 
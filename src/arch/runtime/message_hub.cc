@@ -14,11 +14,25 @@
 #define RDB_RELOOP_MESSAGES 0
 #endif
 
+namespace {
+
+// How many times `on_event` goes back for the messages that came in while it
+// was delivering, before it lets the event loop get to other events.
+const int MAX_DELIVERY_ROUNDS = 4;
+
+// Ends the incoming stack of a hub that is delivering messages.
+linux_thread_message_t *busy_marker() {
+    return reinterpret_cast<linux_thread_message_t *>(1);
+}
+
+}  // namespace
+
 linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          linux_thread_pool_t *thread_pool,
                                          threadnum_t current_thread)
     : queue_(queue), thread_pool_(thread_pool), current_thread_(current_thread) {
-
+    incoming_.value.messages = NULL;
+    incoming_.value.polling = false;
     queue_->watch_resource(event_.get_notify_fd(), poll_event_in, this);
 }
 
@@ -27,7 +41,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(queues_[i].msg_local_list.empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_.value.messages == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -70,15 +84,41 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = incoming_messages_.empty();
-        incoming_messages_.push_back(msg);
+    msg_list_t msg_list;
+    msg_list.push_back(msg);
+    push_incoming(&msg_list);
+}
+
+void linux_message_hub_t::push_incoming(msg_list_t *msgs) {
+    rassert(!msgs->empty());
+
+    // Link the messages newest first, like the rest of the stack.
+    linux_thread_message_t *oldest = msgs->head();
+    linux_thread_message_t *chain = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->next_incoming_ = chain;
+        chain = m;
     }
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    linux_thread_message_t *old_head = incoming_.value.messages;
+    for (;;) {
+        oldest->next_incoming_ = old_head;
+        linux_thread_message_t *seen
+            = __sync_val_compare_and_swap(&incoming_.value.messages, old_head, chain);
+        if (seen == old_head) {
+            break;
+        }
+        old_head = seen;
+    }
+
+    // We only need to do a wake up if the stack was empty: otherwise whoever
+    // made it non-empty did, or the hub is awake and delivering messages.  A
+    // hub that's polling will find the messages by itself.  (The
+    // compare-and-swap above is a full barrier, which `set_polling` relies
+    // on.)
+    if (old_head == NULL && !incoming_.value.polling) {
+        // Wakey wakey eggs and bakey
         event_.wakey_wakey();
     }
 }
@@ -92,18 +132,69 @@ void linux_message_hub_t::on_event(int events) {
     // up and so that poll-based event triggering doesn't infinite-loop.
     event_.consume_wakey_wakeys();
 
-    msg_list_t msg_list;
+    deliver_messages();
+}
 
-    // Pull the messages
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        msg_list.append_and_clear(&incoming_messages_);
+void linux_message_hub_t::set_polling(bool polling) {
+    incoming_.value.polling = polling;
+    if (!polling) {
+        // Messages pushed before the other threads saw that we stopped polling
+        // didn't wake us up, so we wake ourselves up for them.
+        __sync_synchronize();
+        if (incoming_.value.messages != NULL) {
+            event_.wakey_wakey();
+        }
     }
+}
 
+bool linux_message_hub_t::poll_messages() {
+    if (incoming_.value.messages == NULL) {
+        return false;
+    }
+    deliver_messages();
+    return true;
+}
+
+void linux_message_hub_t::deliver_messages() {
 #ifndef NDEBUG
     start_watchdog(); // Initialize watchdog before handling messages
 #endif
 
+    // Pull the messages, leaving the busy marker behind so that nobody wakes
+    // us up for the messages that come in while we deliver these.
+    linux_thread_message_t *chain
+        = __sync_lock_test_and_set(&incoming_.value.messages, busy_marker());
+    for (int round = 1; ; ++round) {
+        deliver_incoming(chain);
+
+        // If nothing came in meanwhile, we go back to being idle.
+        chain = __sync_val_compare_and_swap(&incoming_.value.messages, busy_marker(), NULL);
+        if (chain == busy_marker()) {
+            break;
+        }
+        if (round == MAX_DELIVERY_ROUNDS) {
+            // The stack isn't empty, so nobody else will wake us up for it.
+            // If we're polling, we'll find it anyway.
+            if (!incoming_.value.polling) {
+                event_.wakey_wakey();
+            }
+            break;
+        }
+        chain = __sync_lock_test_and_set(&incoming_.value.messages, busy_marker());
+    }
+}
+
+void linux_message_hub_t::deliver_incoming(linux_thread_message_t *chain) {
+    // The chain is newest first; reversing it puts the messages in the order
+    // they were sent.
+    msg_list_t msg_list;
+    while (chain != NULL && chain != busy_marker()) {
+        linux_thread_message_t *next = chain->next_incoming_;
+        chain->next_incoming_ = NULL;
+        msg_list.push_front(chain);
+        chain = next;
+    }
+
     while (linux_thread_message_t *m = msg_list.head()) {
         msg_list.remove(m);
 #ifndef NDEBUG
@@ -131,22 +222,7 @@ void linux_message_hub_t::push_messages() {
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up = thread_pool_->threads[i]->message_hub.incoming_messages_.empty();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+            thread_pool_->threads[i]->message_hub.push_incoming(&queue->msg_local_list);
         }
     }
 }
@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
@@ -43,6 +42,12 @@ public:
     // (which does not have an event queue)
     void insert_external_message(linux_thread_message_t *msg);
 
+    /* While our event loop busy-polls, nobody wakes us up for the messages
+    they send us, and the loop calls `poll_messages()` to deliver them
+    instead. `poll_messages()` returns false if there weren't any. */
+    void set_polling(bool polling);
+    bool poll_messages();
+
     ~linux_message_hub_t();
 
 private:
@@ -57,6 +62,17 @@ private:
     linux_message_hub_t that is not called on the thread that the message hub belongs to. */
     void pull_messages(threadnum_t thread);
 
+    /* Pushes the messages of `msgs` onto our incoming stack, all at once, and
+    wakes us up if we're not awake already. Can be called from any thread. */
+    void push_incoming(msg_list_t *msgs);
+
+    /* Delivers everything on the incoming stack, including what comes in
+    meanwhile, up to a point. */
+    void deliver_messages();
+
+    /* Delivers the messages of a chain taken from the incoming stack. */
+    void deliver_incoming(linux_thread_message_t *chain);
+
     linux_event_queue_t *const queue_;
     linux_thread_pool_t *const thread_pool_;
 
@@ -64,18 +80,29 @@ private:
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed onto the other thread's incoming
+        stack so that we don't have to touch its cache line as often */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    /* Messages from other threads, in a lock-free stack (linked through
+    `next_incoming_`, newest first) that every other thread pushes onto with a
+    compare-and-swap and we take all of at once. While we're delivering
+    messages, the stack is never empty: it ends in `busy_marker()` instead of
+    NULL, so the threads that push messages then know not to wake us up. Nor do
+    they while `polling` is set. It's padded to keep the other threads' writes
+    to it off of our own cache lines.
+    */
+    struct incoming_t {
+        linux_thread_message_t *messages;
+        volatile bool polling;
+    };
+    cache_line_padded_t<incoming_t> incoming_;
 
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto an empty incoming_messages_.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
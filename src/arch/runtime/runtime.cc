@@ -19,6 +19,11 @@ int get_num_threads() {
     return linux_thread_pool_t::thread_pool->n_threads;
 }
 
+int get_thread_numa_node(threadnum_t thread) {
+    assert_good_thread_id(thread);
+    return linux_thread_pool_t::thread_pool->thread_numa_node[thread.threadnum];
+}
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread) {
     rassert(thread.threadnum >= 0, "(thread = %" PRIi32 ")", thread.threadnum);
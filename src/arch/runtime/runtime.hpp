@@ -11,6 +11,12 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The NUMA node the given thread runs on (see `get_numa_nodes()`).  Threads
+// on the same node share a memory controller and last-level cache.  Unless
+// `get_numa_placement()` is on, threads can run anywhere and this is only the
+// node they would be kept on.
+int get_thread_numa_node(threadnum_t thread);
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
@@ -2,11 +2,18 @@
 #define __STDC_FORMAT_MACROS
 #include "arch/runtime/runtime_utils.hpp"
 
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
+#include <map>
+
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "logger.hpp"
+#include "utils.hpp"
 
 #ifndef NDEBUG
 
@@ -36,6 +43,97 @@ int get_cpu_count() {
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+static bool numa_placement = false;
+
+void set_numa_placement(bool enabled) {
+    numa_placement = enabled;
+}
+
+bool get_numa_placement() {
+    return numa_placement;
+}
+
+// Parses a list of CPUs in the kernel's format, like "0-5,12-17".
+static bool parse_cpu_list(const char *list, std::vector<int> *cpus_out) {
+    const char *p = list;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);  // NOLINT(runtime/int)
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;  // NOLINT(runtime/int)
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {  // NOLINT(runtime/int)
+            cpus_out->push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        }
+    }
+    return true;
+}
+
+std::vector<std::vector<int> > get_numa_nodes() {
+    // The node lists include offline CPUs, and CPUs we've been kept off of.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    // Node numbers can have gaps, so we look at what's there.
+    std::map<int, std::vector<int> > nodes;
+    const char *const node_dir = "/sys/devices/system/node";
+    if (DIR *dir = opendir(node_dir)) {
+        while (struct dirent *entry = readdir(dir)) {
+            int node;
+            char dummy;
+            if (sscanf(entry->d_name, "node%d%c", &node, &dummy) != 1) {
+                continue;
+            }
+            std::string path = strprintf("%s/%s/cpulist", node_dir, entry->d_name);
+            FILE *file = fopen(path.c_str(), "r");
+            if (file == NULL) {
+                continue;
+            }
+            char buf[4096];
+            std::vector<int> cpus;
+            if (fgets(buf, sizeof(buf), file) != NULL && parse_cpu_list(buf, &cpus)) {
+                for (size_t i = 0; i < cpus.size(); ++i) {
+                    if (cpus[i] < CPU_SETSIZE
+                        && (!have_allowed || CPU_ISSET(cpus[i], &allowed))) {
+                        nodes[node].push_back(cpus[i]);
+                    }
+                }
+            }
+            fclose(file);
+        }
+        closedir(dir);
+    }
+
+    std::vector<std::vector<int> > ret;
+    for (std::map<int, std::vector<int> >::iterator it = nodes.begin();
+         it != nodes.end(); ++it) {
+        ret.push_back(it->second);
+    }
+    if (ret.empty()) {
+        ret.push_back(std::vector<int>());
+        for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+            if (!have_allowed || CPU_ISSET(cpu, &allowed)) {
+                ret[0].push_back(cpu);
+            }
+        }
+    }
+    return ret;
+}
+
 callable_action_wrapper_t::callable_action_wrapper_t() :
     action_on_heap(false),
     action_(NULL)
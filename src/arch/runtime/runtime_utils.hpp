@@ -6,6 +6,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "containers/intrusive_list.hpp"
 
@@ -15,8 +16,9 @@ typedef int fd_t;
 class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message_t> {
 public:
     linux_thread_message_t()
+        : next_incoming_(NULL)
 #ifndef NDEBUG
-        : reloop_count_(0)
+        , reloop_count_(0)
 #endif
         { }
     virtual void on_thread_switch() = 0;
@@ -24,6 +26,9 @@ protected:
     virtual ~linux_thread_message_t() {}
 private:
     friend class linux_message_hub_t;
+    // Links the message into the destination hub's incoming stack, which can't
+    // use the intrusive list node because it's pushed onto without a lock.
+    linux_thread_message_t *next_incoming_;
 #ifndef NDEBUG
     int reloop_count_;
 #endif
@@ -33,6 +38,16 @@ typedef linux_thread_message_t thread_message_t;
 
 int get_cpu_count();
 
+// The online CPUs of each NUMA node that has any, in node order.  A machine (or
+// kernel) without NUMA looks like one node with all of the CPUs.
+std::vector<std::vector<int> > get_numa_nodes();
+
+// Whether threads are kept on their NUMA node's CPUs, and tables' stores put on
+// the node of their serializer.  It's off (threads go wherever the scheduler
+// puts them) unless set from the command line before the thread pool starts.
+void set_numa_placement(bool enabled);
+bool get_numa_placement();
+
 #ifndef NDEBUG
 // Functions to keep track of running thread_message_t routines using get_clock_cycles
 void enable_watchdog(); // Enables watchdog printouts (off by default to avoid command-line spam)
@@ -39,6 +39,28 @@ linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affini
 
     res = pthread_mutex_init(&shutdown_cond_mutex, NULL);
     guarantee_xerr(res == 0, res, "Could not create shutdown cond mutex");
+
+    // Spread the threads evenly over the CPUs in node order, so each node gets
+    // a share of them in proportion to its CPUs.
+    numa_placement = get_numa_placement();
+    numa_nodes = get_numa_nodes();
+    int ncpus = 0;
+    for (size_t node = 0; node < numa_nodes.size(); ++node) {
+        ncpus += numa_nodes[node].size();
+    }
+    for (int i = 0; i < n_threads; ++i) {
+        thread_numa_node[i] = 0;
+        thread_cpu[i] = -1;
+        int position = ncpus * i / n_threads;
+        for (size_t node = 0; node < numa_nodes.size(); ++node) {
+            if (position < static_cast<int>(numa_nodes[node].size())) {
+                thread_numa_node[i] = node;
+                thread_cpu[i] = numa_nodes[node][position];
+                break;
+            }
+            position -= numa_nodes[node].size();
+        }
+    }
 }
 
 linux_thread_message_t *linux_thread_pool_t::set_interrupt_message(linux_thread_message_t *m) {
@@ -178,18 +200,24 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
 
-        if (do_set_affinity) {
-            // On Apple, the thread affinity API has awful documentation, so we don't even bother.
+        // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
+        if (thread_cpu[i] != -1
+            && (do_set_affinity || (numa_placement && numa_nodes.size() > 1))) {
             cpu_set_t mask;
             CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
+            if (do_set_affinity) {
+                CPU_SET(thread_cpu[i], &mask);
+            } else {
+                const std::vector<int> &cpus = numa_nodes[thread_numa_node[i]];
+                for (size_t j = 0; j < cpus.size(); ++j) {
+                    CPU_SET(cpus[j], &mask);
+                }
+            }
             res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
             guarantee_xerr(res == 0, res, "Could not set thread affinity");
-#endif
         }
+#endif
     }
 
     // Mark the main thread (for use in assertions etc.)
@@ -385,6 +413,14 @@ void linux_thread_t::pump() {
     message_hub.push_messages();
 }
 
+void linux_thread_t::set_polling(bool polling) {
+    message_hub.set_polling(polling);
+}
+
+bool linux_thread_t::poll_messages() {
+    return message_hub.poll_messages();
+}
+
 void linux_thread_t::on_event(int events) {
     // No-op. This is just to make sure that the event queue wakes up
     // so it can shut down.
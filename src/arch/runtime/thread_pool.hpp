@@ -6,6 +6,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "config/args.hpp"
 #include "arch/runtime/event_queue.hpp"
@@ -15,6 +16,7 @@
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/timer.hpp"
+#include "arch/spinlock.hpp"
 
 class linux_thread_t;
 
@@ -90,6 +92,18 @@ public:
 
     int n_threads;
     bool do_set_affinity;
+
+    // The CPUs of each NUMA node (see `get_numa_nodes()`), and the node and CPU
+    // each thread is placed on.  Threads are laid out over the CPUs in node
+    // order, so consecutive threads share a node.  With `do_set_affinity`, each
+    // thread is pinned to its CPU.  Otherwise, with `numa_placement` on a
+    // machine with more than one node, it's kept on its node's CPUs so that
+    // the memory it allocates is local to it.  With neither, threads aren't
+    // pinned at all and the placement is only nominal.
+    bool numa_placement;
+    std::vector<std::vector<int> > numa_nodes;
+    int thread_numa_node[MAX_THREADS];
+    int thread_cpu[MAX_THREADS];
     // The thread_pool that started the thread we are currently in
     static __thread linux_thread_pool_t *thread_pool;
     // The ID of the thread we are currently in
@@ -158,6 +172,8 @@ public:
 
     void pump();   // Called by the event queue
     bool should_shut_down();   // Called by the event queue
+    void set_polling(bool polling);   // Called by the event queue
+    bool poll_messages();   // Called by the event queue
 #ifndef NDEBUG
     void initiate_shut_down(std::map<std::string, size_t> *coroutine_counts); // Can be called from any thread
 #else
@@ -3,19 +3,21 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+class timer_token_t : public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
-
-    friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
+    timer_token_t()
+        : interval_ms(-1), expiration_ms(-1), level(-1), slot(-1), callback(NULL) { }
 
     // The time between rings, if a repeating timer, otherwise zero.
-    int64_t interval_nanos;
+    int64_t interval_ms;
+
+    // The millisecond of the next 'ring'.
+    int64_t expiration_ms;
 
-    // The time of the next 'ring'.
-    int64_t next_time_in_nanos;
+    // The wheel slot the token is in.
+    int level, slot;
 
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
@@ -23,48 +25,167 @@ private:
     DISABLE_COPYING(timer_token_t);
 };
 
-bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right) {
-    return left->next_time_in_nanos < right->next_time_in_nanos;
-}
-
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(0),
+      current_ms(get_ticks() / MILLION),
+      oneshot_ms(-1) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
+    for (int i = 0; i < WHEEL_LEVELS; ++i) {
+        level_sizes[i] = 0;
+    }
 }
 
 timer_handler_t::~timer_handler_t() {
-    guarantee(token_queue.empty());
+    guarantee(empty());
+}
+
+bool timer_handler_t::empty() const {
+    for (int i = 0; i < WHEEL_LEVELS; ++i) {
+        if (level_sizes[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t timer_handler_t::insert(timer_token_t *token) {
+    // Tokens that are already due go in the next slot to be run.
+    int64_t expiration_ms = std::max(token->expiration_ms, current_ms);
+    int64_t delta = expiration_ms - current_ms;
+
+    // Tokens past the reach of the top level wait in its farthest slot, and
+    // get put back when the wheel comes around to it.
+    const int64_t reach = static_cast<int64_t>(1) << (WHEEL_SLOT_BITS * WHEEL_LEVELS);
+    if (delta >= reach) {
+        delta = reach - 1;
+        expiration_ms = current_ms + delta;
+    }
+
+    int level = 0;
+    while ((delta >> (WHEEL_SLOT_BITS * (level + 1))) != 0) {
+        ++level;
+    }
+    const int shift = WHEEL_SLOT_BITS * level;
+    token->level = level;
+    token->slot = (expiration_ms >> shift) & (WHEEL_SLOTS - 1);
+    wheel[level][token->slot].push_back(token);
+    ++level_sizes[level];
+    return (expiration_ms >> shift) << shift;
+}
+
+void timer_handler_t::cascade(int level) {
+    const int shift = WHEEL_SLOT_BITS * level;
+    intrusive_list_t<timer_token_t> *slot =
+        &wheel[level][(current_ms >> shift) & (WHEEL_SLOTS - 1)];
+    while (timer_token_t *token = slot->head()) {
+        slot->remove(token);
+        --level_sizes[level];
+        insert(token);
+    }
+}
+
+void timer_handler_t::schedule_oneshot(int64_t ms) {
+    if (oneshot_ms == -1 || ms < oneshot_ms) {
+        oneshot_ms = ms;
+        expected_oneshot_time_in_nanos = ms * MILLION;
+        timer_provider.schedule_oneshot(ms * MILLION, this);
+    }
+}
+
+int64_t timer_handler_t::next_wakeup_ms() {
+    int64_t best = -1;
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        if (level_sizes[level] == 0) {
+            continue;
+        }
+        const int shift = WHEEL_SLOT_BITS * level;
+        const int64_t span = static_cast<int64_t>(1) << shift;
+        // The current slot of a higher level has been moved down already,
+        // unless we're right at its start, so what's in it is a turn away.
+        int64_t first = current_ms >> shift;
+        if (level > 0 && (current_ms & (span - 1)) != 0) {
+            ++first;
+        }
+        for (int64_t unit = first; unit < first + WHEEL_SLOTS; ++unit) {
+            if (!wheel[level][unit & (WHEEL_SLOTS - 1)].empty()) {
+                const int64_t start = unit << shift;
+                if (best == -1 || start < best) {
+                    best = start;
+                }
+                break;
+            }
+        }
+    }
+    return best;
 }
 
 void timer_handler_t::on_oneshot() {
     // If the timer_provider tends to return its callback a touch early, we don't want to make a
     // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
-    // threshold.  So we bump the real time up to the threshold when processing the priority queue.
+    // threshold.  So we bump the real time up to the threshold when processing the wheel.
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
-
-    while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
-
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
-        if (token->interval_nanos != 0) {
-            token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+    const int64_t now_ms = ticks / MILLION;
+    oneshot_ms = -1;
+
+    while (current_ms <= now_ms) {
+        for (int level = WHEEL_LEVELS - 1; level > 0; --level) {
+            const int64_t span = static_cast<int64_t>(1) << (WHEEL_SLOT_BITS * level);
+            if ((current_ms & (span - 1)) == 0) {
+                cascade(level);
+            }
         }
 
-        token->callback->on_timer();
+        if (level_sizes[0] == 0) {
+            // Nothing can happen before the start of the next slot of the
+            // lowest level that has tokens, so we skip ahead to it.
+            int level = 1;
+            while (level < WHEEL_LEVELS && level_sizes[level] == 0) {
+                ++level;
+            }
+            if (level == WHEEL_LEVELS) {
+                current_ms = now_ms + 1;
+                break;
+            }
+            const int shift = WHEEL_SLOT_BITS * level;
+            current_ms = std::min(((current_ms >> shift) + 1) << shift, now_ms + 1);
+            continue;
+        }
 
-        // Delete nonrepeating timer tokens.
-        if (token->interval_nanos == 0) {
-            delete token;
+        const int64_t slot_ms = current_ms;
+        intrusive_list_t<timer_token_t> *slot = &wheel[0][slot_ms & (WHEEL_SLOTS - 1)];
+        ++current_ms;
+
+        // Repeating timers can be put back in this slot for its next turn, so
+        // we stop at the first token that isn't due.
+        while (timer_token_t *token = slot->head()) {
+            if (token->expiration_ms > slot_ms) {
+                break;
+            }
+            slot->remove(token);
+            --level_sizes[0];
+
+            // Put the repeating timer back in the wheel before the callback can be called (so that
+            // it may be canceled).
+            if (token->interval_ms != 0) {
+                token->expiration_ms = (real_ticks + MILLION - 1) / MILLION + token->interval_ms;
+                insert(token);
+            }
+
+            token->callback->on_timer();
+
+            // Delete nonrepeating timer tokens.
+            if (token->interval_ms == 0) {
+                delete token;
+            }
         }
     }
 
     // We've processed young tokens.  Now schedule a new one-shot (if necessary).
-    if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+    const int64_t next_ms = next_wakeup_ms();
+    if (next_ms != -1) {
+        schedule_oneshot(next_ms);
     }
 }
 
@@ -72,29 +193,31 @@ timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callb
     const int64_t nanos = ms * MILLION;
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t ticks = get_ticks();
+    if (empty()) {
+        // The wheel doesn't turn while it's empty, so catch it up.
+        current_ms = std::max<int64_t>(current_ms, ticks / MILLION);
+    }
 
     timer_token_t *const token = new timer_token_t;
-    token->interval_nanos = once ? 0 : nanos;
-    token->next_time_in_nanos = next_time_in_nanos;
+    token->interval_ms = once ? 0 : ms;
+    // Rounded up, so that the timer never rings early.
+    token->expiration_ms = (ticks + nanos + MILLION - 1) / MILLION;
     token->callback = callback;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
-    }
+    schedule_oneshot(insert(token));
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    wheel[token->level][token->slot].remove(token);
+    --level_sizes[token->level];
     delete token;
 
-    if (token_queue.empty()) {
+    if (empty()) {
         timer_provider.unschedule_oneshot();
+        oneshot_ms = -1;
     }
 }
 
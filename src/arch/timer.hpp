@@ -2,7 +2,7 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
-#include "containers/intrusive_priority_queue.hpp"
+#include "containers/intrusive_list.hpp"
 #include "arch/io/timer_provider.hpp"
 
 class timer_token_t;
@@ -26,6 +26,19 @@ public:
 private:
     void on_oneshot();
 
+    // Puts a token in the wheel slot that its expiration time falls in, and
+    // returns the first millisecond of that slot.
+    int64_t insert(timer_token_t *token);
+    // Moves the tokens in the current slot of the given level down a level.
+    void cascade(int level);
+    // Asks the timer provider to call us back at the given millisecond, if
+    // that's sooner than it's going to already.
+    void schedule_oneshot(int64_t ms);
+    // Returns the first millisecond at which there might be a token to run, or
+    // -1 if there are no tokens.
+    int64_t next_wakeup_ms();
+    bool empty() const;
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
@@ -33,8 +46,24 @@ private:
     // time, we pretend that it had arrived on time.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
-    intrusive_priority_queue_t<timer_token_t> token_queue;
+    /* The timer tokens are kept in a hierarchical timing wheel, so that adding
+    and canceling them takes constant time.  Level 0 has a slot for each of the
+    next 256 milliseconds; each slot of level 1 covers 256 milliseconds, each
+    slot of level 2 covers 256 of those, and so on.  A token goes in the lowest
+    level that reaches its expiration time, and is moved down a level each time
+    the wheel gets to the start of its slot.  Tokens that expire in the same
+    millisecond are run together. */
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_SLOT_BITS = 8;
+    static const int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+    intrusive_list_t<timer_token_t> wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    size_t level_sizes[WHEEL_LEVELS];
+
+    // The next millisecond whose level 0 slot hasn't been run yet.
+    int64_t current_ms;
+
+    // The millisecond the timer provider is going to call us back at, or -1.
+    int64_t oneshot_ms;
 
     DISABLE_COPYING(timer_handler_t);
 };
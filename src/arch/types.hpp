@@ -83,6 +83,9 @@ typedef linux_tcp_listener_t tcp_listener_t;
 class linux_repeated_nonthrowing_tcp_listener_t;
 typedef linux_repeated_nonthrowing_tcp_listener_t repeated_nonthrowing_tcp_listener_t;
 
+class linux_threaded_tcp_listener_t;
+typedef linux_threaded_tcp_listener_t threaded_tcp_listener_t;
+
 class linux_tcp_conn_descriptor_t;
 typedef linux_tcp_conn_descriptor_t tcp_conn_descriptor_t;
 
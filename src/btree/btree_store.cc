@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "btree/btree_store.hpp"
 
+#include <algorithm>
+
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
 #include "concurrency/wait_any.hpp"
@@ -9,9 +11,10 @@
 #include "stl_utils.hpp"
 
 sindex_not_post_constructed_exc_t::sindex_not_post_constructed_exc_t(
-        std::string sindex_name)
+        std::string sindex_name, progress_completion_fraction_t _progress)
     : info(strprintf("Sindex: %s was accessed before it was finished post constructing.",
-                sindex_name.c_str()))
+                sindex_name.c_str())),
+      progress(_progress)
 { }
 
 const char* sindex_not_post_constructed_exc_t::what() const throw() {
@@ -291,6 +294,49 @@ void btree_store_t<protocol_t>::emergency_deregister_sindex_queue(
     deregister_sindex_queue(disk_backed_queue, &acq);
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::register_sindex_progress(
+        const std::set<uuid_u> &sindex_ids,
+        const traversal_progress_t *progress) {
+    assert_thread();
+    for (std::set<uuid_u>::const_iterator it = sindex_ids.begin();
+         it != sindex_ids.end(); ++it) {
+        sindex_progress[*it].push_back(progress);
+    }
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::deregister_sindex_progress(
+        const std::set<uuid_u> &sindex_ids,
+        const traversal_progress_t *progress) {
+    assert_thread();
+    for (std::set<uuid_u>::const_iterator it = sindex_ids.begin();
+         it != sindex_ids.end(); ++it) {
+        std::map<uuid_u, std::vector<const traversal_progress_t *> >::iterator
+            entry = sindex_progress.find(*it);
+        guarantee(entry != sindex_progress.end());
+        std::vector<const traversal_progress_t *>::iterator registered
+            = std::find(entry->second.begin(), entry->second.end(), progress);
+        guarantee(registered != entry->second.end());
+        entry->second.erase(registered);
+        if (entry->second.empty()) {
+            sindex_progress.erase(entry);
+        }
+    }
+}
+
+template <class protocol_t>
+progress_completion_fraction_t btree_store_t<protocol_t>::get_sindex_progress(
+        uuid_u sindex_id) const {
+    assert_thread();
+    std::map<uuid_u, std::vector<const traversal_progress_t *> >::const_iterator it
+        = sindex_progress.find(sindex_id);
+    if (it == sindex_progress.end()) {
+        return progress_completion_fraction_t::make_invalid();
+    }
+    return it->second.back()->guess_completion();
+}
+
 template <class protocol_t>
 void btree_store_t<protocol_t>::sindex_queue_push(const write_message_t &value,
                                                   const mutex_t::acq_t *acq) {
@@ -663,7 +709,7 @@ MUST_USE bool btree_store_t<protocol_t>::acquire_sindex_superblock_for_read(
     }
 
     if (!sindex.post_construction_complete) {
-        throw sindex_not_post_constructed_exc_t(id);
+        throw sindex_not_post_constructed_exc_t(id, get_sindex_progress(sindex.id));
     }
 
     buf_lock_t superblock_lock(txn, sindex.superblock, rwi_read);
@@ -693,7 +739,7 @@ MUST_USE bool btree_store_t<protocol_t>::acquire_sindex_superblock_for_write(
     }
 
     if (!sindex.post_construction_complete) {
-        throw sindex_not_post_constructed_exc_t(id);
+        throw sindex_not_post_constructed_exc_t(id, get_sindex_progress(sindex.id));
     }
 
 
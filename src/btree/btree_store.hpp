@@ -12,6 +12,7 @@
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
+#include "backfill_progress.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/secondary_operations.hpp"
 #include "buffer_cache/mirrored/config.hpp"  // TODO: Move to buffer_cache/config.hpp or something.
@@ -31,11 +32,16 @@ class real_superblock_t;
 
 class sindex_not_post_constructed_exc_t : public std::exception {
 public:
-    explicit sindex_not_post_constructed_exc_t(std::string sindex_name);
+    sindex_not_post_constructed_exc_t(std::string sindex_name,
+                                      progress_completion_fraction_t progress);
     const char* what() const throw();
     ~sindex_not_post_constructed_exc_t() throw();
+    // How far along the sindex's post construction is, which is invalid if it
+    // hasn't started yet.
+    progress_completion_fraction_t get_progress() const { return progress; }
 private:
     std::string info;
+    progress_completion_fraction_t progress;
 };
 
 template <class protocol_t>
@@ -138,6 +144,21 @@ public:
             const write_message_t& value,
             const mutex_t::acq_t *acq);
 
+    /* A post construction registers its progress for the sindexes it builds
+     * while it runs, so that accessing them early can say how far along they
+     * are.  More than one post construction can be building a sindex at once;
+     * each deregisters only its own progress, and the latest one registered is
+     * the one reported. */
+    void register_sindex_progress(
+            const std::set<uuid_u> &sindex_ids,
+            const traversal_progress_t *progress);
+
+    void deregister_sindex_progress(
+            const std::set<uuid_u> &sindex_ids,
+            const traversal_progress_t *progress);
+
+    progress_completion_fraction_t get_sindex_progress(uuid_u sindex_id) const;
+
     void acquire_sindex_block_for_read(
             read_token_pair_t *token_pair,
             transaction_t *txn,
@@ -424,6 +445,8 @@ public:
     std::vector<internal_disk_backed_queue_t *> sindex_queues;
     mutex_t sindex_queue_mutex;
 
+    std::map<uuid_u, std::vector<const traversal_progress_t *> > sindex_progress;
+
     auto_drainer_t drainer;
 
 private:
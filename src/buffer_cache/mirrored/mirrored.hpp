@@ -17,6 +17,7 @@
 #include "concurrency/mutex.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
+#include "containers/slab_allocator.hpp"
 #include "buffer_cache/mirrored/config.hpp"
 #include "buffer_cache/mirrored/stats.hpp"
 #include "repli_timestamp.hpp"
@@ -36,7 +37,8 @@ class mc_cache_account_t;
 // references evictable_t's cache field.
 class mc_inner_buf_t : public evictable_t,
                        private writeback_t::local_buf_t, /* This local_buf_t has state used by the writeback. */
-                       public home_thread_mixin_debug_only_t {
+                       public home_thread_mixin_debug_only_t,
+                       public slab_allocated_mixin_t {
     friend class mc_cache_t;
     friend class mc_transaction_t;
     friend class mc_buf_lock_t;
@@ -139,7 +141,7 @@ struct i_am_writeback_t { };
 // A mc_buf_lock_t acquires and holds an mc_inner_buf_t.  Make sure you call
 // release() as soon as it's feasible to do so.  The destructor will
 // release the mc_inner_buf_t, so don't worry!
-class mc_buf_lock_t : public home_thread_mixin_t {
+class mc_buf_lock_t : public home_thread_mixin_t, public slab_allocated_mixin_t {
 public:
     mc_buf_lock_t(mc_transaction_t *txn, block_id_t block_id, access_t mode,
             buffer_cache_order_mode_t order_mode = buffer_cache_order_mode_check,
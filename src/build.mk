@@ -226,6 +226,10 @@ ifeq ($(MALLOC_PROF),1)
   RT_CXXFLAGS += -DMALLOC_PROF
 endif
 
+ifeq ($(ALLOC_COUNT),1)
+  RT_CXXFLAGS += -DALLOC_COUNT
+endif
+
 ifeq ($(SERIALIZER_DEBUG),1)
   RT_CXXFLAGS += -DSERIALIZER_MARKERS
 endif
@@ -21,7 +21,10 @@
 #include <functional>
 
 #include "arch/io/disk.hpp"
+#include "arch/io/network.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/starter.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
@@ -33,8 +36,10 @@
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/logger.hpp"
 #include "clustering/administration/persist.hpp"
+#include "containers/hugepage_arena.hpp"
 #include "logger.hpp"
 #include "mock/dummy_protocol.hpp"
+#include "rdb_protocol/query_balancer.hpp"
 #include "utils.hpp"
 
 #define RETHINKDB_EXPORT_SCRIPT "rethinkdb-export"
@@ -881,6 +886,10 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--reuse-port"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--reuse-port", "accept driver connections on every core, with a socket per core (needs SO_REUSEPORT, from Linux 3.9)");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -903,6 +912,19 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--balance-queries"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--balance-queries", "run queries on less busy cores than the ones their clients connected to");
+    options_out->push_back(options::option_t(options::names_t("--busy-poll"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--busy-poll usecs", "spin for up to this many microseconds waiting for work before sleeping, trading CPU for latency (0 to never spin)");
+    options_out->push_back(options::option_t(options::names_t("--hugepages"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--hugepages", "keep the buffer cache in huge pages, using transparent huge pages if there aren't enough reserved ones");
+    options_out->push_back(options::option_t(options::names_t("--numa"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--numa", "keep each thread on one NUMA node's cores, and each table's data on one node");
     return help;
 }
 
@@ -917,6 +939,16 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+MUST_USE bool parse_busy_poll_option(const std::map<std::string, options::values_t> &opts) {
+    int usecs = get_single_int(opts, "--busy-poll");
+    if (usecs < 0 || usecs > MAX_BUSY_POLL_USECS) {
+        fprintf(stderr, "ERROR: busy-poll must be between 0 and %lld microseconds\n", MAX_BUSY_POLL_USECS);
+        return false;
+    }
+    set_busy_poll_usecs(usecs);
+    return true;
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1226,6 +1258,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         const std::vector<host_and_port_t> joins = parse_join_options(opts, port_defaults::peer_port);
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
+        set_tcp_reuse_port(exists_option(opts, "--reuse-port"));
 
         const std::string web_path = get_web_path(opts, argv);
 
@@ -1233,6 +1266,12 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        set_query_balancing(exists_option(opts, "--balance-queries"));
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_hugepage_arena_enabled(exists_option(opts, "--hugepages"));
+        set_numa_placement(exists_option(opts, "--numa"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
@@ -1353,6 +1392,7 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
         const std::vector<host_and_port_t> joins = parse_join_options(opts, port_defaults::peer_port);
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
+        set_tcp_reuse_port(exists_option(opts, "--reuse-port"));
 
         if (joins.empty()) {
             fprintf(stderr, "No --join option(s) given. A proxy needs to connect to something!\n"
@@ -1483,6 +1523,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         const std::vector<host_and_port_t> joins = parse_join_options(opts, port_defaults::peer_port);
 
         const service_address_ports_t address_ports = get_service_address_ports(opts);
+        set_tcp_reuse_port(exists_option(opts, "--reuse-port"));
 
         const std::string web_path = get_web_path(opts, argv);
 
@@ -1490,6 +1531,12 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        set_query_balancing(exists_option(opts, "--balance-queries"));
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_hugepage_arena_enabled(exists_option(opts, "--hugepages"));
+        set_numa_placement(exists_option(opts, "--numa"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/runtime_utils.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "serializer/config.hpp"
@@ -100,10 +102,23 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
         = stores_out->stores();
     stores_out_stores->init(num_stores);
 
+    // With NUMA placement, all of a table's stores go on its serializer
+    // thread's node, rather than being spread over the nodes.  They share the
+    // serializer and go through it for every cache miss and writeback, and
+    // each store's cache is allocated on its own thread, so that keeps a
+    // table's memory and I/O on one node.  The cost is that one table's load
+    // is limited to that node's threads.  Different tables' serializer threads
+    // still go round all the threads, so tables spread over the nodes.
+    // (There's always at least one thread on the node: the serializer thread.)
     const threadnum_t serializer_thread = next_thread(num_db_threads);
+    const int numa_node = get_thread_numa_node(serializer_thread);
     std::vector<threadnum_t> store_threads;
     for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+        threadnum_t store_thread = next_thread(num_db_threads);
+        while (get_numa_placement() && get_thread_numa_node(store_thread) != numa_node) {
+            store_thread = next_thread(num_db_threads);
+        }
+        store_threads.push_back(store_thread);
     }
 
     scoped_ptr_t<standard_serializer_t> serializer;
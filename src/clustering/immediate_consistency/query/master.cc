@@ -25,6 +25,56 @@ master_business_card_t<protocol_t> master_t<protocol_t>::get_business_card() {
                                               multi_throttling_server.get_business_card());
 }
 
+template <class protocol_t>
+void master_write_batch_t<protocol_t>::callback_t::on_response(
+        peer_id_t peer, const typename protocol_t::write_response_t &response) {
+    if (!response_promise.get_ready_signal()->is_pulsed()) {
+        ASSERT_NO_CORO_WAITING;
+        ack_set.insert(peer);
+        // TODO: Having this centralized ack checker is horrible?  But maybe it's ok.
+        bool is_acceptable = ack_checker->is_acceptable_ack_set(ack_set);
+        if (is_acceptable) {
+            response_promise.pulse(response);
+        }
+    }
+}
+
+template <class protocol_t>
+void master_write_batch_t<protocol_t>::callback_t::on_done() {
+    done_cond.pulse();
+}
+
+template <class protocol_t>
+bool master_write_batch_t<protocol_t>::try_join(
+        const typename protocol_t::write_t &w, size_t *index_out) {
+    if (num_members >= MAX_COALESCED_WRITES || !write.coalesce(w)) {
+        return false;
+    }
+    *index_out = num_members++;
+    order_token = order_token_t::ignore;
+    return true;
+}
+
+template <class protocol_t>
+bool master_write_batch_t<protocol_t>::try_get_response(
+        size_t index, typename protocol_t::write_response_t *response_out) {
+    if (num_members == 1) {
+        guarantee(index == 0);
+        return callback.response_promise.try_get_value(response_out);
+    }
+    if (!split_responses_ready) {
+        typename protocol_t::write_response_t response;
+        if (!callback.response_promise.try_get_value(&response)) {
+            return false;
+        }
+        write.split_coalesced_response(response, &split_responses);
+        guarantee(split_responses.size() == num_members);
+        split_responses_ready = true;
+    }
+    *response_out = split_responses[index];
+    return true;
+}
+
 template <class protocol_t>
 void master_t<protocol_t>::client_t::perform_request(
         const typename master_business_card_t<protocol_t>::request_t &request,
@@ -41,7 +91,18 @@ void master_t<protocol_t>::client_t::perform_request(
             reply = typename protocol_t::read_response_t();
             typename protocol_t::read_response_t &resp = boost::get<typename protocol_t::read_response_t>(reply);
 
-            fifo_enforcer_sink_t::exit_read_t exiter(&fifo_sink, read->fifo_token);
+            fifo_enforcer_read_token_t broadcast_fifo_token;
+            {
+                fifo_enforcer_sink_t::exit_read_t client_exiter(&fifo_sink, read->fifo_token);
+                wait_interruptible(&client_exiter, interruptor);
+                ASSERT_FINITE_CORO_WAITING;
+                /* A later write from this client mustn't join a batch that
+                will reach the broadcaster before this read. */
+                parent->open_batch.reset();
+                broadcast_fifo_token = parent->broadcast_fifo_source.enter_read();
+            }
+
+            fifo_enforcer_sink_t::exit_read_t exiter(&parent->broadcast_fifo_sink, broadcast_fifo_token);
             parent->broadcaster->read(read->read, &resp, &exiter, read->order_token, interruptor);
         } catch (const cannot_perform_query_exc_t &e) {
             reply = e.what();
@@ -53,30 +114,6 @@ void master_t<protocol_t>::client_t::perform_request(
 
         write->order_token.assert_write_mode();
 
-        // TODO: avoid extra response_t copies here
-        class write_callback_t : public broadcaster_t<protocol_t>::write_callback_t {
-        public:
-            explicit write_callback_t(ack_checker_t *ac) : ack_checker(ac) { }
-            void on_response(peer_id_t peer, const typename protocol_t::write_response_t &response) {
-                if (!response_promise.get_ready_signal()->is_pulsed()) {
-                    ASSERT_NO_CORO_WAITING;
-                    ack_set.insert(peer);
-                    // TODO: Having this centralized ack checker is horrible?  But maybe it's ok.
-                    bool is_acceptable = ack_checker->is_acceptable_ack_set(ack_set);
-                    if (is_acceptable) {
-                        response_promise.pulse(response);
-                    }
-                }
-            }
-            void on_done() {
-                done_cond.pulse();
-            }
-            ack_checker_t *ack_checker;
-            std::set<peer_id_t> ack_set;
-            promise_t<typename protocol_t::write_response_t> response_promise;
-            cond_t done_cond;
-        } write_callback(parent->ack_checker);
-
         /* Avoid a potential race condition where `parent->shutting_down` has
         been pulsed but the `multi_throttling_server_t` hasn't stopped accepting
         requests yet. If we didn't do this, we might let a whole bunch of
@@ -85,28 +122,58 @@ void master_t<protocol_t>::client_t::perform_request(
             return;
         }
 
-        fifo_enforcer_sink_t::exit_write_t exiter(&fifo_sink, write->fifo_token);
-        parent->broadcaster->spawn_write(write->write, &exiter, write->order_token, &write_callback, interruptor, parent->ack_checker);
-
-        wait_any_t waiter(&write_callback.done_cond, write_callback.response_promise.get_ready_signal());
-        /* Now that we've called `spawn_write()`, we've added another entry to
-        the broadcaster's write queue, and that entry will remain there until
-        `on_done()` is called on the write callback above. If we were to respect
-        `interruptor` here, then when we bailed out our multi-throttler ticket
-        would be returned to the free pool. Then if clients repeatedly
-        connected, sent a bunch of operations, and then disconnected, then the
-        broadcaster's write queue would grow without bound. So instead we use
-        our parent's `shutting_down` signal as the interruptor. That way we
-        won't bail out unless we're actually shutting down the broadcaster too.
-        */
+        boost::shared_ptr<master_write_batch_t<protocol_t> > batch;
+        size_t index;
+        {
+            fifo_enforcer_sink_t::exit_write_t client_exiter(&fifo_sink, write->fifo_token);
+            wait_interruptible(&client_exiter, interruptor);
+            ASSERT_FINITE_CORO_WAITING;
+            if (parent->open_batch.get() != NULL
+                && parent->open_batch->try_join(write->write, &index)) {
+                batch = parent->open_batch;
+            } else {
+                batch.reset(new master_write_batch_t<protocol_t>(
+                                parent->ack_checker, write->write, write->order_token,
+                                parent->broadcast_fifo_source.enter_write()));
+                index = 0;
+                parent->open_batch = batch;
+            }
+        }
+
+        if (index == 0) {
+            /* Give requests that arrived at the same time as this one a chance
+            to join the batch. */
+            coro_t::yield();
+            if (parent->open_batch == batch) {
+                parent->open_batch.reset();
+            }
+
+            /* Now that we've called `spawn_write()`, we've added another entry
+            to the broadcaster's write queue, and that entry will remain there
+            until `on_done()` is called on the batch's write callback. If we
+            were to respect `interruptor` here or below, then when we bailed out
+            our multi-throttler ticket would be returned to the free pool. Then
+            if clients repeatedly connected, sent a bunch of operations, and
+            then disconnected, then the broadcaster's write queue would grow
+            without bound. So instead we use our parent's `shutting_down` signal
+            as the interruptor. That way we won't bail out unless we're actually
+            shutting down the broadcaster too. (The other members of the batch
+            are counting on us to send it, too.) */
+            fifo_enforcer_sink_t::exit_write_t exiter(&parent->broadcast_fifo_sink, batch->fifo_token);
+            parent->broadcaster->spawn_write(batch->write, &exiter, batch->order_token,
+                                             &batch->callback, &parent->shutdown_cond,
+                                             parent->ack_checker);
+        }
+
+        wait_any_t waiter(&batch->callback.done_cond, batch->callback.response_promise.get_ready_signal());
         wait_interruptible(&waiter, &parent->shutdown_cond);
 
         typename protocol_t::write_response_t write_response;
-        if (write_callback.response_promise.try_get_value(&write_response)) {
+        if (batch->try_get_response(index, &write_response)) {
             send(parent->mailbox_manager, write->cont_addr,
                  boost::variant<typename protocol_t::write_response_t, std::string>(write_response));
         } else {
-            guarantee(write_callback.done_cond.is_pulsed());
+            guarantee(batch->callback.done_cond.is_pulsed());
             send(parent->mailbox_manager, write->cont_addr,
                  boost::variant<typename protocol_t::write_response_t, std::string>("not enough replicas responded"));
         }
@@ -114,19 +181,21 @@ void master_t<protocol_t>::client_t::perform_request(
         /* When we return, our multi-throttler ticket will be returned to the
         free pool. So don't return until the entry that we made on the
         broadcaster's write queue is gone. */
-        wait_interruptible(&write_callback.done_cond, &parent->shutdown_cond);
+        wait_interruptible(&batch->callback.done_cond, &parent->shutdown_cond);
 
     } else {
         unreachable();
     }
 }
 
-
 #include "memcached/protocol.hpp"
+template class master_write_batch_t<memcached_protocol_t>;
 template class master_t<memcached_protocol_t>;
 
 #include "mock/dummy_protocol.hpp"
+template class master_write_batch_t<mock::dummy_protocol_t>;
 template class master_t<mock::dummy_protocol_t>;
 
 #include "rdb_protocol/protocol.hpp"
+template class master_write_batch_t<rdb_protocol_t>;
 template class master_t<rdb_protocol_t>;
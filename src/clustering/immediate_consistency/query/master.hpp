@@ -6,6 +6,10 @@
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
 
 #include "clustering/generic/multi_throttling_server.hpp"
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
@@ -18,7 +22,11 @@ and forwarding those queries to the `broadcaster_t`. Specifically, the class
 sends the queries to the `master_t`.
 
 `master_t` internally contains a `multi_throttling_server_t`, which is
-responsible for throttling queries from the different `master_access_t`s. */
+responsible for throttling queries from the different `master_access_t`s.
+
+Concurrent writes from different clients are sent to the broadcaster as one
+write when `protocol_t::write_t::coalesce()` can merge them; see
+`master_write_batch_t`. */
 
 class ack_checker_t : public home_thread_mixin_t {
 public:
@@ -34,6 +42,59 @@ private:
 };
 
 
+/* A write that's on its way from a `master_t` to the broadcaster, and the
+requests that were merged into it. The first request to arrive while no batch is
+open starts one, yields once so that requests which arrived at the same time can
+join, and then sends it. Each member replies to its own client once the
+broadcaster has responded. */
+template<class protocol_t>
+class master_write_batch_t {
+public:
+    master_write_batch_t(ack_checker_t *ac,
+                         const typename protocol_t::write_t &w,
+                         order_token_t ot,
+                         fifo_enforcer_write_token_t ft)
+        : write(w), num_members(1), order_token(ot), fifo_token(ft),
+          callback(ac), split_responses_ready(false) { }
+
+    class callback_t : public broadcaster_t<protocol_t>::write_callback_t {
+    public:
+        explicit callback_t(ack_checker_t *ac) : ack_checker(ac) { }
+        void on_response(peer_id_t peer, const typename protocol_t::write_response_t &response);
+        void on_done();
+
+        ack_checker_t *ack_checker;
+        std::set<peer_id_t> ack_set;
+        promise_t<typename protocol_t::write_response_t> response_promise;
+        cond_t done_cond;
+    };
+
+    /* Merges `w` into the batch if there's room and `protocol_t::write_t::coalesce()`
+    allows it, and sets `*index_out` to its place in the batch. A merged write
+    doesn't belong to any one client's order, so it's sent with
+    `order_token_t::ignore`. */
+    MUST_USE bool try_join(const typename protocol_t::write_t &w, size_t *index_out);
+
+    /* Returns the response to the `index`th member of the batch, if the
+    broadcaster has responded. */
+    bool try_get_response(size_t index, typename protocol_t::write_response_t *response_out);
+
+    /* How many requests we merge into one write at most. */
+    static const size_t MAX_COALESCED_WRITES = 100;
+
+    typename protocol_t::write_t write;
+    size_t num_members;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    callback_t callback;
+
+private:
+    bool split_responses_ready;
+    std::vector<typename protocol_t::write_response_t> split_responses;
+
+    DISABLE_COPYING(master_write_batch_t);
+};
+
 template<class protocol_t>
 class master_t {
 public:
@@ -69,6 +130,14 @@ private:
     /* See note in `client_t::perform_request()` for what this is about */
     cond_t shutdown_cond;
 
+    /* Every request takes its place in this FIFO once it has left its client's
+    FIFO, and anything that doesn't join `open_batch` closes it first. That way
+    each client's operations still reach the broadcaster in the order the
+    client sent them, even though batches wait a little before being sent. */
+    fifo_enforcer_source_t broadcast_fifo_source;
+    fifo_enforcer_sink_t broadcast_fifo_sink;
+    boost::shared_ptr<master_write_batch_t<protocol_t> > open_batch;
+
     multi_throttling_server_t<
             typename master_business_card_t<protocol_t>::request_t,
             typename master_business_card_t<protocol_t>::inner_client_business_card_t,
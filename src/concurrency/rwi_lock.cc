@@ -4,10 +4,12 @@
 #include "config/args.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/cond_var.hpp"
+#include "containers/slab_allocator.hpp"
 
 
 struct lock_request_t : public thread_message_t,
-                        public intrusive_list_node_t<lock_request_t>
+                        public intrusive_list_node_t<lock_request_t>,
+                        public slab_allocated_mixin_t
 {
     lock_request_t(access_t _op, lock_available_callback_t *_callback)
         : op(_op), callback(_callback)
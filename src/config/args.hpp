@@ -27,6 +27,13 @@
 // decrease concurrency
 #define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
 
+// An idle busy-polling event loop spins for no less than this fraction of the
+// busy-poll time before it blocks.
+#define MIN_BUSY_POLL_FRACTION                    8
+
+// The most --busy-poll accepts.  Spinning any longer than this saves nothing.
+#define MAX_BUSY_POLL_USECS                       (100 * THOUSAND)
+
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
 // A higher value might be advantageous for throughput if seek times
@@ -131,6 +138,10 @@
 // have to wait until the first one finishes
 #define MAX_CONCURRENT_QUERIES_PER_CONNECTION     500
 
+// With query balancing on, a connection's queries move to another thread when
+// its own thread is running this many more queries than the other one.
+#define QUERY_BALANCING_THRESHOLD                 2
+
 // The number of concurrent queries when loading memcached operations from a file.
 #define MAX_CONCURRENT_QUEURIES_ON_IMPORT         1000
 
@@ -185,10 +196,37 @@
 // doesn't return memory to the OS. If it's set too low, startup will take a longer time.
 #define LBA_READ_BUFFER_SIZE                      GIGABYTE
 
+// How much memory secondary index post construction may fill with computed sindex
+// entries before it sorts them and writes them out.  Bigger batches make the
+// writes more sequential.
+#define SINDEX_POST_CONSTRUCTION_BATCH_SIZE       (64 * MEGABYTE)
+
 #define COROUTINE_STACK_SIZE                      131072
 
+// How many of a thread's idle coroutines keep their stack memory.  The stacks of
+// the rest are given back to the OS until they're used again.
+#define HOT_COROUTINE_STACKS                      64
+
+// How long a thread's idle coroutines past HOT_COROUTINE_STACKS have to go unused
+// before their stacks are given back.
+#define COROUTINE_STACK_TRIM_INTERVAL_MS          1000
+
 #define MAX_COROS_PER_THREAD                      10000
 
+// The slab allocator's slabs, which must be a power of two, the sizes of objects
+// it allocates from them, and the objects' size granularity.
+#define SLAB_SIZE                                 (64 * KILOBYTE)
+#define MAX_SLAB_OBJECT_SIZE                      (16 * KILOBYTE)
+#define SLAB_SIZE_CLASS_STEP                      16
+
+// The chunks the hugepage arena maps buffer cache blocks from, which must be the
+// size (and so the alignment) of a huge page.
+#define HUGEPAGE_ARENA_CHUNK_SIZE                 (2 * MEGABYTE)
+
+// The address space the hugepage arena reserves for its chunks, which bounds the
+// memory it can hand out.  Past it, blocks come from `malloc_aligned()`.
+#define HUGEPAGE_ARENA_MAX_SIZE                   (1 * TERABYTE)
+
 
 // Size of a cache line (used in cache_line_padded_t).
 #define CACHE_LINE_SIZE                           64
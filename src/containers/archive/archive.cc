@@ -31,6 +31,19 @@ int64_t force_read(read_stream_t *s, void *p, int64_t n) {
     return written_so_far;
 }
 
+int64_t write_stream_t::writev(const iovec *iov, int iovcnt) {
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        int64_t res = write(iov[i].iov_base, iov[i].iov_len);
+        if (res == -1) {
+            return -1;
+        }
+        rassert(res == static_cast<int64_t>(iov[i].iov_len));
+        total += res;
+    }
+    return total;
+}
+
 write_message_t::~write_message_t() {
     while (write_buffer_t *buffer = buffers_.head()) {
         buffers_.remove(buffer);
@@ -55,13 +68,27 @@ void write_message_t::append(const void *p, int64_t n) {
 }
 
 int send_write_message(write_stream_t *s, const write_message_t *msg) {
+    // The buffers go to the stream in batches, so that a stream that can write
+    // them all at once doesn't need them copied together first.
+    static const int BATCH_SIZE = 64;
+    iovec iov[BATCH_SIZE];
+    int iovcnt = 0;
+    int64_t batch_bytes = 0;
     intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
     for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
-        if (res == -1) {
-            return -1;
+        iov[iovcnt].iov_base = p->data;
+        iov[iovcnt].iov_len = p->size;
+        ++iovcnt;
+        batch_bytes += p->size;
+        if (iovcnt == BATCH_SIZE || list->next(p) == NULL) {
+            int64_t res = s->writev(iov, iovcnt);
+            if (res == -1) {
+                return -1;
+            }
+            rassert(res == batch_bytes);
+            iovcnt = 0;
+            batch_bytes = 0;
         }
-        rassert(res == p->size);
     }
     return 0;
 }
@@ -3,8 +3,10 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include "containers/intrusive_list.hpp"
+#include "containers/slab_allocator.hpp"
 #include "utils.hpp"
 
 class uuid_u;
@@ -66,13 +68,18 @@ public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual int64_t write(const void *p, int64_t n) = 0;
+    // Writes the buffers one after the other.  Returns the number of bytes, or
+    // -1 upon error.  Blocks until all bytes are written.  Streams that can
+    // write several buffers at once should override this.
+    virtual int64_t writev(const iovec *iov, int iovcnt);
 protected:
     virtual ~write_stream_t() { }
 private:
     DISABLE_COPYING(write_stream_t);
 };
 
-class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
+class write_buffer_t : public intrusive_list_node_t<write_buffer_t>,
+                       public slab_allocated_mixin_t {
 public:
     write_buffer_t() : size(0) { }
 
@@ -0,0 +1,363 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "containers/hugepage_arena.hpp"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "logger.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+namespace {
+
+const size_t chunk_size = HUGEPAGE_ARENA_CHUNK_SIZE;
+const size_t max_chunks = HUGEPAGE_ARENA_MAX_SIZE / HUGEPAGE_ARENA_CHUNK_SIZE;
+
+class thread_arena_t;
+
+// The blocks of one size, for one thread.
+struct block_list_t {
+    struct local_t {
+        thread_arena_t *owner;
+        size_t block_size;
+        // Freed blocks, linked through their first word.
+        void *free_list;
+        // The part of the newest chunk that hasn't been handed out yet.
+        char *next;
+        char *end;
+    };
+
+    // Only touched by the owning thread...
+    cache_line_padded_t<local_t> local;
+    // ...except for this, which other threads push the blocks they free onto.
+    cache_line_padded_t<void *> remote_frees;
+};
+
+class thread_arena_t {
+public:
+    thread_arena_t() : allocations(0), frees(0), next_orphan(NULL) { }
+
+    block_list_t *get_block_list(size_t block_size) {
+        for (size_t i = 0; i < block_lists.size(); ++i) {
+            if (block_lists[i]->local.value.block_size == block_size) {
+                return block_lists[i];
+            }
+        }
+        block_list_t *list = static_cast<block_list_t *>(
+            malloc_aligned(sizeof(block_list_t), CACHE_LINE_SIZE));
+        list->local.value.owner = this;
+        list->local.value.block_size = block_size;
+        list->local.value.free_list = NULL;
+        list->local.value.next = NULL;
+        list->local.value.end = NULL;
+        list->remote_frees.value = NULL;
+        block_lists.push_back(list);
+        return list;
+    }
+
+    // Blocks allocated and freed on the thread.  A block can be freed on
+    // another thread than the one that allocated it, so only the totals over
+    // every thread mean anything.
+    int64_t allocations;
+    int64_t frees;
+
+    // Links the arenas of the threads that have exited.
+    thread_arena_t *next_orphan;
+
+private:
+    // There's one of these for each block size the serializers use, which is
+    // almost always just the one.
+    std::vector<block_list_t *> block_lists;
+
+    DISABLE_COPYING(thread_arena_t);
+};
+
+// The address space the chunks are mapped into, reserved when the arena is
+// first turned on.  Chunks are handed out from it in order, and never given
+// back.
+char *region = NULL;
+size_t chunks_used = 0;
+
+// The block list of each chunk in `region`, by the chunk's index.  Blocks find
+// their owners here, so that freeing doesn't take a lock.
+block_list_t *chunk_lists[max_chunks];
+
+bool arena_enabled = false;
+bool hugetlb_unavailable = false;
+int64_t hugetlb_chunks = 0;
+int64_t transparent_chunks = 0;
+
+// Every thread's arena, for the stats, and the arenas of the threads that have
+// exited, which wait for the next thread that starts.
+pthread_mutex_t arenas_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<thread_arena_t *> *all_arenas = NULL;
+thread_arena_t *orphans = NULL;
+
+pthread_once_t thread_arena_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t thread_arena_key;
+
+__thread thread_arena_t *current_thread_arena = NULL;
+
+void orphan_thread_arena(void *arg) {
+    thread_arena_t *arena = static_cast<thread_arena_t *>(arg);
+    current_thread_arena = NULL;
+    int res = pthread_mutex_lock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not lock arenas_mutex");
+    arena->next_orphan = orphans;
+    orphans = arena;
+    res = pthread_mutex_unlock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not unlock arenas_mutex");
+}
+
+void create_thread_arena_key() {
+    int res = pthread_key_create(&thread_arena_key, &orphan_thread_arena);
+    guarantee_xerr(res == 0, res, "could not create thread_arena_key");
+}
+
+thread_arena_t *get_thread_arena() {
+    if (current_thread_arena != NULL) {
+        return current_thread_arena;
+    }
+
+    int res = pthread_once(&thread_arena_key_once, &create_thread_arena_key);
+    guarantee_xerr(res == 0, res, "pthread_once failed");
+
+    thread_arena_t *arena;
+    res = pthread_mutex_lock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not lock arenas_mutex");
+    arena = orphans;
+    if (arena != NULL) {
+        orphans = arena->next_orphan;
+    } else {
+        arena = new thread_arena_t;
+        if (all_arenas == NULL) {
+            all_arenas = new std::vector<thread_arena_t *>;
+        }
+        all_arenas->push_back(arena);
+    }
+    res = pthread_mutex_unlock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not unlock arenas_mutex");
+    arena->next_orphan = NULL;
+
+    // So that we can hand the arena on when the thread exits.
+    res = pthread_setspecific(thread_arena_key, arena);
+    guarantee_xerr(res == 0, res, "pthread_setspecific failed");
+
+    current_thread_arena = arena;
+    return arena;
+}
+
+#ifndef VALGRIND
+
+// Reserves address space for `max_chunks` chunks, aligned to the chunk size.
+// It takes no memory until the chunks are mapped over it.
+char *reserve_region() {
+    void *reserved = mmap(NULL, (max_chunks + 1) * chunk_size, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        logWRN("Could not reserve address space for the buffer cache's huge pages "
+               "(%s), so it will use ordinary pages.", errno_string(errno).c_str());
+        return NULL;
+    }
+    return reinterpret_cast<char *>(
+        ceil_aligned(reinterpret_cast<uintptr_t>(reserved), chunk_size));
+}
+
+// Maps the next chunk of `region` for `list`, on the calling thread, so that the
+// kernel puts its pages on the thread's NUMA node.  Returns NULL once the region
+// is used up.
+char *map_chunk(block_list_t *list) {
+    const size_t index = __sync_fetch_and_add(&chunks_used, 1);
+    if (index >= max_chunks) {
+        return NULL;
+    }
+    char *chunk = region + index * chunk_size;
+
+    bool mapped = false;
+#ifdef MAP_HUGETLB
+    if (!hugetlb_unavailable) {
+        // This fails before it touches the reservation when there are no huge
+        // pages left.
+        void *res = mmap(chunk, chunk_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+        if (res != MAP_FAILED) {
+            __sync_fetch_and_add(&hugetlb_chunks, 1);
+            mapped = true;
+        } else if (__sync_bool_compare_and_swap(&hugetlb_unavailable, false, true)) {
+            logWRN("Could not map huge pages for the buffer cache (%s), so it will "
+                   "use transparent huge pages where the kernel has them.  Set aside "
+                   "huge pages with the vm.nr_hugepages sysctl to use them instead.",
+                   errno_string(errno).c_str());
+        }
+    }
+#endif
+
+    if (!mapped) {
+        void *res = mmap(chunk, chunk_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        guarantee_err(res != MAP_FAILED, "could not map memory for the buffer cache");
+#ifdef MADV_HUGEPAGE
+        // This fails when the kernel has no transparent huge pages, and then the
+        // chunk just gets ordinary pages.
+        UNUSED int advise_res = madvise(chunk, chunk_size, MADV_HUGEPAGE);
+#endif
+        __sync_fetch_and_add(&transparent_chunks, 1);
+    }
+
+    chunk_lists[index] = list;
+    return chunk;
+}
+
+// Returns NULL once the arena is full.
+void *allocate_block(size_t block_size) {
+    thread_arena_t *arena = get_thread_arena();
+    block_list_t *list = arena->get_block_list(block_size);
+    block_list_t::local_t *local = &list->local.value;
+
+    if (local->free_list == NULL && list->remote_frees.value != NULL) {
+        // Take back everything the other threads have freed at once.
+        local->free_list = __sync_lock_test_and_set(&list->remote_frees.value,
+                                                    static_cast<void *>(NULL));
+    }
+
+    void *ptr = local->free_list;
+    if (ptr != NULL) {
+        local->free_list = *static_cast<void **>(ptr);
+    } else {
+        if (static_cast<size_t>(local->end - local->next) < block_size) {
+            char *chunk = map_chunk(list);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            local->next = chunk;
+            local->end = chunk + chunk_size;
+        }
+        ptr = local->next;
+        local->next += block_size;
+    }
+    ++arena->allocations;
+    return ptr;
+}
+
+#endif  // VALGRIND
+
+// Returns false if `ptr` didn't come from the arena.
+bool free_block(void *ptr) {
+    const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr)
+        - reinterpret_cast<uintptr_t>(region);
+    if (region == NULL || offset >= max_chunks * chunk_size) {
+        return false;
+    }
+    block_list_t *list = chunk_lists[offset / chunk_size];
+    rassert(list != NULL);
+    thread_arena_t *arena = get_thread_arena();
+    ++arena->frees;
+
+    if (list->local.value.owner == arena) {
+        *static_cast<void **>(ptr) = list->local.value.free_list;
+        list->local.value.free_list = ptr;
+    } else {
+        void *head = list->remote_frees.value;
+        for (;;) {
+            *static_cast<void **>(ptr) = head;
+            void *seen = __sync_val_compare_and_swap(&list->remote_frees.value,
+                                                     head, ptr);
+            if (seen == head) {
+                break;
+            }
+            head = seen;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void set_hugepage_arena_enabled(bool enabled) {
+#ifndef VALGRIND
+    if (enabled && region == NULL) {
+        region = reserve_region();
+    }
+#endif
+    arena_enabled = enabled && region != NULL;
+}
+
+bool get_hugepage_arena_enabled() {
+    return arena_enabled;
+}
+
+// With valgrind, everything goes to `malloc_aligned()`, so that it can see
+// use-after-free errors.
+
+void *hugepage_arena_malloc(size_t size, size_t alignment) {
+    rassert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    rassert(alignment <= chunk_size);
+#ifndef VALGRIND
+    const size_t block_size = ceil_aligned(std::max(size, sizeof(void *)), alignment);
+    if (arena_enabled && block_size <= chunk_size) {
+        void *ptr = allocate_block(block_size);
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+#endif
+    return malloc_aligned(size, alignment);
+}
+
+void hugepage_arena_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (free_block(ptr)) {
+        return;
+    }
+    free(ptr);
+}
+
+hugepage_arena_stats_t get_hugepage_arena_stats() {
+    hugepage_arena_stats_t stats;
+    stats.hugetlb_chunks = hugetlb_chunks;
+    stats.transparent_chunks = transparent_chunks;
+    int res = pthread_mutex_lock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not lock arenas_mutex");
+    if (all_arenas != NULL) {
+        for (size_t i = 0; i < all_arenas->size(); ++i) {
+            stats.blocks += (*all_arenas)[i]->allocations - (*all_arenas)[i]->frees;
+        }
+    }
+    res = pthread_mutex_unlock(&arenas_mutex);
+    guarantee_xerr(res == 0, res, "could not unlock arenas_mutex");
+    return stats;
+}
+
+class hugepage_arena_perfmon_t : public perfmon_t {
+public:
+    void *begin_stats() {
+        return NULL;
+    }
+
+    void visit_stats(void *) { }
+
+    scoped_ptr_t<perfmon_result_t> end_stats(void *) {
+        const hugepage_arena_stats_t stats = get_hugepage_arena_stats();
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        result->insert("hugetlb_chunks",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.hugetlb_chunks)));
+        result->insert("transparent_chunks",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.transparent_chunks)));
+        result->insert("blocks",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.blocks)));
+        return result;
+    }
+};
+
+static hugepage_arena_perfmon_t pm_hugepage_arena;
+static perfmon_membership_t pm_hugepage_arena_membership(&get_global_perfmon_collection(), &pm_hugepage_arena, "hugepage_arena");
@@ -0,0 +1,55 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_HUGEPAGE_ARENA_HPP_
+#define CONTAINERS_HUGEPAGE_ARENA_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* An arena for the buffer cache's blocks, backed by huge pages so that walking a
+big cache doesn't miss the TLB on every block.
+
+The arena reserves `HUGEPAGE_ARENA_MAX_SIZE` of address space when it's turned
+on, and maps it `HUGEPAGE_ARENA_CHUNK_SIZE` bytes at a time.  It first asks for
+explicit huge pages (`MAP_HUGETLB`, which need to be set aside with
+`vm.nr_hugepages`); once those run out or turn out not to be there, it maps
+ordinary memory and asks for transparent huge pages with `MADV_HUGEPAGE`, which
+the kernel gives when it can.
+
+Each thread maps its own chunks, so their pages land on the thread's NUMA node,
+and each chunk holds blocks of one size.  Blocks go back on the free list of the
+thread that allocated them: a block freed on another thread goes onto a
+lock-free stack, which the owner takes back when its own free list runs dry, as
+in the slab allocator.  A fixed table, indexed by the chunk's place in the
+reserved space, finds a block's owner.
+
+Chunks are never given back to the system, so the arena grows to the most
+blocks the caches have held at once (which their page replacement keeps under
+their memory limits) and then recycles them. */
+
+// Whether block buffers come from the arena.  It's off unless turned on from the
+// command line, and it has to be set before any block is allocated.
+void set_hugepage_arena_enabled(bool enabled);
+bool get_hugepage_arena_enabled();
+
+/* Allocates `size` bytes aligned to `alignment`, which must be a power of two no
+bigger than a chunk.  With the arena off or full (or for sizes bigger than a
+chunk) this is `malloc_aligned()`. */
+void *hugepage_arena_malloc(size_t size, size_t alignment);
+
+/* Frees memory from `hugepage_arena_malloc()`.  Memory that didn't come from the
+arena goes to `free()`, so this is safe for any `malloc()`ed pointer. */
+void hugepage_arena_free(void *ptr);
+
+struct hugepage_arena_stats_t {
+    hugepage_arena_stats_t() : hugetlb_chunks(0), transparent_chunks(0), blocks(0) { }
+    // Chunks mapped with explicit huge pages.
+    int64_t hugetlb_chunks;
+    // Chunks mapped with ordinary pages, advised to be huge.
+    int64_t transparent_chunks;
+    // Blocks allocated from the arena and not yet freed.
+    int64_t blocks;
+};
+
+hugepage_arena_stats_t get_hugepage_arena_stats();
+
+#endif  // CONTAINERS_HUGEPAGE_ARENA_HPP_
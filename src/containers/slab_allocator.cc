@@ -0,0 +1,386 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "containers/slab_allocator.hpp"
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <new>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+namespace {
+
+const size_t slab_size = SLAB_SIZE;
+const size_t max_object_size = MAX_SLAB_OBJECT_SIZE;
+const size_t size_class_step = SLAB_SIZE_CLASS_STEP;
+const size_t num_size_classes = MAX_SLAB_OBJECT_SIZE / SLAB_SIZE_CLASS_STEP + 1;
+
+class thread_slabs_t;
+struct slab_header_t;
+
+// The objects of one size, for one thread.
+struct size_class_t {
+    struct local_t {
+        thread_slabs_t *owner;
+        size_t object_size;
+        // The slab objects are allocated from.
+        slab_header_t *current;
+        // The other slabs that have room for more objects.
+        slab_header_t *partial;
+        // An empty slab kept back for when `current` fills up, so that
+        // allocating and freeing around a slab boundary doesn't allocate and
+        // free a slab every time.  Other empty slabs are freed.
+        slab_header_t *spare;
+    };
+
+    // Only touched by the owning thread...
+    cache_line_padded_t<local_t> local;
+    // ...except for this, which other threads push the objects they free onto.
+    cache_line_padded_t<void *> remote_frees;
+};
+
+// Starts every slab, so that an object's slab can be found from its address.
+// It takes up a whole cache line, to keep the objects aligned.
+struct slab_header_t {
+    size_class_t *size_class;
+    // The slab's freed objects, linked through their first word.
+    void *free_list;
+    // The part of the slab that hasn't been handed out yet.
+    char *next;
+    // How many of the slab's objects are allocated.
+    size_t allocated;
+    // Links the size class's `partial` list, if the slab is on it.
+    slab_header_t *prev_partial;
+    slab_header_t *next_partial;
+    bool is_partial;
+};
+
+const size_t slab_header_size = CACHE_LINE_SIZE;
+
+class thread_slabs_t {
+public:
+    thread_slabs_t() {
+        for (size_t i = 0; i < num_size_classes; ++i) {
+            size_classes[i] = NULL;
+        }
+    }
+
+    size_class_t *get_size_class(size_t size) {
+        const size_t index = (size + size_class_step - 1) / size_class_step;
+        rassert(index < num_size_classes);
+        size_class_t *size_class = size_classes[index];
+        if (size_class == NULL) {
+            size_class = static_cast<size_class_t *>(
+                malloc_aligned(sizeof(size_class_t), CACHE_LINE_SIZE));
+            size_class->local.value.owner = this;
+            size_class->local.value.object_size
+                = std::max(index * size_class_step, sizeof(void *));
+            size_class->local.value.current = NULL;
+            size_class->local.value.partial = NULL;
+            size_class->local.value.spare = NULL;
+            size_class->remote_frees.value = NULL;
+            size_classes[index] = size_class;
+        }
+        return size_class;
+    }
+
+    slab_allocator_stats_t stats;
+
+    // Links the threads' slabs that are waiting to be taken over.
+    thread_slabs_t *next_orphan;
+
+private:
+    size_class_t *size_classes[num_size_classes];
+
+    DISABLE_COPYING(thread_slabs_t);
+};
+
+// The slabs of the threads that have exited.
+pthread_mutex_t orphans_mutex = PTHREAD_MUTEX_INITIALIZER;
+thread_slabs_t *orphans = NULL;
+
+pthread_once_t thread_slabs_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t thread_slabs_key;
+
+__thread thread_slabs_t *current_thread_slabs = NULL;
+
+void orphan_thread_slabs(void *arg) {
+    thread_slabs_t *slabs = static_cast<thread_slabs_t *>(arg);
+    current_thread_slabs = NULL;
+    int res = pthread_mutex_lock(&orphans_mutex);
+    guarantee_xerr(res == 0, res, "could not lock orphans_mutex");
+    slabs->next_orphan = orphans;
+    orphans = slabs;
+    res = pthread_mutex_unlock(&orphans_mutex);
+    guarantee_xerr(res == 0, res, "could not unlock orphans_mutex");
+}
+
+void create_thread_slabs_key() {
+    int res = pthread_key_create(&thread_slabs_key, &orphan_thread_slabs);
+    guarantee_xerr(res == 0, res, "could not create thread_slabs_key");
+}
+
+thread_slabs_t *get_thread_slabs() {
+    if (current_thread_slabs != NULL) {
+        return current_thread_slabs;
+    }
+
+    int res = pthread_once(&thread_slabs_key_once, &create_thread_slabs_key);
+    guarantee_xerr(res == 0, res, "pthread_once failed");
+
+    thread_slabs_t *slabs;
+    res = pthread_mutex_lock(&orphans_mutex);
+    guarantee_xerr(res == 0, res, "could not lock orphans_mutex");
+    slabs = orphans;
+    if (slabs != NULL) {
+        orphans = slabs->next_orphan;
+    }
+    res = pthread_mutex_unlock(&orphans_mutex);
+    guarantee_xerr(res == 0, res, "could not unlock orphans_mutex");
+
+    if (slabs == NULL) {
+        slabs = new thread_slabs_t;
+    }
+    slabs->next_orphan = NULL;
+
+    // So that we can hand the slabs on when the thread exits.
+    res = pthread_setspecific(thread_slabs_key, slabs);
+    guarantee_xerr(res == 0, res, "pthread_setspecific failed");
+
+    current_thread_slabs = slabs;
+    return slabs;
+}
+
+#ifndef VALGRIND
+
+slab_header_t *slab_of(void *ptr) {
+    return reinterpret_cast<slab_header_t *>(
+        reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(slab_size - 1));
+}
+
+char *slab_objects(slab_header_t *slab) {
+    return reinterpret_cast<char *>(slab) + slab_header_size;
+}
+
+slab_header_t *new_slab(thread_slabs_t *slabs, size_class_t *size_class) {
+    CT_ASSERT(sizeof(slab_header_t) <= slab_header_size);
+    slab_header_t *slab = static_cast<slab_header_t *>(
+        malloc_aligned(slab_size, slab_size));
+    slab->size_class = size_class;
+    slab->free_list = NULL;
+    slab->next = slab_objects(slab);
+    slab->allocated = 0;
+    slab->prev_partial = NULL;
+    slab->next_partial = NULL;
+    slab->is_partial = false;
+    ++slabs->stats.slabs;
+    return slab;
+}
+
+void add_partial(size_class_t::local_t *local, slab_header_t *slab) {
+    rassert(!slab->is_partial);
+    slab->is_partial = true;
+    slab->prev_partial = NULL;
+    slab->next_partial = local->partial;
+    if (local->partial != NULL) {
+        local->partial->prev_partial = slab;
+    }
+    local->partial = slab;
+}
+
+void remove_partial(size_class_t::local_t *local, slab_header_t *slab) {
+    rassert(slab->is_partial);
+    slab->is_partial = false;
+    if (slab->prev_partial != NULL) {
+        slab->prev_partial->next_partial = slab->next_partial;
+    } else {
+        local->partial = slab->next_partial;
+    }
+    if (slab->next_partial != NULL) {
+        slab->next_partial->prev_partial = slab->prev_partial;
+    }
+}
+
+// Puts a freed object back in its slab, on the thread that owns the slab.
+void release_object(thread_slabs_t *slabs, size_class_t::local_t *local, void *ptr) {
+    slab_header_t *slab = slab_of(ptr);
+    *static_cast<void **>(ptr) = slab->free_list;
+    slab->free_list = ptr;
+    --slab->allocated;
+
+    if (slab == local->current) {
+        return;
+    }
+    if (slab->allocated == 0) {
+        if (slab->is_partial) {
+            remove_partial(local, slab);
+        }
+        if (local->spare == NULL) {
+            slab->free_list = NULL;
+            slab->next = slab_objects(slab);
+            local->spare = slab;
+        } else {
+            free(slab);
+            --slabs->stats.slabs;
+        }
+    } else if (!slab->is_partial) {
+        add_partial(local, slab);
+    }
+}
+
+// Takes back everything the other threads have freed at once.
+void take_remote_frees(thread_slabs_t *slabs, size_class_t *size_class) {
+    void *ptr = __sync_lock_test_and_set(&size_class->remote_frees.value,
+                                         static_cast<void *>(NULL));
+    while (ptr != NULL) {
+        void *next = *static_cast<void **>(ptr);
+        release_object(slabs, &size_class->local.value, ptr);
+        ptr = next;
+    }
+}
+
+void *allocate_from_slab(size_class_t::local_t *local, slab_header_t *slab) {
+    void *ptr = slab->free_list;
+    if (ptr != NULL) {
+        slab->free_list = *static_cast<void **>(ptr);
+        ++slab->allocated;
+        return ptr;
+    }
+    char *end = reinterpret_cast<char *>(slab) + slab_size;
+    if (static_cast<size_t>(end - slab->next) >= local->object_size) {
+        ptr = slab->next;
+        slab->next += local->object_size;
+        ++slab->allocated;
+        return ptr;
+    }
+    return NULL;
+}
+
+void *allocate_small(size_t size) {
+    thread_slabs_t *slabs = get_thread_slabs();
+    size_class_t *size_class = slabs->get_size_class(size);
+    size_class_t::local_t *local = &size_class->local.value;
+    ++slabs->stats.allocations;
+
+    if (local->current != NULL) {
+        void *ptr = allocate_from_slab(local, local->current);
+        if (ptr != NULL) {
+            return ptr;
+        }
+        if (size_class->remote_frees.value != NULL) {
+            take_remote_frees(slabs, size_class);
+            ptr = allocate_from_slab(local, local->current);
+            if (ptr != NULL) {
+                return ptr;
+            }
+        }
+    }
+
+    // `current` is full; it joins the partial list once something in it is
+    // freed.
+    if (local->partial != NULL) {
+        local->current = local->partial;
+        remove_partial(local, local->current);
+    } else if (local->spare != NULL) {
+        local->current = local->spare;
+        local->spare = NULL;
+    } else {
+        local->current = new_slab(slabs, size_class);
+    }
+    void *ptr = allocate_from_slab(local, local->current);
+    rassert(ptr != NULL);
+    return ptr;
+}
+
+void free_small(void *ptr) {
+    size_class_t *size_class = slab_of(ptr)->size_class;
+    thread_slabs_t *slabs = get_thread_slabs();
+
+    if (size_class->local.value.owner == slabs) {
+        release_object(slabs, &size_class->local.value, ptr);
+        if (size_class->remote_frees.value != NULL) {
+            take_remote_frees(slabs, size_class);
+        }
+    } else {
+        ++slabs->stats.remote_frees;
+        void *head = size_class->remote_frees.value;
+        for (;;) {
+            *static_cast<void **>(ptr) = head;
+            void *seen = __sync_val_compare_and_swap(&size_class->remote_frees.value,
+                                                     head, ptr);
+            if (seen == head) {
+                break;
+            }
+            head = seen;
+        }
+    }
+}
+
+#endif  // VALGRIND
+
+}  // namespace
+
+// With valgrind, everything goes to `::operator new`, so that it can see
+// use-after-free errors.
+
+void *slab_allocate(size_t size) {
+#ifndef VALGRIND
+    if (size <= max_object_size) {
+        return allocate_small(size);
+    }
+#endif
+    return ::operator new(size);
+}
+
+void slab_free(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+#ifndef VALGRIND
+    if (size <= max_object_size) {
+        free_small(ptr);
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
+
+slab_allocator_stats_t get_thread_slab_allocator_stats() {
+    return get_thread_slabs()->stats;
+}
+
+class slab_allocator_perfmon_t
+    : public perfmon_perthread_t<slab_allocator_stats_t> {
+protected:
+    void get_thread_stat(slab_allocator_stats_t *stat) {
+        *stat = get_thread_slab_allocator_stats();
+    }
+
+    slab_allocator_stats_t combine_stats(const slab_allocator_stats_t *stats) {
+        slab_allocator_stats_t combined;
+        for (int i = 0; i < get_num_threads(); ++i) {
+            combined.allocations += stats[i].allocations;
+            combined.remote_frees += stats[i].remote_frees;
+            combined.slabs += stats[i].slabs;
+        }
+        return combined;
+    }
+
+    scoped_ptr_t<perfmon_result_t> output_stat(const slab_allocator_stats_t &stats) {
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        result->insert("allocations",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.allocations)));
+        result->insert("remote_frees",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.remote_frees)));
+        result->insert("slabs",
+                       new perfmon_result_t(strprintf("%" PRIi64, stats.slabs)));
+        return result;
+    }
+};
+
+static slab_allocator_perfmon_t pm_slab_allocator;
+static perfmon_membership_t pm_slab_allocator_membership(&get_global_perfmon_collection(), &pm_slab_allocator, "slab_allocator");
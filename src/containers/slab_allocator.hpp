@@ -0,0 +1,66 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_SLAB_ALLOCATOR_HPP_
+#define CONTAINERS_SLAB_ALLOCATOR_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A per-thread slab allocator for small objects that get allocated and freed
+all the time.  Sizes are rounded up to a multiple of `SLAB_SIZE_CLASS_STEP`,
+and each thread keeps its own free list and slabs for every size, so most
+allocations and frees touch nothing that another thread does.
+
+An object freed on another thread than the one that allocated it goes onto a
+lock-free stack belonging to the allocating thread, which takes the whole stack
+back the next time it frees an object of that size, or fills up its slab for
+that size.  When a thread exits, its slabs wait for the next thread that starts,
+which takes them over.
+
+Each slab keeps its own free list and count of allocated objects.  Once every
+object in a slab has been freed, the slab is given back, except for one empty
+slab per size that is kept for reuse.  Sizes bigger than
+`MAX_SLAB_OBJECT_SIZE` go to `::operator new`. */
+
+void *slab_allocate(size_t size);
+
+/* `size` must be the same size as the object was allocated with. */
+void slab_free(void *ptr, size_t size);
+
+struct slab_allocator_stats_t {
+    slab_allocator_stats_t() : allocations(0), remote_frees(0), slabs(0) { }
+    // Allocations made on the thread.
+    int64_t allocations;
+    // Frees of objects that other threads allocated, made on the thread.
+    int64_t remote_frees;
+    // The slabs the thread holds.
+    int64_t slabs;
+};
+
+/* The stats of the calling thread. */
+slab_allocator_stats_t get_thread_slab_allocator_stats();
+
+/* Classes that inherit from `slab_allocated_mixin_t` are allocated with
+`slab_allocate()`.  They have to be deleted as themselves, or through a base
+class with a virtual destructor, so that `operator delete` gets the right size.
+*/
+class slab_allocated_mixin_t {
+public:
+    static void *operator new(size_t size) {
+        return slab_allocate(size);
+    }
+    static void operator delete(void *ptr, size_t size) {
+        slab_free(ptr, size);
+    }
+
+    // Placement new, which the ones above would hide otherwise.
+    static void *operator new(size_t, void *ptr) {
+        return ptr;
+    }
+    static void operator delete(void *, void *) { }
+
+protected:
+    slab_allocated_mixin_t() { }
+    ~slab_allocated_mixin_t() { }
+};
+
+#endif  // CONTAINERS_SLAB_ALLOCATOR_HPP_
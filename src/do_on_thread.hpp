@@ -3,13 +3,15 @@
 #define DO_ON_THREAD_HPP_
 
 #include "arch/runtime/runtime.hpp"
+#include "containers/slab_allocator.hpp"
 #include "utils.hpp"
 
 /* Functions to do something on another core in a way that is more convenient than
 continue_on_thread() is. */
 
 template <class callable_t>
-struct thread_doer_t : public thread_message_t, public home_thread_mixin_t {
+struct thread_doer_t : public thread_message_t, public home_thread_mixin_t,
+                       public slab_allocated_mixin_t {
     const callable_t callable;
     threadnum_t thread;
     enum state_t {
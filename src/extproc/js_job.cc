@@ -13,6 +13,7 @@
 #endif
 
 #include <cmath>
+#include <unordered_map>
 
 #include "extproc/js_job.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
@@ -32,7 +33,9 @@ counted_t<const ql::datum_t> js_to_datum(const v8::Handle<v8::Value> &value,
 // Should never error.
 v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum);
 
-// Worker-side JS evaluation environment.
+// Worker-side JS evaluation environment.  There is one per worker process, and
+// it outlives the jobs that use it, so functions compiled for one query can be
+// reused by the next.
 class js_env_t {
 public:
     js_env_t();
@@ -43,11 +46,29 @@ public:
     void release(js_id_t id);
 
 private:
+    static const size_t FUNC_CACHE_SIZE;
+
     js_id_t remember_value(const v8::Handle<v8::Value> &value);
     const boost::shared_ptr<v8::Persistent<v8::Value> > find_value(js_id_t id);
 
+    void cache_func(const std::string &source, js_id_t id);
+
     js_id_t next_id;
     std::map<js_id_t, boost::shared_ptr<v8::Persistent<v8::Value> > > values;
+
+    // Functions compiled by `eval`, by source.  `last_use` is a tick of
+    // `cache_clock`, for evicting the least recently used one.
+    struct cached_func_t {
+        js_id_t id;
+        uint64_t last_use;
+    };
+    std::unordered_map<std::string, cached_func_t> func_cache;
+    uint64_t cache_clock;
+
+    // The number of holders of each cached function's id: the cache, plus each
+    // `eval` that returned it and hasn't been released yet.  Ids that aren't
+    // in here have just the one holder.
+    std::map<js_id_t, size_t> ref_counts;
 };
 
 // Cleans the worker process's environment when instantiated
@@ -77,6 +98,7 @@ public:
 enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
+    TASK_CALL_BATCH,
     TASK_RELEASE,
     TASK_EXIT
 };
@@ -114,6 +136,25 @@ js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::dat
     return result;
 }
 
+void js_job_t::begin_call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch) {
+    js_task_t task = js_task_t::TASK_CALL_BATCH;
+    write_message_t msg;
+    msg.append(&task, sizeof(task));
+    msg << id;
+    msg << args_batch;
+    int res = send_write_message(extproc_job.write_stream(), &msg);
+    if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
+}
+
+js_result_t js_job_t::read_batch_result() {
+    js_result_t result;
+    int res = deserialize(extproc_job.read_stream(), &result);
+    if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
+    return result;
+}
+
 void js_job_t::release(js_id_t id) {
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t msg;
@@ -137,7 +178,9 @@ void js_job_t::worker_error() {
 
 bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
     bool running = true;
-    js_env_t js_env;
+    // This lives as long as the worker process, see `js_env_t`.
+    static js_env_t *const persistent_js_env = new js_env_t();
+    js_env_t &js_env = *persistent_js_env;
 
     while (running) {
         js_task_t task;
@@ -175,6 +218,26 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 if (res != 0) { return false; }
             }
             break;
+        case TASK_CALL_BATCH:
+            {
+                js_id_t id;
+                std::vector<std::vector<counted_t<const ql::datum_t> > > args_batch;
+                res = deserialize(stream_in, &id);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+                res = deserialize(stream_in, &args_batch);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+
+                // Each result goes back as soon as it's ready, so that the
+                // server can time the calls one at a time.
+                for (auto it = args_batch.begin(); it != args_batch.end(); ++it) {
+                    js_result_t js_result = js_env.call(id, *it);
+                    write_message_t msg;
+                    msg << js_result;
+                    res = send_write_message(stream_out, &msg);
+                    if (res != 0) { return false; }
+                }
+            }
+            break;
         case TASK_RELEASE:
             {
                 js_id_t id;
@@ -203,8 +266,10 @@ static void append_caught_error(std::string *errmsg, const v8::TryCatch &try_cat
 }
 
 // The env_t runs in the context of the worker process
+const size_t js_env_t::FUNC_CACHE_SIZE = 1000;
+
 js_env_t::js_env_t() :
-    next_id(MIN_ID) { }
+    next_id(MIN_ID), cache_clock(0) { }
 
 js_env_t::~js_env_t() {
     // Clean up handles.
@@ -214,6 +279,13 @@ js_env_t::~js_env_t() {
 }
 
 js_result_t js_env_t::eval(const std::string &source) {
+    auto cached = func_cache.find(source);
+    if (cached != func_cache.end()) {
+        cached->second.last_use = ++cache_clock;
+        ++ref_counts[cached->second.id];
+        return js_result_t(cached->second.id);
+    }
+
     js_context_t clean_context;
     js_result_t result("");
     std::string *errmsg = boost::get<std::string>(&result);
@@ -245,7 +317,9 @@ js_result_t js_env_t::eval(const std::string &source) {
             if (result_val->IsFunction()) {
                 v8::Handle<v8::Function> func
                     = v8::Handle<v8::Function>::Cast(result_val);
-                result = remember_value(func);
+                js_id_t id = remember_value(func);
+                cache_func(source, id);
+                result = id;
             } else {
                 guarantee(!result_val.IsEmpty());
 
@@ -347,8 +421,39 @@ js_result_t js_env_t::call(js_id_t id,
     return result;
 }
 
+void js_env_t::cache_func(const std::string &source, js_id_t id) {
+    if (func_cache.size() >= FUNC_CACHE_SIZE) {
+        auto oldest_func = func_cache.begin();
+        for (auto it = func_cache.begin(); it != func_cache.end(); ++it) {
+            if (it->second.last_use < oldest_func->second.last_use) {
+                oldest_func = it;
+            }
+        }
+        js_id_t oldest_id = oldest_func->second.id;
+        func_cache.erase(oldest_func);
+        // Drop the cache's reference; the function stays around for whoever
+        // else still holds it.
+        release(oldest_id);
+    }
+
+    cached_func_t cached;
+    cached.id = id;
+    cached.last_use = ++cache_clock;
+    func_cache.insert(std::make_pair(source, cached));
+    // One reference for the cache, one for the caller of `eval`.
+    ref_counts[id] = 2;
+}
+
 void js_env_t::release(js_id_t id) {
     guarantee(id < next_id);
+    auto ref_count = ref_counts.find(id);
+    if (ref_count != ref_counts.end()) {
+        guarantee(ref_count->second > 0);
+        if (--ref_count->second > 0) {
+            return;
+        }
+        ref_counts.erase(ref_count);
+    }
     size_t num_erased = values.erase(id);
     guarantee(1 == num_erased);
 }
@@ -499,7 +604,7 @@ v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum) {
     }
     case ql::datum_t::type_t::R_OBJECT: {
         v8::Handle<v8::Object> obj = v8::Object::New();
-        const std::map<std::string, counted_t<const ql::datum_t> > &source_map = datum->as_object();
+        const ql::datum_object_t &source_map = datum->as_object();
 
         for (auto it = source_map.begin(); it != source_map.end(); ++it) {
             v8::HandleScope scope;
@@ -23,6 +23,13 @@ public:
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    // Has the worker call the function once for each element of `args_batch`.
+    // The worker sends each result back as soon as it has it; read them with
+    // `read_batch_result`, one per element, in order.
+    void begin_call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch);
+    js_result_t read_batch_result();
     void release(js_id_t id);
     void exit();
 
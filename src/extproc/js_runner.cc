@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #define __STDC_LIMIT_MACROS
 
+#include <algorithm>
 #include <map>
 
 #include "extproc/js_runner.hpp"
@@ -174,6 +175,65 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+void js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config,
+        std::vector<js_result_t> *results_out) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn_result = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn_result);
+    guarantee(fn_id != NULL);
+
+    {
+        object_buffer_t<js_timeout_t::sentry_t> sentry;
+        sentry.create(&job_data->js_timeout, config.timeout_ms);
+
+        try {
+            job_data->js_job.begin_call_batch(*fn_id, args_batch);
+        } catch (...) {
+            // Sentry must be destroyed before the js_timeout
+            sentry.reset();
+            // This will mark the worker as errored so we don't try to re-sync with it
+            //  on the next line (since we're in a catch statement, we aren't allowed)
+            job_data->js_job.worker_error();
+            job_data.reset();
+            throw;
+        }
+    }
+
+    // The timer starts over for each result, so every call gets the whole
+    // timeout, as it would with `call`.
+    for (size_t i = 0; i < args_batch.size(); ++i) {
+        object_buffer_t<js_timeout_t::sentry_t> sentry;
+        sentry.create(&job_data->js_timeout, config.timeout_ms);
+
+        js_result_t result;
+        try {
+            result = job_data->js_job.read_batch_result();
+
+            // Callers rebuild functions from their source (see
+            // `js_result_visitor_t`), so nobody needs these ids.
+            js_id_t *any_id = boost::get<js_id_t>(&result);
+            if (any_id != NULL) {
+                release_id(*any_id);
+            }
+        } catch (...) {
+            // Sentry must be destroyed before the js_timeout
+            sentry.reset();
+            // This will mark the worker as errored so we don't try to re-sync with it
+            //  on the next line (since we're in a catch statement, we aren't allowed)
+            job_data->js_job.worker_error();
+            job_data.reset();
+            throw;
+        }
+        results_out->push_back(result);
+    }
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
@@ -64,6 +64,17 @@ public:
                      const std::vector<counted_t<const ql::datum_t> > &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once for each element of
+    // `args_batch`, sending them all to the worker at once.  Each call gets the
+    // whole timeout.  The results are appended to `results_out` as they come
+    // in, so if a call times out, the ones before it are still there.
+    // Function results are released rather than cached.
+    void call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config,
+        std::vector<js_result_t> *results_out);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -2,7 +2,7 @@
 #ifdef MALLOC_PROF
 #include <google/tcmalloc.h>
 #include <stdio.h>
-#include <perfmon.hpp>
+#include "perfmon/perfmon.hpp"
 
 static perfmon_duration_sampler_t pm_operator_new(secs_to_ticks(1)),
                            pm_operator_delete(secs_to_ticks(1));
@@ -28,3 +28,60 @@ void operator delete[](void* p) __THROW {
     tc_deletearray(p);
 }
 #endif
+
+#ifdef ALLOC_COUNT
+#ifdef MALLOC_PROF
+#error "ALLOC_COUNT and MALLOC_PROF both replace operator new."
+#endif
+#include <inttypes.h>
+#include <stdlib.h>
+#include <new>
+#include "perfmon/perfmon.hpp"
+
+// Counts the calls each thread makes to operator new.  Objects from the slab
+// allocator are counted by the slab_allocator stat instead.
+static __thread int64_t operator_new_calls = 0;
+
+static void *counted_malloc(size_t size) {
+    ++operator_new_calls;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(size_t size) {
+    return counted_malloc(size);
+}
+void operator delete(void* p) __THROW {
+    free(p);
+}
+void* operator new[](size_t size) {
+    return counted_malloc(size);
+}
+void operator delete[](void* p) __THROW {
+    free(p);
+}
+
+class operator_new_calls_perfmon_t : public perfmon_perthread_t<int64_t> {
+protected:
+    void get_thread_stat(int64_t *stat) {
+        *stat = operator_new_calls;
+    }
+    int64_t combine_stats(const int64_t *stats) {
+        int64_t total = 0;
+        for (int i = 0; i < get_num_threads(); ++i) {
+            total += stats[i];
+        }
+        return total;
+    }
+    scoped_ptr_t<perfmon_result_t> output_stat(const int64_t &total) {
+        return scoped_ptr_t<perfmon_result_t>(
+            new perfmon_result_t(strprintf("%" PRIi64, total)));
+    }
+};
+
+static operator_new_calls_perfmon_t pm_operator_new_calls;
+static perfmon_membership_t pm_operator_new_calls_membership(&get_global_perfmon_collection(), &pm_operator_new_calls, "operator_new_calls");
+#endif  // ALLOC_COUNT
@@ -109,6 +109,13 @@ public:
         bool shard(const region_t &region,
                    write_t *write_out) const THROWS_NOTHING;
         void unshard(const write_response_t *responses, size_t count, write_response_t *response, context_t *ctx, signal_t *) const THROWS_NOTHING;
+        // We never merge writes; see `rdb_protocol_t::write_t::coalesce()`.
+        bool coalesce(UNUSED const write_t &other) THROWS_NOTHING { return false; }
+        void split_coalesced_response(UNUSED const write_response_t &response,
+                                      UNUSED std::vector<write_response_t> *responses_out)
+            const THROWS_NOTHING {
+            unreachable();
+        }
 
         write_t() { }
         write_t(const write_t& w) : mutation(w.mutation), proposed_cas(w.proposed_cas), effective_time(w.effective_time) { }
@@ -126,6 +126,41 @@ void dummy_protocol_t::write_t::unshard(const write_response_t* resps, size_t co
     }
 }
 
+bool dummy_protocol_t::write_t::coalesce(const write_t &other) THROWS_NOTHING {
+    // Each write's response has the values its keys had before it, so two
+    // writes to the same key can't be merged.
+    if (!other.coalesced_keys.empty()) {
+        return false;
+    }
+    for (auto it = other.values.begin(); it != other.values.end(); ++it) {
+        if (values.count(it->first) != 0) {
+            return false;
+        }
+    }
+    if (coalesced_keys.empty()) {
+        coalesced_keys.push_back(get_region().keys);
+    }
+    values.insert(other.values.begin(), other.values.end());
+    coalesced_keys.push_back(other.get_region().keys);
+    return true;
+}
+
+void dummy_protocol_t::write_t::split_coalesced_response(const write_response_t &response,
+                                                         std::vector<write_response_t> *responses_out)
+    const THROWS_NOTHING {
+    guarantee(!coalesced_keys.empty());
+    responses_out->clear();
+    responses_out->resize(coalesced_keys.size());
+    for (size_t i = 0; i < coalesced_keys.size(); ++i) {
+        for (auto it = coalesced_keys[i].begin(); it != coalesced_keys[i].end(); ++it) {
+            auto jt = response.old_values.find(*it);
+            if (jt != response.old_values.end()) {
+                (*responses_out)[i].old_values.insert(*jt);
+            }
+        }
+    }
+}
+
 bool region_is_superset(dummy_protocol_t::region_t a, dummy_protocol_t::region_t b) {
     for (std::set<std::string>::const_iterator it = b.keys.begin(); it != b.keys.end(); it++) {
         if (a.keys.count(*it) == 0) {
@@ -77,9 +77,19 @@ public:
         bool shard(const region_t &region,
                    write_t *write_out) const;
         void unshard(const write_response_t *resps, size_t count, write_response_t *response, context_t *cache, signal_t *) const;
+        // Merges writes to different keys, so that tests can exercise the
+        // master's write batching; see `rdb_protocol_t::write_t::coalesce()`.
+        bool coalesce(const write_t &other) THROWS_NOTHING;
+        void split_coalesced_response(const write_response_t &response,
+                                      std::vector<write_response_t> *responses_out)
+            const THROWS_NOTHING;
 
         RDB_MAKE_ME_SERIALIZABLE_1(values);
         std::map<std::string, std::string> values;
+
+        // The keys each merged write brought, in the order they were merged.
+        // Only the master's copy needs them, so they aren't serialized.
+        std::vector<std::set<std::string> > coalesced_keys;
     };
 
     class backfill_chunk_t {
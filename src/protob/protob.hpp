@@ -16,6 +16,8 @@
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "containers/archive/archive.hpp"
 #include "http/http.hpp"
 
@@ -105,6 +107,17 @@ private:
 // request_t::protob_type *underlying_protob_value(request_t *request);
 //
 // "request_t::protob_type" does not actually have to be defined.
+//
+// Likewise response_t is serialized with the overloaded functions:
+//
+// // Returns the size of the serialized response.
+// int32_t serialized_response_size(const response_t &response);
+//
+// // Writes the serialized response to conn with buffered writes.
+// void write_response(const response_t &response, tcp_conn_t *conn, signal_t *closer);
+//
+// // Serializes the response into buf, which holds size bytes.
+// void serialize_response(const response_t &response, char *buf, int32_t size);
 
 
 template <class request_t, class response_t, class context_t>
@@ -121,7 +134,7 @@ public:
     int get_port() const;
 private:
 
-    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t);
+    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
     void send(const response_t &, tcp_conn_t *conn, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
     static auth_key_t read_auth_key(tcp_conn_t *conn, signal_t *interruptor);
 
@@ -139,7 +152,13 @@ private:
     cond_t main_shutting_down_cond;
     signal_t *shutdown_signal() { return &shutting_down_conds[get_thread_id().threadnum]; }
     boost::ptr_vector<cross_thread_signal_t> shutting_down_conds;
+    // The auth metadata, as seen from each thread
+    scoped_array_t<scoped_ptr_t<cross_thread_watchable_variable_t<auth_semilattice_metadata_t> > >
+        auth_watchables;
     auto_drainer_t auto_drainer;
+    // Connections are handled on the thread that accepted them, and keep that
+    // thread's drainer locked.
+    one_per_thread_t<auto_drainer_t> conn_drainers;
     struct pulse_on_destruct_t {
         explicit pulse_on_destruct_t(cond_t *_cond) : cond(_cond) { }
         ~pulse_on_destruct_t() { cond->pulse(); }
@@ -147,9 +166,7 @@ private:
     } pulse_sdc_on_shutdown;
     http_conn_cache_t<context_t> http_conn_cache;
 
-    scoped_ptr_t<tcp_listener_t> tcp_listener;
-
-    unsigned next_thread;
+    scoped_ptr_t<threaded_tcp_listener_t> tcp_listener;
 };
 
 //TODO figure out how to do 0 copy serialization with this.
@@ -20,6 +20,7 @@
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
 #include "rpc/semilattice/view.hpp"
+#include "rpc/semilattice/watchable.hpp"
 #include "utils.hpp"
 
 template <class request_t, class response_t, class context_t>
@@ -35,22 +36,35 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
       auth_metadata(_auth_metadata),
       cb_mode(_cb_mode),
       shutting_down_conds(get_num_threads()),
-      pulse_sdc_on_shutdown(&main_shutting_down_cond),
-      next_thread(0) {
+      auth_watchables(get_num_threads()),
+      pulse_sdc_on_shutdown(&main_shutting_down_cond) {
 
     for (int i = 0; i < get_num_threads(); ++i) {
         cross_thread_signal_t *s =
             new cross_thread_signal_t(&main_shutting_down_cond, threadnum_t(i));
         shutting_down_conds.push_back(s);
         rassert(s == &shutting_down_conds[i]);
+
+        auth_watchables[i].init(
+            new cross_thread_watchable_variable_t<auth_semilattice_metadata_t>(
+                clone_ptr_t<semilattice_watchable_t<auth_semilattice_metadata_t> >(
+                    new semilattice_watchable_t<auth_semilattice_metadata_t>(auth_metadata)),
+                threadnum_t(i)));
+    }
+
+    // Every db thread accepts connections (and handles the ones it accepts).
+    std::vector<threadnum_t> threads;
+    for (int i = 0; i < get_num_db_threads(); ++i) {
+        threads.push_back(threadnum_t(i));
     }
 
     try {
-        tcp_listener.init(new tcp_listener_t(
+        tcp_listener.init(new threaded_tcp_listener_t(
             local_addresses,
             port,
+            threads,
             boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
-                        this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+                        this, _1)));
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -96,15 +110,13 @@ auth_key_t protob_server_t<request_t, response_t, context_t>::read_auth_key(tcp_
 
 template <class request_t, class response_t, class context_t>
 void protob_server_t<request_t, response_t, context_t>::handle_conn(
-    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
-    auto_drainer_t::lock_t keepalive) {
+    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    // We stay on the thread that accepted the connection.
+    auto_drainer_t::lock_t keepalive(conn_drainers.get());
+    signal_t *const closer = keepalive.get_drain_signal();
 
-    // This must be read here because of home threads and stuff
-    const vclock_t<auth_key_t> auth_vclock = auth_metadata->get().auth_key;
-
-    threadnum_t chosen_thread = threadnum_t((next_thread++) % get_num_db_threads());
-    cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
-    on_thread_t rethreader(chosen_thread);
+    const vclock_t<auth_key_t> auth_vclock =
+        auth_watchables[get_thread_id().threadnum]->get_watchable()->get().auth_key;
 
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
@@ -128,19 +140,19 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         }
 
         int32_t client_magic_number;
-        conn->read(&client_magic_number, sizeof(int32_t), &ct_keepalive);
+        conn->read(&client_magic_number, sizeof(int32_t), closer);
 
         if (client_magic_number == context_t::no_auth_magic_number) {
             if (!auth_vclock.get().str().empty()) {
                 throw protob_server_exc_t("authorization required, client does not support it");
             }
         } else if (client_magic_number == context_t::auth_magic_number) {
-            auth_key_t provided_auth = read_auth_key(conn.get(), &ct_keepalive);
+            auth_key_t provided_auth = read_auth_key(conn.get(), closer);
             if (!timing_sensitive_equals(provided_auth, auth_vclock.get())) {
                 throw protob_server_exc_t("incorrect authorization key");
             }
             const char *success_msg = "SUCCESS";
-            conn->write(success_msg, strlen(success_msg) + 1, &ct_keepalive);
+            conn->write(success_msg, strlen(success_msg) + 1, closer);
         } else {
             throw protob_server_exc_t("this is the rdb protocol port (bad magic number)");
         }
@@ -156,7 +168,7 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
 
     try {
         if (!init_error.empty()) {
-            conn->write(init_error.c_str(), init_error.length() + 1, &ct_keepalive);
+            conn->write(init_error.c_str(), init_error.length() + 1, closer);
             conn->shutdown_write();
             return;
         }
@@ -173,14 +185,14 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         std::string err;
         try {
             int32_t size;
-            conn->read(&size, sizeof(int32_t), &ct_keepalive);
+            conn->read(&size, sizeof(int32_t), closer);
             if (size < 0) {
                 err = strprintf("Negative protobuf size (%d).", size);
                 forced_response = on_unparsable_query(request_t(), err);
                 force_response = true;
             } else {
                 scoped_array_t<char> data(size);
-                conn->read(data.data(), size, &ct_keepalive);
+                conn->read(data.data(), size, closer);
 
                 const bool res
                     = underlying_protob_value(&request)->ParseFromArray(data.data(), size);
@@ -200,12 +212,12 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
             switch (cb_mode) {
             case INLINE:
                 if (force_response) {
-                    send(forced_response, conn.get(), &ct_keepalive);
+                    send(forced_response, conn.get(), closer);
                 } else {
                     response_t response;
                     bool response_needed = f(request, &response, &ctx);
                     if (response_needed) {
-                        send(response, conn.get(), &ct_keepalive);
+                        send(response, conn.get(), closer);
                     }
                 }
                 break;
@@ -232,12 +244,12 @@ void protob_server_t<request_t, response_t, context_t>::send(
     const response_t &res,
     tcp_conn_t *conn,
     signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    int size = res.ByteSize();
-    conn->write(&size, sizeof(res.ByteSize()), closer);
-    scoped_array_t<char> data(size);
-
-    res.SerializeToArray(data.data(), size);
-    conn->write(data.data(), size, closer);
+    // The response goes out in buffered writes, as it's serialized, so that
+    // we never need a copy of all of it.
+    int32_t size = serialized_response_size(res);
+    conn->write_buffered(&size, sizeof(size), closer);
+    write_response(res, conn, closer);
+    conn->flush_buffer(closer);
 }
 
 template <class request_t, class response_t, class context_t>
@@ -322,10 +334,10 @@ http_res_t protob_server_t<request_t, response_t, context_t>::handle(
             break;
         }
 
-        int32_t res_size = response.ByteSize();
+        int32_t res_size = serialized_response_size(response);
         scoped_array_t<char> res_data(sizeof(res_size) + res_size);
         *reinterpret_cast<int32_t *>(res_data.data()) = res_size;
-        response.SerializeToArray(res_data.data() + sizeof(res_size), res_size);
+        serialize_response(response, res_data.data() + sizeof(res_size), res_size);
 
         http_res_t res(HTTP_OK);
         res.version = "HTTP/1.1";
@@ -1,7 +1,10 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "errors.hpp"
@@ -12,6 +15,7 @@
 #include "btree/concurrent_traversal.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/get_distribution.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -19,7 +23,7 @@
 #include "containers/archive/vector_stream.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
-
+#include "rdb_protocol/datum_view.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
@@ -79,6 +83,66 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice, transaction_t *
     }
 }
 
+void rdb_multi_get_descend(const std::vector<store_key_t> &keys,
+                           size_t begin, size_t end,
+                           btree_slice_t *slice, transaction_t *txn, buf_lock_t *buf,
+                           multi_point_read_response_t *response) {
+    value_sizer_t<rdb_value_t> sizer(txn->get_cache()->get_block_size());
+    const node_t *node = reinterpret_cast<const node_t *>(buf->get_data_read());
+#ifndef NDEBUG
+    node::validate(&sizer, node);
+#endif  // NDEBUG
+
+    if (node::is_internal(node)) {
+        const internal_node_t *internal
+            = reinterpret_cast<const internal_node_t *>(node);
+        size_t i = begin;
+        while (i < end) {
+            block_id_t child_id = internal_node::lookup(internal, keys[i].btree_key());
+            rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+            // Sorted keys that go to the same child are next to each other.
+            size_t j = i + 1;
+            while (j < end
+                   && internal_node::lookup(internal, keys[j].btree_key()) == child_id) {
+                ++j;
+            }
+
+            buf_lock_t child(txn, child_id, rwi_read);
+            child.set_eviction_priority(incr_priority(buf->get_eviction_priority()));
+            rdb_multi_get_descend(keys, i, j, slice, txn, &child, response);
+            i = j;
+        }
+    } else {
+        const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+        scoped_malloc_t<rdb_value_t> value(sizer.max_possible_size());
+        for (size_t i = begin; i < end; ++i) {
+            slice->stats.pm_keys_read.record();
+            if (leaf::lookup(&sizer, leaf, keys[i].btree_key(), value.get())) {
+                response->rows.push_back(
+                    std::make_pair(keys[i], get_data(value.get(), txn)));
+            }
+        }
+    }
+}
+
+void rdb_multi_get(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   transaction_t *txn, superblock_t *superblock,
+                   multi_point_read_response_t *response) {
+    block_id_t root_id = superblock->get_root_block_id();
+    rassert(root_id != SUPERBLOCK_ID);
+    if (root_id == NULL_BLOCK_ID) {
+        // There is no root, so the tree is empty.
+        superblock->release();
+        return;
+    }
+
+    buf_lock_t root(txn, root_id, rwi_read);
+    root.set_eviction_priority(slice->root_eviction_priority);
+    superblock->release();
+
+    rdb_multi_get_descend(keys, 0, keys.size(), slice, txn, &root, response);
+}
+
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                         const store_key_t &key,
                         btree_slice_t *slice,
@@ -115,7 +179,7 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
 
     // TODO unnecessary copies they must go away.
     write_message_t wm;
-    wm << data;
+    ql::serialize_indexed(&wm, data);
     vector_stream_t stream;
     int res = send_write_message(&stream, &wm);
     guarantee_err(res == 0,
@@ -344,12 +408,17 @@ batched_replace_response_t rdb_batched_replace(
     scoped_ptr_t<superblock_t> *superblock,
     const std::vector<store_key_t> &keys,
     const btree_batched_replacer_t *replacer,
-    rdb_modification_report_cb_t *sindex_cb) {
+    rdb_modification_report_cb_t *sindex_cb,
+    const std::vector<uint64_t> &group_sizes) {
 
     fifo_enforcer_source_t batched_replaces_fifo_source;
     fifo_enforcer_sink_t batched_replaces_fifo_sink;
 
-    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    std::vector<counted_t<const ql::datum_t> > stats(
+        std::max<size_t>(group_sizes.size(), 1),
+        make_counted<const ql::datum_t>(ql::datum_t::R_OBJECT));
+    size_t group = 0;
+    uint64_t group_end = group_sizes.empty() ? keys.size() : group_sizes[0];
 
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
@@ -360,6 +429,11 @@ batched_replace_response_t rdb_batched_replace(
         // on all the write operations.
         scoped_ptr_t<superblock_t> current_superblock(superblock->release());
         for (size_t i = 0; i < keys.size(); ++i) {
+            while (i == group_end) {
+                ++group;
+                guarantee(group < group_sizes.size());
+                group_end += group_sizes[group];
+            }
             // Pass out the point_replace_response_t.
             promise_t<superblock_t *> superblock_promise;
             coro_t::spawn(
@@ -374,12 +448,16 @@ batched_replace_response_t rdb_batched_replace(
 
                     &superblock_promise,
                     sindex_cb,
-                    &stats));
+                    &stats[group]));
 
             current_superblock.init(superblock_promise.wait());
         }
     } // Make sure the drainer is destructed before the return statement.
-    return stats;
+    sindex_cb->flush();
+    if (group_sizes.empty()) {
+        return stats[0];
+    }
+    return make_counted<const ql::datum_t>(std::move(stats));
 }
 
 void rdb_set(const store_key_t &key,
@@ -631,11 +709,13 @@ public:
         boost::optional<rdb_protocol_details::terminal_t> _terminal,
         const key_range_t &range,
         sorting_t _sorting,
+        size_t _chunk_size,
         rget_read_response_t *_response)
         : bad_init(false),
           transaction(txn),
           response(_response),
           cumulative_size(0),
+          chunk_size(_chunk_size),
           ql_env(_ql_env),
           transform(_transform),
           terminal(_terminal),
@@ -663,11 +743,13 @@ public:
         ql::map_wire_func_t _sindex_function,
         sindex_multi_bool_t _sindex_multi,
         sindex_range_t _sindex_range,
+        size_t _chunk_size,
         rget_read_response_t *_response)
         : bad_init(false),
           transaction(txn),
           response(_response),
           cumulative_size(0),
+          chunk_size(_chunk_size),
           ql_env(_ql_env),
           transform(_transform),
           terminal(_terminal),
@@ -677,10 +759,45 @@ public:
           sindex_multi(_sindex_multi)
     {
         sindex_function = _sindex_function.compile_wire_func();
+        std::string field;
+        if (ql::func_is_get_field(sindex_function, &field)) {
+            sindex_field = field;
+            // The bounds get compared against each row's field in place, see
+            // `check_sindex_field`.
+            if (sindex_range->start) {
+                serialize_bound(sindex_range->start, &sindex_start);
+            }
+            if (sindex_range->end) {
+                serialize_bound(sindex_range->end, &sindex_end);
+            }
+        }
         init(range);
     }
 
     void init(const key_range_t &range) {
+        // If the first thing we do with each row is pluck some top-level
+        // fields, we only need to deserialize those fields.
+        if (!transform.empty()) {
+            const pluck_transform_t *pluck =
+                boost::get<pluck_transform_t>(&transform.front());
+            if (pluck != NULL && !pluck->without
+                && pluck->paths->get_type() == ql::datum_t::R_ARRAY) {
+                std::vector<std::string> fields;
+                for (size_t i = 0; i < pluck->paths->size(); ++i) {
+                    counted_t<const ql::datum_t> path = pluck->paths->get(i);
+                    // (Plucking the pseudotype field can fail, which we leave
+                    // to the transform to report.)
+                    if (path->get_type() != ql::datum_t::R_STR
+                        || path->as_str() == ql::datum_t::reql_type_string) {
+                        fields.clear();
+                        break;
+                    }
+                    fields.push_back(path->as_str());
+                }
+                pluck_fields.swap(fields);
+            }
+        }
+
         try {
             if (forward(sorting)) {
                 response->last_considered_key = range.left;
@@ -724,7 +841,28 @@ public:
         try {
             lazy_json_t first_value(static_cast<const rdb_value_t *>(keyvalue.value()),
                                     transaction);
-            first_value.get();
+
+            // If the sindex function just reads a field, read only that field and
+            // don't deserialize rows that turn out to be outside the range.  (If
+            // the field is missing, calling the function below reports the error.)
+            counted_t<const ql::datum_t> sindex_value;
+            bool in_sindex_range = true;
+            if (sindex_field) {
+                first_value.with_field_view(*sindex_field, boost::bind(
+                        &rdb_rget_depth_first_traversal_callback_t::check_sindex_field,
+                        this, boost::cref(store_key), _1,
+                        &sindex_value, &in_sindex_range));
+            }
+            // Unless the sindex function needs the whole row, a leading pluck
+            // of top-level fields can be done while we still have the leaf.
+            counted_t<const ql::datum_t> plucked;
+            if (in_sindex_range) {
+                if (!pluck_fields.empty() && (!sindex_function || sindex_value)) {
+                    plucked = pluck_fields_of(first_value);
+                } else {
+                    first_value.get();
+                }
+            }
 
             keyvalue.reset();
 
@@ -735,23 +873,22 @@ public:
                 response->last_considered_key = store_key;
             }
 
+            if (!in_sindex_range) {
+                return true;
+            }
+
             std::vector<lazy_json_t> data;
-            data.push_back(first_value);
+            rdb_protocol_details::transform_t::iterator first_transform = transform.begin();
+            if (plucked) {
+                data.push_back(lazy_json_t(plucked));
+                ++first_transform;
+            } else {
+                data.push_back(first_value);
+            }
 
-            counted_t<const ql::datum_t> sindex_value;
-            if (sindex_function) {
+            if (sindex_function && !sindex_value) {
                 sindex_value = sindex_function->call(ql_env, first_value.get())->as_datum();
-                guarantee(sindex_range);
-                guarantee(sindex_multi);
-
-                if (sindex_multi == MULTI &&
-                    sindex_value->get_type() == ql::datum_t::R_ARRAY) {
-                        boost::optional<uint64_t> tag = ql::datum_t::extract_tag(key_to_unescaped_str(store_key));
-                        guarantee(tag);
-                        guarantee(sindex_value->size() > *tag);
-                        sindex_value = sindex_value->get(*tag);
-                }
-                if (!sindex_range->contains(sindex_value)) {
+                if (!sindex_value_in_range(store_key, &sindex_value)) {
                     return true;
                 }
             }
@@ -759,7 +896,7 @@ public:
             // Apply transforms to the data
             {
                 rdb_protocol_details::transform_t::iterator it;
-                for (it = transform.begin(); it != transform.end(); ++it) {
+                for (it = first_transform; it != transform.end(); ++it) {
                     try {
                         std::vector<counted_t<const ql::datum_t> > tmp;
 
@@ -796,7 +933,7 @@ public:
 
                     cumulative_size += estimate_rget_response_size(datum);
                 }
-                return cumulative_size < rget_max_chunk_size;
+                return cumulative_size < chunk_size;
             } else {
                 try {
                     for (auto jt = data.begin(); jt != data.end(); ++jt) {
@@ -818,10 +955,87 @@ public:
         }
 
     }
+
+    // Builds the object `pluck_fields` of the (unloaded) row `value` would
+    // project to, reading only those fields.  Rows are always objects.
+    counted_t<const ql::datum_t> pluck_fields_of(const lazy_json_t &value) {
+        ql::datum_ptr_t res(ql::datum_t::R_OBJECT);
+        for (auto it = pluck_fields.begin(); it != pluck_fields.end(); ++it) {
+            if (counted_t<const ql::datum_t> field = value.get_field(*it)) {
+                UNUSED bool b = res.add(*it, field, ql::CLOBBER);
+            }
+        }
+        return res.to_counted();
+    }
+
+    static void serialize_bound(counted_t<const ql::datum_t> bound,
+                                std::vector<char> *bytes_out) {
+        write_message_t wm;
+        wm << bound;
+        vector_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        *bytes_out = stream.vector();
+    }
+
+    /* Reads the sindex value of a row whose sindex function just returns
+     * `sindex_field`.  Unless it's an array in a multi index, the value is
+     * compared with the range in place, so that rows outside the range never
+     * get deserialized.  Leaves `*sindex_value_out` empty if the row has no such
+     * field. */
+    void check_sindex_field(const store_key_t &store_key,
+                            const ql::datum_view_t &field,
+                            counted_t<const ql::datum_t> *sindex_value_out,
+                            bool *in_range_out) {
+        if (!field.has()) {
+            return;
+        }
+        if (sindex_multi == MULTI && field.get_type() == ql::datum_t::R_ARRAY) {
+            *sindex_value_out = field.materialize();
+            *in_range_out = sindex_value_in_range(store_key, sindex_value_out);
+            return;
+        }
+        guarantee(sindex_range);
+        if (!sindex_start.empty()) {
+            int res = ql::datum_view_t(sindex_start.data(), sindex_start.size()).cmp(field);
+            if (res > 0 || (res == 0 && sindex_range->start_open)) {
+                *in_range_out = false;
+                return;
+            }
+        }
+        if (!sindex_end.empty()) {
+            int res = field.cmp(ql::datum_view_t(sindex_end.data(), sindex_end.size()));
+            if (res > 0 || (res == 0 && sindex_range->end_open)) {
+                *in_range_out = false;
+                return;
+            }
+        }
+        *sindex_value_out = field.materialize();
+        *in_range_out = true;
+    }
+
+    // Replaces a multi-index array with the element `store_key` is for, and
+    // checks the result against the sindex range.
+    bool sindex_value_in_range(const store_key_t &store_key,
+                               counted_t<const ql::datum_t> *sindex_value) {
+        guarantee(sindex_range);
+        guarantee(sindex_multi);
+
+        if (sindex_multi == MULTI &&
+            (*sindex_value)->get_type() == ql::datum_t::R_ARRAY) {
+                boost::optional<uint64_t> tag = ql::datum_t::extract_tag(key_to_unescaped_str(store_key));
+                guarantee(tag);
+                guarantee((*sindex_value)->size() > *tag);
+                *sindex_value = (*sindex_value)->get(*tag);
+        }
+        return sindex_range->contains(*sindex_value);
+    }
+
     bool bad_init;
     transaction_t *transaction;
     rget_read_response_t *response;
     size_t cumulative_size;
+    size_t chunk_size;
     ql::env_t *ql_env;
     rdb_protocol_details::transform_t transform;
     boost::optional<rdb_protocol_details::terminal_t> terminal;
@@ -831,7 +1045,14 @@ public:
     boost::optional<key_range_t> primary_key_range;
     boost::optional<sindex_range_t> sindex_range;
     counted_t<ql::func_t> sindex_function;
+    // Set if `sindex_function` just returns this field of the row.
+    boost::optional<std::string> sindex_field;
+    // If so, the serialized bounds of `sindex_range`, or empty for no bound.
+    std::vector<char> sindex_start, sindex_end;
     boost::optional<sindex_multi_bool_t> sindex_multi;
+
+    // Set if the first transform is a pluck of these top-level fields.
+    std::vector<std::string> pluck_fields;
 };
 
 class result_finalizer_visitor_t : public boost::static_visitor<void> {
@@ -855,13 +1076,14 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     const rdb_protocol_details::transform_t &transform,
                     const boost::optional<rdb_protocol_details::terminal_t> &terminal,
                     sorting_t sorting,
+                    size_t chunk_size,
                     rget_read_response_t *response) {
     rdb_rget_depth_first_traversal_callback_t callback(
-            txn, ql_env, transform, terminal, range, sorting, response);
+            txn, ql_env, transform, terminal, range, sorting, chunk_size, response);
     btree_concurrent_traversal(slice, txn, superblock, range, &callback,
             (forward(sorting) ? FORWARD : BACKWARD));
 
-    if (callback.cumulative_size >= rget_max_chunk_size) {
+    if (callback.cumulative_size >= chunk_size) {
         response->truncated = true;
     } else {
         response->truncated = false;
@@ -878,15 +1100,16 @@ void rdb_rget_secondary_slice(btree_slice_t *slice, const sindex_range_t &sindex
                     sorting_t sorting,
                     const ql::map_wire_func_t &sindex_func,
                     sindex_multi_bool_t sindex_multi,
+                    size_t chunk_size,
                     rget_read_response_t *response) {
     rdb_rget_depth_first_traversal_callback_t callback(txn, ql_env, transform, terminal,
             sindex_range.to_region().inner, pk_range,
-            sorting, sindex_func, sindex_multi, sindex_range, response);
+            sorting, sindex_func, sindex_multi, sindex_range, chunk_size, response);
 
     btree_concurrent_traversal(slice, txn, superblock, sindex_range.to_region().inner,
             &callback, (forward(sorting) ? FORWARD : BACKWARD));
 
-    if (callback.cumulative_size >= rget_max_chunk_size) {
+    if (callback.cumulative_size >= chunk_size) {
         response->truncated = true;
     } else {
         response->truncated = false;
@@ -974,6 +1197,7 @@ rdb_modification_report_cb_t::rdb_modification_report_cb_t(
 { }
 
 rdb_modification_report_cb_t::~rdb_modification_report_cb_t() {
+    flush();
     if (token_pair_->sindex_write_token.has()) {
         token_pair_->sindex_write_token.reset();
     }
@@ -999,7 +1223,14 @@ void rdb_modification_report_cb_t::on_mod_report(
     wm << rdb_sindex_change_t(mod_report);
     store_->sindex_queue_push(wm, &acq);
 
-    rdb_update_sindexes(sindexes_, &mod_report, txn_);
+    pending_.push_back(mod_report);
+}
+
+void rdb_modification_report_cb_t::flush() {
+    if (!pending_.empty()) {
+        rdb_update_sindexes_batch(sindexes_, pending_, txn_);
+        pending_.clear();
+    }
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
@@ -1021,6 +1252,46 @@ void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> d
     }
 }
 
+void compute_keys_of_field(const store_key_t &primary_key,
+                           sindex_multi_bool_t multi,
+                           const ql::datum_view_t &field,
+                           std::vector<store_key_t> *keys_out,
+                           bool *found_out) {
+    if (!field.has()) {
+        return;
+    }
+    *found_out = true;
+    if (multi == MULTI && field.get_type() == ql::datum_t::R_ARRAY) {
+        counted_t<const ql::datum_t> index = field.materialize();
+        for (uint64_t i = 0; i < index->size(); ++i) {
+            keys_out->push_back(
+                store_key_t(index->get(i, ql::THROW)->print_secondary(primary_key, i)));
+        }
+    } else {
+        keys_out->push_back(store_key_t(field.print_secondary(primary_key)));
+    }
+}
+
+/* Like the above, but if the mapping just reads a field, only that field of
+ * `doc` gets deserialized. */
+void compute_keys(const store_key_t &primary_key, const lazy_json_t &doc,
+                  ql::map_wire_func_t *mapping, sindex_multi_bool_t multi, ql::env_t *env,
+                  std::vector<store_key_t> *keys_out) {
+    guarantee(keys_out->empty());
+    std::string field;
+    if (ql::func_is_get_field(mapping->compile_wire_func(), &field)) {
+        bool found = false;
+        doc.with_field_view(field, boost::bind(&compute_keys_of_field,
+                                               boost::cref(primary_key), multi, _1,
+                                               keys_out, &found));
+        if (found) {
+            return;
+        }
+        // Calling the mapping reports the missing field.
+    }
+    compute_keys(primary_key, doc.get(), mapping, multi, env, keys_out);
+}
+
 /* Used below by rdb_update_sindexes. */
 void rdb_update_single_sindex(
         const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
@@ -1145,6 +1416,122 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
     }
 }
 
+/* Sets `key` in the sindex to `value_ref`, or deletes it if `value_ref` is NULL,
+ * and passes the superblock on to the next write. */
+void apply_sindex_key(const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+                      const store_key_t &key,
+                      const std::vector<char> *value_ref,
+                      transaction_t *txn,
+                      superblock_t **super_block) {
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t<rdb_value_t> kv_location;
+
+        find_keyvalue_location_for_write(txn, *super_block,
+                                         key.btree_key(),
+                                         &kv_location,
+                                         &sindex->btree->root_eviction_priority,
+                                         &sindex->btree->stats,
+                                         &return_superblock_local);
+
+        if (value_ref != NULL) {
+            kv_location_set(&kv_location, key, *value_ref, sindex->btree,
+                            repli_timestamp_t::distant_past, txn);
+        } else if (kv_location.value.has()) {
+            kv_location_delete(&kv_location, key,
+                sindex->btree, repli_timestamp_t::distant_past, txn, NULL);
+        }
+        // The keyvalue location gets destroyed here.
+    }
+    *super_block = return_superblock_local.wait();
+}
+
+/* Used below by rdb_update_sindexes_batch. */
+void rdb_update_single_sindex_batch(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<rdb_modification_report_t> *modifications,
+        transaction_t *txn,
+        auto_drainer_t::lock_t) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = MULTI;
+    vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
+    int success = deserialize(&read_stream, &mapping);
+    guarantee(success == ARCHIVE_SUCCESS, "Corrupted sindex description.");
+    success = deserialize(&read_stream, &multi);
+    guarantee(success == ARCHIVE_SUCCESS, "Corrupted sindex description.");
+
+    // See `rdb_update_single_sindex` for why this environment is empty.
+    cond_t non_interruptor;
+    ql::env_t env(&non_interruptor);
+
+    // The last thing the batch does to each sindex key: the value ref to set it
+    // to, or NULL to delete it.  Sindex keys contain the primary key, so if one
+    // row is modified twice in a batch, only the later modification survives.
+    std::map<store_key_t, const std::vector<char> *> changes;
+    for (auto it = modifications->begin(); it != modifications->end(); ++it) {
+        guarantee(it->primary_key.size() != 0);
+        if (it->info.deleted.first) {
+            guarantee(!it->info.deleted.second.empty());
+            try {
+                std::vector<store_key_t> keys;
+                compute_keys(it->primary_key, it->info.deleted.first,
+                             &mapping, multi, &env, &keys);
+                for (auto key = keys.begin(); key != keys.end(); ++key) {
+                    changes[*key] = NULL;
+                }
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (it wasn't actually in the index).
+            }
+        }
+        if (it->info.added.first) {
+            try {
+                std::vector<store_key_t> keys;
+                compute_keys(it->primary_key, it->info.added.first,
+                             &mapping, multi, &env, &keys);
+                for (auto key = keys.begin(); key != keys.end(); ++key) {
+                    changes[*key] = &it->info.added.second;
+                }
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (we just drop the row from the index).
+            }
+        }
+    }
+
+    // Applying them in key order keeps consecutive writes in the same leaf.
+    superblock_t *super_block = sindex->super_block.get();
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        apply_sindex_key(sindex, it->first, it->second, txn, &super_block);
+    }
+}
+
+void rdb_update_sindexes_batch(const sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        transaction_t *txn) {
+    {
+        auto_drainer_t drainer;
+
+        for (sindex_access_vector_t::const_iterator it  = sindexes.begin();
+                                                    it != sindexes.end();
+                                                    ++it) {
+            coro_t::spawn_sometime(boost::bind(
+                        &rdb_update_single_sindex_batch, &*it,
+                        &modifications, txn, auto_drainer_t::lock_t(&drainer)));
+        }
+    }
+
+    /* As in rdb_update_sindexes, the deleted blobs can go now that no sindex
+     * refers to them. */
+    rdb_value_deleter_t deleter;
+    for (auto it = modifications.begin(); it != modifications.end(); ++it) {
+        if (it->info.deleted.first) {
+            std::vector<char> ref_cpy(it->info.deleted.second);
+            ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
+            guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+            deleter.delete_value(txn, ref_cpy.data());
+        }
+    }
+}
+
 void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
         transaction_t *txn, signal_t *interruptor) {
@@ -1155,6 +1542,109 @@ void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
             false, /* don't release the superblock */ interruptor);
 }
 
+/* One row of the primary btree, as post construction sees it.  The document is
+ * copied out of the leaf but only deserialized if a sindex function needs more
+ * than one of its fields. */
+struct post_construct_row_t {
+    post_construct_row_t(const store_key_t &_primary_key, const lazy_json_t &_doc)
+        : primary_key(_primary_key), doc(_doc) { }
+
+    store_key_t primary_key;
+    lazy_json_t doc;
+    std::vector<char> value_ref;
+};
+
+/* Sindex entries that post construction has computed but not written yet.  They
+ * pile up over many primary leaves and are then sorted and written together, so
+ * that consecutive writes mostly land in the same sindex leaf instead of all
+ * over the tree.  (Neighbouring rows of the primary btree rarely have
+ * neighbouring sindex keys, so sorting a single leaf's worth barely helps.) */
+struct post_construct_batch_t {
+    post_construct_batch_t() : bytes(0) { }
+
+    void swap(post_construct_batch_t *other) {
+        value_refs.swap(other->value_refs);
+        entries.swap(other->entries);
+        std::swap(bytes, other->bytes);
+    }
+
+    // The value refs of the rows that the entries belong to.
+    std::vector<std::vector<char> > value_refs;
+    // For each sindex, pairs of a sindex key and the index in `value_refs` of the
+    // row it belongs to.
+    std::map<uuid_u, std::vector<std::pair<store_key_t, size_t> > > entries;
+    // Roughly how much memory the above takes up.
+    size_t bytes;
+};
+
+/* Used below by post_construct_traversal_helper_t.  Computes the keys a leaf's
+ * worth of rows have in one secondary index.  The rows' value refs will be at
+ * `first_value_ref` onwards in the batch. */
+void post_construct_compute_sindex_keys(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        const std::vector<post_construct_row_t> *rows,
+        size_t first_value_ref,
+        std::vector<std::pair<store_key_t, size_t> > *entries_out,
+        auto_drainer_t::lock_t) {
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi = MULTI;
+    vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
+    int success = deserialize(&read_stream, &mapping);
+    guarantee(success == ARCHIVE_SUCCESS, "Corrupted sindex description.");
+    success = deserialize(&read_stream, &multi);
+    guarantee(success == ARCHIVE_SUCCESS, "Corrupted sindex description.");
+
+    // See `rdb_update_single_sindex` for why this environment is empty.
+    cond_t non_interruptor;
+    ql::env_t env(&non_interruptor);
+
+    entries_out->reserve(rows->size());
+    for (size_t i = 0; i < rows->size(); ++i) {
+        try {
+            std::vector<store_key_t> keys;
+            compute_keys((*rows)[i].primary_key, (*rows)[i].doc,
+                         &mapping, multi, &env, &keys);
+            for (auto it = keys.begin(); it != keys.end(); ++it) {
+                entries_out->push_back(std::make_pair(*it, first_value_ref + i));
+            }
+        } catch (const ql::base_exc_t &) {
+            // Do nothing (we just drop the row from the index).
+        }
+    }
+}
+
+/* Writes a batch's entries for one secondary index, in sorted order. */
+void post_construct_write_sindex_entries(
+        const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
+        std::vector<std::pair<store_key_t, size_t> > *entries,
+        const std::vector<std::vector<char> > *value_refs,
+        transaction_t *txn,
+        auto_drainer_t::lock_t) {
+    std::sort(entries->begin(), entries->end());
+
+    superblock_t *super_block = sindex->super_block.get();
+    for (auto it = entries->begin(); it != entries->end(); ++it) {
+        apply_sindex_key(sindex, it->first, &(*value_refs)[it->second],
+                         txn, &super_block);
+    }
+}
+
+/* Writes a batch to whichever of its sindexes still exist. */
+void write_post_construct_batch(const sindex_access_vector_t &sindexes,
+                                post_construct_batch_t *batch,
+                                transaction_t *txn) {
+    auto_drainer_t drainer;
+    for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+        auto entries = batch->entries.find(it->sindex.id);
+        if (entries != batch->entries.end()) {
+            coro_t::spawn_sometime(boost::bind(
+                        &post_construct_write_sindex_entries, &*it,
+                        &entries->second, &batch->value_refs, txn,
+                        auto_drainer_t::lock_t(&drainer)));
+        }
+    }
+}
+
 class post_construct_traversal_helper_t : public btree_traversal_helper_t {
 public:
     post_construct_traversal_helper_t(
@@ -1175,7 +1665,7 @@ public:
         store_->new_write_token_pair(&token_pair);
 
         scoped_ptr_t<transaction_t> wtxn;
-        btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
+        sindex_access_vector_t sindexes;
 
         // If we get interrupted, post-construction will happen later, no need to
         //  guarantee that we touch the sindex tree now
@@ -1183,34 +1673,7 @@ public:
             destroyer(&token_pair.sindex_write_token);
 
         try {
-            scoped_ptr_t<real_superblock_t> superblock;
-
-            // We want soft durability because having a partially constructed secondary index is
-            // okay -- we wipe it and rebuild it, if it has not been marked completely
-            // constructed.
-            store_->acquire_superblock_for_write(
-                rwi_write,
-                repli_timestamp_t::distant_past,
-                2,
-                WRITE_DURABILITY_SOFT,
-                &token_pair,
-                &wtxn,
-                &superblock,
-                interruptor_);
-
-            scoped_ptr_t<buf_lock_t> sindex_block;
-            store_->acquire_sindex_block_for_write(
-                &token_pair,
-                wtxn.get(),
-                &sindex_block,
-                superblock->get_sindex_block_id(),
-                interruptor_);
-
-            store_->acquire_sindex_superblocks_for_write(
-                    sindexes_to_post_construct_,
-                    sindex_block.get(),
-                    wtxn.get(),
-                    &sindexes);
+            acquire_sindexes_for_write(&token_pair, &wtxn, &sindexes);
 
             if (sindexes.empty()) {
                 interrupt_myself_->pulse_if_not_already_pulsed();
@@ -1222,24 +1685,77 @@ public:
 
         const leaf_node_t *leaf_node = static_cast<const leaf_node_t *>(leaf_node_buf->get_data_read());
 
+        std::vector<post_construct_row_t> rows;
         for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
             /* Grab relevant values from the leaf node. */
             const btree_key_t *key = (*it).first;
             const void *value = (*it).second;
             guarantee(key);
 
-            store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
             const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
             block_size_t block_size = txn->get_cache()->get_block_size();
-            mod_report.info.added = std::make_pair(get_data(rdb_value, txn),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
+            rows.push_back(post_construct_row_t(store_key_t(key),
+                                                lazy_json_t(rdb_value, txn)));
+            rows.back().doc.copy_serialized();
+            rows.back().value_ref.assign(rdb_value->value_ref(),
+                    rdb_value->value_ref() + rdb_value->inline_size(block_size));
+        }
+
+        // We hold the write transaction, so no other leaf touches `batch_` until
+        // we're done with it.
+        std::vector<std::vector<std::pair<store_key_t, size_t> > >
+            leaf_entries(sindexes.size());
+        {
+            auto_drainer_t drainer;
+            for (size_t i = 0; i < sindexes.size(); ++i) {
+                coro_t::spawn_sometime(boost::bind(
+                            &post_construct_compute_sindex_keys, &sindexes[i],
+                            &rows, batch_.value_refs.size(), &leaf_entries[i],
+                            auto_drainer_t::lock_t(&drainer)));
+            }
+        }
 
-            rdb_update_sindexes(sindexes, &mod_report, wtxn.get());
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            batch_.bytes += sizeof(std::vector<char>) + it->value_ref.size();
+            batch_.value_refs.push_back(std::vector<char>());
+            batch_.value_refs.back().swap(it->value_ref);
+        }
+        for (size_t i = 0; i < sindexes.size(); ++i) {
+            std::vector<std::pair<store_key_t, size_t> > *entries
+                = &batch_.entries[sindexes[i].sindex.id];
+            entries->insert(entries->end(),
+                            leaf_entries[i].begin(), leaf_entries[i].end());
+            batch_.bytes += leaf_entries[i].size()
+                * sizeof(std::pair<store_key_t, size_t>);
+        }
+
+        if (batch_.bytes >= SINDEX_POST_CONSTRUCTION_BATCH_SIZE) {
+            post_construct_batch_t full_batch;
+            full_batch.swap(&batch_);
+            write_post_construct_batch(sindexes, &full_batch, wtxn.get());
         }
     }
 
+    /* Writes the entries that haven't made a full batch, once the traversal is
+     * done. */
+    void write_remaining_entries() THROWS_ONLY(interrupted_exc_t) {
+        if (batch_.entries.empty()) {
+            return;
+        }
+
+        write_token_pair_t token_pair;
+        store_->new_write_token_pair(&token_pair);
+
+        scoped_ptr_t<transaction_t> wtxn;
+        sindex_access_vector_t sindexes;
+
+        object_buffer_t<fifo_enforcer_sink_t::exit_write_t>::destruction_sentinel_t
+            destroyer(&token_pair.sindex_write_token);
+
+        acquire_sindexes_for_write(&token_pair, &wtxn, &sindexes);
+        write_post_construct_batch(sindexes, &batch_, wtxn.get());
+    }
+
     void postprocess_internal_node(buf_lock_t *) { }
 
     void filter_interesting_children(UNUSED transaction_t *txn, ranged_block_ids_t *ids_source, interesting_children_callback_t *cb) {
@@ -1256,11 +1772,50 @@ public:
     const std::set<uuid_u> &sindexes_to_post_construct_;
     cond_t *interrupt_myself_;
     signal_t *interruptor_;
+
+private:
+    /* Leaves `sindexes_out` empty if the sindexes have all been dropped. */
+    void acquire_sindexes_for_write(write_token_pair_t *token_pair,
+                                    scoped_ptr_t<transaction_t> *wtxn_out,
+                                    sindex_access_vector_t *sindexes_out)
+        THROWS_ONLY(interrupted_exc_t) {
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        // We want soft durability because having a partially constructed secondary index is
+        // okay -- we wipe it and rebuild it, if it has not been marked completely
+        // constructed.
+        store_->acquire_superblock_for_write(
+            rwi_write,
+            repli_timestamp_t::distant_past,
+            2,
+            WRITE_DURABILITY_SOFT,
+            token_pair,
+            wtxn_out,
+            &superblock,
+            interruptor_);
+
+        scoped_ptr_t<buf_lock_t> sindex_block;
+        store_->acquire_sindex_block_for_write(
+            token_pair,
+            wtxn_out->get(),
+            &sindex_block,
+            superblock->get_sindex_block_id(),
+            interruptor_);
+
+        store_->acquire_sindex_superblocks_for_write(
+                sindexes_to_post_construct_,
+                sindex_block.get(),
+                wtxn_out->get(),
+                sindexes_out);
+    }
+
+    post_construct_batch_t batch_;
 };
 
 void post_construct_secondary_indexes(
         btree_store_t<rdb_protocol_t> *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
+        parallel_traversal_progress_t *progress,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
     cond_t local_interruptor;
@@ -1269,6 +1824,7 @@ void post_construct_secondary_indexes(
 
     post_construct_traversal_helper_t helper(store,
             sindexes_to_post_construct, &local_interruptor, interruptor);
+    helper.progress = progress;
 
     object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
     store->new_read_token(&read_token);
@@ -1286,4 +1842,11 @@ void post_construct_secondary_indexes(
 
     btree_parallel_traversal(txn.get(), superblock.get(),
             store->btree.get(), &helper, &wait_any);
+
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+    if (!local_interruptor.is_pulsed()) {
+        helper.write_remaining_entries();
+    }
 }
@@ -23,6 +23,7 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::multi_point_read_response_t multi_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -45,8 +46,6 @@ typedef rdb_protocol_t::point_delete_response_t point_delete_response_t;
 
 class parallel_traversal_progress_t;
 
-static const size_t rget_max_chunk_size = MEGABYTE;
-
 bool btree_value_fits(block_size_t bs, int data_length, const rdb_value_t *value);
 
 template <>
@@ -86,6 +85,12 @@ void rdb_get(const store_key_t &key,
              superblock_t *superblock,
              point_read_response_t *response);
 
+/* Looks up all of `keys` with a single descent of the btree: each node on the
+ * way down is acquired once for all the keys that go through it. */
+void rdb_multi_get(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   transaction_t *txn, superblock_t *superblock,
+                   multi_point_read_response_t *response);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -135,12 +140,15 @@ struct btree_point_replacer_t {
     virtual bool should_return_vals() const = 0;
 };
 
+// If `group_sizes` is non-empty, `keys` is split into consecutive groups of
+// those sizes, and the response is an array of one stats object per group.
 batched_replace_response_t rdb_batched_replace(
     const btree_info_t &info,
     scoped_ptr_t<superblock_t> *superblock,
     const std::vector<store_key_t> &keys,
     const btree_batched_replacer_t *replacer,
-    rdb_modification_report_cb_t *sindex_cb);
+    rdb_modification_report_cb_t *sindex_cb,
+    const std::vector<uint64_t> &group_sizes = std::vector<uint64_t>());
 
 void rdb_set(const store_key_t &key, counted_t<const ql::datum_t> data, bool overwrite,
              btree_slice_t *slice, repli_timestamp_t timestamp,
@@ -203,6 +211,7 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     const rdb_protocol_details::transform_t &transform,
                     const boost::optional<rdb_protocol_details::terminal_t> &terminal,
                     sorting_t sorting,
+                    size_t chunk_size,
                     rget_read_response_t *response);
 
 void rdb_rget_secondary_slice(btree_slice_t *slice, const sindex_range_t &sindex_range,
@@ -213,6 +222,7 @@ void rdb_rget_secondary_slice(btree_slice_t *slice, const sindex_range_t &sindex
                     sorting_t sorting,
                     const ql::map_wire_func_t &sindex_func,
                     sindex_multi_bool_t sindex_multi,
+                    size_t chunk_size,
                     rget_read_response_t *response);
 
 void rdb_distribution_get(btree_slice_t *slice, int max_depth, const store_key_t &left_key,
@@ -262,7 +272,12 @@ public:
             btree_store_t<rdb_protocol_t> *store, write_token_pair_t *token_pair,
             transaction_t *txn, block_id_t sindex_block, auto_drainer_t::lock_t lock);
 
+    // Queues the report for post-construction, but holds on to the sindex
+    // updates until `flush` so that a whole batch can be applied at once.
     void on_mod_report(const rdb_modification_report_t &mod_report);
+    // Applies the sindex updates for every report since the last flush.  Also
+    // called by the destructor.
+    void flush();
 
     ~rdb_modification_report_cb_t();
 private:
@@ -277,6 +292,7 @@ private:
     /* Fields initialized by calls to on_mod_report */
     scoped_ptr_t<buf_lock_t> sindex_block_;
     btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes_;
+    std::vector<rdb_modification_report_t> pending_;
 };
 
 void rdb_update_sindexes(
@@ -284,15 +300,25 @@ void rdb_update_sindexes(
         const rdb_modification_report_t *modification,
         transaction_t *txn);
 
+/* Like calling rdb_update_sindexes on each of `modifications` in turn, but
+ * each sindex is updated once for the whole batch, in key order. */
+void rdb_update_sindexes_batch(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        transaction_t *txn);
+
 void rdb_erase_range_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
         transaction_t *txn,
         signal_t *interruptor);
 
+/* `progress` may be NULL; otherwise it's informed as the primary btree is
+ * traversed, the same way backfills report their progress. */
 void post_construct_secondary_indexes(
         btree_store_t<rdb_protocol_t> *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
+        parallel_traversal_progress_t *progress,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
@@ -300,6 +326,10 @@ class rdb_value_deleter_t : public value_deleter_t {
 friend void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_modification_report_t *modification, transaction_t *txn);
+friend void rdb_update_sindexes_batch(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        transaction_t *txn);
 
     void delete_value(transaction_t *_txn, void *_value);
 };
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
@@ -49,9 +50,13 @@ datum_t::datum_t(const char *cstr)
 datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
     : type(R_ARRAY), r_array(new std::vector<counted_t<const datum_t> >(std::move(_array))) { }
 
+datum_t::datum_t(datum_object_t &&_object)
+    : type(R_OBJECT), r_object(new datum_object_t(std::move(_object))) {
+    maybe_sanitize_ptype();
+}
+
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
-    : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >(std::move(_object))) {
+    : type(R_OBJECT), r_object(new datum_object_t(_object)) {
     maybe_sanitize_ptype();
 }
 
@@ -68,7 +73,7 @@ datum_t::datum_t(datum_t::type_t _type) : type(_type) {
         r_array = new std::vector<counted_t<const datum_t> >();
     } break;
     case R_OBJECT: {
-        r_object = new std::map<std::string, counted_t<const datum_t> >();
+        r_object = new datum_object_t();
     } break;
     case UNINITIALIZED: // fallthru
     default: unreachable();
@@ -109,7 +114,7 @@ void datum_t::init_array() {
 
 void datum_t::init_object() {
     type = R_OBJECT;
-    r_object = new std::map<std::string, counted_t<const datum_t> >();
+    r_object = new datum_object_t();
 }
 
 void datum_t::init_json(cJSON *json) {
@@ -333,6 +338,84 @@ int datum_t::pseudo_cmp(const datum_t &rhs) const {
     rfail(base_exc_t::GENERIC, "Incomparable type %s.", get_type_name().c_str());
 }
 
+namespace {
+
+// Appends `str` so that it sorts the way `std::string::compare` sorts it, even
+// when followed by more of the key: embedded nulls become "\0\xff" and the
+// string ends with "\0\0".
+void append_cmp_key_str(const std::string &str, std::string *str_out) {
+    for (size_t i = 0; i < str.size(); ++i) {
+        str_out->push_back(str[i]);
+        if (str[i] == '\0') {
+            str_out->push_back('\xff');
+        }
+    }
+    str_out->append(2, '\0');
+}
+
+// Every `type_t` is below this, and pseudotypes sort after everything else.
+const char ptype_cmp_key_tag = 0x10;
+
+}  // namespace
+
+void datum_t::append_cmp_key(std::string *str_out) const {
+    if (is_ptype()) {
+        str_out->push_back(ptype_cmp_key_tag);
+        append_cmp_key_str(get_reql_type(), str_out);
+        if (get_reql_type() == pseudo::time_string) {
+            pseudo::time_to_cmp_key(*this, str_out);
+            return;
+        }
+        rfail(base_exc_t::GENERIC, "Incomparable type %s.", get_type_name().c_str());
+    }
+
+    str_out->push_back(static_cast<char>(get_type()));
+    switch (get_type()) {
+    case R_NULL: break;
+    case R_BOOL: str_out->push_back(as_bool() ? 1 : 0); break;
+    case R_NUM: {
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        guarantee(sizeof(packed.d) == sizeof(packed.u));
+        // `cmp` considers -0.0 and 0.0 equal, so they need the same key.
+        packed.d = as_num() == 0 ? 0.0 : as_num();
+        // Same mangling as `num_to_str_key`, but written out big-endian
+        // rather than in hex.
+        if (packed.u & (1ULL << 63)) {
+            packed.u = ~packed.u;
+        } else {
+            packed.u ^= (1ULL << 63);
+        }
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            str_out->push_back(static_cast<char>((packed.u >> shift) & 0xff));
+        }
+    } break;
+    case R_STR: append_cmp_key_str(as_str(), str_out); break;
+    case R_ARRAY: {
+        // Every element key starts with a nonzero type tag, so the trailing
+        // null sorts shorter arrays first.
+        const std::vector<counted_t<const datum_t> > &arr = as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            (*it)->append_cmp_key(str_out);
+        }
+        str_out->push_back('\0');
+    } break;
+    case R_OBJECT: {
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            str_out->push_back('\1');
+            append_cmp_key_str(it->first, str_out);
+            it->second->append_cmp_key(str_out);
+        }
+        str_out->push_back('\0');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 void datum_t::maybe_sanitize_ptype(const std::set<std::string> &allowed_pts) {
     if (is_ptype()) {
         if (get_reql_type() == pseudo::time_string) {
@@ -689,8 +772,7 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
+    datum_object_t::const_iterator it = as_object().find(key);
     if (it != as_object().end()) return it->second;
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
@@ -699,7 +781,7 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
-const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
+const datum_object_t &datum_t::as_object() const {
     check_type(R_OBJECT);
     return *r_object;
 }
@@ -719,7 +801,7 @@ cJSON *datum_t::as_json_raw() const {
     } break;
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
-        for (std::map<std::string, counted_t<const datum_t> >::const_iterator
+        for (datum_object_t::const_iterator
                  it = r_object->begin(); it != r_object->end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
@@ -766,9 +848,7 @@ MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
     check_type(R_OBJECT);
     check_str_validity(key);
     r_sanity_check(val.has());
-    bool key_in_obj = r_object->count(key) > 0;
-    if (!key_in_obj || (clobber_bool == CLOBBER)) (*r_object)[key] = val;
-    return key_in_obj;
+    return r_object->set(key, val, clobber_bool);
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
@@ -779,7 +859,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
     if (get_type() != R_OBJECT || rhs->get_type() != R_OBJECT) { return rhs; }
 
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         counted_t<const datum_t> sub_lhs = d->get(it->first, NOTHROW);
         bool is_literal = it->second->is_ptype(pseudo::literal_string);
@@ -805,7 +885,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
 counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs,
                                         merge_resoluter_t f) const {
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         if (counted_t<const datum_t> left = get(it->first, NOTHROW)) {
             bool b = d.add(it->first, f(it->first, left, it->second), CLOBBER);
@@ -860,9 +940,8 @@ int datum_t::cmp(const datum_t &rhs) const {
             }
             return pseudo_cmp(rhs);
         } else {
-            const std::map<std::string, counted_t<const datum_t> > &obj = as_object();
-            const std::map<std::string, counted_t<const datum_t> > &rhs_obj
-                = rhs.as_object();
+            const datum_object_t &obj = as_object();
+            const datum_object_t &rhs_obj = rhs.as_object();
             auto it = obj.begin();
             auto it2 = rhs_obj.begin();
             while (it != obj.end() && it2 != rhs_obj.end()) {
@@ -938,14 +1017,16 @@ void datum_t::init_from_pb(const Datum *d) {
     } break;
     case Datum::R_OBJECT: {
         init_object();
+        r_object->reserve(d->r_object_size());
         for (int i = 0; i < d->r_object_size(); ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
             const std::string &key = ap->key();
             check_str_validity(key);
-            rcheck(r_object->count(key) == 0,
+            bool conflict = r_object->set(key, make_counted<datum_t>(&ap->val()),
+                                          NOCLOBBER);
+            rcheck(!conflict,
                    base_exc_t::GENERIC,
                    strprintf("Duplicate key %s in object.", key.c_str()));
-            (*r_object)[key] = make_counted<datum_t>(&ap->val());
         }
         std::set<std::string> allowed_ptypes = { pseudo::literal_string };
         maybe_sanitize_ptype(allowed_ptypes);
@@ -1003,7 +1084,7 @@ void datum_t::write_to_protobuf(Datum *d) const {
     case R_OBJECT: {
         d->set_type(Datum::R_OBJECT);
         // We use rbegin and rend so that things print the way we expect.
-        for (std::map<std::string, counted_t<const datum_t> >::const_reverse_iterator
+        for (datum_object_t::const_reverse_iterator
                  it = r_object->rbegin(); it != r_object->rend(); ++it) {
             Datum_AssocPair *ap = d->add_r_object();
             ap->set_key(it->first);
@@ -1015,21 +1096,6 @@ void datum_t::write_to_protobuf(Datum *d) const {
     }
 }
 
-enum class datum_serialized_type_t {
-    R_ARRAY = 1,
-    R_BOOL = 2,
-    R_NULL = 3,
-    DOUBLE = 4,
-    R_OBJECT = 5,
-    R_STR = 6,
-    INT_NEGATIVE = 7,
-    INT_POSITIVE = 8,
-};
-
-ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
-                                      datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::INT_POSITIVE);
-
 // This must be kept in sync with operator<<(write_message_t &, const counted_t<const
 // datum_T> &).
 size_t serialized_size(const counted_t<const datum_t> &datum) {
@@ -1103,7 +1169,7 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     } break;
     case datum_t::R_OBJECT: {
         wm << datum_serialized_type_t::R_OBJECT;
-        const std::map<std::string, counted_t<const datum_t> > &value = datum->as_object();
+        const datum_object_t &value = datum->as_object();
         wm << value;
     } break;
     case datum_t::R_STR: {
@@ -1190,7 +1256,7 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
         }
     } break;
     case datum_serialized_type_t::R_OBJECT: {
-        std::map<std::string, counted_t<const datum_t> > value;
+        datum_object_t value;
         res = deserialize(s, &value);
         if (res) {
             return res;
@@ -1201,6 +1267,31 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
             return ARCHIVE_RANGE_ERROR;
         }
     } break;
+    case datum_serialized_type_t::R_OBJECT_INDEXED: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        if (res) {
+            return res;
+        }
+        // We're building the whole object, so we have no use for the offsets.
+        for (uint64_t i = 0; i <= sz; ++i) {
+            uint32_t offset;
+            res = deserialize(s, &offset);
+            if (res) {
+                return res;
+            }
+        }
+        datum_object_t value;
+        res = deserialize_object_pairs(s, sz, &value);
+        if (res) {
+            return res;
+        }
+        try {
+            datum->reset(new datum_t(std::move(value)));
+        } catch (const base_exc_t &) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+    } break;
     case datum_serialized_type_t::R_STR: {
         std::string value;
         res = deserialize(s, &value);
@@ -1246,67 +1337,295 @@ archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const da
         return deserialize(s, pointer);
     }
 }
+size_t indexed_serialized_size(const counted_t<const datum_t> &datum) {
+    r_sanity_check(datum.has());
+    switch (datum->get_type()) {
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = datum->as_array();
+        size_t sz = 1 + varint_uint64_serialized_size(arr.size());
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            sz += indexed_serialized_size(*it);
+        }
+        return sz;
+    } break;
+    case datum_t::R_OBJECT: {
+        const datum_object_t &obj = datum->as_object();
+        size_t sz = 1 + varint_uint64_serialized_size(obj.size())
+            + (obj.size() + 1) * serialized_size_t<uint32_t>::value;
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            sz += serialized_size(it->first) + indexed_serialized_size(it->second);
+        }
+        return sz;
+    } break;
+    case datum_t::R_BOOL: // fallthru
+    case datum_t::R_NULL: // fallthru
+    case datum_t::R_NUM: // fallthru
+    case datum_t::R_STR:
+        return serialized_size(datum);
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
+
+// Keep in sync with indexed_serialized_size.
+void serialize_indexed(write_message_t *wm, const counted_t<const datum_t> &datum) {
+    r_sanity_check(datum.has());
+    switch (datum->get_type()) {
+    case datum_t::R_ARRAY: {
+        // Arrays keep the plain format (an offset per element would double the
+        // size of an array of small numbers), but their elements may be objects.
+        const std::vector<counted_t<const datum_t> > &arr = datum->as_array();
+        *wm << datum_serialized_type_t::R_ARRAY;
+        serialize_varint_uint64(wm, arr.size());
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            serialize_indexed(wm, *it);
+        }
+    } break;
+    case datum_t::R_OBJECT: {
+        const datum_object_t &obj = datum->as_object();
+        *wm << datum_serialized_type_t::R_OBJECT_INDEXED;
+        serialize_varint_uint64(wm, obj.size());
+        uint64_t offset = 0;
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            *wm << static_cast<uint32_t>(offset);
+            offset += serialized_size(it->first) + indexed_serialized_size(it->second);
+            guarantee(offset <= std::numeric_limits<uint32_t>::max());
+        }
+        *wm << static_cast<uint32_t>(offset);
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            *wm << it->first;
+            serialize_indexed(wm, it->second);
+        }
+    } break;
+    case datum_t::R_BOOL: // fallthru
+    case datum_t::R_NULL: // fallthru
+    case datum_t::R_NUM: // fallthru
+    case datum_t::R_STR: {
+        *wm << datum;
+    } break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
 
+datum_object_t::datum_object_t(
+        const std::map<std::string, counted_t<const datum_t> > &map) {
+    // `std::map` iterates in key order, so the result is already sorted.
+    pairs.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        pairs.push_back(*it);
+    }
+}
 
-bool wire_datum_map_t::has(counted_t<const datum_t> key) {
-    r_sanity_check(state == COMPILED);
-    return map.count(key) > 0;
+datum_object_t::const_iterator datum_object_t::find(const std::string &key) const {
+    const_iterator it = std::lower_bound(pairs.begin(), pairs.end(), key,
+                                         key_less_t());
+    return (it != pairs.end() && it->first == key) ? it : pairs.end();
 }
 
-counted_t<const datum_t> wire_datum_map_t::get(counted_t<const datum_t> key) {
-    r_sanity_check(state == COMPILED);
-    r_sanity_check(has(key));
-    return map[key];
+std::vector<datum_object_t::value_type>::iterator
+datum_object_t::lower_bound(const std::string &key) {
+    // Objects are usually built in key order (from disk, or from another
+    // object), so check the back of the vector before doing a binary search.
+    if (pairs.empty() || pairs.back().first < key) {
+        return pairs.end();
+    }
+    return std::lower_bound(pairs.begin(), pairs.end(), key, key_less_t());
+}
+
+bool datum_object_t::set(std::string key, counted_t<const datum_t> val,
+                         clobber_bool_t clobber_bool) {
+    std::vector<value_type>::iterator it = lower_bound(key);
+    if (it != pairs.end() && it->first == key) {
+        if (clobber_bool == CLOBBER) {
+            it->second = std::move(val);
+        }
+        return true;
+    }
+    pairs.insert(it, value_type(std::move(key), std::move(val)));
+    return false;
+}
+
+bool datum_object_t::erase(const std::string &key) {
+    std::vector<value_type>::iterator it = lower_bound(key);
+    if (it != pairs.end() && it->first == key) {
+        pairs.erase(it);
+        return true;
+    }
+    return false;
+}
+
+// The serialization format is the same as that of the `std::map` objects used
+// to be stored as, so that existing data can still be read.  Keep in sync with
+// operator<<.
+size_t serialized_size(const datum_object_t &obj) {
+    size_t sz = varint_uint64_serialized_size(obj.size());
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        sz += serialized_size(*it);
+    }
+    return sz;
+}
+
+write_message_t &operator<<(write_message_t &wm, const datum_object_t &obj) {
+    serialize_varint_uint64(&wm, obj.size());
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        wm << *it;
+    }
+    return wm;
+}
+
+archive_result_t deserialize(read_stream_t *s, datum_object_t *obj) {
+    uint64_t sz;
+    archive_result_t res = deserialize_varint_uint64(s, &sz);
+    if (res) { return res; }
+    return deserialize_object_pairs(s, sz, obj);
 }
 
-void wire_datum_map_t::set(counted_t<const datum_t> key, counted_t<const datum_t> val) {
+archive_result_t deserialize_object_pairs(read_stream_t *s, uint64_t sz,
+                                          datum_object_t *obj) {
+    *obj = datum_object_t();
+
+    if (sz > std::numeric_limits<size_t>::max()) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+
+    // Don't trust `sz` too far for the reservation: a corrupt size shouldn't
+    // make us try to allocate a huge vector before the reads start failing.
+    obj->reserve(std::min<uint64_t>(sz, 256));
+    for (uint64_t i = 0; i < sz; ++i) {
+        std::pair<std::string, counted_t<const datum_t> > p;
+        archive_result_t res = deserialize(s, &p);
+        if (res) { return res; }
+        // Like `std::map::insert`, a duplicate key keeps the first value.  The
+        // keys were written in order, so this appends at the back.
+        UNUSED bool dup = obj->set(std::move(p.first), std::move(p.second), NOCLOBBER);
+    }
+
+    return ARCHIVE_SUCCESS;
+}
+
+counted_t<const datum_t> *wire_datum_map_t::get_reduction(counted_t<const datum_t> key) {
     r_sanity_check(state == COMPILED);
-    map[key] = val;
+    std::string cmp_key;
+    key->append_cmp_key(&cmp_key);
+    group_t *group = &map[std::move(cmp_key)];
+    if (!group->group.has()) {
+        group->group = key;
+    }
+    return &group->reduction;
+}
+
+void wire_datum_map_t::push_back_sorted(group_t &&group) {
+    r_sanity_check(state == SERIALIZABLE);
+    r_sanity_check(sorted.empty() || sorted.back().cmp_key < group.cmp_key);
+    sorted.push_back(std::move(group));
+}
+
+const std::vector<wire_datum_map_t::group_t> &wire_datum_map_t::sorted_groups() const {
+    r_sanity_check(state == SERIALIZABLE);
+    return sorted;
 }
 
 void wire_datum_map_t::compile() {
     if (state == COMPILED) return;
-    while (!map_pb.empty()) {
-        map[make_counted<datum_t>(&map_pb.back().first)] =
-            make_counted<datum_t>(&map_pb.back().second);
-        map_pb.pop_back();
+    for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+        std::string cmp_key = std::move(it->cmp_key);
+        map[std::move(cmp_key)] = std::move(*it);
     }
+    sorted.clear();
     state = COMPILED;
 }
+
+struct cmp_key_less_t {
+    bool operator()(const wire_datum_map_t::group_t &a,
+                    const wire_datum_map_t::group_t &b) const {
+        return a.cmp_key < b.cmp_key;
+    }
+};
+
+typedef std::pair<const std::string, wire_datum_map_t::group_t> map_entry_t;
+
+struct map_entry_less_t {
+    bool operator()(const map_entry_t *a, const map_entry_t *b) const {
+        return a->first < b->first;
+    }
+};
+
 void wire_datum_map_t::finalize() {
     if (state == SERIALIZABLE) return;
     r_sanity_check(state == COMPILED);
-    while (!map.empty()) {
-        map_pb.push_back(std::make_pair(Datum(), Datum()));
-        map.begin()->first->write_to_protobuf(&map_pb.back().first);
-        map.begin()->second->write_to_protobuf(&map_pb.back().second);
-        map.erase(map.begin());
+    sorted.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        r_sanity_check(it->second.reduction.has());
+        sorted.push_back(std::move(it->second));
+        sorted.back().cmp_key = it->first;
     }
+    map.clear();
+    std::sort(sorted.begin(), sorted.end(), cmp_key_less_t());
     state = SERIALIZABLE;
 }
 
 counted_t<const datum_t> wire_datum_map_t::to_arr() const {
-    r_sanity_check(state == COMPILED);
+    std::vector<const group_t *> groups;
+    if (state == COMPILED) {
+        std::vector<const map_entry_t *> entries;
+        entries.reserve(map.size());
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            entries.push_back(&*it);
+        }
+        std::sort(entries.begin(), entries.end(), map_entry_less_t());
+        groups.reserve(entries.size());
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            groups.push_back(&(*it)->second);
+        }
+    } else {
+        groups.reserve(sorted.size());
+        for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+            groups.push_back(&*it);
+        }
+    }
+
     datum_ptr_t arr(datum_t::R_ARRAY);
-    for (auto it = map.begin(); it != map.end(); ++it) {
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        r_sanity_check((*it)->reduction.has());
         datum_ptr_t obj(datum_t::R_OBJECT);
-        bool b1 = obj.add("group", it->first);
-        bool b2 = obj.add("reduction", it->second);
+        bool b1 = obj.add("group", (*it)->group);
+        bool b2 = obj.add("reduction", (*it)->reduction);
         r_sanity_check(!b1 && !b2);
         arr.add(obj.to_counted());
     }
     return arr.to_counted();
 }
 
+// Only the groups and reductions go over the wire; the receiving end
+// recomputes the keys, which is cheaper than shipping them.
 void wire_datum_map_t::rdb_serialize(write_message_t &msg /* NOLINT */) const {
     r_sanity_check(state == SERIALIZABLE);
-    msg << map_pb;
+    msg << static_cast<uint64_t>(sorted.size());
+    for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+        msg << it->group;
+        msg << it->reduction;
+    }
 }
 
 archive_result_t wire_datum_map_t::rdb_deserialize(read_stream_t *s) {
-    archive_result_t res = deserialize(s, &map_pb);
+    uint64_t sz;
+    archive_result_t res = deserialize(s, &sz);
     if (res) return res;
+    map.clear();
+    sorted.clear();
     state = SERIALIZABLE;
+    for (uint64_t i = 0; i < sz; ++i) {
+        group_t group;
+        res = deserialize(s, &group.group);
+        if (res) return res;
+        res = deserialize(s, &group.reduction);
+        if (res) return res;
+        group.group->append_cmp_key(&group.cmp_key);
+        push_back_sorted(std::move(group));
+    }
     return ARCHIVE_SUCCESS;
 }
 
@@ -6,6 +6,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -16,6 +17,7 @@
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
+#include "containers/slab_allocator.hpp"
 #include "http/json.hpp"
 #include "rdb_protocol/error.hpp"
 
@@ -24,6 +26,7 @@ class Datum;
 RDB_DECLARE_SERIALIZABLE(Datum);
 
 namespace ql {
+class datum_object_t;
 class datum_stream_t;
 class env_t;
 class val_t;
@@ -47,7 +50,7 @@ enum throw_bool_t { NOTHROW = 0, THROW = 1};
 enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 
 // A `datum_t` is basically a JSON value, although we may extend it later.
-class datum_t : public slow_atomic_countable_t<datum_t> {
+class datum_t : public slow_atomic_countable_t<datum_t>, public slab_allocated_mixin_t {
 public:
     // This ordering is important, because we use it to sort objects of
     // disparate type.  It should be alphabetical.
@@ -67,6 +70,7 @@ public:
     explicit datum_t(std::string &&str);
     explicit datum_t(const char *cstr);
     explicit datum_t(std::vector<counted_t<const datum_t> > &&_array);
+    explicit datum_t(datum_object_t &&object);
     explicit datum_t(std::map<std::string, counted_t<const datum_t> > &&object);
 
     // These construct a datum from an equivalent representation.
@@ -98,6 +102,11 @@ public:
     static std::string extract_secondary(const std::string &secondary_and_primary);
     static boost::optional<uint64_t> extract_tag(const std::string &secondary_and_primary);
     store_key_t truncated_secondary() const;
+    /* Appends a string to `str_out` that sorts (bytewise) against other such
+    strings the way this datum sorts against other datums with `cmp`.  Datums
+    that are equal according to `cmp` get the same string.  Unlike
+    `print_primary` this works for every type and is never truncated. */
+    void append_cmp_key(std::string *str_out) const;
     void check_type(type_t desired, const char *msg = NULL) const;
     void type_error(const std::string &msg) const NORETURN;
 
@@ -112,7 +121,7 @@ public:
     // Access an element of an array.
     counted_t<const datum_t> get(size_t index, throw_bool_t throw_bool = THROW) const;
     // Use of `get` is preferred to `as_object` when possible.
-    const std::map<std::string, counted_t<const datum_t> > &as_object() const;
+    const datum_object_t &as_object() const;
 
     // Access an element of an object.
     counted_t<const datum_t> get(const std::string &key,
@@ -201,7 +210,7 @@ private:
         // TODO: Make this a char vector
         std::string *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
-        std::map<std::string, counted_t<const datum_t> > *r_object;
+        datum_object_t *r_object;
     };
 
 public:
@@ -211,11 +220,95 @@ private:
     DISABLE_COPYING(datum_t);
 };
 
+// The representation of an R_OBJECT datum.  Rather than a `std::map` (one tree
+// node per field, pointer chasing on every lookup), this is a contiguous vector
+// of (key, value) pairs kept sorted by key.  Iteration order is the same as the
+// old `std::map` order, lookups are a binary search, and deserializing an
+// object (whose fields are written in key order) is a sequence of appends.  It
+// provides the read-only subset of the `std::map` interface that callers of
+// `datum_t::as_object` need.
+class datum_object_t {
+public:
+    typedef std::string key_type;
+    typedef counted_t<const datum_t> mapped_type;
+    typedef std::pair<std::string, counted_t<const datum_t> > value_type;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+    typedef std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+
+    datum_object_t() { }
+    explicit datum_object_t(const std::map<std::string, counted_t<const datum_t> > &map);
+
+    const_iterator begin() const { return pairs.begin(); }
+    const_iterator end() const { return pairs.end(); }
+    const_reverse_iterator rbegin() const { return pairs.rbegin(); }
+    const_reverse_iterator rend() const { return pairs.rend(); }
+    size_t size() const { return pairs.size(); }
+    bool empty() const { return pairs.empty(); }
+
+    const_iterator find(const std::string &key) const;
+    size_t count(const std::string &key) const { return find(key) != end() ? 1 : 0; }
+
+    void reserve(size_t n) { pairs.reserve(n); }
+    // Sets `key` to `val`, overwriting an existing value only if `clobber_bool`
+    // is `CLOBBER`.  Returns true if `key` was already present.
+    bool set(std::string key, counted_t<const datum_t> val,
+             clobber_bool_t clobber_bool);
+    // Returns true if `key` was present.
+    bool erase(const std::string &key);
+
+private:
+    struct key_less_t {
+        bool operator()(const value_type &p, const std::string &key) const {
+            return p.first < key;
+        }
+    };
+    std::vector<value_type>::iterator lower_bound(const std::string &key);
+
+    std::vector<value_type> pairs;
+};
+
+size_t serialized_size(const datum_object_t &obj);
+write_message_t &operator<<(write_message_t &wm, const datum_object_t &obj);
+archive_result_t deserialize(read_stream_t *s, datum_object_t *obj);
+// Reads the `sz` (key, value) pairs that follow an object's size.
+archive_result_t deserialize_object_pairs(read_stream_t *s, uint64_t sz,
+                                          datum_object_t *obj);
+
+// The tag byte that begins every serialized datum.  `datum_view_t` reads these
+// directly, so the values must never change.
+enum class datum_serialized_type_t {
+    R_ARRAY = 1,
+    R_BOOL = 2,
+    R_NULL = 3,
+    DOUBLE = 4,
+    R_OBJECT = 5,
+    R_STR = 6,
+    INT_NEGATIVE = 7,
+    INT_POSITIVE = 8,
+    // An object followed by an offset table, see `serialize_indexed`.
+    R_OBJECT_INDEXED = 9,
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
+                                      datum_serialized_type_t::R_ARRAY,
+                                      datum_serialized_type_t::R_OBJECT_INDEXED);
+
 size_t serialized_size(const counted_t<const datum_t> &datum);
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
 
+// Serializes `datum` the way `operator<<` does, except that every object is
+// written as `R_OBJECT_INDEXED`: the field count, then `n + 1` uint32 offsets of
+// each (key, value) pair relative to the first pair (the last one being the
+// total size of the pairs), then the pairs themselves in key order.  This lets a
+// `datum_view_t` binary search for a field, or skip over a whole object, without
+// deserializing anything.  This is the format documents are stored in on disk;
+// `deserialize` reads both formats.
+void serialize_indexed(write_message_t *wm, const counted_t<const datum_t> &datum);
+size_t indexed_serialized_size(const counted_t<const datum_t> &datum);
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
 
@@ -281,28 +374,41 @@ private:
 // This is like a `wire_datum_t` but for gmr.  We need it because gmr allows
 // non-strings as keys, while the data model we pinched from JSON doesn't.  See
 // README.md for more info.
+//
+// Groups are hashed on a string from `append_cmp_key`, so adding a row to its
+// group costs one encoding and one hash lookup rather than a `datum_t::cmp` per
+// level of a tree.  `finalize` sorts the groups by that string, which is also
+// their `cmp` order; the serialized form is a sorted run, so the coordinator
+// can merge the runs from each shard without building another hash table.
 class wire_datum_map_t {
 public:
+    struct group_t {
+        group_t() { }
+        group_t(std::string &&_cmp_key, counted_t<const datum_t> _group,
+                counted_t<const datum_t> _reduction)
+            : cmp_key(std::move(_cmp_key)), group(_group), reduction(_reduction) { }
+        std::string cmp_key;
+        counted_t<const datum_t> group;
+        counted_t<const datum_t> reduction;
+    };
+
     wire_datum_map_t() : state(COMPILED) { }
-    bool has(counted_t<const datum_t> key);
-    counted_t<const datum_t> get(counted_t<const datum_t> key);
-    void set(counted_t<const datum_t> key, counted_t<const datum_t> val);
+
+    // Returns the reduction for the group `key`.  It's empty if this is a new
+    // group, and the caller should fill it in.
+    counted_t<const datum_t> *get_reduction(counted_t<const datum_t> key);
+
+    // Appends a group that sorts after every group already in a finalized map.
+    void push_back_sorted(group_t &&group);
+    const std::vector<group_t> &sorted_groups() const;
 
     void compile();
     void finalize();
 
     counted_t<const datum_t> to_arr() const;
 private:
-    struct datum_value_compare_t {
-        bool operator()(counted_t<const datum_t> a, counted_t<const datum_t> b) const {
-            return *a < *b;
-        }
-    };
-
-    std::map<counted_t<const datum_t>,
-             counted_t<const datum_t>,
-             datum_value_compare_t> map;
-    std::vector<std::pair<Datum, Datum> > map_pb;
+    std::unordered_map<std::string, group_t> map;
+    std::vector<group_t> sorted;
 
 public:
     friend class write_message_t;
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <algorithm>
 #include <map>
 
 #include "clustering/administration/metadata.hpp"
@@ -22,6 +23,11 @@ counted_t<datum_stream_t> datum_stream_t::slice(size_t l, size_t r) {
 counted_t<datum_stream_t> datum_stream_t::zip() {
     return make_counted<zip_datum_stream_t>(this->counted_from_this());
 }
+counted_t<datum_stream_t> datum_stream_t::project(UNUSED counted_t<const datum_t> paths,
+                                                  UNUSED bool without,
+                                                  counted_t<func_t> f) {
+    return map(f);
+}
 counted_t<datum_stream_t> datum_stream_t::indexes_of(counted_t<func_t> f) {
     return make_counted<indexes_of_datum_stream_t>(f, counted_from_this());
 }
@@ -92,11 +98,11 @@ counted_t<const datum_t> eager_datum_stream_t::gmr(env_t *env,
     while (counted_t<const datum_t> el = next(env)) {
         counted_t<const datum_t> el_group = group->call(env, el)->as_datum();
         counted_t<const datum_t> el_map = map->call(env, el)->as_datum();
-        if (!wd_map.has(el_group)) {
-            wd_map.set(el_group,
-                       base.has() ? reduce->call(env, base, el_map)->as_datum() : el_map);
+        counted_t<const datum_t> *reduction = wd_map.get_reduction(el_group);
+        if (!reduction->has()) {
+            *reduction = base.has() ? reduce->call(env, base, el_map)->as_datum() : el_map;
         } else {
-            wd_map.set(el_group, reduce->call(env, wd_map.get(el_group), el_map)->as_datum());
+            *reduction = reduce->call(env, *reduction, el_map)->as_datum();
         }
     }
     return wd_map.to_arr();
@@ -187,6 +193,16 @@ counted_t<datum_stream_t> lazy_datum_stream_t::concatmap(counted_t<func_t> f) {
         rdb_protocol_details::transform_variant_t(concatmap_wire_func_t(f)));
     return counted_t<datum_stream_t>(out.release());
 }
+counted_t<datum_stream_t> lazy_datum_stream_t::project(counted_t<const datum_t> paths,
+                                                       bool without,
+                                                       counted_t<func_t> f) {
+    scoped_ptr_t<lazy_datum_stream_t> out(new lazy_datum_stream_t(this));
+    out->json_stream = json_stream->add_transformation(
+        rdb_protocol_details::transform_variant_t(
+            pluck_transform_t(paths, without, map_wire_func_t(f))));
+    return counted_t<datum_stream_t>(out.release());
+}
+
 counted_t<datum_stream_t>
 lazy_datum_stream_t::filter(counted_t<func_t> f,
                             counted_t<func_t> default_filter_val) {
@@ -247,27 +263,30 @@ counted_t<const datum_t> lazy_datum_stream_t::gmr(env_t *env,
             rdb_protocol_details::terminal_variant_t(gmr_wire_func_t(g, m, r)), env);
     wire_datum_map_t *dm = boost::get<wire_datum_map_t>(&res);
     r_sanity_check(dm);
-    dm->compile();
-    counted_t<const datum_t> dm_arr = dm->to_arr();
-    if (!base.has()) {
-        return dm_arr;
-    } else {
+    dm->finalize();
+    if (base.has()) {
+        // The groups are already sorted, so we can fold in `base` in place.
         wire_datum_map_t map;
-
-        for (size_t f = 0; f < dm_arr->size(); ++f) {
-            counted_t<const datum_t> key = dm_arr->get(f)->get("group");
-            counted_t<const datum_t> val = dm_arr->get(f)->get("reduction");
-            r_sanity_check(!map.has(key));
-            map.set(key, r->call(env, base, val)->as_datum());
+        map.finalize();
+        const std::vector<wire_datum_map_t::group_t> &groups = dm->sorted_groups();
+        for (auto it = groups.begin(); it != groups.end(); ++it) {
+            wire_datum_map_t::group_t group = *it;
+            group.reduction = r->call(env, base, group.reduction)->as_datum();
+            map.push_back_sorted(std::move(group));
         }
         return map.to_arr();
     }
+    return dm->to_arr();
 }
 
 hinted_datum_t lazy_datum_stream_t::sorting_hint_next(env_t *env) {
     return json_stream->sorting_hint_next(env);
 }
 
+void lazy_datum_stream_t::read_ahead() {
+    json_stream->read_ahead();
+}
+
 counted_t<const datum_t> lazy_datum_stream_t::next_impl(env_t *env) {
     return json_stream->next(env);
 }
@@ -292,9 +311,32 @@ map_datum_stream_t::map_datum_stream_t(counted_t<func_t> _f,
                                        counted_t<datum_stream_t> _source)
     : eager_datum_stream_t(_source->backtrace()), f(_f), source(_source) {
     guarantee(f.has() && source.has());
+    js_f = func_as_js(f);
 }
 
 counted_t<const datum_t> map_datum_stream_t::next_impl(env_t *env) {
+    if (js_f != NULL) {
+        if (js_results.empty()) {
+            std::vector<counted_t<const datum_t> > args;
+            while (args.size() < js_batch_size) {
+                counted_t<const datum_t> arg = source->next(env);
+                if (!arg.has()) {
+                    break;
+                }
+                args.push_back(arg);
+            }
+            if (args.empty()) {
+                return counted_t<const datum_t>();
+            }
+            std::vector<js_result_t> results;
+            js_f->call_batch(env, args, &results);
+            js_results.insert(js_results.end(), results.begin(), results.end());
+        }
+        js_result_t result = js_results.front();
+        js_results.pop_front();
+        return js_f->result_to_val(result)->as_datum();
+    }
+
     counted_t<const datum_t> arg = source->next(env);
     if (!arg.has()) {
         return counted_t<const datum_t>();
@@ -330,9 +372,38 @@ filter_datum_stream_t::filter_datum_stream_t(counted_t<func_t> _f,
     : eager_datum_stream_t(_source->backtrace()), f(_f),
       default_filter_val(_default_filter_val), source(_source) {
     guarantee(f.has() && source.has());
+    js_f = func_as_js(f);
 }
 
 counted_t<const datum_t> filter_datum_stream_t::next_impl(env_t *env) {
+    if (js_f != NULL) {
+        for (;;) {
+            if (js_results.empty()) {
+                std::vector<counted_t<const datum_t> > args;
+                while (args.size() < js_batch_size) {
+                    counted_t<const datum_t> arg = source->next(env);
+                    if (!arg.has()) {
+                        break;
+                    }
+                    args.push_back(arg);
+                }
+                if (args.empty()) {
+                    return counted_t<const datum_t>();
+                }
+                std::vector<js_result_t> results;
+                js_f->call_batch(env, args, &results);
+                for (size_t i = 0; i < results.size(); ++i) {
+                    js_results.push_back(std::make_pair(args[i], results[i]));
+                }
+            }
+            std::pair<counted_t<const datum_t>, js_result_t> row = js_results.front();
+            js_results.pop_front();
+            if (js_f->filter_result(env, row.second, default_filter_val)) {
+                return row.first;
+            }
+        }
+    }
+
     for (;;) {
         counted_t<const datum_t> arg = source->next(env);
 
@@ -415,6 +486,191 @@ counted_t<const datum_t> zip_datum_stream_t::next_impl(env_t *env) {
     return right.has() ? left->merge(right) : left;
 }
 
+// EQ_JOIN_DATUM_STREAM_T
+eq_join_datum_stream_t::eq_join_datum_stream_t(counted_t<datum_stream_t> _src,
+                                               counted_t<func_t> _left_attr,
+                                               counted_t<table_t> _right,
+                                               const std::string &_index)
+    : wrapper_datum_stream_t(_src), left_attr(_left_attr), right(_right),
+      index(_index), source_done(false) {
+    guarantee(left_attr.has() && right.has());
+}
+
+counted_t<const datum_t> eq_join_datum_stream_t::next_impl(env_t *env) {
+    while (joined.empty() && !source_done) {
+        join_batch(env);
+    }
+    if (joined.empty()) {
+        return counted_t<const datum_t>();
+    }
+    counted_t<const datum_t> datum = joined.front();
+    joined.pop_front();
+    return datum;
+}
+
+void eq_join_datum_stream_t::join_batch(env_t *env) {
+    std::vector<counted_t<const datum_t> > lefts;
+    std::vector<counted_t<const datum_t> > keys;
+    while (lefts.size() < eq_join_batch_size) {
+        counted_t<const datum_t> row = source->next(env);
+        if (!row.has()) {
+            source_done = true;
+            break;
+        }
+        keys.push_back(left_attr->call(env, row)->as_datum());
+        lefts.push_back(row);
+    }
+    if (lefts.empty()) {
+        return;
+    }
+
+    if (index == right->get_pkey()) {
+        std::vector<counted_t<const datum_t> > rights = right->get_rows(env, keys);
+        r_sanity_check(rights.size() == lefts.size());
+        for (size_t i = 0; i < lefts.size(); ++i) {
+            if (rights[i]->get_type() != datum_t::R_NULL) {
+                datum_ptr_t pair(datum_t::R_OBJECT);
+                UNUSED bool b1 = pair.add("left", lefts[i]);
+                UNUSED bool b2 = pair.add("right", rights[i]);
+                joined.push_back(pair.to_counted());
+            }
+        }
+    } else {
+        // Secondary index lookups can match any number of rows, so they're
+        // still one `get_all` per row, but we keep the next
+        // `max_read_ahead_streams` of them reading while we wait on one.
+        std::vector<counted_t<datum_stream_t> > rights;
+        rights.reserve(keys.size());
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+            rights.push_back(right->get_all(env, *it, index, backtrace()));
+        }
+        size_t read_ahead_index = 0;
+        for (size_t i = 0; i < lefts.size(); ++i) {
+            const size_t read_ahead_end
+                = std::min(rights.size(), i + max_read_ahead_streams);
+            for (; read_ahead_index < read_ahead_end; ++read_ahead_index) {
+                rights[read_ahead_index]->read_ahead();
+            }
+            for (;;) {
+                counted_t<const datum_t> row = rights[i]->next(env);
+                if (!row.has()) {
+                    break;
+                }
+                datum_ptr_t pair(datum_t::R_OBJECT);
+                UNUSED bool b1 = pair.add("left", lefts[i]);
+                UNUSED bool b2 = pair.add("right", row);
+                joined.push_back(pair.to_counted());
+            }
+        }
+    }
+}
+
+// HASH_JOIN_DATUM_STREAM_T
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+        counted_t<datum_stream_t> _src,
+        const std::string &_left_field,
+        const std::string &_right_field,
+        const std::vector<counted_t<const datum_t> > &_right_rows,
+        bool _outer)
+    : wrapper_datum_stream_t(_src), left_field(_left_field),
+      right_field(_right_field), outer(_outer), right_rows(_right_rows) { }
+
+counted_t<const datum_t> hash_join_datum_stream_t::next_impl(env_t *env) {
+    while (joined.empty()) {
+        counted_t<const datum_t> left = source->next(env);
+        if (!left.has()) {
+            return counted_t<const datum_t>();
+        }
+
+        // Like the nested loop, we only look at the fields once there's
+        // something to compare them to.
+        for (auto it = right_rows.begin(); it != right_rows.end(); ++it) {
+            std::string key;
+            (*it)->get(right_field)->append_cmp_key(&key);
+            right_by_key[key].push_back(*it);
+        }
+        std::vector<counted_t<const datum_t> >().swap(right_rows);
+
+        const std::vector<counted_t<const datum_t> > *matches = NULL;
+        if (!right_by_key.empty()) {
+            std::string key;
+            left->get(left_field)->append_cmp_key(&key);
+            auto it = right_by_key.find(key);
+            if (it != right_by_key.end()) {
+                matches = &it->second;
+            }
+        }
+
+        if (matches != NULL) {
+            for (auto it = matches->begin(); it != matches->end(); ++it) {
+                datum_ptr_t pair(datum_t::R_OBJECT);
+                UNUSED bool b1 = pair.add("left", left);
+                UNUSED bool b2 = pair.add("right", *it);
+                joined.push_back(pair.to_counted());
+            }
+        } else if (outer) {
+            datum_ptr_t pair(datum_t::R_OBJECT);
+            UNUSED bool b = pair.add("left", left);
+            joined.push_back(pair.to_counted());
+        }
+    }
+    counted_t<const datum_t> datum = joined.front();
+    joined.pop_front();
+    return datum;
+}
+
+// NESTED_LOOP_JOIN_DATUM_STREAM_T
+nested_loop_join_datum_stream_t::nested_loop_join_datum_stream_t(
+        counted_t<datum_stream_t> _src,
+        counted_t<func_t> _predicate,
+        counted_t<datum_stream_t> _right,
+        const std::vector<counted_t<const datum_t> > &_right_rows,
+        bool _outer)
+    : wrapper_datum_stream_t(_src), predicate(_predicate), right(_right),
+      right_rows(_right_rows), outer(_outer) {
+    guarantee(predicate.has() && right.has());
+}
+
+counted_t<const datum_t> nested_loop_join_datum_stream_t::next_impl(env_t *env) {
+    while (joined.empty()) {
+        counted_t<const datum_t> left = source->next(env);
+        if (!left.has()) {
+            return counted_t<const datum_t>();
+        }
+
+        bool matched = false;
+        for (size_t i = 0; ; ++i) {
+            if (i == right_rows.size()) {
+                if (!right.has()) {
+                    break;
+                }
+                counted_t<const datum_t> row = right->next(env);
+                if (!row.has()) {
+                    right.reset();
+                    break;
+                }
+                right_rows.push_back(row);
+            }
+            if (predicate->call(env, left, right_rows[i])->as_bool()) {
+                datum_ptr_t pair(datum_t::R_OBJECT);
+                UNUSED bool b1 = pair.add("left", left);
+                UNUSED bool b2 = pair.add("right", right_rows[i]);
+                joined.push_back(pair.to_counted());
+                matched = true;
+            }
+        }
+
+        if (!matched && outer) {
+            datum_ptr_t pair(datum_t::R_OBJECT);
+            UNUSED bool b = pair.add("left", left);
+            joined.push_back(pair.to_counted());
+        }
+    }
+    counted_t<const datum_t> datum = joined.front();
+    joined.pop_front();
+    return datum;
+}
+
 // UNION_DATUM_STREAM_T
 counted_t<datum_stream_t> union_datum_stream_t::filter(counted_t<func_t> f,
                                                        counted_t<func_t> default_filter_val) {
@@ -429,6 +685,14 @@ counted_t<datum_stream_t> union_datum_stream_t::map(counted_t<func_t> f) {
     }
     return counted_t<datum_stream_t>(this);
 }
+counted_t<datum_stream_t> union_datum_stream_t::project(counted_t<const datum_t> paths,
+                                                        bool without,
+                                                        counted_t<func_t> f) {
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        *it = (*it)->project(paths, without, f);
+    }
+    return counted_t<datum_stream_t>(this);
+}
 counted_t<datum_stream_t> union_datum_stream_t::concatmap(counted_t<func_t> f) {
     for (auto it = streams.begin(); it != streams.end(); ++it) {
         *it = (*it)->concatmap(f);
@@ -488,10 +752,11 @@ counted_t<const datum_t> union_datum_stream_t::gmr(
             counted_t<const datum_t> el = d->get(i);
             counted_t<const datum_t> el_group = el->get("group");
             counted_t<const datum_t> el_reduction = el->get("reduction");
-            if (!dm.has(el_group)) {
-                dm.set(el_group, el_reduction);
+            counted_t<const datum_t> *reduction = dm.get_reduction(el_group);
+            if (!reduction->has()) {
+                *reduction = el_reduction;
             } else {
-                dm.set(el_group, r->call(env, dm.get(el_group), el_reduction)->as_datum());
+                *reduction = r->call(env, *reduction, el_reduction)->as_datum();
             }
         }
     }
@@ -519,6 +784,12 @@ counted_t<const datum_t> union_datum_stream_t::as_array(env_t *env) {
 
 counted_t<const datum_t> union_datum_stream_t::next_impl(env_t *env) {
     for (; streams_index < streams.size(); ++streams_index) {
+        size_t read_ahead_end
+            = std::min(streams.size(), streams_index + max_read_ahead_streams);
+        for (; read_ahead_index < read_ahead_end; ++read_ahead_index) {
+            streams[read_ahead_index]->read_ahead();
+        }
+
         counted_t<const datum_t> datum = streams[streams_index]->next(env);
         if (datum.has()) {
             return datum;
@@ -5,9 +5,11 @@
 #include <algorithm>
 #include <deque>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "extproc/js_runner.hpp"
 #include "rdb_protocol/stream.hpp"
 
 namespace query_language {
@@ -18,7 +20,9 @@ namespace ql {
 typedef query_language::sorting_hint_t sorting_hint_t;
 typedef query_language::hinted_datum_t hinted_datum_t;
 
+class js_func_t;
 class scope_env_t;
+class table_t;
 
 class datum_stream_t : public single_threaded_countable_t<datum_stream_t>,
                        public pb_rcheckable_t {
@@ -30,6 +34,12 @@ public:
                                              counted_t<func_t> default_filter_val) = 0;
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f) = 0;
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f) = 0;
+    // A `pluck` (or, if `without`, a `without`) of `paths`; `f` is the same
+    // thing as a function.  Streams that read from the cluster hand the paths
+    // to the shards, the rest just map `f`.
+    virtual counted_t<datum_stream_t> project(counted_t<const datum_t> paths,
+                                              bool without,
+                                              counted_t<func_t> f);
 
     // stream -> atom
     virtual counted_t<const datum_t> count(env_t *env) = 0;
@@ -48,6 +58,11 @@ public:
     counted_t<datum_stream_t> zip();
     counted_t<datum_stream_t> indexes_of(counted_t<func_t> f);
 
+    // Lets a stream that reads from the cluster start reading before the first
+    // call to `next`.  Only call it once the stream won't be transformed any
+    // further.
+    virtual void read_ahead() { }
+
     // Returns false or NULL respectively if stream is lazy.
     virtual bool is_array() = 0;
     virtual counted_t<const datum_t> as_array(env_t *env) = 0;
@@ -142,6 +157,9 @@ protected:
     const counted_t<datum_stream_t> source;
 };
 
+// JavaScript mapping and filter functions are called on `js_batch_size` rows at
+// a time, to save round trips to the worker process.
+static const size_t js_batch_size = 100;
 class map_datum_stream_t : public eager_datum_stream_t {
 public:
     map_datum_stream_t(counted_t<func_t> _f, counted_t<datum_stream_t> _source);
@@ -151,6 +169,10 @@ private:
 
     counted_t<func_t> f;
     counted_t<datum_stream_t> source;
+
+    // Non-NULL if `f` is a JavaScript function.
+    const js_func_t *js_f;
+    std::deque<js_result_t> js_results;
 };
 
 class indexes_of_datum_stream_t : public eager_datum_stream_t {
@@ -178,6 +200,11 @@ private:
     counted_t<func_t> f;
     counted_t<func_t> default_filter_val;
     counted_t<datum_stream_t> source;
+
+    // Non-NULL if `f` is a JavaScript function.
+    const js_func_t *js_f;
+    // The rows of the current batch, with their results.
+    std::deque<std::pair<counted_t<const datum_t>, js_result_t> > js_results;
 };
 
 class concatmap_datum_stream_t : public eager_datum_stream_t {
@@ -216,6 +243,9 @@ public:
                                              counted_t<func_t> default_filter_val);
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f);
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f);
+    virtual counted_t<datum_stream_t> project(counted_t<const datum_t> paths,
+                                              bool without,
+                                              counted_t<func_t> f);
 
     virtual counted_t<const datum_t> count(env_t *env);
     virtual counted_t<const datum_t> reduce(env_t *env,
@@ -230,6 +260,7 @@ public:
     virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
         return counted_t<const datum_t>();  // Cannot be converted implicitly.
     }
+    virtual void read_ahead();
 
 protected:
     virtual hinted_datum_t sorting_hint_next(env_t *env);
@@ -274,6 +305,84 @@ private:
     counted_t<const datum_t> next_impl(env_t *env);
 };
 
+// How many `get_all` streams on a secondary index we keep reading at once, in
+// `union_datum_stream_t` and `eq_join_datum_stream_t`.  This turns one read per
+// key, one after another, into overlapping reads without flooding the shards.
+static const size_t max_read_ahead_streams = 64;
+
+// Joins each row of `source` with the rows of `right` whose `index` equals
+// `left_attr` of that row.  Rather than doing a lookup per row, it pulls
+// `eq_join_batch_size` rows from `source` at a time and, when `index` is the
+// primary key, looks them all up with a single `get_rows`.  On a secondary
+// index it reads up to `max_read_ahead_streams` of the batch's rows at once.
+static const size_t eq_join_batch_size = 1000;
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> src,
+                           counted_t<func_t> _left_attr,
+                           counted_t<table_t> _right,
+                           const std::string &_index);
+private:
+    counted_t<const datum_t> next_impl(env_t *env);
+    void join_batch(env_t *env);
+
+    counted_t<func_t> left_attr;
+    counted_t<table_t> right;
+    std::string index;
+
+    std::deque<counted_t<const datum_t> > joined;
+    bool source_done;
+};
+
+// The probe side of `innerJoin` and `outerJoin` when the predicate is a field
+// equality: `right_rows` is hashed on `right_field` once, and each row of
+// `source` is joined with the ones whose key matches its `left_field`.  Rows
+// come out in the same order as the nested loop would produce them.
+static const size_t hash_join_build_limit = 100000;
+class hash_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> src,
+                             const std::string &_left_field,
+                             const std::string &_right_field,
+                             const std::vector<counted_t<const datum_t> > &_right_rows,
+                             bool _outer);
+private:
+    counted_t<const datum_t> next_impl(env_t *env);
+
+    std::string left_field;
+    std::string right_field;
+    bool outer;
+    // Emptied into `right_by_key` when the first row of `source` shows up.
+    std::vector<counted_t<const datum_t> > right_rows;
+    std::unordered_map<std::string, std::vector<counted_t<const datum_t> > > right_by_key;
+
+    std::deque<counted_t<const datum_t> > joined;
+};
+
+// `innerJoin` and `outerJoin` for any other predicate, or when the right side
+// has more than `hash_join_build_limit` rows: each row of `source` is compared
+// with every right row.  The right rows are `right_rows` followed by the rest of
+// `right`, which is read as the first row of `source` needs it and kept, so that
+// it's only evaluated once.
+class nested_loop_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    nested_loop_join_datum_stream_t(counted_t<datum_stream_t> src,
+                                    counted_t<func_t> _predicate,
+                                    counted_t<datum_stream_t> _right,
+                                    const std::vector<counted_t<const datum_t> > &_right_rows,
+                                    bool _outer);
+private:
+    counted_t<const datum_t> next_impl(env_t *env);
+
+    counted_t<func_t> predicate;
+    // Empty once it's been read to the end.
+    counted_t<datum_stream_t> right;
+    std::vector<counted_t<const datum_t> > right_rows;
+    bool outer;
+
+    std::deque<counted_t<const datum_t> > joined;
+};
+
 // This has to be constructed explicitly rather than invoking `.sort()`.  There
 // was a good reason for this involving header dependencies, but I don't
 // remember exactly what it was.
@@ -371,13 +480,17 @@ class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(const std::vector<counted_t<datum_stream_t> > &_streams,
                          const protob_t<const Backtrace> &bt_src)
-        : datum_stream_t(bt_src), streams(_streams), streams_index(0) { }
+        : datum_stream_t(bt_src), streams(_streams), streams_index(0),
+          read_ahead_index(0) { }
 
     // stream -> stream
     virtual counted_t<datum_stream_t> filter(counted_t<func_t> f,
                                              counted_t<func_t> default_filter_val);
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f);
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f);
+    virtual counted_t<datum_stream_t> project(counted_t<const datum_t> paths,
+                                              bool without,
+                                              counted_t<func_t> f);
 
     // stream -> atom
     virtual counted_t<const datum_t> count(env_t *env);
@@ -397,6 +510,8 @@ private:
 
     std::vector<counted_t<datum_stream_t> > streams;
     size_t streams_index;
+    // Streams before this one have been told to read ahead.
+    size_t read_ahead_index;
 };
 
 } // namespace ql
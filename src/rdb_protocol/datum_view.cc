@@ -0,0 +1,280 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum_view.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "containers/archive/buffer_group_stream.hpp"
+#include "containers/buffer_group.hpp"
+
+namespace ql {
+
+namespace {
+
+const char *const corruption_msg = "disk corruption (or programmer error) detected";
+
+// The bytes we look at were written by us, so running off the end of them means
+// corruption.
+void check_remaining(const char *p, const char *end, uint64_t n) {
+    guarantee(p <= end && static_cast<uint64_t>(end - p) >= n, "%s", corruption_msg);
+}
+
+// See containers/archive/varint.hpp for the encoding.
+uint64_t read_varint(const char **p, const char *end) {
+    uint64_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        check_remaining(*p, end, 1);
+        guarantee(shift < 64, "%s", corruption_msg);
+        uint8_t byte = static_cast<uint8_t>(**p);
+        ++*p;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+uint32_t read_offset(const char *offsets, uint64_t i) {
+    uint32_t offset;
+    memcpy(&offset, offsets + i * sizeof(uint32_t), sizeof(uint32_t));
+    return offset;
+}
+
+// Compares like `std::string::compare`.
+int compare_key(const char *key, uint64_t key_size, const std::string &rhs) {
+    int res = memcmp(key, rhs.data(), std::min<uint64_t>(key_size, rhs.size()));
+    if (res != 0) {
+        return res;
+    }
+    return key_size < rhs.size() ? -1 : (key_size > rhs.size() ? 1 : 0);
+}
+
+const char *skip_string(const char *p, const char *end) {
+    uint64_t sz = read_varint(&p, end);
+    check_remaining(p, end, sz);
+    return p + sz;
+}
+
+// Returns a pointer just past the serialized datum that starts at `p`.
+const char *skip_datum(const char *p, const char *end) {
+    check_remaining(p, end, 1);
+    datum_serialized_type_t type = static_cast<datum_serialized_type_t>(*p);
+    ++p;
+    switch (type) {
+    case datum_serialized_type_t::R_ARRAY: {
+        uint64_t n = read_varint(&p, end);
+        for (uint64_t i = 0; i < n; ++i) {
+            p = skip_datum(p, end);
+        }
+        return p;
+    }
+    case datum_serialized_type_t::R_BOOL: {
+        check_remaining(p, end, serialized_size_t<bool>::value);
+        return p + serialized_size_t<bool>::value;
+    }
+    case datum_serialized_type_t::R_NULL:
+        return p;
+    case datum_serialized_type_t::DOUBLE: {
+        check_remaining(p, end, serialized_size_t<double>::value);
+        return p + serialized_size_t<double>::value;
+    }
+    case datum_serialized_type_t::INT_NEGATIVE: // fallthru
+    case datum_serialized_type_t::INT_POSITIVE: {
+        read_varint(&p, end);
+        return p;
+    }
+    case datum_serialized_type_t::R_OBJECT: {
+        uint64_t n = read_varint(&p, end);
+        for (uint64_t i = 0; i < n; ++i) {
+            p = skip_string(p, end);
+            p = skip_datum(p, end);
+        }
+        return p;
+    }
+    case datum_serialized_type_t::R_STR:
+        return skip_string(p, end);
+    case datum_serialized_type_t::R_OBJECT_INDEXED: {
+        uint64_t n = read_varint(&p, end);
+        check_remaining(p, end, (n + 1) * sizeof(uint32_t));
+        uint32_t total = read_offset(p, n);
+        p += (n + 1) * sizeof(uint32_t);
+        check_remaining(p, end, total);
+        return p + total;
+    }
+    default:
+        crash("%s", corruption_msg);
+    }
+}
+
+}  // namespace
+
+datum_view_t::datum_view_t(const char *_data, size_t _size)
+    : data(_data), size(_size) {
+    guarantee(data != NULL);
+    check_remaining(data, data + size, 1);
+}
+
+datum_serialized_type_t datum_view_t::tag() const {
+    r_sanity_check(has());
+    return static_cast<datum_serialized_type_t>(data[0]);
+}
+
+datum_t::type_t datum_view_t::get_type() const {
+    switch (tag()) {
+    case datum_serialized_type_t::R_ARRAY: return datum_t::R_ARRAY;
+    case datum_serialized_type_t::R_BOOL: return datum_t::R_BOOL;
+    case datum_serialized_type_t::R_NULL: return datum_t::R_NULL;
+    case datum_serialized_type_t::DOUBLE: // fallthru
+    case datum_serialized_type_t::INT_NEGATIVE: // fallthru
+    case datum_serialized_type_t::INT_POSITIVE: return datum_t::R_NUM;
+    case datum_serialized_type_t::R_OBJECT: // fallthru
+    case datum_serialized_type_t::R_OBJECT_INDEXED: return datum_t::R_OBJECT;
+    case datum_serialized_type_t::R_STR: return datum_t::R_STR;
+    default: crash("%s", corruption_msg);
+    }
+}
+
+bool datum_view_t::is_scalar() const {
+    datum_t::type_t type = get_type();
+    return type != datum_t::R_ARRAY && type != datum_t::R_OBJECT;
+}
+
+double datum_view_t::scalar_num() const {
+    const char *p = data + 1;
+    const char *end = data + size;
+    switch (tag()) {
+    case datum_serialized_type_t::DOUBLE: {
+        check_remaining(p, end, sizeof(double));
+        double d;
+        memcpy(&d, p, sizeof(double));
+        return d;
+    }
+    case datum_serialized_type_t::INT_NEGATIVE:
+        return -static_cast<double>(read_varint(&p, end));
+    case datum_serialized_type_t::INT_POSITIVE:
+        return static_cast<double>(read_varint(&p, end));
+    default: unreachable();
+    }
+}
+
+datum_view_t datum_view_t::get_field(const std::string &key) const {
+    const char *p = data + 1;
+    const char *end = data + size;
+    switch (tag()) {
+    case datum_serialized_type_t::R_OBJECT: {
+        uint64_t n = read_varint(&p, end);
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t key_size = read_varint(&p, end);
+            check_remaining(p, end, key_size);
+            int key_cmp = compare_key(p, key_size, key);
+            p += key_size;
+            const char *value_end = skip_datum(p, end);
+            if (key_cmp == 0) {
+                return datum_view_t(p, value_end - p);
+            } else if (key_cmp > 0) {
+                // Fields are always written in key order.
+                break;
+            }
+            p = value_end;
+        }
+        return datum_view_t();
+    }
+    case datum_serialized_type_t::R_OBJECT_INDEXED: {
+        uint64_t n = read_varint(&p, end);
+        check_remaining(p, end, (n + 1) * sizeof(uint32_t));
+        const char *offsets = p;
+        const char *pairs = p + (n + 1) * sizeof(uint32_t);
+        const char *pairs_end = pairs + read_offset(offsets, n);
+        check_remaining(pairs, end, pairs_end - pairs);
+
+        uint64_t lo = 0, hi = n;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            const char *pair = pairs + read_offset(offsets, mid);
+            const char *pair_end = pairs + read_offset(offsets, mid + 1);
+            guarantee(pair <= pair_end && pair_end <= pairs_end, "%s", corruption_msg);
+            uint64_t key_size = read_varint(&pair, pair_end);
+            check_remaining(pair, pair_end, key_size);
+            int key_cmp = compare_key(pair, key_size, key);
+            if (key_cmp == 0) {
+                pair += key_size;
+                return datum_view_t(pair, pair_end - pair);
+            } else if (key_cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return datum_view_t();
+    }
+    default:
+        return datum_view_t();
+    }
+}
+
+counted_t<const datum_t> datum_view_t::materialize() const {
+    r_sanity_check(has());
+    const_buffer_group_t group;
+    group.add_buffer(size, data);
+    buffer_group_read_stream_t read_stream(&group);
+    counted_t<const datum_t> datum;
+    archive_result_t res = deserialize(&read_stream, &datum);
+    guarantee(res == ARCHIVE_SUCCESS, "%s", corruption_msg);
+    return datum;
+}
+
+int datum_view_t::cmp(const datum_view_t &rhs) const {
+    // Only objects can be pseudotypes, and only arrays and objects need a
+    // recursive comparison, so anything else we can compare in place.
+    if (!is_scalar() || !rhs.is_scalar()) {
+        return materialize()->cmp(*rhs.materialize());
+    }
+
+    datum_t::type_t type = get_type();
+    datum_t::type_t rhs_type = rhs.get_type();
+    if (type != rhs_type) {
+        return type < rhs_type ? -1 : 1;
+    }
+    switch (type) {
+    case datum_t::R_NULL: return 0;
+    case datum_t::R_BOOL: {
+        check_remaining(data + 1, data + size, 1);
+        check_remaining(rhs.data + 1, rhs.data + rhs.size, 1);
+        bool b = data[1] != 0;
+        bool rhs_b = rhs.data[1] != 0;
+        return b == rhs_b ? 0 : (b < rhs_b ? -1 : 1);
+    }
+    case datum_t::R_NUM: {
+        double d = scalar_num();
+        double rhs_d = rhs.scalar_num();
+        return d == rhs_d ? 0 : (d < rhs_d ? -1 : 1);
+    }
+    case datum_t::R_STR: {
+        const char *p = data + 1;
+        uint64_t sz = read_varint(&p, data + size);
+        check_remaining(p, data + size, sz);
+        const char *rhs_p = rhs.data + 1;
+        uint64_t rhs_sz = read_varint(&rhs_p, rhs.data + rhs.size);
+        check_remaining(rhs_p, rhs.data + rhs.size, rhs_sz);
+        int res = memcmp(p, rhs_p, std::min(sz, rhs_sz));
+        if (res != 0) {
+            return res;
+        }
+        return sz < rhs_sz ? -1 : (sz > rhs_sz ? 1 : 0);
+    }
+    case datum_t::R_ARRAY: // fallthru
+    case datum_t::R_OBJECT: // fallthru
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+std::string datum_view_t::print_secondary(const store_key_t &primary_key,
+                                          boost::optional<uint64_t> tag_num) const {
+    // Secondary index values are small compared to the documents they come
+    // from; what matters is that we only build this part of the document.
+    return materialize()->print_secondary(primary_key, tag_num);
+}
+
+}  // namespace ql
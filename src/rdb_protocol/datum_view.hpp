@@ -0,0 +1,53 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_VIEW_HPP_
+#define RDB_PROTOCOL_DATUM_VIEW_HPP_
+
+#include <string>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+// A read-only view of one serialized datum, in either the format written by
+// `operator<<` or the one written by `serialize_indexed`.  It answers field
+// lookups, comparisons and `print_secondary` by looking at the bytes, and only
+// builds `datum_t`s for the parts of the document it's asked about.  The view
+// doesn't own the bytes; they must outlive it.
+class datum_view_t {
+public:
+    datum_view_t() : data(NULL), size(0) { }
+    datum_view_t(const char *_data, size_t _size);
+
+    bool has() const { return data != NULL; }
+
+    datum_t::type_t get_type() const;
+
+    // Returns a view of the field `key`, or an empty view if this isn't an
+    // object or it has no such field.  This is a binary search if the object was
+    // written by `serialize_indexed`, and a scan over the keys otherwise.
+    datum_view_t get_field(const std::string &key) const;
+
+    // Deserializes the viewed datum.
+    counted_t<const datum_t> materialize() const;
+
+    // These give the same results as the `datum_t` methods of the same name.
+    // Only arrays and objects get materialized.
+    int cmp(const datum_view_t &rhs) const;
+    std::string print_secondary(const store_key_t &primary_key,
+            boost::optional<uint64_t> tag_num = boost::optional<uint64_t>()) const;
+
+private:
+    datum_serialized_type_t tag() const;
+    bool is_scalar() const;
+    double scalar_num() const;
+
+    const char *data;
+    size_t size;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_VIEW_HPP_
@@ -3,6 +3,7 @@
 
 #include "backtrace.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/response.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/val.hpp"
 
@@ -75,7 +76,7 @@ void backtrace_t::fill_bt(Backtrace *bt) const {
         *bt->add_frames() = it->toproto();
     }
 }
-void backtrace_t::fill_error(Response *res, Response_ResponseType type,
+void backtrace_t::fill_error(response_t *res, Response_ResponseType type,
                              std::string msg) const {
     guarantee(type == Response::CLIENT_ERROR ||
               type == Response::COMPILE_ERROR ||
@@ -83,11 +84,14 @@ void backtrace_t::fill_error(Response *res, Response_ResponseType type,
     Datum error_msg;
     error_msg.set_type(Datum::R_STR);
     error_msg.set_r_str(msg);
-    res->set_type(type);
-    *res->add_response() = error_msg;
-    fill_bt(res->mutable_backtrace());
+    // Drop any data we got before the error.
+    res->clear_data();
+    Response *pb = res->mutable_pb();
+    pb->set_type(type);
+    *pb->add_response() = error_msg;
+    fill_bt(pb->mutable_backtrace());
 }
-void fill_error(Response *res, Response_ResponseType type, std::string msg,
+void fill_error(response_t *res, Response_ResponseType type, std::string msg,
                 const backtrace_t &bt) {
     bt.fill_error(res, type, msg);
 }
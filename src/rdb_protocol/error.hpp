@@ -15,6 +15,8 @@
 
 namespace ql {
 
+class response_t;
+
 // Catch this if you want to handle either `exc_t` or `datum_exc_t`.
 class base_exc_t : public std::exception {
 public:
@@ -214,7 +216,7 @@ public:
 
     void fill_bt(Backtrace *bt) const;
     // Write out the backtrace to return it to the user.
-    void fill_error(Response *res, Response_ResponseType type, std::string msg) const;
+    void fill_error(response_t *res, Response_ResponseType type, std::string msg) const;
     RDB_MAKE_ME_SERIALIZABLE_1(frames);
 
     bool is_empty() { return frames.size() == 0; }
@@ -287,7 +289,7 @@ public:
     RDB_MAKE_ME_SERIALIZABLE_2(type_, exc_msg);
 };
 
-void fill_error(Response *res, Response_ResponseType type, std::string msg,
+void fill_error(response_t *res, Response_ResponseType type, std::string msg,
                 const backtrace_t &bt = backtrace_t());
 
 } // namespace ql
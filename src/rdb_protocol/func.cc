@@ -1,5 +1,9 @@
 #include "rdb_protocol/func.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/pb_utils.hpp"
@@ -111,6 +115,45 @@ counted_t<val_t> js_func_t::call(env_t *env, const std::vector<counted_t<const d
     }
 }
 
+void js_func_t::call_batch(env_t *env,
+                           const std::vector<counted_t<const datum_t> > &args,
+                           std::vector<js_result_t> *results_out) const {
+    js_runner_t::req_config_t config;
+    config.timeout_ms = js_timeout_ms;
+
+    r_sanity_check(!js_source.empty());
+    std::vector<std::vector<counted_t<const datum_t> > > args_batch;
+    args_batch.reserve(args.size());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        args_batch.push_back(std::vector<counted_t<const datum_t> >(1, *it));
+    }
+
+    try {
+        env->get_js_runner()->call_batch(js_source, args_batch, config, results_out);
+    } catch (const js_worker_exc_t &e) {
+        rfail(base_exc_t::GENERIC,
+              "Javascript query `%s` caused a crash in a worker process.",
+              js_source.c_str());
+    } catch (const interrupted_exc_t &e) {
+        // The row after the last result timed out by itself.  The rows before
+        // it keep their results, and the ones after it never ran.
+        results_out->push_back(js_result_t(strprintf(
+            "JavaScript query `%s` timed out after %" PRIu64 ".%03" PRIu64 " seconds.",
+            js_source.c_str(), js_timeout_ms / 1000, js_timeout_ms % 1000)));
+    }
+}
+
+counted_t<val_t> js_func_t::result_to_val(const js_result_t &result) const {
+    try {
+        return boost::apply_visitor(js_result_visitor_t(js_source,
+                                                        js_timeout_ms, this),
+                                    result);
+    } catch (const datum_exc_t &e) {
+        rfail(e.get_type(), "%s", e.what());
+        unreachable();
+    }
+}
+
 bool js_func_t::is_deterministic() const {
     return false;
 }
@@ -123,6 +166,106 @@ void js_func_t::visit(func_visitor_t *visitor) const {
     visitor->on_js_func(this);
 }
 
+bool term_is_get_field(const Term &term, sym_t var, std::string *field_out) {
+    if (term.type() != Term::GET_FIELD
+        || term.args_size() != 2 || term.optargs_size() != 0) {
+        return false;
+    }
+    const Term &obj = term.args(0);
+    if (obj.type() != Term::VAR || obj.args_size() != 1
+        || obj.args(0).type() != Term::DATUM
+        || obj.args(0).datum().type() != Datum::R_NUM
+        || obj.args(0).datum().r_num() != var.value) {
+        return false;
+    }
+    const Term &field = term.args(1);
+    if (field.type() != Term::DATUM || field.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *field_out = field.datum().r_str();
+    return true;
+}
+
+class get_field_func_visitor_t : public func_visitor_t {
+public:
+    explicit get_field_func_visitor_t(std::string *_field_out)
+        : field_out(_field_out), result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        const std::vector<sym_t> &arg_names = reql_func->get_arg_names();
+        result = arg_names.size() == 1
+            && term_is_get_field(*reql_func->get_body()->get_src(),
+                                 arg_names[0], field_out);
+    }
+    void on_js_func(const js_func_t *) {
+        result = false;
+    }
+
+    std::string *field_out;
+    bool result;
+};
+
+bool func_is_get_field(const counted_t<func_t> &func, std::string *field_out) {
+    get_field_func_visitor_t visitor(field_out);
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class js_func_visitor_t : public func_visitor_t {
+public:
+    js_func_visitor_t() : result(NULL) { }
+
+    void on_reql_func(const reql_func_t *) {
+        result = NULL;
+    }
+    void on_js_func(const js_func_t *js_func) {
+        result = js_func;
+    }
+
+    const js_func_t *result;
+};
+
+const js_func_t *func_as_js(const counted_t<func_t> &func) {
+    js_func_visitor_t visitor;
+    func->visit(&visitor);
+    return visitor.result;
+}
+
+class field_eq_func_visitor_t : public func_visitor_t {
+public:
+    field_eq_func_visitor_t(std::string *_left_field_out, std::string *_right_field_out)
+        : left_field_out(_left_field_out), right_field_out(_right_field_out),
+          result(false) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        const std::vector<sym_t> &arg_names = reql_func->get_arg_names();
+        const Term &body = *reql_func->get_body()->get_src();
+        if (arg_names.size() != 2 || body.type() != Term::EQ
+            || body.args_size() != 2 || body.optargs_size() != 0) {
+            result = false;
+            return;
+        }
+        result = (term_is_get_field(body.args(0), arg_names[0], left_field_out)
+                  && term_is_get_field(body.args(1), arg_names[1], right_field_out))
+            || (term_is_get_field(body.args(0), arg_names[1], right_field_out)
+                && term_is_get_field(body.args(1), arg_names[0], left_field_out));
+    }
+    void on_js_func(const js_func_t *) {
+        result = false;
+    }
+
+    std::string *left_field_out;
+    std::string *right_field_out;
+    bool result;
+};
+
+bool func_is_field_eq(const counted_t<func_t> &func,
+                      std::string *left_field_out, std::string *right_field_out) {
+    field_eq_func_visitor_t visitor(left_field_out, right_field_out);
+    func->visit(&visitor);
+    return visitor.result;
+}
+
 func_term_t::func_term_t(compile_env_t *env, const protob_t<const Term> &t)
     : term_t(t) {
     r_sanity_check(t.has());
@@ -216,7 +359,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     if (predicate->is_ptype(pseudo::literal_string)) {
         return *predicate->get(pseudo::value_key) == *value;
     } else {
-        const std::map<std::string, counted_t<const datum_t> > &obj = predicate->as_object();
+        const datum_object_t &obj = predicate->as_object();
         for (auto it = obj.begin(); it != obj.end(); ++it) {
             r_sanity_check(it->second.has());
             counted_t<const datum_t> elt = value->get(it->first, NOTHROW);
@@ -264,19 +407,17 @@ std::string js_func_t::print_source() const {
     return ret;
 }
 
-bool js_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const {
-    counted_t<const datum_t> d = call(env, make_vector(arg))->as_datum();
-    return d->as_bool();
-}
-
-bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<func_t> default_filter_val) const {
+// Calls `filter_fn`, and falls back on `default_filter_val` the way `filter`
+// does when it throws a non-existence error.
+static bool filter_with_default(env_t *env, const boost::function<bool()> &filter_fn,
+                                counted_t<func_t> default_filter_val) {
     // We have to catch every exception type and save it so we can rethrow it later
     // So we don't trigger a coroutine wait in a catch statement
     std::exception_ptr saved_exception;
     base_exc_t::type_t exception_type;
 
     try {
-        return filter_helper(env, arg);
+        return filter_fn();
     } catch (const base_exc_t &e) {
         saved_exception = std::current_exception();
         exception_type = e.get_type();
@@ -313,6 +454,27 @@ bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<fun
     std::rethrow_exception(saved_exception);
 }
 
+bool js_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const {
+    counted_t<const datum_t> d = call(env, make_vector(arg))->as_datum();
+    return d->as_bool();
+}
+
+bool js_func_t::result_filter_helper(const js_result_t &result) const {
+    return result_to_val(result)->as_datum()->as_bool();
+}
+
+bool js_func_t::filter_result(env_t *env, const js_result_t &result,
+                              counted_t<func_t> default_filter_val) const {
+    return filter_with_default(
+        env, boost::bind(&js_func_t::result_filter_helper, this, result),
+        default_filter_val);
+}
+
+bool func_t::filter_call(env_t *env, counted_t<const datum_t> arg, counted_t<func_t> default_filter_val) const {
+    return filter_with_default(
+        env, boost::bind(&func_t::filter_helper, this, env, arg), default_filter_val);
+}
+
 counted_t<func_t> new_constant_func(counted_t<const datum_t> obj,
                                     const protob_t<const Backtrace> &bt_src) {
     protob_t<Term> twrap = make_counted_term();
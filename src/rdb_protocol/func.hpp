@@ -76,6 +76,10 @@ public:
 
     void visit(func_visitor_t *visitor) const;
 
+    // For callers that recognize common function shapes, see `func_is_get_field`.
+    const std::vector<sym_t> &get_arg_names() const { return arg_names; }
+    const counted_t<term_t> &get_body() const { return body; }
+
 private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
@@ -103,6 +107,19 @@ public:
     // function as their argument.
     counted_t<val_t> call(env_t *env, const std::vector<counted_t<const datum_t> > &args) const;
 
+    // Calls the function on each of `args`, sending them to the worker all at
+    // once.  The results are turned into values by `result_to_val` (or
+    // `filter_result`), so that an error for one row doesn't show up until that
+    // row is used.  Each row gets the function's whole timeout, as it would
+    // with `call`; if one runs out of it, its result is the timeout error and
+    // the rows after it are left out.
+    void call_batch(env_t *env, const std::vector<counted_t<const datum_t> > &args,
+                    std::vector<js_result_t> *results_out) const;
+    counted_t<val_t> result_to_val(const js_result_t &result) const;
+    // What `filter_call` would have returned for the row that gave `result`.
+    bool filter_result(env_t *env, const js_result_t &result,
+                       counted_t<func_t> default_filter_val) const;
+
     bool is_deterministic() const;
 
     std::string print_source() const;
@@ -112,6 +129,7 @@ public:
 private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
+    bool result_filter_helper(const js_result_t &result) const;
 
     std::string js_source;
     uint64_t js_timeout_ms;
@@ -144,6 +162,25 @@ counted_t<func_t> new_get_field_func(counted_t<const datum_t> obj,
 counted_t<func_t> new_eq_comparison_func(counted_t<const datum_t> obj,
                                          const protob_t<const Backtrace> &bt_src);
 
+// If `term` is `var(field)` for a literal string `field`, stores the field in
+// `field_out` and returns true.
+bool term_is_get_field(const Term &term, sym_t var, std::string *field_out);
+
+// If `func` is a ReQL function of one argument that just returns a field of it
+// (`function(x) { return x('field'); }`, which is what `indexCreate('field')`
+// produces), stores the field in `field_out` and returns true.
+bool func_is_get_field(const counted_t<func_t> &func, std::string *field_out);
+
+// Returns `func` if it's a JavaScript function, or NULL.
+const js_func_t *func_as_js(const counted_t<func_t> &func);
+
+// If `func` is a ReQL function of two arguments that just compares a field of
+// each for equality (`function(l, r) { return l('a').eq(r('b')); }`, in either
+// order), stores the fields in `left_field_out` and `right_field_out` and
+// returns true.
+bool func_is_field_eq(const counted_t<func_t> &func,
+                      std::string *left_field_out, std::string *right_field_out);
+
 
 class js_result_visitor_t : public boost::static_visitor<counted_t<val_t> > {
 public:
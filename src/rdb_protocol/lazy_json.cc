@@ -1,8 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/lazy_json.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "containers/archive/buffer_group_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/datum_view.hpp"
 
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
                                       transaction_t *txn) {
@@ -23,7 +28,100 @@ counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
 
 const counted_t<const ql::datum_t> &lazy_json_t::get() const {
     if (!pointee->ptr) {
-        pointee->ptr = get_data(pointee->rdb_value, pointee->txn);
+        if (!pointee->serialized.empty()) {
+            pointee->ptr = ql::datum_view_t(pointee->serialized.data(),
+                                            pointee->serialized.size()).materialize();
+            pointee->serialized.clear();
+        } else {
+            pointee->ptr = get_data(pointee->rdb_value, pointee->txn);
+        }
     }
     return pointee->ptr;
 }
+
+void materialize_field(const ql::datum_view_t &field,
+                       counted_t<const ql::datum_t> *field_out) {
+    if (field.has()) {
+        *field_out = field.materialize();
+    }
+}
+
+counted_t<const ql::datum_t> lazy_json_t::get_field(const std::string &key) const {
+    if (pointee->ptr) {
+        if (pointee->ptr->get_type() != ql::datum_t::R_OBJECT) {
+            return counted_t<const ql::datum_t>();
+        }
+        return pointee->ptr->get(key, ql::NOTHROW);
+    }
+
+    counted_t<const ql::datum_t> field;
+    with_field_view(key, boost::bind(&materialize_field, _1, &field));
+    return field;
+}
+
+void lazy_json_t::with_field_view(
+        const std::string &key,
+        const boost::function<void(const ql::datum_view_t &)> &fn) const {
+    if (pointee->ptr) {
+        counted_t<const ql::datum_t> field;
+        if (pointee->ptr->get_type() == ql::datum_t::R_OBJECT) {
+            field = pointee->ptr->get(key, ql::NOTHROW);
+        }
+        if (!field) {
+            fn(ql::datum_view_t());
+            return;
+        }
+        // The value has already been deserialized, so there are no bytes to
+        // look at.  Fields are small next to whole rows, so we write this one
+        // out again.
+        write_message_t wm;
+        wm << field;
+        vector_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        fn(ql::datum_view_t(stream.vector().data(), stream.vector().size()));
+        return;
+    }
+
+    if (pointee->serialized.empty()) {
+        rdb_blob_wrapper_t blob(pointee->txn->get_cache()->get_block_size(),
+                                const_cast<rdb_value_t *>(pointee->rdb_value)->value_ref(),
+                                blob::btree_maxreflen);
+        blob_acq_t acq_group;
+        buffer_group_t buffer_group;
+        blob.expose_all(pointee->txn, rwi_read, &buffer_group, &acq_group);
+        if (buffer_group.num_buffers() == 1) {
+            // The value is contiguous (in the leaf node, or in a single blob
+            // block), so we can look at it in place.
+            buffer_group_t::buffer_t buf = buffer_group.get_buffer(0);
+            fn(ql::datum_view_t(static_cast<const char *>(buf.data),
+                                buf.size).get_field(key));
+            return;
+        }
+    }
+
+    copy_serialized();
+    fn(ql::datum_view_t(pointee->serialized.data(),
+                        pointee->serialized.size()).get_field(key));
+}
+
+void lazy_json_t::copy_serialized() const {
+    if (pointee->ptr || !pointee->serialized.empty()) {
+        return;
+    }
+    rdb_blob_wrapper_t blob(pointee->txn->get_cache()->get_block_size(),
+                            const_cast<rdb_value_t *>(pointee->rdb_value)->value_ref(),
+                            blob::btree_maxreflen);
+    blob_acq_t acq_group;
+    buffer_group_t buffer_group;
+    blob.expose_all(pointee->txn, rwi_read, &buffer_group, &acq_group);
+    pointee->serialized.reserve(buffer_group.get_size());
+    for (size_t i = 0; i < buffer_group.num_buffers(); ++i) {
+        buffer_group_t::buffer_t buf = buffer_group.get_buffer(i);
+        const char *data = static_cast<const char *>(buf.data);
+        pointee->serialized.insert(pointee->serialized.end(), data, data + buf.size);
+    }
+    guarantee(!pointee->serialized.empty());
+    pointee->rdb_value = NULL;
+    pointee->txn = NULL;
+}
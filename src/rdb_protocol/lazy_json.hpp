@@ -2,10 +2,18 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
 #include "buffer_cache/blob.hpp"
 #include "buffer_cache/types.hpp"
 #include "rdb_protocol/datum.hpp"
 
+namespace ql { class datum_view_t; }
+
 struct rdb_value_t {
     char contents[];
 
@@ -47,6 +55,9 @@ class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee
     // If empty, we haven't loaded the value yet.
     counted_t<const ql::datum_t> ptr;
 
+    // The serialized value, once `copy_serialized` has copied it out of the blob.
+    std::vector<char> serialized;
+
     // A pointer to the rdb value buffer in the leaf node (or perhaps a copy), and the
     // transaction with which to load it.
     const rdb_value_t *rdb_value;
@@ -65,6 +76,23 @@ public:
 
     const counted_t<const ql::datum_t> &get() const;
 
+    // Returns the field `key` of the value, or an empty pointer if the value
+    // isn't an object or has no such field.  If the value hasn't been loaded
+    // yet, only that field gets deserialized.
+    counted_t<const ql::datum_t> get_field(const std::string &key) const;
+
+    // Calls `fn` with a view of the field `key` of the value, which is empty if
+    // the value isn't an object or has no such field.  If the value hasn't been
+    // loaded yet, nothing gets deserialized unless `fn` asks for it.  The view
+    // is only valid during the call.
+    void with_field_view(const std::string &key,
+                         const boost::function<void(const ql::datum_view_t &)> &fn) const;
+
+    // Copies the serialized value out of the btree, so that the `lazy_json_t`
+    // no longer refers to the leaf node (or the transaction) it was created
+    // from, without deserializing it yet.
+    void copy_serialized() const;
+
 private:
     counted_t<lazy_json_pointee_t> pointee;
 };
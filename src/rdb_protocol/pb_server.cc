@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/pb_server.hpp"
 
+#include <string.h>
+
 #include "concurrency/cross_thread_watchable.hpp"
 #include "concurrency/watchable.hpp"
 #include "rdb_protocol/counted_term.hpp"
@@ -8,9 +10,9 @@
 #include "rdb_protocol/stream_cache.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
-Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
-    Response res;
-    res.set_token((q.has() && q->has_token()) ? q->token() : -1);
+ql::response_t on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
+    ql::response_t res;
+    res.mutable_pb()->set_token((q.has() && q->has_token()) ? q->token() : -1);
     ql::fill_error(&res, Response::CLIENT_ERROR, msg);
     return res;
 }
@@ -18,15 +20,27 @@ Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
 query2_server_t::query2_server_t(const std::set<ip_address_t> &local_addresses,
                                  int port,
                                  rdb_protocol_t::context_t *_ctx) :
+    balancer(get_query_balancing()),
     server(local_addresses,
            port,
            boost::bind(&query2_server_t::handle, this, _1, _2, _3),
            &on_unparsable_query2,
            _ctx->auth_metadata,
            INLINE),
-    ctx(_ctx), parser_id(generate_uuid()), thread_counters(0)
+    ctx(_ctx), parser_id(generate_uuid())
 { }
 
+query2_server_t::context_t::context_t()
+    : interruptor(0), eval_thread(get_thread_id()) { }
+
+query2_server_t::context_t::~context_t() {
+    if (!(eval_thread == get_thread_id())) {
+        // The cursors have to be destroyed on the thread they were made on.
+        on_thread_t thread_switcher(eval_thread);
+        stream_cache2.clear();
+    }
+}
+
 http_app_t *query2_server_t::get_http_app() {
     return &server;
 }
@@ -36,12 +50,31 @@ int query2_server_t::get_port() const {
 }
 
 bool query2_server_t::handle(ql::protob_t<Query> q,
-                             Response *response_out,
+                             ql::response_t *response_out,
                              context_t *query2_context) {
     ql::stream_cache2_t *stream_cache2 = &query2_context->stream_cache2;
     signal_t *interruptor = query2_context->interruptor;
     guarantee(interruptor);
-    response_out->set_token(q->token());
+    response_out->mutable_pb()->set_token(q->token());
+
+    if (stream_cache2->empty()) {
+        threadnum_t thread = balancer.pick_thread();
+        if (!(thread == query2_context->eval_thread)) {
+            query2_context->eval_interruptor.reset();
+            if (!(thread == get_thread_id())) {
+                query2_context->eval_interruptor.init(
+                    new cross_thread_signal_t(interruptor, thread));
+            }
+            query2_context->eval_thread = thread;
+        }
+    }
+    if (query2_context->eval_interruptor.has()) {
+        interruptor = query2_context->eval_interruptor.get();
+    }
+    const bool moved = !(query2_context->eval_thread == get_thread_id());
+
+    on_thread_t thread_switcher(query2_context->eval_thread);
+    query_balancer_t::running_query_t running_query(&balancer, moved);
 
     bool response_needed = true;
     try {
@@ -57,6 +90,18 @@ bool query2_server_t::handle(ql::protob_t<Query> q,
                 std::map<std::string, ql::wire_func_t>()));
         // `ql::run` will set the status code
         ql::run(q, std::move(env), response_out, stream_cache2, &response_needed);
+
+        // Responses are sent with a 32-bit size, the same limit protocol
+        // buffers has on a message, so a bigger one fails the query.
+        const size_t size = response_out->serialized_size();
+        if (size > static_cast<size_t>(INT32_MAX)) {
+            if (stream_cache2->contains(q->token())) {
+                stream_cache2->erase(q->token());
+            }
+            ql::fill_error(response_out, Response::RUNTIME_ERROR,
+                           strprintf("Query result is too large to send (%zu bytes).  "
+                                     "Use `limit` or fetch it in smaller pieces.", size));
+        }
     } catch (const interrupted_exc_t &e) {
         ql::fill_error(response_out, Response::RUNTIME_ERROR,
                        "Query interrupted.  Did you shut down the server?");
@@ -75,3 +120,52 @@ void make_empty_protob_bearer(ql::protob_t<Query> *request) {
 Query *underlying_protob_value(ql::protob_t<Query> *request) {
     return request->get();
 }
+
+namespace ql {
+
+int32_t serialized_response_size(const response_t &response) {
+    size_t size = response.serialized_size();
+    // `query2_server_t::handle` turns bigger responses into errors.
+    guarantee(size <= static_cast<size_t>(INT32_MAX),
+              "Response too large (%zu bytes).", size);
+    return size;
+}
+
+class tcp_response_writer_t : public response_writer_t {
+public:
+    tcp_response_writer_t(tcp_conn_t *_conn, signal_t *_closer)
+        : conn(_conn), closer(_closer) { }
+    void write(const char *data, size_t size) {
+        conn->write_buffered(data, size, closer);
+    }
+private:
+    tcp_conn_t *conn;
+    signal_t *closer;
+};
+
+void write_response(const response_t &response, tcp_conn_t *conn,
+                    signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    tcp_response_writer_t writer(conn, closer);
+    response.write(&writer);
+}
+
+class array_response_writer_t : public response_writer_t {
+public:
+    array_response_writer_t(char *_buf, size_t _size) : buf(_buf), size(_size) { }
+    void write(const char *data, size_t n) {
+        guarantee(n <= size);
+        memcpy(buf, data, n);
+        buf += n;
+        size -= n;
+    }
+private:
+    char *buf;
+    size_t size;
+};
+
+void serialize_response(const response_t &response, char *buf, int32_t size) {
+    array_response_writer_t writer(buf, size);
+    response.write(&writer);
+}
+
+}  // namespace ql
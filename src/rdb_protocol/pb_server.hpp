@@ -6,10 +6,13 @@
 #include <set>
 #include <string>
 
+#include "concurrency/cross_thread_signal.hpp"
 #include "protob/protob.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/ql2.hpp"
+#include "rdb_protocol/query_balancer.hpp"
+#include "rdb_protocol/response.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 
 namespace ql { template <class> class protob_t; }
@@ -18,6 +21,14 @@ namespace ql { template <class> class protob_t; }
 void make_empty_protob_bearer(ql::protob_t<Query> *request);
 Query *underlying_protob_value(ql::protob_t<Query> *request);
 
+// (These are in `ql` so that argument-dependent lookup finds them.)
+namespace ql {
+int32_t serialized_response_size(const response_t &response);
+void write_response(const response_t &response, tcp_conn_t *conn,
+                    signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+void serialize_response(const response_t &response, char *buf, int32_t size);
+}  // namespace ql
+
 class query2_server_t {
 public:
     query2_server_t(const std::set<ip_address_t> &local_addresses, int port,
@@ -28,20 +39,30 @@ public:
     int get_port() const;
 
     struct context_t {
-        context_t() : interruptor(0) { }
+        context_t();
+        ~context_t();
         static const int32_t no_auth_magic_number = VersionDummy::V0_1;
         static const int32_t auth_magic_number = VersionDummy::V0_2;
         ql::stream_cache2_t stream_cache2;
         signal_t *interruptor;
+
+        // The thread the connection's queries run on, which is the thread it
+        // came in on unless `query_balancer_t` sent them elsewhere.  The
+        // cursors in `stream_cache2` belong to that thread, so it only changes
+        // while there are none.  `eval_interruptor` is `interruptor` on that
+        // thread, if it's a different one.
+        threadnum_t eval_thread;
+        scoped_ptr_t<cross_thread_signal_t> eval_interruptor;
     };
 private:
     MUST_USE bool handle(ql::protob_t<Query> q,
-                         Response *response_out,
+                         ql::response_t *response_out,
                          context_t *query2_context);
-    protob_server_t<ql::protob_t<Query>, Response, context_t> server;
+    // Declared before `server`, so that it outlives the connections.
+    query_balancer_t balancer;
+    protob_server_t<ql::protob_t<Query>, ql::response_t, context_t> server;
     rdb_protocol_t::context_t *ctx;
     uuid_u parser_id;
-    one_per_thread_t<int> thread_counters;
 
     DISABLE_COPYING(query2_server_t);
 };
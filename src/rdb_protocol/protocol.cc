@@ -45,6 +45,9 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
 
+typedef rdb_protocol_t::multi_point_read_t multi_point_read_t;
+typedef rdb_protocol_t::multi_point_read_response_t multi_point_read_response_t;
+
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -88,6 +91,7 @@ RDB_IMPL_PROTOB_SERIALIZABLE(Backtrace);
 
 
 RDB_IMPL_SERIALIZABLE_2(filter_transform_t, filter_func, default_filter_val);
+RDB_IMPL_SERIALIZABLE_3(pluck_transform_t, paths, without, func);
 
 namespace rdb_protocol_details {
 
@@ -169,6 +173,27 @@ private:
     signal_t *interruptor_;
 };
 
+/* Lets reads of the sindexes see how far their post construction is, until it
+ * finishes or gives up. */
+class sindex_progress_registration_t {
+public:
+    sindex_progress_registration_t(btree_store_t<rdb_protocol_t> *store,
+                                   const std::set<uuid_u> &sindex_ids,
+                                   const traversal_progress_t *progress)
+        : store_(store), sindex_ids_(sindex_ids), progress_(progress) {
+        store_->register_sindex_progress(sindex_ids_, progress_);
+    }
+    ~sindex_progress_registration_t() {
+        store_->deregister_sindex_progress(sindex_ids_, progress_);
+    }
+private:
+    btree_store_t<rdb_protocol_t> *store_;
+    const std::set<uuid_u> &sindex_ids_;
+    const traversal_progress_t *progress_;
+
+    DISABLE_COPYING(sindex_progress_registration_t);
+};
+
 /* This function is really part of the logic of bring_sindexes_up_to_date
  * however it needs to be in a seperate function so that it can be spawned in a
  * coro. */
@@ -179,8 +204,13 @@ void post_construct_and_drain_queue(
         auto_drainer_t::lock_t lock)
     THROWS_NOTHING
 {
+    parallel_traversal_progress_t progress;
+    sindex_progress_registration_t progress_registration(
+        store, sindexes_to_bring_up_to_date, &progress);
+
     try {
-        post_construct_secondary_indexes(store, sindexes_to_bring_up_to_date, lock.get_drain_signal());
+        post_construct_secondary_indexes(store, sindexes_to_bring_up_to_date,
+                                         &progress, lock.get_drain_signal());
 
         /* Drain the queue. */
 
@@ -393,12 +423,55 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+// TODO: This entire type is suspect, given the performance for
+// batched_replaces_t.  Is it used in anything other than assertions?  (It's
+// also the region of a multi_point_read_t.)
+region_t region_from_keys(const std::vector<store_key_t> &keys) {
+    // It shouldn't be empty, but we let the places that would break use a
+    // guarantee.
+    rassert(!keys.empty());
+    if (keys.empty()) {
+        return hash_region_t<key_range_t>();
+    }
+
+    store_key_t min_key = store_key_t::max();
+    store_key_t max_key = store_key_t::min();
+    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
+    uint64_t max_hash_value = 0;
+
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        const store_key_t &key = *it;
+        if (key < min_key) {
+            min_key = key;
+        }
+        if (key > max_key) {
+            max_key = key;
+        }
+
+        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
+        if (hash_value < min_hash_value) {
+            min_hash_value = hash_value;
+        }
+        if (hash_value > max_hash_value) {
+            max_hash_value = hash_value;
+        }
+    }
+
+    return hash_region_t<key_range_t>(
+        min_hash_value, max_hash_value + 1,
+        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    region_t operator()(const multi_point_read_t &mpr) const {
+        return region_from_keys(mpr.keys);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -436,6 +509,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const multi_point_read_t &mpr) const {
+        std::vector<store_key_t> shard_keys;
+        for (auto it = mpr.keys.begin(); it != mpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                shard_keys.push_back(*it);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *read_out = read_t(multi_point_read_t(std::move(shard_keys)));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -511,6 +599,60 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
     }
 }
 
+// Each shard sends its gmr groups sorted by `cmp_key`, so rather than hashing
+// every group again we merge the runs.  There's one run per shard, so a linear
+// scan for the smallest head is fine.  Groups that appear on several shards are
+// reduced in shard order, like before.
+void merge_gmr_runs(const std::vector<const ql::wire_datum_map_t *> &runs,
+                    counted_t<ql::func_t> reduce, ql::env_t *ql_env,
+                    ql::wire_datum_map_t *out) {
+    typedef std::vector<ql::wire_datum_map_t::group_t>::const_iterator group_iter_t;
+    std::vector<std::pair<group_iter_t, group_iter_t> > heads;
+    for (auto it = runs.begin(); it != runs.end(); ++it) {
+        const std::vector<ql::wire_datum_map_t::group_t> &groups = (*it)->sorted_groups();
+        if (!groups.empty()) {
+            heads.push_back(std::make_pair(groups.begin(), groups.end()));
+        }
+    }
+
+    out->finalize();
+    while (!heads.empty()) {
+        size_t min = 0;
+        for (size_t i = 1; i < heads.size(); ++i) {
+            if (heads[i].first->cmp_key < heads[min].first->cmp_key) {
+                min = i;
+            }
+        }
+
+        // Runs before `min` all have bigger keys.
+        ql::wire_datum_map_t::group_t group = *heads[min].first;
+        ++heads[min].first;
+        for (size_t i = min + 1; i < heads.size(); ++i) {
+            if (heads[i].first->cmp_key == group.cmp_key) {
+                group.reduction = reduce->call(ql_env, group.reduction,
+                                               heads[i].first->reduction)->as_datum();
+                ++heads[i].first;
+            }
+        }
+
+        size_t live = 0;
+        for (size_t i = 0; i < heads.size(); ++i) {
+            if (heads[i].first != heads[i].second) {
+                heads[live++] = heads[i];
+            }
+        }
+        heads.resize(live);
+        out->push_back_sorted(std::move(group));
+    }
+}
+
+struct row_key_less_t {
+    bool operator()(const std::pair<store_key_t, counted_t<const ql::datum_t> > &a,
+                    const std::pair<store_key_t, counted_t<const ql::datum_t> > &b) const {
+        return a.first < b.first;
+    }
+};
+
 class rdb_r_unshard_visitor_t : public boost::static_visitor<void> {
 public:
     rdb_r_unshard_visitor_t(const read_response_t *_responses,
@@ -538,6 +680,20 @@ public:
         *response_out = responses[0];
     }
 
+    void operator()(const multi_point_read_t &) {
+        response_out->response = multi_point_read_response_t();
+        multi_point_read_response_t *res
+            = boost::get<multi_point_read_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            const multi_point_read_response_t *rr
+                = boost::get<multi_point_read_response_t>(&responses[i].response);
+            guarantee(rr != NULL);
+            res->rows.insert(res->rows.end(), rr->rows.begin(), rr->rows.end());
+        }
+        // Hash sharding interleaves the shards' keys.
+        std::sort(res->rows.begin(), res->rows.end(), row_key_less_t());
+    }
+
     void operator()(const rget_read_t &rg) {
         response_out->response = rget_read_response_t();
         rget_read_response_t *rg_response
@@ -771,37 +927,19 @@ private:
                 }
             } else if (const ql::gmr_wire_func_t *gmr_func =
                     boost::get<ql::gmr_wire_func_t>(&*rg.terminal)) {
-                ql::gmr_wire_func_t local_gmr_func = *gmr_func;
-                rg_response->result = ql::wire_datum_map_t();
-                ql::wire_datum_map_t *map =
-                    boost::get<ql::wire_datum_map_t>(&rg_response->result);
-
-                  for (size_t i = 0; i < count; ++i) {
+                std::vector<const ql::wire_datum_map_t *> runs;
+                for (size_t i = 0; i < count; ++i) {
                     const rget_read_response_t *_rr =
                         boost::get<rget_read_response_t>(&responses[i].response);
                     guarantee(_rr);
                     const ql::wire_datum_map_t *rhs =
                         boost::get<ql::wire_datum_map_t>(&(_rr->result));
                     r_sanity_check(rhs);
-                    ql::wire_datum_map_t local_rhs = *rhs;
-                    local_rhs.compile();
-
-                    counted_t<const ql::datum_t> rhs_arr = local_rhs.to_arr();
-                    for (size_t f = 0; f < rhs_arr->size(); ++f) {
-                        counted_t<const ql::datum_t> key
-                            = rhs_arr->get(f)->get("group");
-                        counted_t<const ql::datum_t> val
-                            = rhs_arr->get(f)->get("reduction");
-                        if (!map->has(key)) {
-                            map->set(key, val);
-                        } else {
-                            counted_t<ql::func_t> r
-                                = local_gmr_func.compile_reduce();
-                            map->set(key, r->call(&ql_env, map->get(key), val)->as_datum());
-                        }
-                    }
+                    runs.push_back(rhs);
                 }
-                boost::get<ql::wire_datum_map_t>(rg_response->result).finalize();
+                rg_response->result = ql::wire_datum_map_t();
+                merge_gmr_runs(runs, gmr_func->compile_reduce(), &ql_env,
+                               boost::get<ql::wire_datum_map_t>(&rg_response->result));
             } else {
                 unreachable();
             }
@@ -823,44 +961,6 @@ void read_t::unshard(read_response_t *responses, size_t count,
 
 /* write_t::get_region() implementation */
 
-// TODO: This entire type is suspect, given the performance for
-// batched_replaces_t.  Is it used in anything other than assertions?
-region_t region_from_keys(const std::vector<store_key_t> &keys) {
-    // It shouldn't be empty, but we let the places that would break use a
-    // guarantee.
-    rassert(!keys.empty());
-    if (keys.empty()) {
-        return hash_region_t<key_range_t>();
-    }
-
-    store_key_t min_key = store_key_t::max();
-    store_key_t max_key = store_key_t::min();
-    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
-    uint64_t max_hash_value = 0;
-
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        const store_key_t &key = *it;
-        if (key < min_key) {
-            min_key = key;
-        }
-        if (key > max_key) {
-            max_key = key;
-        }
-
-        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
-        if (hash_value < min_hash_value) {
-            min_hash_value = hash_value;
-        }
-        if (hash_value > max_hash_value) {
-            max_hash_value = hash_value;
-        }
-    }
-
-    return hash_region_t<key_range_t>(
-        min_hash_value, max_hash_value + 1,
-        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
-}
-
 struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const batched_replace_t &br) const {
         return region_from_keys(br.keys);
@@ -1064,6 +1164,46 @@ void write_t::unshard(const write_response_t *responses, size_t count,
     boost::apply_visitor(visitor, write);
 }
 
+bool write_t::coalesce(const write_t &other) THROWS_NOTHING {
+    // Only plain inserts are worth merging: they're what many clients send
+    // at once, and their per-row results don't depend on anything but the
+    // row.  We don't merge inserts that return values, because the response
+    // format for those only has room for one row.
+    batched_insert_t *bi = boost::get<batched_insert_t>(&write);
+    const batched_insert_t *other_bi = boost::get<batched_insert_t>(&other.write);
+    if (bi == NULL || other_bi == NULL
+        || durability_requirement != other.durability_requirement
+        || bi->pkey != other_bi->pkey || bi->upsert != other_bi->upsert
+        || bi->return_vals || other_bi->return_vals
+        || !other_bi->coalesced_sizes.empty()) {
+        return false;
+    }
+    if (bi->coalesced_sizes.empty()) {
+        bi->coalesced_sizes.push_back(bi->inserts.size());
+    }
+    bi->inserts.insert(bi->inserts.end(),
+                       other_bi->inserts.begin(), other_bi->inserts.end());
+    bi->coalesced_sizes.push_back(other_bi->inserts.size());
+    return true;
+}
+
+void write_t::split_coalesced_response(const write_response_t &response,
+                                       std::vector<write_response_t> *responses_out)
+    const THROWS_NOTHING {
+    const batched_insert_t *bi = boost::get<batched_insert_t>(&write);
+    guarantee(bi != NULL && !bi->coalesced_sizes.empty());
+    const batched_replace_response_t *stats =
+        boost::get<batched_replace_response_t>(&response.response);
+    guarantee(stats != NULL);
+    const std::vector<counted_t<const ql::datum_t> > &array = (*stats)->as_array();
+    guarantee(array.size() == bi->coalesced_sizes.size());
+    responses_out->clear();
+    responses_out->reserve(array.size());
+    for (auto it = array.begin(); it != array.end(); ++it) {
+        responses_out->push_back(write_response_t(*it));
+    }
+}
+
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_target,
@@ -1115,6 +1255,13 @@ store_t::~store_t() {
     assert_thread();
 }
 
+// The chunk size comes from the parser, so don't let it make us build
+// arbitrarily large responses.
+size_t rget_chunk_size(const rget_read_t &rget) {
+    return std::max<uint64_t>(1, std::min<uint64_t>(rget.chunk_size,
+                                                    rdb_protocol_t::MAX_RGET_CHUNK_SIZE));
+}
+
 // TODO: get rid of this extra response_t copy on the stack
 struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const point_read_t &get) {
@@ -1124,6 +1271,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rdb_get(get.key, btree, txn, superblock, res);
     }
 
+    void operator()(const multi_point_read_t &get) {
+        response->response = multi_point_read_response_t();
+        multi_point_read_response_t *res =
+            boost::get<multi_point_read_response_t>(&response->response);
+        rdb_multi_get(get.keys, btree, txn, superblock, res);
+    }
+
     void operator()(const rget_read_t &rget) {
         if (rget.transform.size() != 0 || rget.terminal) {
             rassert(rget.optargs.size() != 0);
@@ -1137,7 +1291,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             // Normal rget
             rdb_rget_slice(btree, rget.region.inner, txn, superblock,
                     &ql_env, rget.transform, rget.terminal,
-                    rget.sorting, res);
+                    rget.sorting, rget_chunk_size(rget), res);
         } else {
             scoped_ptr_t<real_superblock_t> sindex_sb;
             std::vector<char> sindex_mapping_data;
@@ -1154,12 +1308,19 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                                   rget.sindex->c_str()));
                     return;
                 }
-            } catch (const sindex_not_post_constructed_exc_t &) {
+            } catch (const sindex_not_post_constructed_exc_t &e) {
+                progress_completion_fraction_t progress = e.get_progress();
+                std::string done;
+                if (!progress.invalid() && progress.estimate_of_total_nodes > 0) {
+                    done = strprintf(" (it is about %d%% done)",
+                                     100 * progress.estimate_of_released_nodes
+                                     / progress.estimate_of_total_nodes);
+                }
                 res->result = ql::datum_exc_t(
                     ql::base_exc_t::GENERIC,
                     strprintf("Index `%s` was accessed before "
-                              "its construction was finished.",
-                              rget.sindex->c_str()));
+                              "its construction was finished%s.",
+                              rget.sindex->c_str(), done.c_str()));
                 return;
             }
 
@@ -1186,7 +1347,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                     *rget.sindex_range, //guaranteed present above
                     txn, sindex_sb.get(), &ql_env, rget.transform,
                     rget.terminal, rget.region.inner, rget.sorting,
-                    sindex_mapping, multi_bool, res);
+                    sindex_mapping, multi_bool, rget_chunk_size(rget), res);
         }
     }
 
@@ -1352,7 +1513,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         response->response =
             rdb_batched_replace(
                 btree_info_t(btree, timestamp, txn, &bi.pkey),
-                superblock, keys, &replacer, &sindex_cb);
+                superblock, keys, &replacer, &sindex_cb, bi.coalesced_sizes);
     }
 
     void operator()(const point_write_t &w) {
@@ -1734,6 +1895,7 @@ bool sindex_range_t::contains(counted_t<const ql::datum_t> value) const {
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::rget_item_t, key, sindex_key, data);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::multi_point_read_response_t, rows);
 RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
                            result, key_range, truncated, last_considered_key);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
@@ -1742,12 +1904,13 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::read_response_t, response);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::multi_point_read_t, keys);
 
 RDB_IMPL_ME_SERIALIZABLE_4(sindex_range_t,
                            empty_ok(start), empty_ok(end), start_open, end_open);
-RDB_IMPL_ME_SERIALIZABLE_8(rdb_protocol_t::rget_read_t, region, sindex,
+RDB_IMPL_ME_SERIALIZABLE_9(rdb_protocol_t::rget_read_t, region, sindex,
                            sindex_region, sindex_range,
-                           transform, terminal, optargs, sorting);
+                           transform, terminal, optargs, sorting, chunk_size);
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_t,
                            max_depth, result_limit, region);
@@ -1763,8 +1926,8 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::write_response_t, response);
 
 RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::batched_replace_t,
                            keys, pkey, f, optargs, return_vals);
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::batched_insert_t,
-                           inserts, pkey, upsert, return_vals);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::batched_insert_t,
+                           inserts, pkey, upsert, return_vals, coalesced_sizes);
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::point_write_t, key, data, overwrite);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_t, key);
@@ -106,6 +106,22 @@ struct filter_transform_t {
 
 RDB_DECLARE_SERIALIZABLE(filter_transform_t);
 
+// A `pluck` or `without` over the rows of a table.  Shards apply it to objects
+// directly; `func` is the equivalent map function, which is used for anything
+// else (so that errors come out the same as for a plain `map`).
+struct pluck_transform_t {
+    pluck_transform_t() : without(false) { }
+    pluck_transform_t(counted_t<const ql::datum_t> _paths, bool _without,
+                      const ql::map_wire_func_t &_func)
+        : paths(_paths), without(_without), func(_func) { }
+
+    counted_t<const ql::datum_t> paths;
+    bool without;
+    ql::map_wire_func_t func;
+};
+
+RDB_DECLARE_SERIALIZABLE(pluck_transform_t);
+
 namespace rdb_protocol_details {
 
 struct backfill_atom_t {
@@ -127,7 +143,8 @@ RDB_DECLARE_SERIALIZABLE(backfill_atom_t);
 
 typedef boost::variant<ql::map_wire_func_t,
                        filter_transform_t,
-                       ql::concatmap_wire_func_t> transform_variant_t;
+                       ql::concatmap_wire_func_t,
+                       pluck_transform_t> transform_variant_t;
 typedef std::list<transform_variant_t> transform_t;
 
 typedef boost::variant<ql::gmr_wire_func_t,
@@ -169,6 +186,7 @@ class auth_semilattice_metadata_t;
 
 struct rdb_protocol_t {
     static const size_t MAX_PRIMARY_KEY_SIZE = 128;
+    static const size_t MAX_RGET_CHUNK_SIZE = MEGABYTE;
 
     static const std::string protocol_name;
     typedef hash_region_t<key_range_t> region_t;
@@ -224,6 +242,14 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct multi_point_read_response_t {
+        multi_point_read_response_t() { }
+        /* The rows that were found, in key order.  Keys without a row are
+        left out. */
+        std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > rows;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
          // Present if there was no terminal
         typedef std::vector<rdb_protocol_details::rget_item_t> stream_t;
@@ -285,7 +311,8 @@ struct rdb_protocol_t {
         boost::variant<point_read_response_t,
                        rget_read_response_t,
                        distribution_read_response_t,
-                       sindex_list_response_t> response;
+                       sindex_list_response_t,
+                       multi_point_read_response_t> response;
 
         read_response_t() { }
         explicit read_response_t(
@@ -307,15 +334,31 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    /* Reads several rows by primary key.  Each shard gets the keys in its
+    region and looks them all up in one transaction. */
+    class multi_point_read_t {
+    public:
+        multi_point_read_t() { }
+        // `_keys` should be sorted, so that neighbouring keys share a path
+        // down the btree.
+        explicit multi_point_read_t(std::vector<store_key_t> &&_keys)
+            : keys(std::move(_keys)) {
+            r_sanity_check(!keys.empty());
+        }
+
+        std::vector<store_key_t> keys;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     class rget_read_t {
     public:
-        rget_read_t() { }
+        rget_read_t() : chunk_size(MAX_RGET_CHUNK_SIZE) { }
 
         explicit rget_read_t(const region_t &_region,
                              sorting_t _sorting = UNORDERED)
-            : region(_region), sorting(_sorting) {
-        }
-
+            : region(_region), sorting(_sorting),
+              chunk_size(MAX_RGET_CHUNK_SIZE) { }
 
         rget_read_t(const std::string &_sindex,
                     sindex_range_t _sindex_range,
@@ -323,7 +366,7 @@ struct rdb_protocol_t {
             : region(region_t::universe()), sindex(_sindex),
               sindex_range(_sindex_range),
               sindex_region(sindex_range->to_region()),
-              sorting(_sorting) { }
+              sorting(_sorting), chunk_size(MAX_RGET_CHUNK_SIZE) { }
 
         rget_read_t(const region_t &_sindex_region,
                     const std::string &_sindex,
@@ -331,7 +374,8 @@ struct rdb_protocol_t {
                     sorting_t _sorting = UNORDERED)
             : region(region_t::universe()), sindex(_sindex),
               sindex_range(_sindex_range),
-              sindex_region(_sindex_region), sorting(_sorting) { }
+              sindex_region(_sindex_region), sorting(_sorting),
+              chunk_size(MAX_RGET_CHUNK_SIZE) { }
 
         rget_read_t(const region_t &_sindex_region,
                     const std::string &_sindex,
@@ -343,21 +387,23 @@ struct rdb_protocol_t {
               sindex_range(_sindex_range),
               sindex_region(_sindex_region),
               transform(_transform), optargs(_optargs),
-              sorting(_sorting) { }
+              sorting(_sorting), chunk_size(MAX_RGET_CHUNK_SIZE) { }
 
         rget_read_t(const region_t &_region,
                     const rdb_protocol_details::transform_t &_transform,
                     const std::map<std::string, ql::wire_func_t> &_optargs,
                     sorting_t _sorting = UNORDERED)
             : region(_region), transform(_transform),
-              optargs(_optargs), sorting(_sorting) {
+              optargs(_optargs), sorting(_sorting),
+              chunk_size(MAX_RGET_CHUNK_SIZE) {
             rassert(optargs.size() != 0);
         }
 
         rget_read_t(const region_t &_region,
                     const boost::optional<rdb_protocol_details::terminal_t> &_terminal,
                     const std::map<std::string, ql::wire_func_t> &_optargs)
-            : region(_region), terminal(_terminal), optargs(_optargs) {
+            : region(_region), terminal(_terminal), optargs(_optargs),
+              chunk_size(MAX_RGET_CHUNK_SIZE) {
             rassert(optargs.size() != 0);
         }
 
@@ -366,7 +412,8 @@ struct rdb_protocol_t {
                     const boost::optional<rdb_protocol_details::terminal_t> &_terminal,
                     const std::map<std::string, ql::wire_func_t> &_optargs)
             : region(_region), transform(_transform),
-              terminal(_terminal), optargs(_optargs) {
+              terminal(_terminal), optargs(_optargs),
+              chunk_size(MAX_RGET_CHUNK_SIZE) {
             rassert(optargs.size() != 0);
         }
 
@@ -397,6 +444,11 @@ struct rdb_protocol_t {
         /* How to sort the data. */
         sorting_t sorting;
 
+        /* The shard stops reading once it has this many bytes of results
+        (roughly, see `estimate_rget_response_size`) and marks the response
+        truncated.  Clamped to `MAX_RGET_CHUNK_SIZE`. */
+        uint64_t chunk_size;
+
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -426,7 +478,8 @@ struct rdb_protocol_t {
         boost::variant<point_read_t,
                        rget_read_t,
                        distribution_read_t,
-                       sindex_list_t> read;
+                       sindex_list_t,
+                       multi_point_read_t> read;
 
         region_t get_region() const THROWS_NOTHING;
         // Returns true if the read has any operation for this region.  Returns
@@ -443,11 +496,16 @@ struct rdb_protocol_t {
         explicit read_t(const boost::variant<point_read_t,
                                              rget_read_t,
                                              distribution_read_t,
-                                             sindex_list_t> &r)
+                                             sindex_list_t,
+                                             multi_point_read_t> &r)
             : read(r) { }
 
-        // Only use snapshotting if we're doing a range get.
-        bool use_snapshot() const { return boost::get<rget_read_t>(&read); }
+        // Only use snapshotting if we're doing a range get, or something that
+        // holds on to btree nodes for as long as one.
+        bool use_snapshot() const {
+            return boost::get<rget_read_t>(&read)
+                || boost::get<multi_point_read_t>(&read);
+        }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -554,6 +612,10 @@ struct rdb_protocol_t {
         std::string pkey;
         bool upsert;
         bool return_vals;
+        // Empty unless this is several inserts merged by `write_t::coalesce`,
+        // in which case it holds how many of `inserts` came from each of them,
+        // and the response is an array with one stats object per insert.
+        std::vector<uint64_t> coalesced_sizes;
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -631,6 +693,17 @@ struct rdb_protocol_t {
                      write_response_t *response, context_t *cache, signal_t *)
             const THROWS_NOTHING;
 
+        // Merges `other` into this write and returns true if the two can be
+        // performed as one write; otherwise leaves this write alone and
+        // returns false.  `master_t` uses this to batch concurrent writes from
+        // different clients.
+        bool coalesce(const write_t &other) THROWS_NOTHING;
+        // Splits the response to a write built by `coalesce` into one response
+        // for each of the writes that went into it, in order.
+        void split_coalesced_response(const write_response_t &response,
+                                      std::vector<write_response_t> *responses_out)
+            const THROWS_NOTHING;
+
         durability_requirement_t durability() const { return durability_requirement; }
 
         write_t() : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT) { }
@@ -3,6 +3,9 @@
 
 #include <time.h>
 #include <math.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "errors.hpp"
 #include <boost/date_time.hpp>
@@ -16,37 +19,22 @@ const char *const time_string = "TIME";
 const char *const epoch_time_key = "epoch_time";
 const char *const timezone_key = "timezone";
 
-typedef boost::local_time::local_time_input_facet input_timefmt_t;
-typedef boost::local_time::local_time_facet output_timefmt_t;
 typedef boost::local_time::local_date_time time_t;
 typedef boost::posix_time::ptime ptime_t;
 typedef boost::posix_time::time_duration dur_t;
 typedef boost::gregorian::date date_t;
 
 // Some notes on our ISO 8601 parsing --
-// * We use %ZP instead of %Q because I can't get %Q to work.  I don't know why,
-//   the documentation says it should, but there you go.
-// * The above is fine because we need a sanitization step anyway.
-// * We need a sanitization step because Boost is very...liberal in its parsing,
-//   so much so that it will sometimes parse total gibberish.  When I tried
-//   the classic approach of simply listing all the possible formats (you can
-//   see the list in 06f4535 or earlier), I ended up needing about 90 formats,
-//   and with that many options to work with boost would parse basically
-//   anything.  It would also often parse correct dates in one format
-//   (especially week dates; see below) as incorrect dates in a similar format,
-//   happily skipping characters and leaving garbage at the end in pursuit of a
-//   valid interpretation of the input string.
-// * We can't support week dates right now, because Boost doesn't allow %V or %u
-//   in parsing right now.  This will theoretically change at some point in the
-//   future.
-// * I hate boost, I hate dates, and most of all, I hate myself.
-const std::locale daycount_format =
-    std::locale(std::locale::classic(), new input_timefmt_t("%Y-%jT%H:%M:%s%ZP"));
-// One day...
-// const std::locale weekcount_format =
-//     std::locale(std::locale::classic(), new input_timefmt_t("%Y-W%V-%uT%H:%M:%s%ZP"));
-const std::locale month_day_format =
-    std::locale(std::locale::classic(), new input_timefmt_t("%Y-%m-%dT%H:%M:%s%ZP"));
+// * We used to sanitize the string and then hand it to a boost input facet,
+//   but that meant a round trip through `std::locale` and a pile of temporary
+//   strings for every date, so now we parse it by hand in `parse` below.
+// * We're deliberately strict: the grammar is exactly the one the old
+//   sanitization step accepted (YYYY, YYYY-MM, YYYY-MM-DD, YYYYMMDD, YYYY-DDD,
+//   YYYYDDD; hh, hh:mm, hhmm, hh:mm:ss[.sss], hhmmss[.sss]; Z, +-hh, +-hh:mm,
+//   +-hhmm), and we don't skip or guess at anything we don't recognize.
+// * We still don't support week dates, so that the set of strings we accept
+//   doesn't change.
+// * Fractional seconds past milliseconds are checked but truncated.
 
 const ptime_t raw_epoch(date_t(1970, 1, 1));
 const boost::local_time::time_zone_ptr utc(
@@ -108,187 +96,244 @@ const datum_t dummy_datum;
 
 enum date_format_t { UNSET, MONTH_DAY, WEEKCOUNT, DAYCOUNT };
 
-// This is where we do our sanitization.
-namespace sanitize {
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar, and the
+// reverse.  These are the usual era-based conversions; they're exact for any
+// year that fits in an `int`.
+int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+void civil_from_days(int64_t days, int64_t *year_out, int *month_out, int *day_out) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t day_of_era = days - era * 146097;
+    int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+                           - day_of_era / 146096) / 365;
+    int64_t day_of_year =
+        day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64_t mp = (5 * day_of_year + 2) / 153;
+    *day_out = day_of_year - (153 * mp + 2) / 5 + 1;
+    *month_out = mp < 10 ? mp + 3 : mp - 9;
+    *year_out = year_of_era + era * 400 + (*month_out <= 2);
+}
+
+bool is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+int days_in_month(int year, int month) {
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return (month == 2 && is_leap_year(year)) ? 29 : days[month - 1];
+}
+
+const int64_t ms_per_minute = 60 * 1000;
+const int64_t ms_per_day = 24 * 60 * ms_per_minute;
+
+// This is where we do our parsing.  Every function here reads one part of an
+// ISO 8601 string in place and throws a `datum_exc_t` on any error; the only
+// strings we build are the error messages.
+namespace parse {
+
+// A part of the input string, and how far into it we've read.
+struct span_t {
+    span_t(const char *_begin, const char *_end)
+        : begin(_begin), at(_begin), end(_end) { }
+    bool done() const { return at == end; }
+    size_t remaining() const { return end - at; }
+    std::string str() const { return std::string(begin, end); }
+    std::string rest() const { return std::string(at, end); }
+    bool equals(const char *s) const {
+        size_t n = strlen(s);
+        return static_cast<size_t>(end - begin) == n && memcmp(begin, s, n) == 0;
+    }
+
+    const char *begin, *at, *end;
+};
 
-// Copy n digits from `s` to the end of `*p_out`, starting at `*p_at`.
-// Increment `*p_at` by the number of digits copied.  Throw on any error.
-void mandatory_digits(const std::string &s, size_t n, size_t *p_at, std::string *p_out) {
+// Read `n` digits from `*s` and return them as a number.  Throw on any error.
+int mandatory_digits(span_t *s, size_t n) {
+    int res = 0;
     for (size_t i = 0; i < n; ++i) {
-        size_t at = (*p_at)++;
-        rcheck_datum(at < s.size(), base_exc_t::GENERIC,
-                     strprintf("Truncated date string `%s`.", s.c_str()));
-        char c = s[at];
+        rcheck_datum(!s->done(), base_exc_t::GENERIC,
+                     strprintf("Truncated date string `%s`.", s->str().c_str()));
+        char c = *s->at;
         rcheck_datum('0' <= c && c <= '9', base_exc_t::GENERIC,
                      strprintf(
                          "Invalid date string `%s` (got `%c` but expected a digit).",
-                         s.c_str(), c));
-        if (p_out) {
-            *p_out += c;
-        }
+                         s->str().c_str(), c));
+        ++s->at;
+        res = res * 10 + (c - '0');
     }
+    return res;
 }
 
-enum optional_char_default_behavior_t { INCLUDE, EXCLUDE };
-// If `s[*p_at]` is `c`, increment `*p_at` and add `c` to the end of `*p_out`.
-// Otherwise, if `default_behavior` is `INCLUDE`, add `c` to the end of `*p_out`
-// anyway.  Return whether or not `*p_at` was incremented.
-bool optional_char(const std::string &s, char c, size_t *p_at, std::string *p_out,
-                   optional_char_default_behavior_t default_behavior = INCLUDE) {
-    bool consumed = false;
-    size_t at = *p_at;
-    if (at < s.size() && s[at] == c) {
-        (*p_at) += 1;
-        consumed = true;
-        *p_out += c;
-    } else {
-        if (default_behavior == INCLUDE) {
-            *p_out += c;
-        }
+// If the next character of `*s` is `c`, skip it and return true.
+bool optional_char(span_t *s, char c) {
+    if (!s->done() && *s->at == c) {
+        ++s->at;
+        return true;
     }
-    return consumed;
+    return false;
 }
 
-// Sanitize a date, and return which format it's in.
-std::string date(const std::string &s, date_format_t *df_out) {
-    std::string out;
-    size_t at = 0;
-    // Add Year
-    mandatory_digits(s, 4, &at, &out);
-    if (at == s.size()) {
+void check_done(const span_t &s, const char *what) {
+    rcheck_datum(s.done(), base_exc_t::GENERIC,
+                 strprintf("Garbage characters `%s` at end of %s string `%s`.",
+                           s.rest().c_str(), what, s.str().c_str()));
+}
+
+// Parse a date into days since the epoch, and return which format it's in.
+// We don't compute anything for week dates, since we reject them anyway.
+int64_t date(span_t s, date_format_t *df_out) {
+    int year = mandatory_digits(&s, 4);
+    int month = 1, day = 1, day_of_year = 0;
+    if (s.done()) {
         *df_out = MONTH_DAY;
-        return out + "-01-01";
-    }
-    // We need to keep track of this because YYYY-MM and YYYYMMDD are valid, but
-    // YYYYMM is not.  I don't write these standards.
-    bool first_hyphen = optional_char(s, '-', &at, &out);
-    if (optional_char(s, 'W', &at, &out, EXCLUDE)) {
-        *df_out = WEEKCOUNT;
-        mandatory_digits(s, 2, &at, &out);
-        if (at == s.size()) {
-            return out + "-1"; // 1 through 7
-        }
-        optional_char(s, '-', &at, &out);
-        mandatory_digits(s, 1, &at, &out);
-    } else if (s.size() - at == 3) {
-        *df_out = DAYCOUNT;
-        mandatory_digits(s, 3, &at, &out);
     } else {
-        *df_out = MONTH_DAY;
-        mandatory_digits(s, 2, &at, &out);
-        if (first_hyphen && at == s.size()) {
-            return out + "-01";
+        // We need to keep track of this because YYYY-MM and YYYYMMDD are
+        // valid, but YYYYMM is not.  I don't write these standards.
+        bool first_hyphen = optional_char(&s, '-');
+        if (optional_char(&s, 'W')) {
+            *df_out = WEEKCOUNT;
+            mandatory_digits(&s, 2);
+            if (!s.done()) {
+                optional_char(&s, '-');
+                mandatory_digits(&s, 1);
+            }
+        } else if (s.remaining() == 3) {
+            *df_out = DAYCOUNT;
+            day_of_year = mandatory_digits(&s, 3);
+        } else {
+            *df_out = MONTH_DAY;
+            month = mandatory_digits(&s, 2);
+            if (!(first_hyphen && s.done())) {
+                bool second_hyphen = optional_char(&s, '-');
+                rcheck_datum(!(first_hyphen ^ second_hyphen), base_exc_t::GENERIC,
+                             strprintf("Date string `%s` must have 0 or 2 hyphens.",
+                                       s.str().c_str()));
+                day = mandatory_digits(&s, 2);
+            }
         }
-        bool second_hyphen = optional_char(s, '-', &at, &out);
-        rcheck_datum(!(first_hyphen ^ second_hyphen), base_exc_t::GENERIC,
-                     strprintf("Date string `%s` must have 0 or 2 hyphens.", s.c_str()));
-        mandatory_digits(s, 2, &at, &out);
-    }
-    rcheck_datum(at == s.size(), base_exc_t::GENERIC,
-                 strprintf("Garbage characters `%s` at end of date string `%s`.",
-                           s.substr(at).c_str(), s.c_str()));
-    return out;
-}
-
-// Sanitize a time.
-std::string time(const std::string &s) {
-    std::string out;
-    size_t at = 0;
-    mandatory_digits(s, 2, &at, &out);
-    if (at == s.size()) {
-        return out + ":00:00.000";
+        check_done(s, "date");
     }
-    bool first_colon = optional_char(s, ':', &at, &out);
-    mandatory_digits(s, 2, &at, &out);
-    if (at == s.size()) {
-        return out + ":00.000";
+
+    if (*df_out == DAYCOUNT) {
+        rcheck_datum(1 <= day_of_year && day_of_year <= (is_leap_year(year) ? 366 : 365),
+                     base_exc_t::GENERIC,
+                     strprintf("Day of year out of range in `%s`.", s.str().c_str()));
+        return days_from_civil(year, 1, 1) + day_of_year - 1;
+    } else if (*df_out == MONTH_DAY) {
+        rcheck_datum(1 <= month && month <= 12, base_exc_t::GENERIC,
+                     strprintf("Month out of range in `%s`.", s.str().c_str()));
+        rcheck_datum(1 <= day && day <= days_in_month(year, month), base_exc_t::GENERIC,
+                     strprintf("Day out of range in `%s`.", s.str().c_str()));
+        return days_from_civil(year, month, day);
     }
-    bool second_colon = optional_char(s, ':', &at, &out);
-    rcheck_datum(!(first_colon ^ second_colon), base_exc_t::GENERIC,
-                 strprintf("Time string `%s` must have 0 or 2 colons.", s.c_str()));
-    mandatory_digits(s, 2, &at, &out);
-    if (optional_char(s, '.', &at, &out)) {
-        size_t read = 0;
-        while (at < s.size() && read < 3) {
-            mandatory_digits(s, 1, &at, &out);
-            read += 1;
-        }
-        while (at < s.size()) {
-            mandatory_digits(s, 1, &at, NULL);
-        }
-        while (read++ < 3) {
-            out += '0';
+    return 0;
+}
+
+// Parse a time of day into milliseconds.
+int64_t time(span_t s) {
+    int hours = mandatory_digits(&s, 2);
+    int minutes = 0, seconds = 0, ms = 0;
+    if (!s.done()) {
+        bool first_colon = optional_char(&s, ':');
+        minutes = mandatory_digits(&s, 2);
+        if (!s.done()) {
+            bool second_colon = optional_char(&s, ':');
+            rcheck_datum(!(first_colon ^ second_colon), base_exc_t::GENERIC,
+                         strprintf("Time string `%s` must have 0 or 2 colons.",
+                                   s.str().c_str()));
+            seconds = mandatory_digits(&s, 2);
+            if (optional_char(&s, '.')) {
+                int scale = 100;
+                while (!s.done()) {
+                    int digit = mandatory_digits(&s, 1);
+                    ms += digit * scale;
+                    scale /= 10;
+                }
+            }
+            check_done(s, "time");
         }
+    }
+
+    rcheck_datum(hours < 24 || (hours == 24 && minutes == 0 && seconds == 0 && ms == 0),
+                 base_exc_t::GENERIC,
+                 strprintf("Hours out of range in `%s`.", s.str().c_str()));
+    rcheck_datum(minutes < 60, base_exc_t::GENERIC,
+                 strprintf("Minutes out of range in `%s`.", s.str().c_str()));
+    // 60 is a leap second.
+    rcheck_datum(seconds <= 60, base_exc_t::GENERIC,
+                 strprintf("Seconds out of range in `%s`.", s.str().c_str()));
+    return ((hours * 60 + minutes) * 60 + seconds) * 1000 + ms;
+}
+
+// Parse a timezone into an offset in minutes.
+int tz(span_t s) {
+    rcheck_datum(!s.equals("-00") && !s.equals("-00:00"), base_exc_t::GENERIC,
+                 strprintf("`%s` is not a valid time offset.", s.str().c_str()));
+    if (s.equals("Z")) {
+        return 0;
+    }
+    int sign = 1;
+    if (optional_char(&s, '-')) {
+        sign = -1;
     } else {
-        out += "000";
+        rcheck_datum(optional_char(&s, '+'), base_exc_t::GENERIC,
+                     strprintf("Timezone `%s` does not start with `-` or `+`.",
+                               s.str().c_str()));
     }
-    rcheck_datum(at == s.size(), base_exc_t::GENERIC,
-                 strprintf("Garbage characters `%s` at end of time string `%s`.",
-                           s.substr(at).c_str(), s.c_str()));
-    return out;
+    int hours = mandatory_digits(&s, 2);
+    int minutes = 0;
+    if (!s.done()) {
+        optional_char(&s, ':');
+        minutes = mandatory_digits(&s, 2);
+        check_done(s, "timezone");
+    }
+
+    rcheck_datum(hours <= 24, base_exc_t::GENERIC,
+                 strprintf("Hours out of range in `%s`.", s.str().c_str()));
+    rcheck_datum(minutes <= 59, base_exc_t::GENERIC,
+                 strprintf("Minutes out of range in `%s`.", s.str().c_str()));
+    return sign * (hours * 60 + minutes);
+}
+
+} // namespace parse
+
+// Write `n` digits of `value` to `out`, zero-padded, and return the end.
+char *format_digits(int64_t value, int n, char *out) {
+    for (int i = n - 1; i >= 0; --i) {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return out + n;
 }
 
-bool hours_valid(char l, char r) {
-    return ((l == '0' || l == '1') && ('0' <= r && r <= '9'))
-        || ((l == '2') && ('0' <= r && r <= '4'));
+// Write an offset in minutes to `out` as `+HH:MM`, and return the end.
+char *format_tz(int tz_minutes, char *out) {
+    *out++ = tz_minutes < 0 ? '-' : '+';
+    int abs_minutes = tz_minutes < 0 ? -tz_minutes : tz_minutes;
+    out = format_digits(abs_minutes / 60, 2, out);
+    *out++ = ':';
+    return format_digits(abs_minutes % 60, 2, out);
 }
-bool minutes_valid(char l, char r) {
-    return ('0' <= l && l <= '5') && ('0' <= r && r <= '9');
+
+std::string tz_to_str(int tz_minutes) {
+    char buf[6];
+    return std::string(buf, format_tz(tz_minutes, buf));
 }
 
+namespace sanitize {
+
 // Sanitize a timezone.
 std::string tz(const std::string &s) {
-    rcheck_datum(s != "-00" && s != "-00:00", base_exc_t::GENERIC,
-                 strprintf("`%s` is not a valid time offset.", s.c_str()));
-    if (s == "Z") {
-        return "+00:00";
-    }
-    std::string out;
-    size_t at = 0;
-    bool sign_prefix = optional_char(s, '-', &at, &out, EXCLUDE)
-        || optional_char(s, '+', &at, &out, EXCLUDE);
-    rcheck_datum(sign_prefix, base_exc_t::GENERIC,
-                 strprintf("Timezone `%s` does not start with `-` or `+`.", s.c_str()));
-    mandatory_digits(s, 2, &at, &out);
-    if (at == s.size()) {
-        return out + ":00";
-    }
-    optional_char(s, ':', &at, &out);
-    mandatory_digits(s, 2, &at, &out);
-    rcheck_datum(at == s.size(), base_exc_t::GENERIC,
-                 strprintf("Garbage characters `%s` at end of timezone string `%s`.",
-                           s.substr(at).c_str(), s.c_str()));
-
-    r_sanity_check(out.size() == 6);
-    rcheck_datum(hours_valid(out[1], out[2]), base_exc_t::GENERIC,
-                 strprintf("Hours out of range in `%s`.", s.c_str()));
-    rcheck_datum(minutes_valid(out[4], out[5]), base_exc_t::GENERIC,
-                 strprintf("Minutes out of range in `%s`.", s.c_str()));
-    return out;
-}
-
-// Sanitize an ISO 8601 string.
-std::string iso8601(const std::string &s, const std::string &default_tz, date_format_t *df_out) {
-    std::string date_s, time_s, tz_s;
-    size_t tloc, start, sign_loc;
-    tloc = s.find('T');
-    date_s = date(s.substr(0, tloc), df_out);
-    if (tloc == std::string::npos) {
-        time_s = "00:00:00.000";
-        tz_s = default_tz;
-    } else {
-        start = tloc + 1;
-        sign_loc = s.find('-', start);
-        sign_loc = (sign_loc == std::string::npos) ? s.find('+', start) : sign_loc;
-        sign_loc = (sign_loc == std::string::npos) ? s.find('Z', start) : sign_loc;
-        time_s = time(s.substr(start, sign_loc - start));
-        if (sign_loc == std::string::npos) {
-            tz_s = default_tz;
-        } else {
-            tz_s = tz(s.substr(sign_loc));
-        }
-    }
-    return date_s + "T" + time_s + tz_s;
+    return tz_to_str(parse::tz(parse::span_t(s.data(), s.data() + s.size())));
 }
 
 } // namespace sanitize
@@ -336,40 +381,99 @@ counted_t<const datum_t> boost_to_time(time_t t, const rcheckable_t *target) {
     return make_time(seconds, tz);
 }
 
-counted_t<const datum_t> iso8601_to_time(
-    const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
+// The low bits of a `packed_time_t` hold the offset in two's complement.
+const int tz_bits = 12;
+const int64_t tz_mask = (1 << tz_bits) - 1;
+const int64_t tz_sign_bit = 1 << (tz_bits - 1);
+// How many milliseconds fit in the other 52 bits (roughly 70000 years).
+const int64_t max_packed_ms = (INT64_C(1) << (63 - tz_bits)) - 1;
+
+packed_time_t::packed_time_t() : bits(0) { }
+
+packed_time_t::packed_time_t(int64_t epoch_ms, int tz_minutes)
+    : bits(epoch_ms * (tz_mask + 1) + (tz_minutes & tz_mask)) {
+    r_sanity_check(-max_packed_ms <= epoch_ms && epoch_ms <= max_packed_ms);
+    r_sanity_check(-tz_sign_bit < tz_minutes && tz_minutes < tz_sign_bit);
+}
+
+bool packed_time_t::pack(double epoch_time, int tz_minutes, packed_time_t *out) {
+    double ms = round(epoch_time * 1000);
+    if (!(-max_packed_ms <= ms && ms <= max_packed_ms)) {
+        return false;
+    }
+    *out = packed_time_t(static_cast<int64_t>(ms), tz_minutes);
+    return true;
+}
+
+int64_t packed_time_t::epoch_ms() const {
+    // The low bits are never negative, so this rounds towards the right value.
+    return (bits - (bits & tz_mask)) / (tz_mask + 1);
+}
+
+int packed_time_t::tz_minutes() const {
+    return ((bits & tz_mask) ^ tz_sign_bit) - tz_sign_bit;
+}
+
+double packed_time_t::epoch_time() const {
+    return epoch_ms() / 1000.0;
+}
+
+packed_time_t iso8601_to_packed(const std::string &s, const std::string &default_tz,
+                                const rcheckable_t *target) {
+    date_format_t df = UNSET;
+    int64_t days = 0, ms_of_day = 0;
+    int tz_minutes = 0;
+    bool has_tz = false;
     try {
-        date_format_t df = UNSET;
-        std::string sanitized;
+        const char *begin = s.data(), *end = s.data() + s.size();
+        const char *tloc = std::find(begin, end, 'T');
+        days = parse::date(parse::span_t(begin, tloc), &df);
+        if (tloc != end) {
+            const char *start = tloc + 1;
+            const char *sign_loc = std::find(start, end, '-');
+            sign_loc = (sign_loc == end) ? std::find(start, end, '+') : sign_loc;
+            sign_loc = (sign_loc == end) ? std::find(start, end, 'Z') : sign_loc;
+            ms_of_day = parse::time(parse::span_t(start, sign_loc));
+            if (sign_loc != end) {
+                tz_minutes = parse::tz(parse::span_t(sign_loc, end));
+                has_tz = true;
+            }
+        }
+    } catch (const datum_exc_t &e) {
+        rfail_target(target, base_exc_t::GENERIC, "%s", e.what());
+    }
+
+    if (df == WEEKCOUNT) {
+        // Same message as before we parsed by hand, since clients may match on it.
+        rfail_target(target, base_exc_t::GENERIC, "%s",
+                     "Due to limitations in the boost time library we use for "
+                     "parsing, we cannot support ISO week dates right now.  "
+                     "Sorry about that!  Please use years, calendar dates, or "
+                     "ordinal dates instead.");
+    }
+    r_sanity_check(df != UNSET);
+
+    if (!has_tz) {
+        rcheck_target(target, base_exc_t::GENERIC, default_tz != "",
+                      "ISO 8601 string has no time zone, and no default time "
+                      "zone was provided.");
         try {
-            sanitized = sanitize::iso8601(s, default_tz, &df);
+            tz_minutes = parse::tz(
+                parse::span_t(default_tz.data(), default_tz.data() + default_tz.size()));
         } catch (const datum_exc_t &e) {
-            rfail_target(target, base_exc_t::GENERIC, "%s", e.what());
+            rfail_target(target, base_exc_t::GENERIC,
+                         "Invalid ISO 8601 timezone: `%s`.", default_tz.c_str());
         }
+    }
 
-        std::istringstream ss(sanitized);
-        ss.exceptions(std::ios_base::failbit);
-        switch (df) {
-        case UNSET: r_sanity_check(false); break;
-        case MONTH_DAY: ss.imbue(month_day_format); break;
-        case WEEKCOUNT: {
-            rfail_target(target, base_exc_t::GENERIC, "%s",
-                         "Due to limitations in the boost time library we use for "
-                         "parsing, we cannot support ISO week dates right now.  "
-                         "Sorry about that!  Please use years, calendar dates, or "
-                         "ordinal dates instead.");
-        } break;
-        case DAYCOUNT: ss.imbue(daycount_format); break;
-        default: unreachable();
-        }
-        time_t t(boost::date_time::not_a_date_time);
-        ss >> t;
-        rcheck_target(
-            target, base_exc_t::GENERIC, !t.is_special(),
-            strprintf("Failed to parse `%s` (`%s`) as ISO 8601 time.",
-                      s.c_str(), sanitized.c_str()));
-        return boost_to_time(t, target);
-    } HANDLE_BOOST_ERRORS(target);
+    return packed_time_t(days * ms_per_day + ms_of_day - tz_minutes * ms_per_minute,
+                         tz_minutes);
+}
+
+counted_t<const datum_t> iso8601_to_time(
+    const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
+    packed_time_t t = iso8601_to_packed(s, default_tz, target);
+    return make_time(t.epoch_time(), tz_to_str(t.tz_minutes()));
 }
 
 const int64_t sec_incr = INT_MAX;
@@ -406,32 +510,50 @@ time_t time_to_boost(counted_t<const datum_t> d) {
     }
 }
 
-const std::locale tz_format =
-    std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F%Q"));
-const std::locale no_tz_format =
-    std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F"));
 std::string time_to_iso8601(counted_t<const datum_t> d) {
-    try {
-        time_t t = time_to_boost(d);
-        int year = t.date().year();
-        // Boost also accepts year 10000.  I don't think any real users will hit
-        // that edge case, but better safe than sorry.
-        rcheck_datum(year >= 0 && year <= 9999, base_exc_t::GENERIC,
-                     strprintf("Year `%d` out of valid ISO 8601 range [0, 9999].",
-                               year));
-        std::ostringstream ss;
-        ss.exceptions(std::ios_base::failbit);
-        if (counted_t<const datum_t> tz = d->get(timezone_key, NOTHROW)) {
-            ss.imbue(tz_format);
-        } else {
-            ss.imbue(no_tz_format);
-        }
-        ss << time_to_boost(d);
-        std::string s = ss.str();
-        size_t dot_off = s.find('.');
-        return (dot_off == std::string::npos) ? s :
-            s.substr(0, dot_off + 4) + s.substr(dot_off + 7, std::string::npos);
-    } HANDLE_BOOST_ERRORS_NO_TARGET;
+    double epoch_time = d->get(epoch_time_key)->as_num();
+    counted_t<const datum_t> tz = d->get(timezone_key, NOTHROW);
+    int tz_minutes = 0;
+    if (tz) {
+        const std::string &tz_s = tz->as_str();
+        tz_minutes = parse::tz(parse::span_t(tz_s.data(), tz_s.data() + tz_s.size()));
+    }
+    packed_time_t t;
+    rcheck_datum(packed_time_t::pack(epoch_time, tz_minutes, &t), base_exc_t::GENERIC,
+                 strprintf("Time `%.0f` out of valid ISO 8601 range.", epoch_time));
+
+    int64_t local_ms = t.epoch_ms() + t.tz_minutes() * ms_per_minute;
+    int64_t ms_of_day = local_ms % ms_per_day;
+    ms_of_day += ms_of_day < 0 ? ms_per_day : 0;
+    int64_t year;
+    int month, day;
+    civil_from_days((local_ms - ms_of_day) / ms_per_day, &year, &month, &day);
+    rcheck_datum(year >= 0 && year <= 9999, base_exc_t::GENERIC,
+                 strprintf("Year `%" PRIi64 "` out of valid ISO 8601 range [0, 9999].",
+                           year));
+
+    // YYYY-MM-DDThh:mm:ss.sss+hh:mm
+    char buf[29];
+    char *out = buf;
+    out = format_digits(year, 4, out);
+    *out++ = '-';
+    out = format_digits(month, 2, out);
+    *out++ = '-';
+    out = format_digits(day, 2, out);
+    *out++ = 'T';
+    out = format_digits(ms_of_day / (60 * ms_per_minute), 2, out);
+    *out++ = ':';
+    out = format_digits(ms_of_day / ms_per_minute % 60, 2, out);
+    *out++ = ':';
+    out = format_digits(ms_of_day / 1000 % 60, 2, out);
+    if (ms_of_day % 1000 != 0) {
+        *out++ = '.';
+        out = format_digits(ms_of_day % 1000, 3, out);
+    }
+    if (tz) {
+        out = format_tz(t.tz_minutes(), out);
+    }
+    return std::string(buf, out);
 }
 
 double time_to_epoch_time(counted_t<const datum_t> d) {
@@ -673,5 +795,10 @@ void time_to_str_key(const datum_t &d, std::string *str_out) {
     d.get(epoch_time_key)->num_to_str_key(str_out);
 }
 
+void time_to_cmp_key(const datum_t &d, std::string *str_out) {
+    // Times compare by `epoch_time` alone; see `time_cmp`.
+    d.get(epoch_time_key)->append_cmp_key(str_out);
+}
+
 } // namespace pseudo
 } // namespace ql
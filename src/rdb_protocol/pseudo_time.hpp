@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_PSEUDO_TIME_HPP_
 #define RDB_PROTOCOL_PSEUDO_TIME_HPP_
 
+#include <stdint.h>
+
 #include <string>
 
 template <class> class counted_t;
@@ -13,6 +15,24 @@ class datum_t;
 namespace pseudo {
 extern const char *const time_string;
 
+// A time packed into one word: milliseconds since the epoch in the high 52 bits
+// and the timezone offset in minutes in the low 12.  The ISO 8601 parser and
+// formatter work on these rather than on boost times.
+class packed_time_t {
+public:
+    packed_time_t();
+    packed_time_t(int64_t epoch_ms, int tz_minutes);
+    // Returns false if `epoch_time` is out of the (roughly 70000 year) range we
+    // can pack.  Rounds to the nearest millisecond, like `sanitize_time`.
+    static bool pack(double epoch_time, int tz_minutes, packed_time_t *out);
+
+    int64_t epoch_ms() const;
+    int tz_minutes() const;
+    double epoch_time() const;
+private:
+    int64_t bits;
+};
+
 counted_t<const datum_t> iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *t);
 std::string time_to_iso8601(counted_t<const datum_t> d);
@@ -50,6 +70,7 @@ counted_t<const datum_t> time_date(counted_t<const datum_t> time,
 counted_t<const datum_t> time_of_day(counted_t<const datum_t> time);
 
 void time_to_str_key(const datum_t &d, std::string *str_out);
+void time_to_cmp_key(const datum_t &d, std::string *str_out);
 
 } // namespace pseudo
 } // namespace ql
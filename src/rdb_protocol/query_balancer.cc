@@ -0,0 +1,127 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_balancer.hpp"
+
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+static bool query_balancing = false;
+
+void set_query_balancing(bool enabled) {
+    query_balancing = enabled;
+}
+
+bool get_query_balancing() {
+    return query_balancing;
+}
+
+namespace {
+
+struct load_stat_t {
+    load_stat_t() : running(0), queries(0), moved_queries(0) { }
+    int64_t running;
+    int64_t queries;
+    int64_t moved_queries;
+};
+
+}  // namespace
+
+/* Reports each thread's load separately, since how even it is is the point. */
+class query_balancer_t::stats_perfmon_t
+    : public perfmon_perthread_t<load_stat_t, std::vector<load_stat_t> > {
+public:
+    explicit stats_perfmon_t(query_balancer_t *_parent) : parent(_parent) { }
+
+protected:
+    void get_thread_stat(load_stat_t *stat) {
+        const thread_load_t &load = parent->loads[get_thread_id().threadnum].value;
+        stat->running = load.running;
+        stat->queries = load.queries;
+        stat->moved_queries = load.moved_queries;
+    }
+
+    std::vector<load_stat_t> combine_stats(const load_stat_t *stats) {
+        return std::vector<load_stat_t>(stats, stats + get_num_db_threads());
+    }
+
+    scoped_ptr_t<perfmon_result_t> output_stat(const std::vector<load_stat_t> &stats) {
+        scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            scoped_ptr_t<perfmon_result_t> thread = perfmon_result_t::alloc_map_result();
+            thread->insert("running_queries",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].running)));
+            thread->insert("queries",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].queries)));
+            thread->insert("moved_queries",
+                           new perfmon_result_t(strprintf("%" PRIi64, stats[i].moved_queries)));
+            result->insert(strprintf("thread_%zu", i), thread.release());
+        }
+        return result;
+    }
+
+private:
+    query_balancer_t *parent;
+
+    DISABLE_COPYING(stats_perfmon_t);
+};
+
+query_balancer_t::query_balancer_t(bool _enabled)
+    : enabled(_enabled), loads(MAX_THREADS) {
+    for (size_t i = 0; i < loads.size(); ++i) {
+        loads[i].value.running = 0;
+        loads[i].value.queries = 0;
+        loads[i].value.moved_queries = 0;
+    }
+    stats.init(new stats_perfmon_t(this));
+    stats_membership.init(new perfmon_membership_t(&get_global_perfmon_collection(),
+                                                   stats.get(), "query_threads"));
+}
+
+query_balancer_t::~query_balancer_t() {
+    stats_membership.reset();
+    for (size_t i = 0; i < loads.size(); ++i) {
+        guarantee(loads[i].value.running == 0);
+    }
+}
+
+threadnum_t query_balancer_t::pick_thread() const {
+    const threadnum_t current = get_thread_id();
+    if (!enabled) {
+        return current;
+    }
+
+    // The counts can be stale by the time we read them, which is fine; the
+    // next query will see the newer ones.
+    int best = current.threadnum;
+    int64_t best_running = loads[best].value.running;
+    for (int i = 0; i < get_num_db_threads(); ++i) {
+        const int64_t running = loads[i].value.running;
+        if (running < best_running) {
+            best = i;
+            best_running = running;
+        }
+    }
+
+    if (loads[current.threadnum].value.running - best_running
+        >= QUERY_BALANCING_THRESHOLD) {
+        return threadnum_t(best);
+    }
+    return current;
+}
+
+query_balancer_t::running_query_t::running_query_t(query_balancer_t *_parent, bool moved)
+    : parent(_parent), threadnum(get_thread_id().threadnum) {
+    thread_load_t *load = &parent->loads[threadnum].value;
+    ++load->running;
+    ++load->queries;
+    if (moved) {
+        ++load->moved_queries;
+    }
+}
+
+query_balancer_t::running_query_t::~running_query_t() {
+    rassert(get_thread_id().threadnum == threadnum);
+    --parent->loads[threadnum].value.running;
+}
@@ -0,0 +1,69 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_BALANCER_HPP_
+#define RDB_PROTOCOL_QUERY_BALANCER_HPP_
+
+#include "containers/scoped.hpp"
+#include "perfmon/types.hpp"
+#include "utils.hpp"
+
+class perfmon_membership_t;
+
+// Whether query servers made after this balance their queries across threads.
+// It's off unless turned on from the command line.
+void set_query_balancing(bool enabled);
+bool get_query_balancing();
+
+/* A client connection's queries are evaluated on the thread that accepted the
+connection, so a few heavy queries can keep one thread busy while the others sit
+idle.  `query_balancer_t` keeps count of the queries running on each thread, and
+when balancing is on, it sends a connection's queries to the least busy thread
+once the connection's own thread is `QUERY_BALANCING_THRESHOLD` queries busier.
+
+A query's coroutine can only move before the query starts running, because a
+running query is full of thread-local state (the watchables its environment
+reads the metadata from, and the signals and drainers of its streams).  For the
+same reason, a connection's queries only change threads when it has no open
+cursors; `query2_server_t` takes care of that. */
+class query_balancer_t {
+public:
+    explicit query_balancer_t(bool enabled);
+    ~query_balancer_t();
+
+    // Returns the thread a query that came in on the current thread should run
+    // on: the current thread, unless balancing is on and it's too busy.
+    threadnum_t pick_thread() const;
+
+    // Counts a query as running on the current thread, for as long as it
+    // exists.  `moved` is true if the query came in on another thread.
+    class running_query_t {
+    public:
+        running_query_t(query_balancer_t *parent, bool moved);
+        ~running_query_t();
+    private:
+        query_balancer_t *parent;
+        int threadnum;
+
+        DISABLE_COPYING(running_query_t);
+    };
+
+private:
+    class stats_perfmon_t;
+
+    struct thread_load_t {
+        // Only changed on the thread itself, but read from other threads by
+        // `pick_thread`.
+        volatile int64_t running;
+        int64_t queries;
+        int64_t moved_queries;
+    };
+
+    const bool enabled;
+    scoped_array_t<cache_line_padded_t<thread_load_t> > loads;
+
+    scoped_ptr_t<stats_perfmon_t> stats;
+    scoped_ptr_t<perfmon_membership_t> stats_membership;
+
+    DISABLE_COPYING(query_balancer_t);
+};
+
+#endif  // RDB_PROTOCOL_QUERY_BALANCER_HPP_
@@ -0,0 +1,262 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/response.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <string>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+
+using google::protobuf::io::CodedOutputStream;
+
+namespace ql {
+
+namespace {
+
+// The tags (field number and wire type) of the fields we write.  They all fit
+// in one byte.
+enum wire_tag_t {
+    RESPONSE_RESPONSE = (3 << 3) | 2,
+    DATUM_TYPE = (1 << 3) | 0,
+    DATUM_R_BOOL = (2 << 3) | 0,
+    DATUM_R_NUM = (3 << 3) | 1,
+    DATUM_R_STR = (4 << 3) | 2,
+    DATUM_R_ARRAY = (5 << 3) | 2,
+    DATUM_R_OBJECT = (6 << 3) | 2,
+    ASSOC_PAIR_KEY = (1 << 3) | 2,
+    ASSOC_PAIR_VAL = (2 << 3) | 2
+};
+
+const size_t MAX_VARINT_SIZE = 10;
+
+size_t varint_size(uint64_t value) {
+    return CodedOutputStream::VarintSize64(value);
+}
+
+// The size of a length-delimited field (a string or a message) of `size` bytes.
+size_t field_size(size_t size) {
+    return 1 + varint_size(size) + size;
+}
+
+Datum::DatumType datum_type(const datum_t &d) {
+    switch (d.get_type()) {
+    case datum_t::R_NULL: return Datum::R_NULL;
+    case datum_t::R_BOOL: return Datum::R_BOOL;
+    case datum_t::R_NUM: return Datum::R_NUM;
+    case datum_t::R_STR: return Datum::R_STR;
+    case datum_t::R_ARRAY: return Datum::R_ARRAY;
+    case datum_t::R_OBJECT: return Datum::R_OBJECT;
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+// Returns the size of `d` as a `Datum` message, and appends it and the sizes of
+// the messages nested in it to `sizes` in the order `wire_writer_t` writes them.
+size_t datum_size(const datum_t &d, std::vector<size_t> *sizes) {
+    const size_t index = sizes->size();
+    sizes->push_back(0);
+    size_t size = 1 + varint_size(datum_type(d));
+    switch (d.get_type()) {
+    case datum_t::R_NULL: break;
+    case datum_t::R_BOOL: {
+        size += 2;
+    } break;
+    case datum_t::R_NUM: {
+        size += 1 + sizeof(uint64_t);
+    } break;
+    case datum_t::R_STR: {
+        size += field_size(d.as_str().size());
+    } break;
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &arr = d.as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            size += field_size(datum_size(**it, sizes));
+        }
+    } break;
+    case datum_t::R_OBJECT: {
+        // In reverse, like `write_to_protobuf`.
+        const datum_object_t &obj = d.as_object();
+        for (auto it = obj.rbegin(); it != obj.rend(); ++it) {
+            const size_t pair_index = sizes->size();
+            sizes->push_back(0);
+            size_t pair_size = field_size(it->first.size());
+            pair_size += field_size(datum_size(*it->second, sizes));
+            (*sizes)[pair_index] = pair_size;
+            size += field_size(pair_size);
+        }
+    } break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+    (*sizes)[index] = size;
+    return size;
+}
+
+// Encodes data into a buffer, and hands the buffer to a `response_writer_t`
+// whenever it fills up.
+class wire_writer_t {
+public:
+    wire_writer_t(const std::vector<size_t> *_sizes, response_writer_t *_out)
+        : sizes(_sizes), next_size(0), out(_out), buf(BUF_SIZE), used(0) { }
+
+    void write_bytes(const char *data, size_t n) {
+        if (n > BUF_SIZE / 2) {
+            // Big strings don't need to be copied twice.
+            flush();
+            out->write(data, n);
+        } else {
+            reserve(n);
+            memcpy(buf.data() + used, data, n);
+            used += n;
+        }
+    }
+
+    void write_field(wire_tag_t tag, size_t size) {
+        reserve(1 + MAX_VARINT_SIZE);
+        buf[used++] = tag;
+        write_varint_unchecked(size);
+    }
+
+    // Writes a `Datum` message field (the tag, length and message).
+    void write_datum_field(wire_tag_t tag, const datum_t &d) {
+        write_field(tag, (*sizes)[next_size]);
+        write_datum(d);
+    }
+
+    void write_datum(const datum_t &d) {
+        guarantee(next_size < sizes->size());
+        ++next_size;
+        reserve(2 + MAX_VARINT_SIZE);
+        buf[used++] = DATUM_TYPE;
+        write_varint_unchecked(datum_type(d));
+        switch (d.get_type()) {
+        case datum_t::R_NULL: break;
+        case datum_t::R_BOOL: {
+            buf[used++] = DATUM_R_BOOL;
+            buf[used++] = d.as_bool() ? 1 : 0;
+        } break;
+        case datum_t::R_NUM: {
+            double num = d.as_num();
+            // so we can use `isfinite` in a GCC 4.4.3-compatible way
+            using namespace std;  // NOLINT(build/namespaces)
+            r_sanity_check(isfinite(num));
+            uint64_t bits;
+            memcpy(&bits, &num, sizeof(bits));
+            reserve(1 + sizeof(bits));
+            buf[used++] = DATUM_R_NUM;
+            uint8_t *p = reinterpret_cast<uint8_t *>(buf.data() + used);
+            used += CodedOutputStream::WriteLittleEndian64ToArray(bits, p) - p;
+        } break;
+        case datum_t::R_STR: {
+            const std::string &str = d.as_str();
+            write_field(DATUM_R_STR, str.size());
+            write_bytes(str.data(), str.size());
+        } break;
+        case datum_t::R_ARRAY: {
+            const std::vector<counted_t<const datum_t> > &arr = d.as_array();
+            for (auto it = arr.begin(); it != arr.end(); ++it) {
+                write_datum_field(DATUM_R_ARRAY, **it);
+            }
+        } break;
+        case datum_t::R_OBJECT: {
+            const datum_object_t &obj = d.as_object();
+            for (auto it = obj.rbegin(); it != obj.rend(); ++it) {
+                guarantee(next_size < sizes->size());
+                write_field(DATUM_R_OBJECT, (*sizes)[next_size++]);
+                write_field(ASSOC_PAIR_KEY, it->first.size());
+                write_bytes(it->first.data(), it->first.size());
+                write_datum_field(ASSOC_PAIR_VAL, *it->second);
+            }
+        } break;
+        case datum_t::UNINITIALIZED: // fallthru
+        default: unreachable();
+        }
+    }
+
+    void flush() {
+        if (used != 0) {
+            out->write(buf.data(), used);
+            used = 0;
+        }
+    }
+
+    bool done() const { return next_size == sizes->size() && used == 0; }
+
+private:
+    void reserve(size_t n) {
+        rassert(n <= BUF_SIZE);
+        if (used + n > BUF_SIZE) {
+            flush();
+        }
+    }
+
+    void write_varint_unchecked(uint64_t value) {
+        uint8_t *p = reinterpret_cast<uint8_t *>(buf.data() + used);
+        used += CodedOutputStream::WriteVarint64ToArray(value, p) - p;
+    }
+
+    // The same size as a TCP connection's write buffers.
+    static const size_t BUF_SIZE = 8 * KILOBYTE;
+
+    const std::vector<size_t> *sizes;
+    size_t next_size;
+
+    response_writer_t *out;
+    scoped_array_t<char> buf;
+    size_t used;
+
+    DISABLE_COPYING(wire_writer_t);
+};
+
+}  // namespace
+
+Response *response_t::mutable_pb() {
+    size_valid = false;
+    return &pb_;
+}
+
+void response_t::add_datum(counted_t<const datum_t> datum) {
+    size_valid = false;
+    data_.push_back(datum);
+}
+
+void response_t::clear_data() {
+    size_valid = false;
+    data_.clear();
+}
+
+size_t response_t::serialized_size() const {
+    if (!size_valid) {
+        sizes.clear();
+        size = pb_.ByteSize();
+        for (auto it = data_.begin(); it != data_.end(); ++it) {
+            size += field_size(datum_size(**it, &sizes));
+        }
+        size_valid = true;
+    }
+    return size;
+}
+
+void response_t::write(response_writer_t *writer) const {
+    serialized_size();
+
+    // Protocol buffers don't care what order fields come in, so the data can
+    // follow everything else.
+    std::string header;
+    pb_.SerializeToString(&header);
+    wire_writer_t wire_writer(&sizes, writer);
+    wire_writer.write_bytes(header.data(), header.size());
+    for (auto it = data_.begin(); it != data_.end(); ++it) {
+        wire_writer.write_datum_field(RESPONSE_RESPONSE, **it);
+    }
+    wire_writer.flush();
+    guarantee(wire_writer.done());
+}
+
+}  // namespace ql
@@ -0,0 +1,58 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESPONSE_HPP_
+#define RDB_PROTOCOL_RESPONSE_HPP_
+
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+class datum_t;
+
+// Receives a serialized response in pieces.
+class response_writer_t {
+public:
+    virtual void write(const char *data, size_t size) = 0;
+protected:
+    virtual ~response_writer_t() { }
+};
+
+// A `Response` whose data are kept as `datum_t`s until it's sent.  Instead of
+// building a `Datum` message for every row of a big result and serializing the
+// whole thing into one buffer, `write` encodes the data straight into the
+// protocol buffers wire format, a few kilobytes at a time.  The bytes are the
+// same ones `write_to_protobuf` and `SerializeToArray` would give.
+class response_t {
+public:
+    response_t() : size_valid(false), size(0) { }
+
+    // Everything but the data: the type, the token, and for errors the message
+    // and backtrace.
+    const Response &pb() const { return pb_; }
+    Response *mutable_pb();
+
+    void add_datum(counted_t<const datum_t> datum);
+    const std::vector<counted_t<const datum_t> > &data() const { return data_; }
+    void clear_data();
+
+    // The number of bytes `write` writes.
+    size_t serialized_size() const;
+    void write(response_writer_t *writer) const;
+
+private:
+    Response pb_;
+    std::vector<counted_t<const datum_t> > data_;
+
+    // The sizes of all the messages in the serialized data (each datum, and
+    // each array element, object pair and object value within it), in the
+    // order they're written.  Computed by `serialized_size`.
+    mutable std::vector<size_t> sizes;
+    mutable bool size_valid;
+    mutable size_t size;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESPONSE_HPP_
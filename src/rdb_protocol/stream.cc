@@ -1,7 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
 #include "btree/keys.hpp"
+#include "concurrency/wait_any.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/ql2.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
@@ -11,6 +16,11 @@
 
 namespace query_language {
 
+/* The first chunk is small so that queries which only want a few rows get them
+quickly.  After that `adapt_chunk_size` grows the chunks while the caller keeps
+outrunning the reads, up to the largest chunk the shards will build. */
+static const size_t rget_min_chunk_size = 64 * KILOBYTE;
+
 batched_rget_stream_t::batched_rget_stream_t(
     const namespace_repo_t<rdb_protocol_t>::access_t &_ns_access,
     counted_t<const ql::datum_t> left_bound, bool left_bound_open,
@@ -29,7 +39,10 @@ batched_rget_stream_t::batched_rget_stream_t(
               ? store_key_t(right_bound->print_primary())
               : store_key_t::max()),
       sorting(_sorting),
-      parent(_parent)
+      parent(_parent),
+      outstanding_read_is_prefetch(false),
+      chunks_read(0),
+      chunk_size(rget_min_chunk_size)
 { }
 
 batched_rget_stream_t::batched_rget_stream_t(
@@ -55,7 +68,10 @@ batched_rget_stream_t::batched_rget_stream_t(
                   ? _sindex_end_value->truncated_secondary()
                   : store_key_t::max())),
       sorting(_sorting),
-      parent(_parent)
+      parent(_parent),
+      outstanding_read_is_prefetch(false),
+      chunks_read(0),
+      chunk_size(rget_min_chunk_size)
 { }
 
 boost::optional<rget_item_t> batched_rget_stream_t::head(ql::env_t *env) {
@@ -247,6 +263,14 @@ rdb_protocol_t::rget_read_response_t::result_t batched_rget_stream_t::apply_term
     }
 }
 
+void batched_rget_stream_t::read_ahead() {
+    started = true;
+    if (!finished && data.empty() && !outstanding_read.has()) {
+        outstanding_read_is_prefetch = false;
+        start_read();
+    }
+}
+
 rdb_protocol_t::rget_read_t batched_rget_stream_t::get_rget() {
     if (!sindex_id) {
         return rdb_protocol_t::rget_read_t(rdb_protocol_t::region_t(range),
@@ -264,56 +288,115 @@ rdb_protocol_t::rget_read_t batched_rget_stream_t::get_rget() {
 }
 
 void batched_rget_stream_t::read_more(ql::env_t *env) {
-    rdb_protocol_t::read_t read(get_rget());
-    try {
-        guarantee(ns_access.get_namespace_if());
-        rdb_protocol_t::read_response_t res;
-        if (use_outdated) {
-            ns_access.get_namespace_if()->read_outdated(read, &res, env->interruptor);
-        } else {
-            ns_access.get_namespace_if()->read(
-                read, &res, order_token_t::ignore, env->interruptor);
-        }
-        rdb_protocol_t::rget_read_response_t *p_res
-            = boost::get<rdb_protocol_t::rget_read_response_t>(&res.response);
-        guarantee(p_res);
+    if (!outstanding_read.has()) {
+        outstanding_read_is_prefetch = false;
+        start_read();
+    }
+    if (outstanding_read_is_prefetch) {
+        adapt_chunk_size(!outstanding_read->done.is_pulsed());
+    }
+    wait_interruptible(&outstanding_read->done, env->interruptor);
+    scoped_ptr_t<chunk_read_t> chunk(std::move(outstanding_read));
 
-        /* Re throw an exception if we got one. */
-        if (auto e = boost::get<ql::exc_t>(&p_res->result)) {
-            throw *e;
-        } else if (auto e2 = boost::get<ql::datum_exc_t>(&p_res->result)) {
-            throw *e2;
-        }
+    if (chunk->interrupted) {
+        // Only the drainer can interrupt `do_read`, and we're still alive.
+        unreachable();
+    }
+    if (chunk->error) {
+        rfail_datum(ql::base_exc_t::GENERIC,
+                    "cannot perform read: %s", chunk->error->c_str());
+    }
 
-        // todo: just do a straight copy?
-        typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
-        stream_t *stream = boost::get<stream_t>(&p_res->result);
-        guarantee(stream);
+    rdb_protocol_t::rget_read_response_t *p_res
+        = boost::get<rdb_protocol_t::rget_read_response_t>(&chunk->response.response);
+    guarantee(p_res);
 
-        for (stream_t::iterator i = stream->begin(); i != stream->end(); ++i) {
-            guarantee(i->data);
-            data.push_back(*i);
-        }
+    /* Re throw an exception if we got one. */
+    if (auto e = boost::get<ql::exc_t>(&p_res->result)) {
+        throw *e;
+    } else if (auto e2 = boost::get<ql::datum_exc_t>(&p_res->result)) {
+        throw *e2;
+    }
 
-        if (forward(sorting)) {
-            range.left = p_res->last_considered_key;
-        } else {
-            range.right = key_range_t::right_bound_t(p_res->last_considered_key);
-        }
+    // todo: just do a straight copy?
+    typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
+    stream_t *stream = boost::get<stream_t>(&p_res->result);
+    guarantee(stream);
+
+    for (stream_t::iterator i = stream->begin(); i != stream->end(); ++i) {
+        guarantee(i->data);
+        data.push_back(*i);
+    }
+
+    if (forward(sorting)) {
+        range.left = p_res->last_considered_key;
+    } else {
+        range.right = key_range_t::right_bound_t(p_res->last_considered_key);
+    }
 
-        if (forward(sorting) &&
-            (!range.left.increment() ||
-            (!range.right.unbounded && (range.right.key < range.left)))) {
+    if (forward(sorting) &&
+        (!range.left.increment() ||
+        (!range.right.unbounded && (range.right.key < range.left)))) {
+        finished = true;
+    } else if (backward(sorting)) {
+        guarantee(!range.right.unbounded);
+        if (!range.right.key.decrement() ||
+            range.right.key < range.left) {
             finished = true;
-        } else if (backward(sorting)) {
-            guarantee(!range.right.unbounded);
-            if (!range.right.key.decrement() ||
-                range.right.key < range.left) {
-                finished = true;
-            }
+        }
+    }
+
+    /* If the caller got through a whole chunk before this one it's probably
+    going to get through this one too; read the next one while it does. */
+    ++chunks_read;
+    if (!finished && chunks_read > 1) {
+        start_read();
+        outstanding_read_is_prefetch = true;
+    }
+}
+
+void batched_rget_stream_t::start_read() {
+    guarantee(!outstanding_read.has());
+    rdb_protocol_t::rget_read_t rget = get_rget();
+    rget.chunk_size = chunk_size;
+    outstanding_read.init(new chunk_read_t);
+    coro_t::spawn_sometime(boost::bind(&batched_rget_stream_t::do_read, this,
+                                       rdb_protocol_t::read_t(rget),
+                                       outstanding_read.get(),
+                                       auto_drainer_t::lock_t(&drainer)));
+}
+
+void batched_rget_stream_t::do_read(const rdb_protocol_t::read_t &read,
+                                    chunk_read_t *chunk,
+                                    auto_drainer_t::lock_t keepalive) {
+    try {
+        guarantee(ns_access.get_namespace_if());
+        if (use_outdated) {
+            ns_access.get_namespace_if()->read_outdated(
+                read, &chunk->response, keepalive.get_drain_signal());
+        } else {
+            ns_access.get_namespace_if()->read(
+                read, &chunk->response, order_token_t::ignore,
+                keepalive.get_drain_signal());
         }
     } catch (const cannot_perform_query_exc_t &e) {
-        rfail_datum(ql::base_exc_t::GENERIC, "cannot perform read: %s", e.what());
+        chunk->error = std::string(e.what());
+    } catch (const interrupted_exc_t &) {
+        chunk->interrupted = true;
+    }
+    chunk->done.pulse();
+}
+
+void batched_rget_stream_t::adapt_chunk_size(bool had_to_wait) {
+    /* If the caller had to wait for the read ahead then it's faster than the
+    shards, and bigger chunks spread the cost of a read over more rows.  If the
+    chunk was already there then the caller is the bottleneck and there's no
+    point holding so much in memory. */
+    if (had_to_wait) {
+        chunk_size = std::min<size_t>(chunk_size * 2,
+                                      rdb_protocol_t::MAX_RGET_CHUNK_SIZE);
+    } else {
+        chunk_size = std::max<size_t>(chunk_size / 2, rget_min_chunk_size);
     }
 }
 
@@ -19,6 +19,9 @@
 #include <boost/variant/get.hpp>
 
 #include "clustering/administration/namespace_interface_repository.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
 #include "rdb_protocol/protocol.hpp"
 
 enum batch_info_t { MID_BATCH, LAST_OF_BATCH, END_OF_STREAM };
@@ -54,6 +57,10 @@ public:
     apply_terminal(const rdb_protocol_details::terminal_variant_t &,
                    ql::env_t *env) = 0;
 
+    // Tells the stream that `next` is going to be called soon, so it can start
+    // reading now.  No more transformations may be added afterwards.
+    virtual void read_ahead() { }
+
     virtual ~json_stream_t() { }
 
 private:
@@ -89,11 +96,28 @@ public:
     apply_terminal(const rdb_protocol_details::terminal_variant_t &t,
                    ql::env_t *env);
 
+    void read_ahead();
+
 private:
+    /* A read of the next chunk that runs in the background while the caller
+     * works through `data`. */
+    struct chunk_read_t {
+        chunk_read_t() : interrupted(false) { }
+        cond_t done;
+        rdb_protocol_t::read_response_t response;
+        /* Set if the read couldn't be performed. */
+        boost::optional<std::string> error;
+        bool interrupted;
+    };
+
     boost::optional<rget_item_t> head(ql::env_t *env);
     void pop();
     rdb_protocol_t::rget_read_t get_rget();
     void read_more(ql::env_t *env);
+    void start_read();
+    void do_read(const rdb_protocol_t::read_t &read, chunk_read_t *chunk,
+                 auto_drainer_t::lock_t keepalive);
+    void adapt_chunk_size(bool had_to_wait);
     bool check_and_set_key_in_sorting_buffer(const std::string &key);
 
     /* Returns true if the passed value is new. */
@@ -125,6 +149,18 @@ private:
     sorting_t sorting;
 
     ql::rcheckable_t *parent;
+
+    /* We only read ahead once the caller has worked through a whole chunk, so
+     * that queries which only look at the first few rows don't pay for a
+     * second read.  At most one read is outstanding and the next one is only
+     * issued when `data` runs dry, so a stream holds at most two chunks. */
+    scoped_ptr_t<chunk_read_t> outstanding_read;
+    bool outstanding_read_is_prefetch;
+    size_t chunks_read;
+    size_t chunk_size;
+
+    /* Must be destroyed first, so that `do_read` is done with `this`. */
+    auto_drainer_t drainer;
 };
 
 } // namespace query_language
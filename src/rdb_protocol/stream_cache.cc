@@ -1,10 +1,41 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rdb_protocol/env.hpp"
 
 namespace ql {
 
+static perfmon_collection_t pm_cursors_collection;
+static perfmon_membership_t pm_cursors_membership(&get_global_perfmon_collection(),
+    &pm_cursors_collection, "query_cursors");
+static perfmon_counter_t pm_cursor_batches, pm_cursor_rows, pm_cursor_bytes,
+    pm_cursor_prefetched_batches;
+static perfmon_multi_membership_t pm_cursor_counters_membership(&pm_cursors_collection,
+    &pm_cursor_batches, "batches",
+    &pm_cursor_rows, "rows",
+    &pm_cursor_bytes, "bytes",
+    &pm_cursor_prefetched_batches, "prefetched_batches",
+    NULLPTR);
+
+// The same figures for each cursor, recorded when it closes.  Cursors can live
+// much longer than a second, so these cover the last minute's worth.
+static perfmon_sampler_t pm_batches_per_cursor(secs_to_ticks(60), false),
+    pm_rows_per_cursor(secs_to_ticks(60), false),
+    pm_bytes_per_cursor(secs_to_ticks(60), false),
+    pm_prefetched_batches_per_cursor(secs_to_ticks(60), false);
+static perfmon_multi_membership_t pm_per_cursor_membership(&pm_cursors_collection,
+    &pm_batches_per_cursor, "batches_per_cursor",
+    &pm_rows_per_cursor, "rows_per_cursor",
+    &pm_bytes_per_cursor, "bytes_per_cursor",
+    &pm_prefetched_batches_per_cursor, "prefetched_batches_per_cursor",
+    NULLPTR);
+
 bool stream_cache2_t::contains(int64_t key) {
     return streams.find(key) != streams.end();
 }
@@ -19,50 +50,150 @@ void stream_cache2_t::insert(int64_t key,
 }
 
 void stream_cache2_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    guarantee(it != streams.end());
+    prefetch_bytes -= it->second->reserved_bytes;
+    // This waits for any prefetch to finish.
+    streams.erase(it);
+}
+
+bool stream_cache2_t::empty() const {
+    return streams.empty();
+}
+
+void stream_cache2_t::clear() {
+    // This waits for any prefetches to finish.
+    streams.clear();
+    prefetch_bytes = 0;
 }
 
-bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
+bool stream_cache2_t::serve(int64_t key, response_t *res, signal_t *interruptor) {
     boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
     if (it == streams.end()) return false;
     entry_t *entry = it->second;
     entry->last_activity = time(0);
-    try {
-        // Reset the env_t's interruptor to a good one before we use it.  This may be a
-        // hack.  (I'd rather not have env_t be mutable this way -- could we construct
-        // a new env_t instead?  Why do we keep env_t's around anymore?)
-        entry->env->interruptor = interruptor;
 
-        int chunk_size = 0;
+    batch_t batch;
+    bool prefetched = false;
+    if (entry->prefetch_done.has()) {
+        wait_interruptible(entry->prefetch_done.get(), interruptor);
+        entry->prefetch_done.reset();
+        std::swap(batch, entry->prefetched);
+        prefetch_bytes -= entry->reserved_bytes;
+        entry->reserved_bytes = 0;
+        prefetched = true;
+    }
+
+    // Reset the env_t's interruptor to a good one before we use it.  This may be a
+    // hack.  (I'd rather not have env_t be mutable this way -- could we construct
+    // a new env_t instead?  Why do we keep env_t's around anymore?)
+    entry->env->interruptor = interruptor;
+
+    if (!prefetched) {
+        read_batch(entry, &batch);
+    }
+    if (batch.exc != std::exception_ptr()) {
+        erase(key);
+        std::rethrow_exception(batch.exc);
+    }
+
+    const microtime_t now = current_microtime();
+    if (batch.hit_deadline) {
+        // The stream is slow, so send what we have sooner.
+        entry->batch_bytes /= 2;
+        if (entry->batch_bytes < entry_t::MIN_BATCH_BYTES) {
+            entry->batch_bytes = entry_t::MIN_BATCH_BYTES;
+        }
+    } else if (batch.bytes >= entry->batch_bytes && entry->last_served != 0
+               && now - entry->last_served < entry_t::MAX_BATCH_MICROS) {
+        // The client is keeping up, so make fewer round trips.
+        entry->batch_bytes *= 2;
+        if (entry->batch_bytes > entry_t::MAX_BATCH_BYTES) {
+            entry->batch_bytes = entry_t::MAX_BATCH_BYTES;
+        }
+    }
+
+    for (auto jt = batch.data.begin(); jt != batch.data.end(); ++jt) {
+        res->add_datum(*jt);
+    }
+    ++pm_cursor_batches;
+    pm_cursor_rows += batch.data.size();
+    pm_cursor_bytes += batch.bytes;
+    ++entry->batches;
+    entry->rows += batch.data.size();
+    entry->bytes += batch.bytes;
+    if (prefetched) {
+        ++pm_cursor_prefetched_batches;
+        ++entry->prefetched_batches;
+    }
+
+    if (batch.done) {
+        erase(key);
+        res->mutable_pb()->set_type(Response::SUCCESS_SEQUENCE);
+        return true;
+    }
+    res->mutable_pb()->set_type(Response::SUCCESS_PARTIAL);
+    entry->last_served = now;
+
+    // Read the next batch while the client deals with this one, if the
+    // connection can spare the memory.  Many clients only look at the first
+    // batch and then abandon the cursor, so we wait for them to ask for a
+    // second one before reading ahead.
+    if (entry->batches >= 2
+        && prefetch_bytes + entry->batch_bytes <= MAX_PREFETCH_BYTES) {
+        entry->reserved_bytes = entry->batch_bytes;
+        prefetch_bytes += entry->reserved_bytes;
+        entry->prefetch_done.init(new cond_t);
+        coro_t::spawn_sometime(boost::bind(&stream_cache2_t::prefetch, this, entry,
+                                           interruptor,
+                                           auto_drainer_t::lock_t(&entry->drainer)));
+    }
+    return true;
+}
+
+void stream_cache2_t::read_batch(entry_t *entry, batch_t *batch) {
+    const microtime_t start = current_microtime();
+    try {
         if (entry->next_datum.has()) {
-            *res->add_response() = *entry->next_datum.get();
-            ++chunk_size;
+            batch->bytes += serialized_size(entry->next_datum);
+            batch->data.push_back(entry->next_datum);
             entry->next_datum.reset();
         }
-        while (counted_t<const datum_t> d = entry->stream->next(entry->env.get())) {
-            d->write_to_protobuf(res->add_response());
-            if (entry->max_chunk_size && ++chunk_size >= entry->max_chunk_size) {
-                if (counted_t<const datum_t> next_d = entry->stream->next(entry->env.get())) {
-                    r_sanity_check(!entry->next_datum.has());
-                    entry->next_datum.init(new Datum());
-                    next_d->write_to_protobuf(entry->next_datum.get());
-                    res->set_type(Response::SUCCESS_PARTIAL);
-                }
+        for (;;) {
+            const bool full =
+                (entry->max_chunk_size
+                 && batch->data.size() >= static_cast<size_t>(entry->max_chunk_size))
+                || batch->bytes >= entry->batch_bytes;
+            batch->hit_deadline = !full && !batch->data.empty()
+                && current_microtime() - start >= entry_t::MAX_BATCH_MICROS;
+            if (full || batch->hit_deadline) {
+                // Read one row ahead, so we can tell the client whether there
+                // are more.
+                entry->next_datum = entry->stream->next(entry->env.get());
+                batch->done = !entry->next_datum.has();
+                break;
+            }
+            counted_t<const datum_t> d = entry->stream->next(entry->env.get());
+            if (!d.has()) {
+                batch->done = true;
                 break;
             }
+            batch->bytes += serialized_size(d);
+            batch->data.push_back(d);
         }
-    } catch (const std::exception &e) {
-        erase(key);
-        throw;
-    }
-    if (!entry->next_datum.has()) {
-        erase(key);
-        res->set_type(Response::SUCCESS_SEQUENCE);
-    } else {
-        r_sanity_check(res->type() == Response::SUCCESS_PARTIAL);
+    } catch (const std::exception &) {
+        batch->exc = std::current_exception();
     }
-    return true;
+    batch->micros = current_microtime() - start;
+}
+
+void stream_cache2_t::prefetch(entry_t *entry, signal_t *interruptor,
+                               auto_drainer_t::lock_t lock) {
+    wait_any_t prefetch_interruptor(interruptor, lock.get_drain_signal());
+    entry->env->interruptor = &prefetch_interruptor;
+    read_batch(entry, &entry->prefetched);
+    entry->env->interruptor = interruptor;
+    entry->prefetch_done->pulse();
 }
 
 void stream_cache2_t::maybe_evict() {
@@ -72,9 +203,16 @@ void stream_cache2_t::maybe_evict() {
 stream_cache2_t::entry_t::entry_t(time_t _last_activity, scoped_ptr_t<env_t> &&env_ptr,
                                   counted_t<datum_stream_t> _stream)
     : last_activity(_last_activity), env(std::move(env_ptr)), stream(_stream),
-      max_chunk_size(DEFAULT_MAX_CHUNK_SIZE), max_age(DEFAULT_MAX_AGE) { }
+      max_chunk_size(DEFAULT_MAX_CHUNK_SIZE), max_age(DEFAULT_MAX_AGE),
+      batch_bytes(DEFAULT_BATCH_BYTES), last_served(0), batches(0), rows(0),
+      bytes(0), prefetched_batches(0), reserved_bytes(0) { }
 
-stream_cache2_t::entry_t::~entry_t() { }
+stream_cache2_t::entry_t::~entry_t() {
+    pm_batches_per_cursor.record(batches);
+    pm_rows_per_cursor.record(rows);
+    pm_bytes_per_cursor.record(bytes);
+    pm_prefetched_batches_per_cursor.record(prefetched_batches);
+}
 
 
 } // namespace ql
@@ -4,15 +4,20 @@
 
 #include <time.h>
 
+#include <exception>
 #include <map>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/datum_stream.hpp"
-#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/response.hpp"
 
 namespace ql {
 class env_t;
@@ -20,25 +25,56 @@ class env_t;
 
 namespace ql {
 
+// The batches cursors send show up in the `query_cursors` perfmon: how many
+// there were, how many rows and bytes they held, and how many of them were read
+// while the client was busy with the one before.  The same figures for single
+// cursors are sampled there when the cursors close.
 class stream_cache2_t {
 public:
-    stream_cache2_t() { }
+    stream_cache2_t() : prefetch_bytes(0) { }
     MUST_USE bool contains(int64_t key);
     void insert(int64_t key,
                 scoped_ptr_t<env_t> &&val_env, counted_t<datum_stream_t> val_stream);
     void erase(int64_t key);
-    MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
+    MUST_USE bool serve(int64_t key, response_t *res, signal_t *interruptor);
+    // True if there are no open cursors.
+    MUST_USE bool empty() const;
+    // Closes all the cursors.
+    void clear();
 private:
     void maybe_evict();
 
+    // The rows for one response.
+    struct batch_t {
+        batch_t() : bytes(0), done(false), hit_deadline(false), micros(0) { }
+        std::vector<counted_t<const datum_t> > data;
+        size_t bytes;
+        // True if the stream has no more rows.
+        bool done;
+        // True if the batch was cut short because reading it took too long.
+        bool hit_deadline;
+        // How long reading it took.
+        microtime_t micros;
+        // Set if reading the stream threw.
+        std::exception_ptr exc;
+    };
+
     struct entry_t {
         ~entry_t(); // `env_t` is incomplete
 #ifndef NDEBUG
         static const int DEFAULT_MAX_CHUNK_SIZE = 5;
 #else
-        static const int DEFAULT_MAX_CHUNK_SIZE = 1000;
+        static const int DEFAULT_MAX_CHUNK_SIZE = 0;
 #endif // NDEBUG
         static const time_t DEFAULT_MAX_AGE = 0; // 0 = never evict
+        // Batches are cut off by size (measured the way rows are serialized),
+        // starting at `DEFAULT_BATCH_BYTES`.  The budget doubles while the
+        // client keeps coming back for more within `MAX_BATCH_MICROS`, and
+        // halves when a batch takes longer than that to read.
+        static const size_t MIN_BATCH_BYTES = 16 * KILOBYTE;
+        static const size_t DEFAULT_BATCH_BYTES = 256 * KILOBYTE;
+        static const size_t MAX_BATCH_BYTES = 8 * MEGABYTE;
+        static const microtime_t MAX_BATCH_MICROS = 500 * THOUSAND;
         entry_t(time_t _last_activity, scoped_ptr_t<env_t> &&env_ptr,
                 counted_t<datum_stream_t> _stream);
         time_t last_activity;
@@ -46,12 +82,42 @@ private:
         counted_t<datum_stream_t> stream;
         int max_chunk_size; // Size of 0 = unlimited
         time_t max_age;
+        size_t batch_bytes;
+
+        counted_t<const datum_t> next_datum;
+
+        // When we last sent this cursor's rows, to see how long the client
+        // took to ask for more.
+        microtime_t last_served;
 
-        scoped_ptr_t<Datum> next_datum;
+        // What this cursor has sent so far.
+        int64_t batches;
+        int64_t rows;
+        int64_t bytes;
+        int64_t prefetched_batches;
+
+        // Set while the next batch is being read into `prefetched`, and pulsed
+        // once it's there.  `reserved_bytes` is this entry's share of
+        // `prefetch_bytes`.
+        scoped_ptr_t<cond_t> prefetch_done;
+        batch_t prefetched;
+        size_t reserved_bytes;
+
+        // Destroyed first, so that a prefetch gets interrupted and finishes
+        // before the rest of the entry goes away.
+        auto_drainer_t drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
 
+    void read_batch(entry_t *entry, batch_t *batch);
+    void prefetch(entry_t *entry, signal_t *interruptor, auto_drainer_t::lock_t lock);
+
+    // The most memory the prefetched batches of all of a connection's cursors
+    // may take (roughly; batches can overshoot their budget by a row).
+    static const size_t MAX_PREFETCH_BYTES = 64 * MEGABYTE;
+    size_t prefetch_bytes;
+
     boost::ptr_map<int64_t, entry_t> streams;
     DISABLE_COPYING(stream_cache2_t);
 };
@@ -155,7 +155,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
 }
 
 void run(protob_t<Query> q, scoped_ptr_t<env_t> &&env_ptr,
-         Response *res, stream_cache2_t *stream_cache2,
+         response_t *res, stream_cache2_t *stream_cache2,
          bool *response_needed_out) {
     try {
         validate_pb(*q);
@@ -251,9 +251,8 @@ void run(protob_t<Query> q, scoped_ptr_t<env_t> &&env_ptr,
             }
 
             if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
-                res->set_type(Response_ResponseType_SUCCESS_ATOM);
-                counted_t<const datum_t> d = val->as_datum();
-                d->write_to_protobuf(res->add_response());
+                res->mutable_pb()->set_type(Response_ResponseType_SUCCESS_ATOM);
+                res->add_datum(val->as_datum());
             } else if (val->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
                 stream_cache2->insert(token, std::move(env_ptr), val->as_seq(env));
                 bool b = stream_cache2->serve(token, res, env->interruptor);
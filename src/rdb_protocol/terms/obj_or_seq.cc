@@ -65,9 +65,48 @@ public:
         pb::set_var(pb::reset(body->mutable_args(0)), varnum);
         prop_bt(func.get());
     }
+protected:
+    // Evaluates the arguments after the first into an array of paths.
+    counted_t<const datum_t> path_args(scope_env_t *env) {
+        const size_t n = num_args();
+        std::vector<counted_t<const datum_t> > paths;
+        paths.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i) {
+            paths.push_back(arg(env, i)->as_datum());
+        }
+        return make_counted<const datum_t>(std::move(paths));
+    }
+
+    // Maps `func`, a `pluck` or `without` of each row, over `seq`.  Unless the
+    // paths could change from row to row, the stream gets to project the rows
+    // itself (which for a table means on the shards).
+    counted_t<datum_stream_t> project_seq(scope_env_t *env,
+                                          counted_t<datum_stream_t> seq,
+                                          counted_t<func_t> func,
+                                          bool without) {
+        if (!func->is_deterministic()) {
+            return seq->map(func);
+        }
+        counted_t<const datum_t> paths;
+        try {
+            paths = path_args(env);
+            pathspec_t pathspec(paths, this);
+        } catch (const exc_t &) {
+            // Leave bad paths to fail on the first row, like they always have.
+            return seq->map(func);
+        }
+        return seq->project(paths, without, func);
+    }
 private:
     virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) = 0;
 
+    // How a `MAP` term applies `func` to a sequence.
+    virtual counted_t<datum_stream_t> map_seq(UNUSED scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        return seq->map(func);
+    }
+
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> v0 = arg(env, 0);
         counted_t<const datum_t> d;
@@ -93,7 +132,7 @@ private:
 
             switch (poly_type) {
             case MAP:
-                return new_val(env->env, v0->as_seq(env->env)->map(func));
+                return new_val(env->env, map_seq(env, v0->as_seq(env->env), func));
             case FILTER:
                 return new_val(env->env,
                                v0->as_seq(env->env)->filter(func, counted_t<func_t>()));
@@ -121,15 +160,14 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        const size_t n = num_args();
-        std::vector<counted_t<const datum_t> > paths;
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(path_args(env), this);
         return new_val(project(obj, pathspec, DONT_RECURSE));
     }
+    virtual counted_t<datum_stream_t> map_seq(scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        return project_seq(env, seq, func, false);
+    }
     virtual const char *name() const { return "pluck"; }
 };
 
@@ -142,15 +180,14 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        std::vector<counted_t<const datum_t> > paths;
-        const size_t n = num_args();
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(path_args(env), this);
         return new_val(unproject(obj, pathspec, DONT_RECURSE));
     }
+    virtual counted_t<datum_stream_t> map_seq(scope_env_t *env,
+                                              counted_t<datum_stream_t> seq,
+                                              counted_t<func_t> func) {
+        return project_seq(env, seq, func, true);
+    }
     virtual const char *name() const { return "without"; }
 };
 
@@ -202,13 +239,7 @@ private:
         counted_t<const datum_t> obj = v0->as_datum();
         r_sanity_check(obj->get_type() == datum_t::R_OBJECT);
 
-        std::vector<counted_t<const datum_t> > paths;
-        const size_t n = num_args();
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
+        pathspec_t pathspec(path_args(env), this);
         return new_val_bool(contains(obj, pathspec));
     }
     virtual const char *name() const { return "has_fields"; }
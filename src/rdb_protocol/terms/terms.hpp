@@ -53,6 +53,7 @@ counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &t
 counted_t<term_t> make_table_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_drop_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_list_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -96,7 +97,6 @@ counted_t<term_t> make_skip_term(compile_env_t *env, const protob_t<const Term>
 counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_inner_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_outer_join_term(compile_env_t *env, const protob_t<const Term> &term);
-counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_update_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_delete_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_difference_term(compile_env_t *env, const protob_t<const Term> &term);
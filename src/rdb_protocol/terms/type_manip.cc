@@ -164,8 +164,7 @@ private:
 
                 // OBJECT -> ARRAY
                 if (start_type == R_OBJECT_TYPE && end_type == R_ARRAY_TYPE) {
-                    const std::map<std::string, counted_t<const datum_t> > &obj
-                        = d->as_object();
+                    const datum_object_t &obj = d->as_object();
                     std::vector<counted_t<const datum_t> > arr;
                     arr.reserve(obj.size());
                     for (auto it = obj.begin(); it != obj.end(); ++it) {
@@ -3,6 +3,7 @@
 
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/pathspec.hpp"
 
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -59,6 +60,10 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const pluck_transform_t &transf) const {
+        *res_out = exc_t(exc, transf.func.get_bt().get(), 1);
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -88,6 +93,7 @@ public:
     void operator()(const ql::map_wire_func_t &func) const;
     void operator()(const filter_transform_t &func) const;
     void operator()(const ql::concatmap_wire_func_t &func) const;
+    void operator()(const pluck_transform_t &transf) const;
 
 private:
     counted_t<const ql::datum_t> arg;
@@ -126,6 +132,19 @@ void transform_visitor_t::operator()(const filter_transform_t &transf) const {
     }
 }
 
+void transform_visitor_t::operator()(const pluck_transform_t &transf) const {
+    if (arg->get_type() != ql::datum_t::R_OBJECT) {
+        out->push_back(transf.func.compile_wire_func()->call(ql_env, arg)->as_datum());
+        return;
+    }
+    // The paths were checked when the query was evaluated, so there's no term
+    // to blame here.
+    ql::pathspec_t pathspec(transf.paths, NULL);
+    out->push_back(transf.without
+                   ? ql::unproject(arg, pathspec, ql::DONT_RECURSE)
+                   : ql::project(arg, pathspec, ql::DONT_RECURSE));
+}
+
 void transform_apply(ql::env_t *ql_env,
                      counted_t<const ql::datum_t> json,
                      const rdb_protocol_details::transform_variant_t *t,
@@ -165,15 +184,14 @@ void terminal_visitor_t::operator()(const ql::gmr_wire_func_t &func) const {
     counted_t<const ql::datum_t> el = json.get();
     counted_t<const ql::datum_t> el_group
         = func.compile_group()->call(ql_env, el)->as_datum();
-    counted_t<const ql::datum_t> elm = json.get();
     counted_t<const ql::datum_t> el_map
-        = func.compile_map()->call(ql_env, elm)->as_datum();
+        = func.compile_map()->call(ql_env, el)->as_datum();
 
-    if (!obj->has(el_group)) {
-        obj->set(el_group, el_map);
+    counted_t<const ql::datum_t> *reduction = obj->get_reduction(el_group);
+    if (!reduction->has()) {
+        *reduction = el_map;
     } else {
-        counted_t<const ql::datum_t> lhs = obj->get(el_group);
-        obj->set(el_group, func.compile_reduce()->call(ql_env, lhs, el_map)->as_datum());
+        *reduction = func.compile_reduce()->call(ql_env, *reduction, el_map)->as_datum();
     }
 }
 
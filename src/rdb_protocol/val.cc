@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/val.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
@@ -246,6 +248,56 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
     return p_res->data;
 }
 
+// Compares a multi-point read's rows with the keys we look up in them.
+struct row_key_less_t {
+    bool operator()(const std::pair<store_key_t, counted_t<const datum_t> > &row,
+                    const store_key_t &key) const {
+        return row.first < key;
+    }
+};
+
+std::vector<counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    std::vector<store_key_t> pkeys;
+    pkeys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        pkeys.push_back(store_key_t((*it)->print_primary()));
+    }
+    // The shards descend the btree once for all the keys, which needs them sorted.
+    std::vector<store_key_t> sorted_keys = pkeys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()),
+                      sorted_keys.end());
+
+    std::vector<counted_t<const datum_t> > rows;
+    if (sorted_keys.empty()) {
+        return rows;
+    }
+    rdb_protocol_t::read_t read(
+        (rdb_protocol_t::multi_point_read_t(std::move(sorted_keys))));
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if()->read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if()->read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    rdb_protocol_t::multi_point_read_response_t *p_res =
+        boost::get<rdb_protocol_t::multi_point_read_response_t>(&res.response);
+    r_sanity_check(p_res);
+
+    // The response's rows are in key order, so we can binary search them.
+    const std::vector<std::pair<store_key_t, counted_t<const datum_t> > > &found
+        = p_res->rows;
+    counted_t<const datum_t> null = make_counted<datum_t>(datum_t::R_NULL);
+    rows.reserve(pkeys.size());
+    for (auto it = pkeys.begin(); it != pkeys.end(); ++it) {
+        auto row = std::lower_bound(found.begin(), found.end(), *it, row_key_less_t());
+        rows.push_back(row != found.end() && row->first == *it ? row->second : null);
+    }
+    return rows;
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         counted_t<const datum_t> value,
@@ -36,6 +36,11 @@ public:
                                               const protob_t<const Backtrace> &bt);
     const std::string &get_pkey();
     counted_t<const datum_t> get_row(env_t *env, counted_t<const datum_t> pval);
+    // Returns the rows with the given primary keys, in the same order, with a
+    // null datum for each one that doesn't exist (like `get_row`).  This is a
+    // single read, however many keys there are.
+    std::vector<counted_t<const datum_t> > get_rows(
+            env_t *env, const std::vector<counted_t<const datum_t> > &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             counted_t<const datum_t> value,
@@ -11,6 +11,7 @@
 #include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
 #include "containers/archive/string_stream.hpp"
+#include "containers/archive/varint.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/uuid.hpp"
 #include "logger.hpp"
@@ -923,10 +924,19 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         mutex_t::acq_t acq(&conn_structure->send_mutex);
 
         {
+            /* This goes out the way `msg << buffer.str()` would, but only the
+            length is copied into `msg`; the message itself is written from
+            where it is. */
             write_message_t msg;
-            msg << buffer.str();
-            int res = send_write_message(conn_structure->conn, &msg);
-            if (res) {
+            serialize_varint_uint64(&msg, bytes_sent);
+            write_buffer_t *length = msg.unsafe_expose_buffers()->head();
+            iovec iov[2];
+            iov[0].iov_base = length->data;
+            iov[0].iov_len = length->size;
+            iov[1].iov_base = const_cast<char *>(buffer.str().data());
+            iov[1].iov_len = bytes_sent;
+            int64_t res = conn_structure->conn->writev(iov, 2);
+            if (res == -1) {
                 /* Close the other half of the connection to make sure that
                    `connectivity_cluster_t::run_t::handle()` notices that something is
                    up */
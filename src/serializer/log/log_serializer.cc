@@ -10,6 +10,7 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/types.hpp"
+#include "containers/hugepage_arena.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/data_block_manager.hpp"
@@ -382,8 +383,8 @@ log_serializer_t::~log_serializer_t() {
 
 scoped_malloc_t<ser_buffer_t> log_serializer_t::malloc() {
     scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+        hugepage_arena_malloc(static_config.block_size().ser_value(),
+                              DEVICE_BLOCK_SIZE));
 
     // Initialize the block sequence id...
     buf->ser_header.block_sequence_id = NULL_BLOCK_SEQUENCE_ID;
@@ -392,8 +393,8 @@ scoped_malloc_t<ser_buffer_t> log_serializer_t::malloc() {
 
 scoped_malloc_t<ser_buffer_t> log_serializer_t::clone(const ser_buffer_t *_data) {
     scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+        hugepage_arena_malloc(static_config.block_size().ser_value(),
+                              DEVICE_BLOCK_SIZE));
     memcpy(buf.get(), _data, static_config.block_size().ser_value());
     return buf;
 }
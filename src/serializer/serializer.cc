@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "serializer/serializer.hpp"
 #include "arch/arch.hpp"
+#include "containers/hugepage_arena.hpp"
 
 file_account_t *serializer_t::make_io_account(int priority) {
     assert_thread();
@@ -122,6 +123,11 @@ void do_writes(serializer_t *ser, const std::vector<serializer_write_t> &writes,
     ser->index_write(index_write_ops, io_account);
 }
 
+template <>
+scoped_malloc_t<ser_buffer_t>::~scoped_malloc_t() {
+    hugepage_arena_free(ptr_);
+}
+
 void serializer_data_ptr_t::free() {
     rassert(ptr_.has());
     ptr_.reset();
@@ -45,6 +45,10 @@ struct ser_buffer_t {
     char cache_data[];
 } __attribute__((__packed__));
 
+// Block buffers may come from the hugepage arena, so they're freed through it.
+template <>
+scoped_malloc_t<ser_buffer_t>::~scoped_malloc_t();
+
 
 class block_size_t {
 public:
@@ -1,6 +1,10 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include <set>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
@@ -200,5 +204,200 @@ TEST(ClusteringQuery, BroadcasterProblem) {
     unittest::run_in_thread_pool(&run_broadcaster_problem_test);
 }
 
-}   /* namespace unittest */
+/* The `WriteBatch` test merges writes into a `master_write_batch_t` and splits
+the broadcaster's response back up between them. */
+
+static dummy_protocol_t::write_t make_write(const std::string &key, const std::string &value) {
+    dummy_protocol_t::write_t w;
+    w.values[key] = value;
+    return w;
+}
 
+static void run_write_batch_test() {
+    class : public ack_checker_t {
+    public:
+        bool is_acceptable_ack_set(const std::set<peer_id_t> &set) {
+            return set.size() >= 1;
+        }
+        write_durability_t get_write_durability(const peer_id_t&) const {
+            return WRITE_DURABILITY_SOFT;
+        }
+    } ack_checker;
+    order_source_t order_source;
+    fifo_enforcer_source_t fifo_source;
+
+    /* A batch of one keeps its client's order token. */
+    order_token_t first_token = order_source.check_in("unittest::run_write_batch_test(clustering_query.cc)");
+    master_write_batch_t<dummy_protocol_t> batch(&ack_checker, make_write("a", "1"),
+                                                 first_token, fifo_source.enter_write());
+    EXPECT_EQ(first_token.tag(), batch.order_token.tag());
+
+    /* Merged writes come from different clients, so there's no one order to
+    check the batch against. */
+    size_t index;
+    ASSERT_TRUE(batch.try_join(make_write("b", "2"), &index));
+    EXPECT_EQ(1u, index);
+    EXPECT_EQ(order_token_t::ignore.tag(), batch.order_token.tag());
+    dummy_protocol_t::write_t two_keys = make_write("c", "3");
+    two_keys.values["d"] = "4";
+    ASSERT_TRUE(batch.try_join(two_keys, &index));
+    EXPECT_EQ(2u, index);
+
+    /* A second write to a key in the batch has to wait for the next batch. */
+    EXPECT_FALSE(batch.try_join(make_write("a", "5"), &index));
+    EXPECT_EQ(3u, batch.num_members);
+    EXPECT_EQ(4u, batch.write.values.size());
+
+    dummy_protocol_t::write_response_t response;
+    EXPECT_FALSE(batch.try_get_response(0, &response));
+
+    /* Each member gets back only the old values of its own keys. */
+    dummy_protocol_t::write_response_t merged_response;
+    merged_response.old_values["a"] = "w";
+    merged_response.old_values["b"] = "x";
+    merged_response.old_values["c"] = "y";
+    merged_response.old_values["d"] = "z";
+    batch.callback.on_response(peer_id_t(generate_uuid()), merged_response);
+
+    ASSERT_TRUE(batch.try_get_response(0, &response));
+    EXPECT_EQ(1u, response.old_values.size());
+    EXPECT_EQ("w", response.old_values["a"]);
+    ASSERT_TRUE(batch.try_get_response(1, &response));
+    EXPECT_EQ(1u, response.old_values.size());
+    EXPECT_EQ("x", response.old_values["b"]);
+    ASSERT_TRUE(batch.try_get_response(2, &response));
+    EXPECT_EQ(2u, response.old_values.size());
+    EXPECT_EQ("y", response.old_values["c"]);
+    EXPECT_EQ("z", response.old_values["d"]);
+
+    /* Batches stop taking writes once they're full. */
+    master_write_batch_t<dummy_protocol_t> full_batch(&ack_checker, make_write("k0", "v"),
+                                                      order_source.check_in("unittest::run_write_batch_test(clustering_query.cc)"),
+                                                      fifo_source.enter_write());
+    for (size_t i = 1; i < master_write_batch_t<dummy_protocol_t>::MAX_COALESCED_WRITES; ++i) {
+        ASSERT_TRUE(full_batch.try_join(make_write(strprintf("k%zu", i), "v"), &index));
+        EXPECT_EQ(i, index);
+    }
+    EXPECT_FALSE(full_batch.try_join(make_write("last", "v"), &index));
+}
+
+TEST(ClusteringQuery, WriteBatch) {
+    unittest::run_in_thread_pool(&run_write_batch_test);
+}
+
+/* The `CoalescedWrites` test sends writes to different keys from several
+clients at once, and checks that the master merged some of them into one
+broadcaster write and that each client still got its own response. */
+
+static void write_from_client(master_access_t<dummy_protocol_t> *master_access,
+                              const std::string &key, const std::string &value,
+                              dummy_protocol_t::write_response_t *response_out,
+                              int *outstanding, cond_t *done) {
+    order_source_t order_source;
+    fifo_enforcer_sink_t::exit_write_t write_token;
+    master_access->new_write_token(&write_token);
+    cond_t non_interruptor;
+    master_access->write(make_write(key, value), response_out,
+                         order_source.check_in("unittest::write_from_client(clustering_query.cc)"),
+                         &write_token,
+                         &non_interruptor);
+    if (--*outstanding == 0) {
+        done->pulse();
+    }
+}
+
+static void run_coalesced_writes_test() {
+    order_source_t order_source;
+
+    /* Set up a cluster so mailboxes can be created */
+    simple_mailbox_cluster_t cluster;
+
+    /* Set up branch history tracker */
+    in_memory_branch_history_manager_t<dummy_protocol_t> branch_history_manager;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    /* Set up a branch */
+    test_store_t<dummy_protocol_t> initial_store(&io_backender, &order_source, static_cast<dummy_protocol_t::context_t *>(NULL));
+    cond_t interruptor;
+    broadcaster_t<dummy_protocol_t> broadcaster(cluster.get_mailbox_manager(),
+                                                &branch_history_manager,
+                                                &initial_store.store,
+                                                &get_global_perfmon_collection(),
+                                                &order_source,
+                                                &interruptor);
+
+    watchable_variable_t<boost::optional<broadcaster_business_card_t<dummy_protocol_t> > > broadcaster_metadata_controller(
+        boost::optional<broadcaster_business_card_t<dummy_protocol_t> >(broadcaster.get_business_card()));
+
+    listener_t<dummy_protocol_t> initial_listener(
+        base_path_t("."),
+        &io_backender,
+        cluster.get_mailbox_manager(),
+        broadcaster_metadata_controller.get_watchable()->subview(&wrap_in_optional),
+        &branch_history_manager,
+        &broadcaster,
+        &get_global_perfmon_collection(),
+        &interruptor,
+        &order_source);
+
+    replier_t<dummy_protocol_t> initial_replier(&initial_listener, cluster.get_mailbox_manager(), &branch_history_manager);
+
+    /* Set up a master */
+    class : public ack_checker_t {
+    public:
+        bool is_acceptable_ack_set(const std::set<peer_id_t> &set) {
+            return set.size() >= 1;
+        }
+        write_durability_t get_write_durability(const peer_id_t&) const {
+            return WRITE_DURABILITY_SOFT;
+        }
+    } ack_checker;
+    master_t<dummy_protocol_t> master(cluster.get_mailbox_manager(), &ack_checker, mock::a_thru_z_region(), &broadcaster);
+
+    /* Set up a master access for each client */
+    const int num_clients = 8;
+    watchable_variable_t<boost::optional<boost::optional<master_business_card_t<dummy_protocol_t> > > > master_directory_view(
+        boost::make_optional(boost::make_optional(master.get_business_card())));
+    cond_t non_interruptor;
+    boost::ptr_vector<master_access_t<dummy_protocol_t> > master_accesses;
+    for (int i = 0; i < num_clients; ++i) {
+        master_accesses.push_back(new master_access_t<dummy_protocol_t>(
+            cluster.get_mailbox_manager(),
+            master_directory_view.get_watchable(),
+            &non_interruptor));
+    }
+
+    /* Whether writes that arrive together get merged depends on scheduling, so
+    keep sending rounds of them until some are. */
+    bool merged = false;
+    for (int round = 0; round < 50 && !merged; ++round) {
+        std::vector<dummy_protocol_t::write_response_t> responses(num_clients);
+        int outstanding = num_clients;
+        cond_t done;
+        for (int i = 0; i < num_clients; ++i) {
+            coro_t::spawn_sometime(boost::bind(&write_from_client, &master_accesses[i],
+                                               std::string(1, 'a' + i), strprintf("%d", round),
+                                               &responses[i], &outstanding, &done));
+        }
+        done.wait_lazily_unordered();
+
+        std::set<state_timestamp_t> timestamps;
+        for (int i = 0; i < num_clients; ++i) {
+            std::string key(1, 'a' + i);
+            EXPECT_EQ(1u, responses[i].old_values.size());
+            EXPECT_EQ(round == 0 ? "" : strprintf("%d", round - 1), responses[i].old_values[key]);
+            EXPECT_EQ(strprintf("%d", round), initial_store.store.values[key]);
+            timestamps.insert(initial_store.store.timestamps[key]);
+        }
+        /* Keys written by one broadcaster write share its timestamp. */
+        merged = timestamps.size() < static_cast<size_t>(num_clients);
+    }
+    EXPECT_TRUE(merged);
+}
+
+TEST(ClusteringQuery, CoalescedWrites) {
+    unittest::run_in_thread_pool(&run_coalesced_writes_test);
+}
+
+}   /* namespace unittest */
@@ -63,6 +63,53 @@ TEST(ContextSwitchingTest, SwitchToContextRepeatedly) {
     original_context = NULL;
 }
 
+static void __attribute__((noinline)) use_deep_stack(void) {
+    volatile char buffer[256 * 1024];
+    for (size_t i = 0; i < sizeof(buffer); i += 1024) {
+        buffer[i] = 1;
+    }
+    context_switch(artificial_stack_1_context, original_context);
+}
+
+static void free_stack_test(void) {
+    int live = 42;
+    use_deep_stack();
+    context_switch(artificial_stack_1_context, original_context);
+    context_switch(artificial_stack_1_context, original_context);
+    /* Freeing the unused part of the stack must not touch the used part. */
+    test_int = live;
+    context_switch(artificial_stack_1_context, original_context);
+}
+
+TEST(ContextSwitchingTest, FreeUnusedStackSpace) {
+    scoped_ptr_t<context_ref_t> orig_context_local(new context_ref_t);
+    original_context = orig_context_local.get();
+    test_int = 0;
+    {
+        artificial_stack_t a(&free_stack_test, 1024*1024);
+        artificial_stack_1_context = &a.context;
+
+        /* Nothing below `use_deep_stack()`'s frame can be freed while it's
+        running. */
+        context_switch(original_context, artificial_stack_1_context);
+        EXPECT_GE(a.high_water_mark(), 256 * 1024u);
+        context_switch(original_context, artificial_stack_1_context);
+
+        /* The high-water mark stays put until the stack is freed. */
+        EXPECT_GE(a.high_water_mark(), 256 * 1024u);
+        a.free_unused_space();
+
+        /* The deep part of the stack is back with the OS now. */
+        context_switch(original_context, artificial_stack_1_context);
+        EXPECT_LT(a.high_water_mark(), 64 * 1024u);
+        a.free_unused_space();
+
+        context_switch(original_context, artificial_stack_1_context);
+        EXPECT_EQ(42, test_int);
+    }
+    original_context = NULL;
+}
+
 static void first_switch(void) {
     test_int++;
     context_switch(artificial_stack_1_context, artificial_stack_2_context);
@@ -1,8 +1,15 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <sys/resource.h>
+
+#include <algorithm>
 
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_view.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/response.hpp"
 #include "unittest/gtest.hpp"
+#include "utils.hpp"
 
 
 namespace unittest {
@@ -62,6 +69,215 @@ TEST(DatumTest, NumericSerialization) {
     test_datum_serialization(make_counted<ql::datum_t>(std::move(vec)));
 }
 
+TEST(DatumTest, ObjectFieldOrder) {
+    const char *keys[] = { "m", "b", "zz", "a", "", "mm", "z" };
+    ql::datum_ptr_t obj(ql::datum_t::R_OBJECT);
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        bool clobbered = obj.add(keys[i], make_counted<const ql::datum_t>(static_cast<double>(i)));
+        ASSERT_FALSE(clobbered);
+    }
+    ASSERT_TRUE(obj.add("zz", make_counted<const ql::datum_t>(100.0), ql::CLOBBER));
+    ASSERT_TRUE(obj.add("a", make_counted<const ql::datum_t>(200.0), ql::NOCLOBBER));
+    ASSERT_TRUE(obj.delete_field("mm"));
+    ASSERT_FALSE(obj.delete_field("mm"));
+
+    const ql::datum_object_t &fields = obj->as_object();
+    ASSERT_EQ(6u, fields.size());
+    for (auto it = fields.begin(); it + 1 != fields.end(); ++it) {
+        ASSERT_LT(it->first, (it + 1)->first);
+    }
+    ASSERT_EQ(100.0, obj->get("zz")->as_num());
+    ASSERT_EQ(3.0, obj->get("a")->as_num());
+    ASSERT_FALSE(obj->get("mm", ql::NOTHROW).has());
+
+    counted_t<const ql::datum_t> datum = obj.to_counted();
+    test_datum_serialization(datum);
+
+    std::map<std::string, counted_t<const ql::datum_t> > map;
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        map.insert(*it);
+    }
+    ASSERT_EQ(*datum, ql::datum_t(std::move(map)));
+}
+
+TEST(DatumTest, IndexedSerializationAndViews) {
+    scoped_cJSON_t json(cJSON_Parse(
+        "{\"id\": 1, \"name\": \"x\", \"tags\": [\"a\", {\"b\": null}],"
+        " \"nested\": {\"z\": -2.5, \"y\": true}, \"\": 7}"));
+    ASSERT_TRUE(json.get() != NULL);
+    counted_t<const ql::datum_t> datum = make_counted<const ql::datum_t>(json);
+
+    write_message_t wm;
+    ql::serialize_indexed(&wm, datum);
+    string_stream_t write_stream;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    std::string bytes = write_stream.str();
+    ASSERT_EQ(ql::indexed_serialized_size(datum), bytes.size());
+
+    // Both the view and the ordinary deserializer read the indexed format.
+    ql::datum_view_t view(bytes.data(), bytes.size());
+    ASSERT_EQ(*datum, *view.materialize());
+    string_read_stream_t read_stream(std::move(bytes), 0);
+    counted_t<const ql::datum_t> deserialized;
+    ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &deserialized));
+    ASSERT_EQ(*datum, *deserialized);
+
+    std::string fields[] = { "id", "name", "tags", "nested", "", "missing", "zzz" };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        counted_t<const ql::datum_t> expected = datum->get(fields[i], ql::NOTHROW);
+        ql::datum_view_t field = view.get_field(fields[i]);
+        ASSERT_EQ(expected.has(), field.has());
+        if (expected.has()) {
+            ASSERT_EQ(*expected, *field.materialize());
+            ASSERT_EQ(expected->get_type(), field.get_type());
+        }
+    }
+    ql::datum_view_t nested = view.get_field("nested");
+    ASSERT_EQ(-2.5, nested.get_field("z").materialize()->as_num());
+    ASSERT_FALSE(view.get_field("name").get_field("z").has());
+
+    // Comparisons between views agree with `datum_t::cmp`.
+    ASSERT_EQ(0, view.get_field("id").cmp(view.get_field("id")));
+    ASSERT_GT(0, view.get_field("id").cmp(view.get_field("")));
+    ASSERT_LT(0, view.get_field("name").cmp(view.get_field("id")));
+    ASSERT_LT(0, view.get_field("nested").cmp(view.get_field("tags")));
+
+    // So do sindex keys.
+    store_key_t primary_key(datum->get("id")->print_primary());
+    std::string key_fields[] = { "id", "name", "tags", "" };
+    for (size_t i = 0; i < sizeof(key_fields) / sizeof(key_fields[0]); ++i) {
+        ASSERT_EQ(datum->get(key_fields[i])->print_secondary(primary_key),
+                  view.get_field(key_fields[i]).print_secondary(primary_key));
+    }
+}
+
+TEST(DatumTest, CmpKeyOrder) {
+    const char *json_values[] = {
+        "null", "false", "true", "-1e300", "-1", "-0", "0", "0.5", "1", "1e300",
+        "\"\"", "\"a\"", "\"ab\"", "\"b\"", "[]", "[null]", "[1]", "[1, 2]",
+        "[[1], 2]", "[[1, 2]]", "[\"a\"]", "{}", "{\"a\": 1}", "{\"a\": 1, \"b\": 0}",
+        "{\"a\": 2}", "{\"b\": null}", "{\"a\": {\"b\": []}}"
+    };
+    std::vector<counted_t<const ql::datum_t> > datums;
+    for (size_t i = 0; i < sizeof(json_values) / sizeof(json_values[0]); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(json_values[i]));
+        ASSERT_TRUE(json.get() != NULL) << json_values[i];
+        datums.push_back(make_counted<const ql::datum_t>(json));
+    }
+    datums.push_back(make_counted<const ql::datum_t>(std::string("a\0", 2)));
+    datums.push_back(make_counted<const ql::datum_t>(std::string("a\0b", 3)));
+    datums.push_back(ql::pseudo::make_time(0.0, "+00:00"));
+    datums.push_back(ql::pseudo::make_time(0.0, "+01:00"));
+    datums.push_back(ql::pseudo::make_time(-1.5, "+00:00"));
 
+    for (size_t i = 0; i < datums.size(); ++i) {
+        std::string lhs;
+        datums[i]->append_cmp_key(&lhs);
+        for (size_t j = 0; j < datums.size(); ++j) {
+            std::string rhs;
+            datums[j]->append_cmp_key(&rhs);
+            int expected = datums[i]->cmp(*datums[j]);
+            int actual = lhs.compare(rhs);
+            ASSERT_EQ(expected < 0, actual < 0)
+                << datums[i]->print() << " vs " << datums[j]->print();
+            ASSERT_EQ(expected == 0, actual == 0)
+                << datums[i]->print() << " vs " << datums[j]->print();
+        }
+    }
+}
+
+
+class string_response_writer_t : public ql::response_writer_t {
+public:
+    void write(const char *data, size_t size) { str.append(data, size); }
+    std::string str;
+};
+
+TEST(DatumTest, ResponseWireFormat) {
+    scoped_cJSON_t json(cJSON_Parse(
+        "{\"id\": 1, \"name\": \"x\", \"tags\": [\"a\", {\"b\": null}],"
+        " \"nested\": {\"z\": -2.5, \"y\": true}, \"\": 7}"));
+    ASSERT_TRUE(json.get() != NULL);
+    std::vector<counted_t<const ql::datum_t> > data;
+    data.push_back(make_counted<const ql::datum_t>(json));
+    data.push_back(make_counted<const ql::datum_t>(ql::datum_t::R_NULL));
+    data.push_back(make_counted<const ql::datum_t>(std::string(20000, 'x')));
+    std::vector<counted_t<const ql::datum_t> > big;
+    for (int i = 0; i < 5000; ++i) {
+        big.push_back(make_counted<const ql::datum_t>(i * 0.5));
+    }
+    data.push_back(make_counted<const ql::datum_t>(std::move(big)));
+
+    ql::response_t response;
+    Response expected;
+    response.mutable_pb()->set_token(12);
+    expected.set_token(12);
+    response.mutable_pb()->set_type(Response::SUCCESS_SEQUENCE);
+    expected.set_type(Response::SUCCESS_SEQUENCE);
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        response.add_datum(*it);
+        (*it)->write_to_protobuf(expected.add_response());
+    }
+
+    string_response_writer_t writer;
+    response.write(&writer);
+    ASSERT_EQ(static_cast<size_t>(expected.ByteSize()), response.serialized_size());
+    ASSERT_EQ(expected.SerializeAsString(), writer.str);
+}
+
+// Stands in for the connection: it takes the bytes and throws them away,
+// keeping track of the biggest piece it was handed.
+class discarding_response_writer_t : public ql::response_writer_t {
+public:
+    discarding_response_writer_t() : bytes(0), max_write(0) { }
+    void write(const char *, size_t size) {
+        bytes += size;
+        max_write = std::max(max_write, size);
+    }
+    size_t bytes;
+    size_t max_write;
+};
+
+int64_t peak_rss_kb() {
+    struct rusage usage;
+    int res = getrusage(RUSAGE_SELF, &usage);
+    guarantee_err(res == 0, "getrusage failed");
+    return usage.ru_maxrss;
+}
+
+// A response of about 100 MB is written a few kilobytes at a time, without
+// ever being put together in memory.  Every row is the same datum, so the
+// test itself doesn't need the memory either.
+TEST(DatumTest, LargeResponseMemory) {
+    std::string row_json = "{";
+    for (int i = 0; i < 100; ++i) {
+        row_json += strprintf("%s\"field%d\": \"%s\"", i == 0 ? "" : ", ",
+                              i, std::string(100, 'a' + i % 26).c_str());
+    }
+    row_json += "}";
+    scoped_cJSON_t json(cJSON_Parse(row_json.c_str()));
+    counted_t<const ql::datum_t> row = make_counted<const ql::datum_t>(json);
+
+    ql::response_t response;
+    response.mutable_pb()->set_token(1);
+    response.mutable_pb()->set_type(Response::SUCCESS_SEQUENCE);
+    const size_t target_size = 100 * MEGABYTE;
+    while (response.serialized_size() < target_size) {
+        for (int i = 0; i < 1000; ++i) {
+            response.add_datum(row);
+        }
+    }
+
+    const int64_t rss_before = peak_rss_kb();
+    discarding_response_writer_t writer;
+    response.write(&writer);
+    const int64_t rss_growth = peak_rss_kb() - rss_before;
+
+    ASSERT_EQ(response.serialized_size(), writer.bytes);
+    // The rows' strings are small, so everything goes through the 8 KB buffer.
+    EXPECT_LE(writer.max_write, 8 * KILOBYTE);
+    // Serializing the whole response into one buffer would take 100 MB more.
+    EXPECT_LT(rss_growth, 16 * 1024);
+}
 
 }  // namespace unittest
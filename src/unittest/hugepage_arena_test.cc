@@ -0,0 +1,116 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "containers/hugepage_arena.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const int BLOCKS = 2000;
+
+// The size of a 4 KB block with its serializer header.
+const size_t BLOCK_SIZE = 4096 + 12;
+
+TEST(HugepageArenaTest, AllocatesAlignedBlocks) {
+    set_hugepage_arena_enabled(true);
+    const int64_t blocks = get_hugepage_arena_stats().blocks;
+
+    std::vector<char *> ptrs;
+    for (int i = 0; i < BLOCKS; ++i) {
+        char *p = static_cast<char *>(hugepage_arena_malloc(BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p) % DEVICE_BLOCK_SIZE);
+        memset(p, i % 256, BLOCK_SIZE);
+        ptrs.push_back(p);
+    }
+#ifndef VALGRIND
+    EXPECT_EQ(blocks + BLOCKS, get_hugepage_arena_stats().blocks);
+#endif
+
+    for (int i = 0; i < BLOCKS; ++i) {
+        for (size_t k = 0; k < BLOCK_SIZE; ++k) {
+            ASSERT_EQ(static_cast<char>(i % 256), ptrs[i][k]);
+        }
+        hugepage_arena_free(ptrs[i]);
+    }
+    EXPECT_EQ(blocks, get_hugepage_arena_stats().blocks);
+    set_hugepage_arena_enabled(false);
+}
+
+TEST(HugepageArenaTest, ReusesFreedBlocks) {
+    set_hugepage_arena_enabled(true);
+    std::vector<void *> ptrs;
+    for (int i = 0; i < BLOCKS; ++i) {
+        ptrs.push_back(hugepage_arena_malloc(BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+    }
+    const hugepage_arena_stats_t stats = get_hugepage_arena_stats();
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < BLOCKS; ++i) {
+            hugepage_arena_free(ptrs[i]);
+        }
+        for (int i = 0; i < BLOCKS; ++i) {
+            ptrs[i] = hugepage_arena_malloc(BLOCK_SIZE, DEVICE_BLOCK_SIZE);
+        }
+    }
+    EXPECT_EQ(stats.hugetlb_chunks, get_hugepage_arena_stats().hugetlb_chunks);
+    EXPECT_EQ(stats.transparent_chunks, get_hugepage_arena_stats().transparent_chunks);
+    for (int i = 0; i < BLOCKS; ++i) {
+        hugepage_arena_free(ptrs[i]);
+    }
+    set_hugepage_arena_enabled(false);
+}
+
+TEST(HugepageArenaTest, FreesOtherMemory) {
+    set_hugepage_arena_enabled(true);
+    // Neither of these came from the arena.
+    hugepage_arena_free(malloc(BLOCK_SIZE));
+    hugepage_arena_free(malloc(HUGEPAGE_ARENA_CHUNK_SIZE * 2));
+    hugepage_arena_free(NULL);
+    set_hugepage_arena_enabled(false);
+}
+
+void free_blocks_on(threadnum_t thread, std::vector<void *> *ptrs) {
+    on_thread_t thread_switcher(thread);
+    for (size_t i = 0; i < ptrs->size(); ++i) {
+        hugepage_arena_free((*ptrs)[i]);
+    }
+}
+
+void run_cross_thread_test() {
+    std::vector<void *> ptrs;
+    for (int i = 0; i < BLOCKS; ++i) {
+        ptrs.push_back(hugepage_arena_malloc(BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+    }
+    const hugepage_arena_stats_t stats = get_hugepage_arena_stats();
+
+    free_blocks_on(threadnum_t(1), &ptrs);
+#ifndef VALGRIND
+    EXPECT_EQ(stats.blocks - BLOCKS, get_hugepage_arena_stats().blocks);
+#endif
+
+    // The blocks come back to the thread that allocated them.
+    for (int i = 0; i < BLOCKS; ++i) {
+        ptrs[i] = hugepage_arena_malloc(BLOCK_SIZE, DEVICE_BLOCK_SIZE);
+    }
+    EXPECT_EQ(stats.hugetlb_chunks, get_hugepage_arena_stats().hugetlb_chunks);
+    EXPECT_EQ(stats.transparent_chunks, get_hugepage_arena_stats().transparent_chunks);
+    for (int i = 0; i < BLOCKS; ++i) {
+        hugepage_arena_free(ptrs[i]);
+    }
+}
+
+TEST(HugepageArenaTest, CrossThreadFrees) {
+    set_hugepage_arena_enabled(true);
+    run_in_thread_pool(&run_cross_thread_test, 2);
+    set_hugepage_arena_enabled(false);
+}
+
+}  // namespace unittest
@@ -0,0 +1,59 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "concurrency/pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+const int PING_PONG_ROUND_TRIPS = 20000;
+
+// Bounces a coroutine between thread 0 and a thread of its own, so with more
+// than one of them running, thread 0 gets messages from several threads at once.
+void ping_pong(int *round_trips, int i) {
+    on_thread_t home(threadnum_t(i + 1));
+    for (int j = 0; j < PING_PONG_ROUND_TRIPS; ++j) {
+        {
+            on_thread_t hop(threadnum_t(0));
+            ++*round_trips;
+        }
+        ASSERT_EQ(i + 1, get_thread_id().threadnum);
+    }
+}
+
+void run_ping_pong_test(int n_pingers) {
+    int round_trips = 0;
+    ticks_t start = get_ticks();
+    pmap(n_pingers, boost::bind(&ping_pong, &round_trips, _1));
+    double secs = ticks_to_secs(get_ticks() - start);
+
+    EXPECT_EQ(n_pingers * PING_PONG_ROUND_TRIPS, round_trips);
+    printf("%d thread(s) pinging: %.2f us per round trip\n",
+           n_pingers, secs * MILLION / PING_PONG_ROUND_TRIPS);
+}
+
+TEST(MessageHubTest, PingPong) {
+    run_in_thread_pool(boost::bind(&run_ping_pong_test, 1), 2);
+}
+
+TEST(MessageHubTest, ManyToOnePingPong) {
+    run_in_thread_pool(boost::bind(&run_ping_pong_test, 7), 8);
+}
+
+// With busy-polling, threads find each other's messages without being woken
+// up, unless they have given up spinning.
+TEST(MessageHubTest, BusyPollPingPong) {
+    set_busy_poll_usecs(50);
+    run_in_thread_pool(boost::bind(&run_ping_pong_test, 1), 2);
+    run_in_thread_pool(boost::bind(&run_ping_pong_test, 7), 8);
+    set_busy_poll_usecs(0);
+}
+
+}  // namespace unittest
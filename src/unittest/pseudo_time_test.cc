@@ -0,0 +1,103 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+// Reports errors the same way `rcheck_datum` does.
+class datum_rcheckable_t : public ql::rcheckable_t {
+public:
+    void runtime_fail(ql::base_exc_t::type_t type,
+                      const char *test, const char *file, int line,
+                      std::string msg) const {
+        ql::runtime_fail(type, test, file, line, msg);
+    }
+};
+
+std::string iso8601_round_trip(const std::string &s,
+                               const std::string &default_tz = "") {
+    datum_rcheckable_t target;
+    return ql::pseudo::time_to_iso8601(
+        ql::pseudo::iso8601_to_time(s, default_tz, &target));
+}
+
+TEST(PseudoTimeTest, ISO8601Formats) {
+    const char *dates[] = { "2013", "2013-01", "2013-01-01", "20130101",
+                            "2013-001", "2013001" };
+    const char *times[] = { "13", "13:00", "1300", "13:00:00", "13:00:00.000000",
+                            "130000.000000" };
+    const char *tzs[] = { "Z", "+00", "+0000", "+00:00" };
+    for (size_t d = 0; d < sizeof(dates) / sizeof(dates[0]); ++d) {
+        for (size_t t = 0; t < sizeof(times) / sizeof(times[0]); ++t) {
+            for (size_t z = 0; z < sizeof(tzs) / sizeof(tzs[0]); ++z) {
+                std::string s = std::string(dates[d]) + "T" + times[t] + tzs[z];
+                EXPECT_EQ("2013-01-01T13:00:00+00:00", iso8601_round_trip(s)) << s;
+            }
+        }
+    }
+
+    EXPECT_EQ("2013-07-30T20:56:05-07:00",
+              iso8601_round_trip("2013-07-30T20:56:05", "-07"));
+    EXPECT_EQ("2012-12-31T00:00:00+05:30", iso8601_round_trip("2012-366T00+0530"));
+    EXPECT_EQ("1969-12-31T23:59:59.500+00:00",
+              iso8601_round_trip("1969-12-31T23:59:59.5Z"));
+    // Digits past milliseconds are truncated.
+    EXPECT_EQ("2012-02-29T23:59:59.999+00:00",
+              iso8601_round_trip("2012-02-29T23:59:59.9999Z"));
+}
+
+TEST(PseudoTimeTest, ISO8601Values) {
+    datum_rcheckable_t target;
+    counted_t<const ql::datum_t> t =
+        ql::pseudo::iso8601_to_time("2013-07-30T20:56:05-07:00", "", &target);
+    EXPECT_EQ(1375242965, ql::pseudo::time_to_epoch_time(t));
+    EXPECT_EQ("-07:00", ql::pseudo::time_tz(t)->as_str());
+
+    EXPECT_EQ("2013-07-29T18:21:36.680-07:00",
+              ql::pseudo::time_to_iso8601(
+                  ql::pseudo::make_time(1375147296.68, "-07:00")));
+    EXPECT_THROW(ql::pseudo::time_to_iso8601(
+                     ql::pseudo::make_time(253430000000, "+00:00")),
+                 ql::datum_exc_t);
+}
+
+TEST(PseudoTimeTest, ISO8601Errors) {
+    const char *bad[] = {
+        "201301T13Z", "2013-0101T13Z", "2a13T13Z", "2013+01T13Z", "2013-01-01.1T13Z",
+        "2013Ta3Z", "2013T13:0000Z", "2013T13:000Z", "2013T13:00.00Z",
+        "2013T130000.00000000aZ",
+        "2013T13X", "2013T13-7", "2013T13-07:-1", "2013T13+07+01", "2013T13PST",
+        "2013T13UTC", "2013T13Z+00", "2013T13-00:00",
+        "2013-02-29T00Z", "2013-366T00Z", "2013-13-01T00Z", "2013T25Z",
+        "2013-W01T00Z", "2013-07-30T20:56:05"
+    };
+    datum_rcheckable_t target;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        EXPECT_THROW(ql::pseudo::iso8601_to_time(bad[i], "", &target),
+                     ql::datum_exc_t) << bad[i];
+    }
+    EXPECT_THROW(ql::pseudo::iso8601_to_time("2013", "PST", &target),
+                 ql::datum_exc_t);
+}
+
+TEST(PseudoTimeTest, PackedTime) {
+    int64_t epoch_ms[] = { 0, 1, -1, 1444, -1500, 1375242965000LL,
+                            -62167219200000LL, 253402300799999LL };
+    int tz_minutes[] = { 0, 1, -1, 330, -420, 1499, -1499 };
+    for (size_t i = 0; i < sizeof(epoch_ms) / sizeof(epoch_ms[0]); ++i) {
+        for (size_t j = 0; j < sizeof(tz_minutes) / sizeof(tz_minutes[0]); ++j) {
+            ql::pseudo::packed_time_t t(epoch_ms[i], tz_minutes[j]);
+            EXPECT_EQ(epoch_ms[i], t.epoch_ms());
+            EXPECT_EQ(tz_minutes[j], t.tz_minutes());
+        }
+    }
+
+    ql::pseudo::packed_time_t t;
+    ASSERT_TRUE(ql::pseudo::packed_time_t::pack(1.444, -420, &t));
+    EXPECT_EQ(1444, t.epoch_ms());
+    EXPECT_EQ(-420, t.tz_minutes());
+    EXPECT_FALSE(ql::pseudo::packed_time_t::pack(1e300, 0, &t));
+}
+
+}  // namespace unittest
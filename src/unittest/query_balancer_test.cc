@@ -0,0 +1,56 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/query_balancer.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_picks_idle_thread_test() {
+    query_balancer_t balancer(true);
+    on_thread_t thread_switcher((threadnum_t(1)));
+
+    // One query short of the threshold, queries stay where they are.
+    scoped_array_t<scoped_ptr_t<query_balancer_t::running_query_t> >
+        running(QUERY_BALANCING_THRESHOLD);
+    for (int i = 0; i < QUERY_BALANCING_THRESHOLD - 1; ++i) {
+        running[i].init(new query_balancer_t::running_query_t(&balancer, false));
+        EXPECT_EQ(1, balancer.pick_thread().threadnum);
+    }
+
+    // Then they go to the least busy thread.
+    running[QUERY_BALANCING_THRESHOLD - 1].init(
+        new query_balancer_t::running_query_t(&balancer, false));
+    {
+        on_thread_t busy_thread((threadnum_t(0)));
+        query_balancer_t::running_query_t other(&balancer, true);
+        on_thread_t back((threadnum_t(1)));
+        EXPECT_EQ(2, balancer.pick_thread().threadnum);
+    }
+
+    // And come back once it's quiet again.
+    running[0].reset();
+    EXPECT_EQ(1, balancer.pick_thread().threadnum);
+}
+
+TEST(QueryBalancerTest, PicksIdleThread) {
+    run_in_thread_pool(&run_picks_idle_thread_test, 3);
+}
+
+void run_disabled_test() {
+    query_balancer_t balancer(false);
+    query_balancer_t::running_query_t a(&balancer, false), b(&balancer, false),
+        c(&balancer, false);
+    EXPECT_EQ(get_thread_id().threadnum, balancer.pick_thread().threadnum);
+}
+
+TEST(QueryBalancerTest, Disabled) {
+    run_in_thread_pool(&run_disabled_test, 2);
+}
+
+}  // namespace unittest
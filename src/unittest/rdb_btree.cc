@@ -11,6 +11,7 @@
 #include "buffer_cache/mirrored/config.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/env.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/sym.hpp"
@@ -25,49 +26,52 @@
 
 namespace unittest {
 
-void insert_rows(int start, int finish, btree_store_t<rdb_protocol_t> *store) {
-    guarantee(start <= finish);
-    for (int i = start; i < finish; ++i) {
-        cond_t dummy_interruptor;
-        scoped_ptr_t<transaction_t> txn;
-        scoped_ptr_t<real_superblock_t> superblock;
-        write_token_pair_t token_pair;
-        store->new_write_token_pair(&token_pair);
-        store->acquire_superblock_for_write(
-            rwi_write, repli_timestamp_t::invalid,
-            1, WRITE_DURABILITY_SOFT,
-            &token_pair, &txn, &superblock, &dummy_interruptor);
-        block_id_t sindex_block_id = superblock->get_sindex_block_id();
+void insert_row(counted_t<const ql::datum_t> row, btree_store_t<rdb_protocol_t> *store) {
+    cond_t dummy_interruptor;
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        rwi_write, repli_timestamp_t::invalid,
+        1, WRITE_DURABILITY_SOFT,
+        &token_pair, &txn, &superblock, &dummy_interruptor);
+    block_id_t sindex_block_id = superblock->get_sindex_block_id();
 
-        std::string data = strprintf("{\"id\" : %d, \"sid\" : %d}", i, i * i);
-        point_write_response_t response;
+    point_write_response_t response;
 
-        store_key_t pk(make_counted<const ql::datum_t>(double(i))->print_primary());
-        rdb_modification_report_t mod_report(pk);
-        rdb_set(pk,
-                make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))),
-                false, store->btree.get(), repli_timestamp_t::invalid, txn.get(),
-                superblock.get(), &response, &mod_report.info);
+    store_key_t pk(row->get("id")->print_primary());
+    rdb_modification_report_t mod_report(pk);
+    rdb_set(pk, row, false, store->btree.get(), repli_timestamp_t::invalid, txn.get(),
+            superblock.get(), &response, &mod_report.info);
 
-        {
-            scoped_ptr_t<buf_lock_t> sindex_block;
-            store->acquire_sindex_block_for_write(
-                    &token_pair, txn.get(), &sindex_block,
-                    sindex_block_id, &dummy_interruptor);
+    {
+        scoped_ptr_t<buf_lock_t> sindex_block;
+        store->acquire_sindex_block_for_write(
+                &token_pair, txn.get(), &sindex_block,
+                sindex_block_id, &dummy_interruptor);
 
-            btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
-            store->aquire_post_constructed_sindex_superblocks_for_write(
-                     sindex_block.get(), txn.get(), &sindexes);
-            rdb_update_sindexes(sindexes, &mod_report, txn.get());
+        btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
+        store->aquire_post_constructed_sindex_superblocks_for_write(
+                 sindex_block.get(), txn.get(), &sindexes);
+        rdb_update_sindexes(sindexes, &mod_report, txn.get());
 
-            mutex_t::acq_t acq;
-            store->lock_sindex_queue(sindex_block.get(), &acq);
+        mutex_t::acq_t acq;
+        store->lock_sindex_queue(sindex_block.get(), &acq);
 
-            write_message_t wm;
-            wm << rdb_sindex_change_t(mod_report);
+        write_message_t wm;
+        wm << rdb_sindex_change_t(mod_report);
 
-            store->sindex_queue_push(wm, &acq);
-        }
+        store->sindex_queue_push(wm, &acq);
+    }
+}
+
+void insert_rows(int start, int finish, btree_store_t<rdb_protocol_t> *store) {
+    guarantee(start <= finish);
+    for (int i = start; i < finish; ++i) {
+        std::string data = strprintf("{\"id\" : %d, \"sid\" : %d}", i, i * i);
+        insert_row(make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))),
+                   store);
     }
 }
 
@@ -77,6 +81,14 @@ void insert_rows_and_pulse_when_done(int start, int finish,
     pulse_when_done->pulse();
 }
 
+ql::map_wire_func_t get_field_func(const std::string &field) {
+    const ql::sym_t one(1);
+    ql::protob_t<Term> twrap = ql::make_counted_term();
+    Term *arg = twrap.get();
+    N2(GET_FIELD, NVAR(one), NDATUM(field.c_str()));
+    return ql::map_wire_func_t(twrap, make_vector(one), get_backtrace(twrap));
+}
+
 std::string create_sindex(btree_store_t<rdb_protocol_t> *store) {
     cond_t dummy_interruptor;
     std::string sindex_id = uuid_to_str(generate_uuid());
@@ -90,13 +102,7 @@ std::string create_sindex(btree_store_t<rdb_protocol_t> *store) {
                                         1, WRITE_DURABILITY_SOFT,
                                         &token_pair, &txn, &super_block, &dummy_interruptor);
 
-    Term mapping;
-    const ql::sym_t one(1);
-    ql::protob_t<Term> twrap = ql::make_counted_term();
-    Term *arg = twrap.get();
-    N2(GET_FIELD, NVAR(one), NDATUM("sid"));
-
-    ql::map_wire_func_t m(twrap, make_vector(one), get_backtrace(twrap));
+    ql::map_wire_func_t m = get_field_func("sid");
     sindex_multi_bool_t multi_bool = SINGLE;
 
     write_message_t wm;
@@ -228,7 +234,8 @@ void _check_keys_are_present(btree_store_t<rdb_protocol_t> *store,
                 store_key_t(make_counted<const ql::datum_t>(ii)->print_primary()),
                 store_key_t(make_counted<const ql::datum_t>(ii)->print_primary())),
             txn.get(), sindex_sb.get(), NULL, rdb_protocol_details::transform_t(),
-            boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING, &res);
+            boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING,
+            rdb_protocol_t::MAX_RGET_CHUNK_SIZE, &res);
 
         rdb_protocol_t::rget_read_response_t::stream_t *stream
             = boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&res.result);
@@ -284,7 +291,8 @@ void _check_keys_are_NOT_present(btree_store_t<rdb_protocol_t> *store,
                 store_key_t(make_counted<const ql::datum_t>(ii)->print_primary()),
                 store_key_t(make_counted<const ql::datum_t>(ii)->print_primary())),
             txn.get(), sindex_sb.get(), NULL, rdb_protocol_details::transform_t(),
-            boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING, &res);
+            boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING,
+            rdb_protocol_t::MAX_RGET_CHUNK_SIZE, &res);
 
         rdb_protocol_t::rget_read_response_t::stream_t *stream
             = boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&res.result);
@@ -306,6 +314,44 @@ void check_keys_are_NOT_present(btree_store_t<rdb_protocol_t> *store,
     }
 }
 
+class fixed_progress_t : public traversal_progress_t {
+public:
+    fixed_progress_t(int _released, int _total) : released(_released), total(_total) { }
+    progress_completion_fraction_t guess_completion() const {
+        return progress_completion_fraction_t(released, total);
+    }
+private:
+    int released;
+    int total;
+};
+
+void check_sindex_progress(btree_store_t<rdb_protocol_t> *store) {
+    std::set<uuid_u> sindex_ids;
+    sindex_ids.insert(generate_uuid());
+    EXPECT_TRUE(store->get_sindex_progress(*sindex_ids.begin()).invalid());
+
+    fixed_progress_t progress(3, 4);
+    store->register_sindex_progress(sindex_ids, &progress);
+    progress_completion_fraction_t fraction = store->get_sindex_progress(*sindex_ids.begin());
+    EXPECT_EQ(3, fraction.estimate_of_released_nodes);
+    EXPECT_EQ(4, fraction.estimate_of_total_nodes);
+
+    // A second post construction of the same sindex overlaps the first, which
+    // finishing mustn't take the second's progress away.
+    fixed_progress_t later_progress(1, 4);
+    store->register_sindex_progress(sindex_ids, &later_progress);
+    fraction = store->get_sindex_progress(*sindex_ids.begin());
+    EXPECT_EQ(1, fraction.estimate_of_released_nodes);
+
+    store->deregister_sindex_progress(sindex_ids, &progress);
+    fraction = store->get_sindex_progress(*sindex_ids.begin());
+    EXPECT_EQ(1, fraction.estimate_of_released_nodes);
+    EXPECT_EQ(4, fraction.estimate_of_total_nodes);
+
+    store->deregister_sindex_progress(sindex_ids, &later_progress);
+    EXPECT_TRUE(store->get_sindex_progress(*sindex_ids.begin()).invalid());
+}
+
 void run_sindex_post_construction() {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -344,12 +390,145 @@ void run_sindex_post_construction() {
     background_inserts_done.wait();
 
     check_keys_are_present(&store, sindex_id);
+
+    check_sindex_progress(&store);
 }
 
 TEST(RDBBtree, SindexPostConstruct) {
     run_in_thread_pool(&run_sindex_post_construction);
 }
 
+class upsert_replacer_t : public btree_batched_replacer_t {
+public:
+    explicit upsert_replacer_t(const std::vector<counted_t<const ql::datum_t> > *_rows)
+        : rows(_rows) { }
+    counted_t<const ql::datum_t> replace(
+        const counted_t<const ql::datum_t> &, size_t index) const {
+        return (*rows)[index];
+    }
+    bool should_return_vals() const { return false; }
+private:
+    const std::vector<counted_t<const ql::datum_t> > *rows;
+};
+
+/* Writes rows `start` through `finish` in one batched replace, the way a
+ * batched insert would.  Each row is written twice, and the first version's
+ * `sid` (which is negative) should never make it into the sindex. */
+void batched_upsert_rows(int start, int finish, btree_store_t<rdb_protocol_t> *store) {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    std::vector<store_key_t> keys;
+    for (int i = start; i < finish; ++i) {
+        for (int pass = 0; pass < 2; ++pass) {
+            std::string data = strprintf("{\"id\" : %d, \"sid\" : %d}",
+                                         i, pass == 0 ? -1 - i : i * i);
+            rows.push_back(make_counted<ql::datum_t>(
+                               scoped_cJSON_t(cJSON_Parse(data.c_str()))));
+            keys.push_back(store_key_t(
+                               make_counted<const ql::datum_t>(double(i))->print_primary()));
+        }
+    }
+
+    cond_t dummy_interruptor;
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> real_superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        rwi_write, repli_timestamp_t::invalid,
+        1, WRITE_DURABILITY_SOFT,
+        &token_pair, &txn, &real_superblock, &dummy_interruptor);
+
+    rdb_modification_report_cb_t sindex_cb(
+        store, &token_pair, txn.get(),
+        real_superblock->get_sindex_block_id(),
+        auto_drainer_t::lock_t(&store->drainer));
+    upsert_replacer_t replacer(&rows);
+    const std::string pkey("id");
+    scoped_ptr_t<superblock_t> superblock(real_superblock.release());
+    rdb_batched_replace(
+        btree_info_t(store->btree.get(), repli_timestamp_t::invalid, txn.get(), &pkey),
+        &superblock, keys, &replacer, &sindex_cb);
+}
+
+size_t count_sindex_rows(btree_store_t<rdb_protocol_t> *store,
+                         std::string sindex_id, double value) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    scoped_ptr_t<real_superblock_t> sindex_sb;
+
+    bool sindex_exists = store->acquire_sindex_superblock_for_read(sindex_id,
+            super_block->get_sindex_block_id(), &token_pair,
+            txn.get(), &sindex_sb,
+            static_cast<std::vector<char>*>(NULL), &dummy_interruptor);
+    guarantee(sindex_exists);
+
+    rdb_protocol_t::rget_read_response_t res;
+    rdb_rget_slice(store->get_sindex_slice(sindex_id),
+        rdb_protocol_t::sindex_key_range(
+            store_key_t(make_counted<const ql::datum_t>(value)->print_primary()),
+            store_key_t(make_counted<const ql::datum_t>(value)->print_primary())),
+        txn.get(), sindex_sb.get(), NULL, rdb_protocol_details::transform_t(),
+        boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING,
+        rdb_protocol_t::MAX_RGET_CHUNK_SIZE, &res);
+
+    rdb_protocol_t::rget_read_response_t::stream_t *stream
+        = boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&res.result);
+    guarantee(stream != NULL);
+    return stream->size();
+}
+
+void run_sindex_batch_update_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    insert_rows(0, (TOTAL_KEYS_TO_INSERT * 9) / 10, &store);
+
+    std::string sindex_id = create_sindex(&store);
+    bring_sindexes_up_to_date(&store, sindex_id);
+
+    batched_upsert_rows((TOTAL_KEYS_TO_INSERT * 9) / 10, TOTAL_KEYS_TO_INSERT, &store);
+
+    check_keys_are_present(&store, sindex_id);
+    for (int i = (TOTAL_KEYS_TO_INSERT * 9) / 10; i < TOTAL_KEYS_TO_INSERT; ++i) {
+        ASSERT_EQ(0ul, count_sindex_rows(&store, sindex_id, -1 - i));
+    }
+}
+
+TEST(RDBBtree, SindexBatchUpdate) {
+    run_in_thread_pool(&run_sindex_batch_update_test);
+}
+
 void run_erase_range_test() {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -506,4 +685,221 @@ TEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     run_in_thread_pool(&run_sindex_interruption_via_store_delete);
 }
 
+counted_t<const ql::datum_t> parse_datum(const std::string &json) {
+    scoped_cJSON_t parsed(cJSON_Parse(json.c_str()));
+    guarantee(parsed.get() != NULL);
+    return make_counted<const ql::datum_t>(parsed.get());
+}
+
+/* The function a `pluck` or `without` on the selectors in `paths` compiles to
+ * when it isn't pushed down. */
+ql::map_wire_func_t projection_func(counted_t<const ql::datum_t> paths, bool without) {
+    const ql::sym_t one(1);
+    ql::protob_t<Term> twrap = ql::make_counted_term();
+    Term *body = twrap.get();
+    body->set_type(without ? Term::WITHOUT : Term::PLUCK);
+    ql::pb::set_var(body->add_args(), one);
+    for (size_t i = 0; i < paths->size(); ++i) {
+        paths->get(i)->write_to_protobuf(ql::pb::set_datum(body->add_args()));
+    }
+    return ql::map_wire_func_t(twrap, make_vector(one), get_backtrace(twrap));
+}
+
+/* Reads every row, through the primary index if `sindex_id` is empty and
+ * through the sindex on `sid` otherwise. */
+void read_all_rows(btree_store_t<rdb_protocol_t> *store, const std::string &sindex_id,
+                   const rdb_protocol_details::transform_t &transform,
+                   rdb_protocol_t::rget_read_response_t *res_out) {
+    cond_t dummy_interruptor;
+    ql::env_t ql_env(&dummy_interruptor);
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    if (sindex_id.empty()) {
+        rdb_rget_slice(store->btree.get(), key_range_t::universe(),
+            txn.get(), super_block.get(), &ql_env, transform,
+            boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING,
+            rdb_protocol_t::MAX_RGET_CHUNK_SIZE, res_out);
+        return;
+    }
+
+    scoped_ptr_t<real_superblock_t> sindex_sb;
+
+    bool sindex_exists = store->acquire_sindex_superblock_for_read(sindex_id,
+            super_block->get_sindex_block_id(), &token_pair,
+            txn.get(), &sindex_sb,
+            static_cast<std::vector<char>*>(NULL), &dummy_interruptor);
+    guarantee(sindex_exists);
+
+    rdb_rget_secondary_slice(store->get_sindex_slice(sindex_id),
+        sindex_range_t(counted_t<const ql::datum_t>(), false,
+                       counted_t<const ql::datum_t>(), false),
+        txn.get(), sindex_sb.get(), &ql_env, transform,
+        boost::optional<rdb_protocol_details::terminal_t>(),
+        key_range_t::universe(), ASCENDING, get_field_func("sid"), SINGLE,
+        rdb_protocol_t::MAX_RGET_CHUNK_SIZE, res_out);
+}
+
+/* Checks that a read with the projection pushed down returns what the same
+ * read returns with the projection as a plain map: the same rows, or the same
+ * error. */
+void expect_same_results(const rdb_protocol_t::rget_read_response_t &pushed,
+                         const rdb_protocol_t::rget_read_response_t &mapped,
+                         size_t expected_rows) {
+    typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
+    const stream_t *mapped_stream = boost::get<stream_t>(&mapped.result);
+    const stream_t *pushed_stream = boost::get<stream_t>(&pushed.result);
+    if (mapped_stream == NULL) {
+        const ql::exc_t *mapped_exc = boost::get<ql::exc_t>(&mapped.result);
+        const ql::exc_t *pushed_exc = boost::get<ql::exc_t>(&pushed.result);
+        ASSERT_TRUE(mapped_exc != NULL);
+        ASSERT_TRUE(pushed_exc != NULL);
+        EXPECT_STREQ(mapped_exc->what(), pushed_exc->what());
+        return;
+    }
+    ASSERT_TRUE(pushed_stream != NULL);
+    ASSERT_EQ(expected_rows, mapped_stream->size());
+    ASSERT_EQ(mapped_stream->size(), pushed_stream->size());
+    for (size_t i = 0; i < mapped_stream->size(); ++i) {
+        EXPECT_EQ((*mapped_stream)[i].key, (*pushed_stream)[i].key);
+        EXPECT_EQ(*(*mapped_stream)[i].data, *(*pushed_stream)[i].data);
+    }
+}
+
+/* Runs `pluck` or `without` on `paths_json` after `prefix`, once pushed down
+ * and once as a plain map, through both the primary index and the sindex. */
+void check_projection(btree_store_t<rdb_protocol_t> *store, const std::string &sindex_id,
+                      const rdb_protocol_details::transform_t &prefix,
+                      const std::string &paths_json, bool without, bool expect_error,
+                      size_t expected_rows) {
+    SCOPED_TRACE(strprintf("%s %s", without ? "without" : "pluck", paths_json.c_str()));
+    counted_t<const ql::datum_t> paths = parse_datum(paths_json);
+    ql::map_wire_func_t func = projection_func(paths, without);
+
+    rdb_protocol_details::transform_t pushed_transform = prefix;
+    pushed_transform.push_back(pluck_transform_t(paths, without, func));
+    rdb_protocol_details::transform_t mapped_transform = prefix;
+    mapped_transform.push_back(func);
+
+    for (int use_sindex = 0; use_sindex < 2; ++use_sindex) {
+        const std::string index = use_sindex ? sindex_id : std::string();
+        rdb_protocol_t::rget_read_response_t pushed, mapped;
+        read_all_rows(store, index, pushed_transform, &pushed);
+        read_all_rows(store, index, mapped_transform, &mapped);
+        EXPECT_EQ(expect_error, boost::get<ql::exc_t>(&mapped.result) != NULL);
+        expect_same_results(pushed, mapped, expected_rows);
+    }
+}
+
+#define PLUCK_PUSHDOWN_ROWS 40
+
+void _check_pluck_pushdown(btree_store_t<rdb_protocol_t> *store,
+                           const std::string &sindex_id) {
+    const rdb_protocol_details::transform_t none;
+    const size_t rows = PLUCK_PUSHDOWN_ROWS;
+
+    // Top-level fields, which take the `pluck_fields_of` fast path; some rows
+    // are missing them, or have them as pseudotypes or non-objects.
+    check_projection(store, sindex_id, none, "[\"a\", \"b\"]", false, false, rows);
+    check_projection(store, sindex_id, none, "[\"a\", \"missing\"]", false, false, rows);
+    check_projection(store, sindex_id, none, "[\"t\"]", false, false, rows);
+    check_projection(store, sindex_id, none, "[\"$reql_type$\"]", false, false, rows);
+
+    // Nested selectors, including ones into pseudotypes and non-objects.
+    check_projection(store, sindex_id, none, "[{\"b\": {\"c\": true}}]", false, false, rows);
+    check_projection(store, sindex_id, none, "[{\"b\": [\"c\", \"d\"]}, \"id\"]",
+                     false, false, rows);
+    check_projection(store, sindex_id, none, "[{\"t\": \"epoch_time\"}]", false, false, rows);
+
+    check_projection(store, sindex_id, none, "[\"a\", \"missing\"]", true, false, rows);
+    check_projection(store, sindex_id, none, "[{\"b\": \"c\"}, \"t\"]", true, false, rows);
+
+    // Projections of non-objects fail, and have to fail the same way.
+    rdb_protocol_details::transform_t get_b;
+    get_b.push_back(get_field_func("b"));
+    check_projection(store, sindex_id, get_b, "[\"c\"]", false, true, rows);
+    check_projection(store, sindex_id, get_b, "[\"c\"]", true, true, rows);
+}
+
+void check_pluck_pushdown(btree_store_t<rdb_protocol_t> *store,
+                          const std::string &sindex_id) {
+    for (int i = 0; i < MAX_RETRIES_FOR_SINDEX_POSTCONSTRUCT; ++i) {
+        try {
+            _check_pluck_pushdown(store, sindex_id);
+            return;
+        } catch (const sindex_not_post_constructed_exc_t&) { }
+        nap(100);
+    }
+    ADD_FAILURE() << "The sindex was never post constructed.";
+}
+
+void run_pluck_pushdown_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    for (int i = 0; i < PLUCK_PUSHDOWN_ROWS; ++i) {
+        std::string row;
+        switch (i % 4) {
+        case 0:
+            row = strprintf("{\"id\": %d, \"sid\": %d, \"a\": %d, "
+                            "\"b\": {\"c\": %d, \"d\": \"x\"}, "
+                            "\"t\": {\"$reql_type$\": \"TIME\", \"epoch_time\": %d, "
+                            "\"timezone\": \"+00:00\"}}", i, i * i, i, i, i);
+            break;
+        case 1:
+            row = strprintf("{\"id\": %d, \"sid\": %d, \"b\": {\"d\": \"y\"}}", i, i * i);
+            break;
+        case 2:
+            row = strprintf("{\"id\": %d, \"sid\": %d, \"a\": \"s\", \"b\": 5, "
+                            "\"t\": [1, 2]}", i, i * i);
+            break;
+        case 3:
+            row = strprintf("{\"id\": %d, \"sid\": %d, \"a\": null, \"b\": [{\"c\": 1}], "
+                            "\"t\": {\"$reql_type$\": \"TIME\", \"epoch_time\": %d, "
+                            "\"timezone\": \"-07:00\"}}", i, i * i, i);
+            break;
+        default: unreachable();
+        }
+        insert_row(parse_datum(row), &store);
+    }
+
+    std::string sindex_id = create_sindex(&store);
+    bring_sindexes_up_to_date(&store, sindex_id);
+
+    check_pluck_pushdown(&store, sindex_id);
+}
+
+TEST(RDBBtree, PluckPushdown) {
+    run_in_thread_pool(&run_pluck_pushdown_test);
+}
+
 } //namespace unittest
@@ -1,6 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/rdb_env.hpp"
 
+#include <algorithm>
+
+#include "arch/timing.hpp"
 #include "rdb_protocol/func.hpp"
 
 namespace unittest {
@@ -43,7 +46,7 @@ mock_namespace_repo_t::namespace_cache_entry_t *mock_namespace_repo_t::get_cache
 
 
 mock_namespace_interface_t::mock_namespace_interface_t(mock_namespace_repo_t *_parent) :
-    parent(_parent) {
+    parent(_parent), point_reads(0), multi_point_reads(0), rget_delay_ms(0) {
     ready_cond.pulse();
 }
 
@@ -67,6 +70,17 @@ void mock_namespace_interface_t::read_outdated(const rdb_protocol_t::read_t &que
     if (interruptor->is_pulsed()) {
         throw interrupted_exc_t();
     }
+    if (boost::get<rdb_protocol_t::point_read_t>(&query.read) != NULL) {
+        ++point_reads;
+    } else if (boost::get<rdb_protocol_t::multi_point_read_t>(&query.read) != NULL) {
+        ++multi_point_reads;
+    } else if (const rdb_protocol_t::rget_read_t *rget
+                   = boost::get<rdb_protocol_t::rget_read_t>(&query.read)) {
+        rget_chunk_sizes.push_back(rget->chunk_size);
+        if (rget_delay_ms > 0) {
+            nap(rget_delay_ms, interruptor);
+        }
+    }
     read_visitor_t v(&data, response);
     boost::apply_visitor(v, query.read);
 }
@@ -97,8 +111,57 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t
     }
 }
 
-void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::rget_read_t &rget) {
-    throw cannot_perform_query_exc_t("unimplemented");
+void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t::multi_point_read_t &get) {
+    response->response = rdb_protocol_t::multi_point_read_response_t();
+    rdb_protocol_t::multi_point_read_response_t &res = boost::get<rdb_protocol_t::multi_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows.push_back(std::make_pair(*it, make_counted<ql::datum_t>(scoped_cJSON_t(data->at(*it)->DeepCopy()))));
+        }
+    }
+}
+
+// Reads the primary keys in the range in order, and like a table, stops once
+// the rows add up to the chunk size.  Secondary indexes, transforms and
+// terminals aren't supported.
+void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t::rget_read_t &rget) {
+    if (rget.sindex || !rget.transform.empty() || rget.terminal) {
+        throw cannot_perform_query_exc_t("unimplemented");
+    }
+    response->response = rdb_protocol_t::rget_read_response_t();
+    rdb_protocol_t::rget_read_response_t &res = boost::get<rdb_protocol_t::rget_read_response_t>(response->response);
+    typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
+    stream_t *stream = boost::get<stream_t>(&res.result);
+
+    const key_range_t &range = rget.region.inner;
+    res.key_range = range;
+    // What the unsharded response of a read that isn't truncated says.
+    res.last_considered_key = forward(rget.sorting) ? store_key_t::max() : store_key_t::min();
+
+    std::vector<std::map<store_key_t, scoped_cJSON_t *>::iterator> rows;
+    for (auto it = data->lower_bound(range.left); it != data->end(); ++it) {
+        if (!range.contains_key(it->first)) {
+            break;
+        }
+        rows.push_back(it);
+    }
+    if (backward(rget.sorting)) {
+        std::reverse(rows.begin(), rows.end());
+    }
+
+    size_t bytes = 0;
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        counted_t<const ql::datum_t> row
+            = make_counted<ql::datum_t>(scoped_cJSON_t((*it)->second->DeepCopy()));
+        bytes += serialized_size(row);
+        stream->push_back(rdb_protocol_details::rget_item_t((*it)->first, row));
+        if (bytes >= rget.chunk_size) {
+            res.truncated = true;
+            res.last_considered_key = (*it)->first;
+            break;
+        }
+    }
 }
 
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::distribution_read_t &dg) {
@@ -329,9 +392,13 @@ ql::env_t *test_rdb_env_t::instance_t::get() {
 }
 
 std::map<store_key_t, scoped_cJSON_t*>* test_rdb_env_t::instance_t::get_data(const namespace_id_t &ns_id) {
+    return get_ns_if(ns_id)->get_data();
+}
+
+mock_namespace_interface_t *test_rdb_env_t::instance_t::get_ns_if(const namespace_id_t &ns_id) {
     mock_namespace_interface_t *ns_if = rdb_ns_repo.get_ns_if(ns_id);
     guarantee(ns_if != NULL);
-    return ns_if->get_data();
+    return ns_if;
 }
 
 void test_rdb_env_t::instance_t::interrupt() {
@@ -6,6 +6,7 @@
 #include <set>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
@@ -61,12 +62,26 @@ public:
 
     std::map<store_key_t, scoped_cJSON_t*>* get_data();
 
+    // How many `point_read_t`s and `multi_point_read_t`s have been made.
+    int get_point_reads() const { return point_reads; }
+    int get_multi_point_reads() const { return multi_point_reads; }
+
+    // The `chunk_size` of each `rget_read_t`, in the order they were made.
+    const std::vector<uint64_t> &get_rget_chunk_sizes() const { return rget_chunk_sizes; }
+    // Makes each `rget_read_t` take this long, to stand in for a slow shard.
+    void set_rget_delay_ms(int64_t ms) { rget_delay_ms = ms; }
+
 private:
     cond_t ready_cond;
+    int point_reads;
+    int multi_point_reads;
+    std::vector<uint64_t> rget_chunk_sizes;
+    int64_t rget_delay_ms;
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const rdb_protocol_t::point_read_t &get);
-        void NORETURN operator()(UNUSED const rdb_protocol_t::rget_read_t &rget);
+        void operator()(const rdb_protocol_t::multi_point_read_t &get);
+        void operator()(const rdb_protocol_t::rget_read_t &rget);
         void NORETURN operator()(UNUSED const rdb_protocol_t::distribution_read_t &dg);
         void NORETURN operator()(UNUSED const rdb_protocol_t::sindex_list_t &sl);
 
@@ -162,6 +177,7 @@ public:
         void interrupt();
 
         std::map<store_key_t, scoped_cJSON_t*>* get_data(const namespace_id_t &ns_id);
+        mock_namespace_interface_t *get_ns_if(const namespace_id_t &ns_id);
 
     private:
         dummy_semilattice_controller_t<cluster_semilattice_metadata_t> dummy_semilattice_controller;
@@ -0,0 +1,303 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/val.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// The right table's primary keys are "k0" through "k<TABLE_ROWS - 1>".
+const int TABLE_ROWS = 1000;
+
+std::string right_key(int i) {
+    return strprintf("k%d", i);
+}
+
+void set_str(Datum *datum, const std::string &str) {
+    datum->set_type(Datum::R_STR);
+    datum->set_r_str(str);
+}
+
+void add_pair(Datum *object, const std::string &key, const std::string &value) {
+    Datum_AssocPair *pair = object->add_r_object();
+    pair->set_key(key);
+    set_str(pair->mutable_val(), value);
+}
+
+// Makes `term` the array of objects `{n: i, fk: fks[i]}`.
+void make_left_rows(Term *term, const std::vector<std::string> &fks) {
+    term->set_type(Term::DATUM);
+    Datum *array = term->mutable_datum();
+    array->set_type(Datum::R_ARRAY);
+    for (size_t i = 0; i < fks.size(); ++i) {
+        Datum *object = array->add_r_array();
+        object->set_type(Datum::R_OBJECT);
+        add_pair(object, "n", strprintf("%zu", i));
+        add_pair(object, "fk", fks[i]);
+    }
+}
+
+// Makes `term` `r.expr(outer).concatMap(function(x) { return inner; })`, which
+// is `copies` copies of `inner` without building them all up front.
+Term *make_repeated(Term *term, int copies) {
+    term->set_type(Term::CONCATMAP);
+    Term *outer = term->add_args();
+    outer->set_type(Term::DATUM);
+    outer->mutable_datum()->set_type(Datum::R_ARRAY);
+    for (int i = 0; i < copies; ++i) {
+        Datum *num = outer->mutable_datum()->add_r_array();
+        num->set_type(Datum::R_NUM);
+        num->set_r_num(i);
+    }
+
+    Term *func = term->add_args();
+    func->set_type(Term::FUNC);
+    Term *vars = func->add_args();
+    vars->set_type(Term::DATUM);
+    vars->mutable_datum()->set_type(Datum::R_ARRAY);
+    Datum *var = vars->mutable_datum()->add_r_array();
+    var->set_type(Datum::R_NUM);
+    var->set_r_num(1);
+    return func->add_args();
+}
+
+// Makes `term` `left.eqJoin("fk", r.db("db").table("table"))` and returns `left`.
+Term *make_eq_join(Term *term) {
+    term->set_type(Term::EQ_JOIN);
+    Term *left = term->add_args();
+
+    Term *attr = term->add_args();
+    attr->set_type(Term::DATUM);
+    set_str(attr->mutable_datum(), "fk");
+
+    Term *table = term->add_args();
+    table->set_type(Term::TABLE);
+    Term *db = table->add_args();
+    db->set_type(Term::DB);
+    Term *db_name = db->add_args();
+    db_name->set_type(Term::DATUM);
+    set_str(db_name->mutable_datum(), "db");
+    Term *table_name = table->add_args();
+    table_name->set_type(Term::DATUM);
+    set_str(table_name->mutable_datum(), "table");
+    return left;
+}
+
+// Makes `term` the array of objects `{id: right_key(i)}` for the right table's
+// keys.
+void make_right_rows(Term *term) {
+    term->set_type(Term::DATUM);
+    Datum *array = term->mutable_datum();
+    array->set_type(Datum::R_ARRAY);
+    for (int i = 0; i < TABLE_ROWS; ++i) {
+        Datum *object = array->add_r_array();
+        object->set_type(Datum::R_OBJECT);
+        add_pair(object, "id", right_key(i));
+    }
+}
+
+void make_get_field(Term *term, int var_id, const std::string &field) {
+    term->set_type(Term::GET_FIELD);
+    Term *var = term->add_args();
+    var->set_type(Term::VAR);
+    Term *id = var->add_args();
+    id->set_type(Term::DATUM);
+    id->mutable_datum()->set_type(Datum::R_NUM);
+    id->mutable_datum()->set_r_num(var_id);
+    Term *name = term->add_args();
+    name->set_type(Term::DATUM);
+    set_str(name->mutable_datum(), field);
+}
+
+// Makes `term` `left.innerJoin(right, function(l, r) { return l("fk").eq(r("id")); })`
+// (or `outerJoin`) and sets `*left_out` and `*right_out`.
+void make_join(Term *term, bool outer, Term **left_out, Term **right_out) {
+    term->set_type(outer ? Term::OUTER_JOIN : Term::INNER_JOIN);
+    *left_out = term->add_args();
+    *right_out = term->add_args();
+
+    Term *func = term->add_args();
+    func->set_type(Term::FUNC);
+    Term *vars = func->add_args();
+    vars->set_type(Term::DATUM);
+    vars->mutable_datum()->set_type(Datum::R_ARRAY);
+    for (int i = 1; i <= 2; ++i) {
+        Datum *var = vars->mutable_datum()->add_r_array();
+        var->set_type(Datum::R_NUM);
+        var->set_r_num(i);
+    }
+    Term *body = func->add_args();
+    body->set_type(Term::EQ);
+    make_get_field(body->add_args(), 1, "fk");
+    make_get_field(body->add_args(), 2, "id");
+}
+
+// Runs `term`, and if `right_table` is given, counts the point reads and
+// multi-point reads of that table it makes.
+void run_query_counting_reads(test_rdb_env_t *test_env, ql::protob_t<const Term> term,
+               std::vector<counted_t<const ql::datum_t> > *rows_out, size_t *count_out,
+               const namespace_id_t *right_table,
+               int *point_reads_out, int *multi_point_reads_out) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance;
+    test_env->make_env(&env_instance);
+    ql::env_t *env = env_instance->get();
+
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::term_t> compiled_term = ql::compile_term(&compile_env, term);
+    ql::scope_env_t scope_env(env, ql::var_scope_t());
+    counted_t<ql::datum_stream_t> stream = compiled_term->eval(&scope_env)->as_seq(env);
+    *count_out = 0;
+    while (counted_t<const ql::datum_t> row = stream->next(env)) {
+        ++*count_out;
+        if (rows_out != NULL) {
+            rows_out->push_back(row);
+        }
+    }
+
+    if (right_table != NULL) {
+        mock_namespace_interface_t *ns_if = env_instance->get_ns_if(*right_table);
+        *point_reads_out = ns_if->get_point_reads();
+        *multi_point_reads_out = ns_if->get_multi_point_reads();
+    }
+}
+
+void run_query(test_rdb_env_t *test_env, ql::protob_t<const Term> term,
+               std::vector<counted_t<const ql::datum_t> > *rows_out) {
+    size_t count;
+    run_query_counting_reads(test_env, term, rows_out, &count, NULL, NULL, NULL);
+}
+
+namespace_id_t add_right_table(test_rdb_env_t *test_env, bool skip_odd_keys) {
+    std::set<std::map<std::string, std::string> > data;
+    for (int i = 0; i < TABLE_ROWS; ++i) {
+        if (skip_odd_keys && i % 2 == 1) {
+            continue;
+        }
+        std::map<std::string, std::string> row;
+        row["id"] = right_key(i);
+        data.insert(row);
+    }
+    database_id_t db_id = test_env->add_database("db");
+    return test_env->add_table("table", db_id, "id", data);
+}
+
+TEST(RdbEqJoin, OrderAndMissingKeys) {
+    // More rows than fit in one batch, with every key twice, and half the keys
+    // missing from the table.
+    std::vector<std::string> fks;
+    for (int i = 0; i < 2 * TABLE_ROWS + 500; ++i) {
+        fks.push_back(right_key(i % TABLE_ROWS));
+    }
+    ql::protob_t<Term> term = ql::make_counted_term();
+    make_left_rows(make_eq_join(term.get()), fks);
+
+    test_rdb_env_t test_env;
+    add_right_table(&test_env, true);
+    std::vector<counted_t<const ql::datum_t> > rows;
+    run_in_thread_pool(boost::bind(&run_query, &test_env, term, &rows));
+
+    // The joined rows come out in the left rows' order, without the ones whose
+    // key isn't in the table.
+    size_t next = 0;
+    for (size_t i = 0; i < fks.size(); ++i) {
+        if (i % TABLE_ROWS % 2 == 1) {
+            continue;
+        }
+        ASSERT_LT(next, rows.size());
+        counted_t<const ql::datum_t> left = rows[next]->get("left");
+        counted_t<const ql::datum_t> right = rows[next]->get("right");
+        EXPECT_EQ(strprintf("%zu", i), left->get("n")->as_str());
+        EXPECT_EQ(fks[i], right->get("id")->as_str());
+        ++next;
+    }
+    EXPECT_EQ(next, rows.size());
+}
+
+// Joins three left rows, the last of which matches nothing, with `copies` copies
+// of the right table's rows, and checks that each left row comes out with its
+// matches in order (or alone, for an outer join).
+void check_join(bool outer, int copies) {
+    std::vector<std::string> fks;
+    fks.push_back(right_key(0));
+    fks.push_back(right_key(TABLE_ROWS - 1));
+    fks.push_back("missing");
+    ql::protob_t<Term> term = ql::make_counted_term();
+    Term *left;
+    Term *right;
+    make_join(term.get(), outer, &left, &right);
+    make_left_rows(left, fks);
+    make_right_rows(make_repeated(right, copies));
+
+    test_rdb_env_t test_env;
+    std::vector<counted_t<const ql::datum_t> > rows;
+    run_in_thread_pool(boost::bind(&run_query, &test_env, term, &rows));
+
+    size_t next = 0;
+    for (size_t i = 0; i < 2; ++i) {
+        for (int copy = 0; copy < copies; ++copy) {
+            ASSERT_LT(next, rows.size());
+            EXPECT_EQ(strprintf("%zu", i), rows[next]->get("left")->get("n")->as_str());
+            EXPECT_EQ(fks[i], rows[next]->get("right")->get("id")->as_str());
+            ++next;
+        }
+    }
+    if (outer) {
+        ASSERT_LT(next, rows.size());
+        EXPECT_EQ("2", rows[next]->get("left")->get("n")->as_str());
+        EXPECT_FALSE(rows[next]->get("right", ql::NOTHROW).has());
+        ++next;
+    }
+    EXPECT_EQ(next, rows.size());
+}
+
+// Small right sides get a hash join.
+TEST(RdbJoin, HashJoin) {
+    check_join(false, 3);
+}
+
+TEST(RdbJoin, HashOuterJoin) {
+    check_join(true, 3);
+}
+
+// Right sides with more than `hash_join_build_limit` rows fall back to a nested
+// loop over the rows the hash join already read and the rest of the stream.
+TEST(RdbJoin, NestedLoopJoin) {
+    check_join(false, static_cast<int>(ql::hash_join_build_limit) / TABLE_ROWS + 1);
+}
+
+TEST(RdbJoin, NestedLoopOuterJoin) {
+    check_join(true, static_cast<int>(ql::hash_join_build_limit) / TABLE_ROWS + 1);
+}
+
+// A primary key eqJoin reads the right table with one multi-point read per
+// batch of left rows, however many rows there are.
+TEST(RdbEqJoin, ReadsPerBatch) {
+    const int batches = 10;
+    std::vector<std::string> fks;
+    for (size_t i = 0; i < ql::eq_join_batch_size; ++i) {
+        fks.push_back(right_key(i % TABLE_ROWS));
+    }
+    ql::protob_t<Term> term = ql::make_counted_term();
+    make_left_rows(make_repeated(make_eq_join(term.get()), batches), fks);
+
+    test_rdb_env_t test_env;
+    namespace_id_t right_table = add_right_table(&test_env, false);
+    size_t count;
+    int point_reads;
+    int multi_point_reads;
+    run_in_thread_pool(boost::bind(&run_query_counting_reads, &test_env, term,
+                                   static_cast<std::vector<counted_t<const ql::datum_t> > *>(NULL),
+                                   &count, &right_table, &point_reads, &multi_point_reads));
+    EXPECT_EQ(batches * ql::eq_join_batch_size, count);
+    EXPECT_EQ(0, point_reads);
+    EXPECT_EQ(batches, multi_point_reads);
+}
+
+}  // namespace unittest
@@ -478,5 +478,60 @@ TEST(RDBProtocol, OvershardedMissingAttr) {
     run_in_thread_pool_with_namespace_interface(&run_sindex_missing_attr_test, true);
 }
 
+rdb_protocol_t::write_t make_insert(int start, int finish, bool return_vals,
+                                    durability_requirement_t durability) {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    for (int i = start; i < finish; ++i) {
+        std::string data = strprintf("{\"id\" : %d}", i);
+        rows.push_back(make_counted<ql::datum_t>(
+                           scoped_cJSON_t(cJSON_Parse(data.c_str()))));
+    }
+    return rdb_protocol_t::write_t(
+        rdb_protocol_t::batched_insert_t(std::move(rows), "id", false, return_vals),
+        durability);
+}
+
+TEST(RDBProtocol, CoalesceInserts) {
+    rdb_protocol_t::write_t write = make_insert(0, 1, false, DURABILITY_REQUIREMENT_DEFAULT);
+    ASSERT_TRUE(write.coalesce(make_insert(1, 4, false, DURABILITY_REQUIREMENT_DEFAULT)));
+    ASSERT_TRUE(write.coalesce(make_insert(4, 6, false, DURABILITY_REQUIREMENT_DEFAULT)));
+
+    // These can't be merged, and mustn't change `write`.
+    ASSERT_FALSE(write.coalesce(make_insert(6, 7, true, DURABILITY_REQUIREMENT_DEFAULT)));
+    ASSERT_FALSE(write.coalesce(make_insert(6, 7, false, DURABILITY_REQUIREMENT_HARD)));
+    ASSERT_FALSE(write.coalesce(rdb_protocol_t::write_t(
+        rdb_protocol_t::point_delete_t(store_key_t("foo")),
+        DURABILITY_REQUIREMENT_DEFAULT)));
+
+    const rdb_protocol_t::batched_insert_t *bi =
+        boost::get<rdb_protocol_t::batched_insert_t>(&write.write);
+    ASSERT_TRUE(bi != NULL);
+    ASSERT_EQ(6u, bi->inserts.size());
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQ(i, bi->inserts[i]->get("id")->as_int());
+    }
+    ASSERT_EQ(3u, bi->coalesced_sizes.size());
+    EXPECT_EQ(1u, bi->coalesced_sizes[0]);
+    EXPECT_EQ(3u, bi->coalesced_sizes[1]);
+    EXPECT_EQ(2u, bi->coalesced_sizes[2]);
+
+    std::vector<counted_t<const ql::datum_t> > stats;
+    for (size_t i = 0; i < bi->coalesced_sizes.size(); ++i) {
+        stats.push_back(make_counted<const ql::datum_t>(
+                            static_cast<double>(bi->coalesced_sizes[i])));
+    }
+    rdb_protocol_t::write_response_t response(
+        make_counted<const ql::datum_t>(std::move(stats)));
+    std::vector<rdb_protocol_t::write_response_t> responses;
+    write.split_coalesced_response(response, &responses);
+    ASSERT_EQ(3u, responses.size());
+    for (size_t i = 0; i < responses.size(); ++i) {
+        const counted_t<const ql::datum_t> *d =
+            boost::get<counted_t<const ql::datum_t> >(&responses[i].response);
+        ASSERT_TRUE(d != NULL);
+        EXPECT_EQ(static_cast<int64_t>(bi->coalesced_sizes[i]), (*d)->as_int());
+    }
+}
+
 }   /* namespace unittest */
 
@@ -0,0 +1,155 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/stream.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// About 8MB of rows, so that the chunks have room to grow to
+// `MAX_RGET_CHUNK_SIZE` and shrink back again.
+const int STREAM_ROWS = 8000;
+
+// The size of the first chunk `batched_rget_stream_t` reads, and the smallest
+// it shrinks to.
+const uint64_t MIN_CHUNK_SIZE = 64 * KILOBYTE;
+
+std::string stream_key(int i) {
+    return strprintf("k%05d", i);
+}
+
+namespace_id_t add_stream_table(test_rdb_env_t *test_env) {
+    std::set<std::map<std::string, std::string> > data;
+    for (int i = 0; i < STREAM_ROWS; ++i) {
+        std::map<std::string, std::string> row;
+        row["id"] = stream_key(i);
+        row["pad"] = std::string(KILOBYTE, 'a' + i % 26);
+        data.insert(row);
+    }
+    database_id_t db_id = test_env->add_database("db");
+    return test_env->add_table("table", db_id, "id", data);
+}
+
+// Rgets need at least one optarg, so this gives them `db: "db"`.
+std::map<std::string, ql::wire_func_t> make_stream_optargs() {
+    Term db;
+    db.set_type(Term::DATUM);
+    db.mutable_datum()->set_type(Datum::R_STR);
+    db.mutable_datum()->set_r_str("db");
+    ql::global_optargs_t optargs;
+    UNUSED bool already_set = optargs.add_optarg("db", db);
+    return optargs.get_all_optargs();
+}
+
+// Reads the next row and checks that it's the `*next`th row in `sorting`'s
+// order.  Returns false if the stream ran out early.
+bool read_next_row(query_language::batched_rget_stream_t *stream, ql::env_t *env,
+                   sorting_t sorting, int *next) {
+    counted_t<const ql::datum_t> row = stream->next(env);
+    if (!row.has() || *next >= STREAM_ROWS) {
+        return false;
+    }
+    int i = sorting == DESCENDING ? STREAM_ROWS - 1 - *next : *next;
+    EXPECT_EQ(stream_key(i), row->get("id")->as_str());
+    ++*next;
+    return true;
+}
+
+void run_chunk_size_test() {
+    test_rdb_env_t test_env;
+    namespace_id_t table = add_stream_table(&test_env);
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance;
+    test_env.make_env(&env_instance);
+    ql::env_t *env = env_instance->get();
+    mock_namespace_interface_t *ns_if = env_instance->get_ns_if(table);
+
+    namespace_repo_t<rdb_protocol_t>::access_t access(
+        env->cluster_access.ns_repo, table, env->interruptor);
+    query_language::batched_rget_stream_t stream(
+        access, counted_t<const ql::datum_t>(), false,
+        counted_t<const ql::datum_t>(), false,
+        make_stream_optargs(), false, UNORDERED, NULL);
+    const std::vector<uint64_t> &chunk_sizes = ns_if->get_rget_chunk_sizes();
+
+    // A slow shard and a caller that never yields: the caller waits for every
+    // read ahead, so the chunks double until they're as big as they get.
+    ns_if->set_rget_delay_ms(10);
+    int next = 0;
+    while (chunk_sizes.empty()
+           || chunk_sizes.back() < rdb_protocol_t::MAX_RGET_CHUNK_SIZE) {
+        ASSERT_TRUE(read_next_row(&stream, env, UNORDERED, &next));
+    }
+    const size_t grown = chunk_sizes.size();
+    EXPECT_EQ(MIN_CHUNK_SIZE, chunk_sizes[0]);
+    for (size_t i = 1; i < grown; ++i) {
+        EXPECT_LE(chunk_sizes[i - 1], chunk_sizes[i]);
+    }
+
+    // A fast shard and a caller that yields after every row: each read ahead
+    // is already there when the caller gets to it, so the chunks halve.
+    ns_if->set_rget_delay_ms(0);
+    while (chunk_sizes.back() > MIN_CHUNK_SIZE) {
+        ASSERT_TRUE(read_next_row(&stream, env, UNORDERED, &next));
+        coro_t::yield();
+    }
+    for (size_t i = grown; i < chunk_sizes.size(); ++i) {
+        EXPECT_GE(chunk_sizes[i - 1], chunk_sizes[i]);
+    }
+
+    // Changing chunk sizes doesn't lose or repeat rows.
+    while (next < STREAM_ROWS) {
+        ASSERT_TRUE(read_next_row(&stream, env, UNORDERED, &next));
+    }
+    EXPECT_FALSE(stream.next(env).has());
+}
+
+TEST(RdbRgetStream, ChunkSizeAdapts) {
+    run_in_thread_pool(&run_chunk_size_test);
+}
+
+void run_read_ahead_order_test(sorting_t sorting) {
+    test_rdb_env_t test_env;
+    namespace_id_t table = add_stream_table(&test_env);
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance;
+    test_env.make_env(&env_instance);
+    ql::env_t *env = env_instance->get();
+    mock_namespace_interface_t *ns_if = env_instance->get_ns_if(table);
+
+    namespace_repo_t<rdb_protocol_t>::access_t access(
+        env->cluster_access.ns_repo, table, env->interruptor);
+    query_language::batched_rget_stream_t stream(
+        access, counted_t<const ql::datum_t>(), false,
+        counted_t<const ql::datum_t>(), false,
+        make_stream_optargs(), false, sorting, NULL);
+
+    // Reads ahead finish while the caller is still on the chunk before, and
+    // sometimes after the caller starts waiting for them.
+    ns_if->set_rget_delay_ms(1);
+    int next = 0;
+    while (next < STREAM_ROWS) {
+        ASSERT_TRUE(read_next_row(&stream, env, sorting, &next));
+        if (next % 100 == 0) {
+            coro_t::yield();
+        }
+    }
+    EXPECT_FALSE(stream.next(env).has());
+    EXPECT_FALSE(stream.next(env).has());
+
+    // The first two chunks aren't read ahead, and the rest are.
+    EXPECT_LT(2u, ns_if->get_rget_chunk_sizes().size());
+}
+
+TEST(RdbRgetStream, ReadAheadInOrder) {
+    run_in_thread_pool(boost::bind(&run_read_ahead_order_test, UNORDERED));
+}
+
+TEST(RdbRgetStream, ReadAheadInOrderDescending) {
+    run_in_thread_pool(boost::bind(&run_read_ahead_order_test, DESCENDING));
+}
+
+}  // namespace unittest
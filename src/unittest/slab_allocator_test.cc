@@ -0,0 +1,144 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "containers/slab_allocator.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+const int OBJECTS = 10000;
+const int BENCHMARK_ROUNDS = 1000;
+
+// Objects about the size of a `datum_t`, with and without the mixin.
+struct plain_object_t {
+    char data[48];
+};
+
+struct slab_object_t : public slab_allocated_mixin_t {
+    char data[48];
+};
+
+TEST(SlabAllocatorTest, SizesDontOverlap) {
+    const size_t sizes[] = { 1, 8, 16, 17, 48, 100, 1000, 8216, 16 * KILOBYTE,
+                             16 * KILOBYTE + 1 };
+    const size_t n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    std::vector<void *> ptrs;
+    for (int i = 0; i < 100; ++i) {
+        for (size_t j = 0; j < n_sizes; ++j) {
+            void *p = slab_allocate(sizes[j]);
+            memset(p, static_cast<int>(ptrs.size() % 256), sizes[j]);
+            ptrs.push_back(p);
+        }
+    }
+    for (size_t i = 0; i < ptrs.size(); ++i) {
+        const size_t size = sizes[i % n_sizes];
+        const char *p = static_cast<const char *>(ptrs[i]);
+        for (size_t k = 0; k < size; ++k) {
+            ASSERT_EQ(static_cast<char>(i % 256), p[k]);
+        }
+        slab_free(ptrs[i], size);
+    }
+}
+
+TEST(SlabAllocatorTest, ReusesFreedObjects) {
+    std::vector<slab_object_t *> objects;
+    for (int i = 0; i < OBJECTS; ++i) {
+        objects.push_back(new slab_object_t);
+    }
+    const int64_t slabs = get_thread_slab_allocator_stats().slabs;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < OBJECTS; ++i) {
+            delete objects[i];
+        }
+        for (int i = 0; i < OBJECTS; ++i) {
+            objects[i] = new slab_object_t;
+        }
+    }
+    EXPECT_EQ(slabs, get_thread_slab_allocator_stats().slabs);
+    for (int i = 0; i < OBJECTS; ++i) {
+        delete objects[i];
+    }
+}
+
+TEST(SlabAllocatorTest, GivesBackEmptySlabs) {
+    const int64_t before = get_thread_slab_allocator_stats().slabs;
+    std::vector<slab_object_t *> objects;
+    for (int i = 0; i < OBJECTS; ++i) {
+        objects.push_back(new slab_object_t);
+    }
+    EXPECT_LT(before + 2, get_thread_slab_allocator_stats().slabs);
+    for (int i = 0; i < OBJECTS; ++i) {
+        delete objects[i];
+    }
+    // All that's left of the size is the slab it allocates from, and a spare.
+    EXPECT_GE(before + 2, get_thread_slab_allocator_stats().slabs);
+}
+
+void free_objects_on(threadnum_t thread, std::vector<slab_object_t *> *objects,
+                     int64_t *remote_frees_out) {
+    on_thread_t thread_switcher(thread);
+    const int64_t before = get_thread_slab_allocator_stats().remote_frees;
+    for (size_t i = 0; i < objects->size(); ++i) {
+        delete (*objects)[i];
+    }
+    *remote_frees_out = get_thread_slab_allocator_stats().remote_frees - before;
+}
+
+void run_cross_thread_test() {
+    std::vector<slab_object_t *> objects;
+    for (int i = 0; i < OBJECTS; ++i) {
+        objects.push_back(new slab_object_t);
+    }
+    const int64_t slabs = get_thread_slab_allocator_stats().slabs;
+
+    int64_t remote_frees;
+    free_objects_on(threadnum_t(1), &objects, &remote_frees);
+    EXPECT_EQ(OBJECTS, remote_frees);
+
+    // The objects come back to the thread that allocated them.
+    for (int i = 0; i < OBJECTS; ++i) {
+        objects[i] = new slab_object_t;
+    }
+    EXPECT_EQ(slabs, get_thread_slab_allocator_stats().slabs);
+    for (int i = 0; i < OBJECTS; ++i) {
+        delete objects[i];
+    }
+}
+
+TEST(SlabAllocatorTest, CrossThreadFrees) {
+    run_in_thread_pool(&run_cross_thread_test, 2);
+}
+
+template <class object_t>
+double time_allocations() {
+    std::vector<object_t *> objects(OBJECTS);
+    ticks_t start = get_ticks();
+    for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+        for (int i = 0; i < OBJECTS; ++i) {
+            objects[i] = new object_t;
+        }
+        for (int i = 0; i < OBJECTS; ++i) {
+            delete objects[i];
+        }
+    }
+    return ticks_to_secs(get_ticks() - start) * BILLION
+        / (static_cast<double>(BENCHMARK_ROUNDS) * OBJECTS);
+}
+
+TEST(SlabAllocatorTest, AllocationThroughput) {
+    printf("operator new: %.1f ns per allocation and free\n",
+           time_allocations<plain_object_t>());
+    printf("slab allocator: %.1f ns per allocation and free\n",
+           time_allocations<slab_object_t>());
+}
+
+}  // namespace unittest
@@ -0,0 +1,114 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdlib.h>
+
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "perfmon/collect.hpp"
+#include "perfmon/core.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/stream_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Reads `query_cursors/<name>`, or `query_cursors/<name>/<field>` for samplers.
+int64_t get_cursor_stat(const std::string &name, const std::string &field = "") {
+    scoped_ptr_t<perfmon_result_t> stats_ptr = perfmon_get_stats();
+    const perfmon_result_t &stats = *stats_ptr;
+    perfmon_result_t::const_iterator cursors = stats.get_map()->find("query_cursors");
+    guarantee(cursors != stats.end());
+    const perfmon_result_t &cursor_stats = *cursors->second;
+    perfmon_result_t::const_iterator stat = cursor_stats.get_map()->find(name);
+    guarantee(stat != cursor_stats.end());
+    const perfmon_result_t *value = stat->second;
+    if (!field.empty()) {
+        perfmon_result_t::const_iterator sub = value->get_map()->find(field);
+        guarantee(sub != value->end());
+        value = sub->second;
+    }
+    return strtoll(value->get_string()->c_str(), NULL, 10);
+}
+
+// Rows of about a kilobyte, so that even release builds, which cut batches by
+// size, split a few thousand of them into several batches.
+counted_t<ql::datum_stream_t> make_row_stream(int rows) {
+    std::vector<counted_t<const ql::datum_t> > data;
+    for (int i = 0; i < rows; ++i) {
+        data.push_back(make_counted<const ql::datum_t>(std::string(KILOBYTE, 'a' + i % 26)));
+    }
+    return make_counted<ql::array_datum_stream_t>(
+        make_counted<const ql::datum_t>(std::move(data)), ql::make_counted_backtrace());
+}
+
+void run_cursor_stats_test() {
+    const int rows = 4000;
+    counted_t<ql::datum_stream_t> stream = make_row_stream(rows);
+
+    const int64_t batches_before = get_cursor_stat("batches");
+    const int64_t rows_before = get_cursor_stat("rows");
+    const int64_t bytes_before = get_cursor_stat("bytes");
+    const int64_t prefetched_before = get_cursor_stat("prefetched_batches");
+
+    cond_t interruptor;
+    ql::stream_cache2_t stream_cache;
+    stream_cache.insert(1, scoped_ptr_t<ql::env_t>(new ql::env_t(&interruptor)), stream);
+    int responses = 0;
+    size_t rows_sent = 0;
+    for (;;) {
+        ql::response_t response;
+        ASSERT_TRUE(stream_cache.serve(1, &response, &interruptor));
+        ++responses;
+        rows_sent += response.data().size();
+        if (response.pb().type() == Response::SUCCESS_SEQUENCE) {
+            break;
+        }
+        ASSERT_EQ(Response::SUCCESS_PARTIAL, response.pb().type());
+    }
+    EXPECT_FALSE(stream_cache.contains(1));
+    EXPECT_EQ(static_cast<size_t>(rows), rows_sent);
+
+    EXPECT_EQ(batches_before + responses, get_cursor_stat("batches"));
+    EXPECT_EQ(rows_before + rows, get_cursor_stat("rows"));
+    EXPECT_LT(bytes_before, get_cursor_stat("bytes"));
+    // Reading ahead starts with the first CONTINUE, so every batch after the
+    // second was read while the test handled the one before it.
+    ASSERT_LE(3, responses);
+    EXPECT_EQ(prefetched_before + responses - 2, get_cursor_stat("prefetched_batches"));
+
+    // The cursor's own totals were sampled when it closed.
+    EXPECT_LE(rows, get_cursor_stat("rows_per_cursor", "max"));
+    EXPECT_LE(responses, get_cursor_stat("batches_per_cursor", "max"));
+}
+
+TEST(StreamCache, CursorStats) {
+    run_in_thread_pool(&run_cursor_stats_test);
+}
+
+void run_read_ahead_start_test() {
+    cond_t interruptor;
+    ql::stream_cache2_t stream_cache;
+    stream_cache.insert(1, scoped_ptr_t<ql::env_t>(new ql::env_t(&interruptor)),
+                        make_row_stream(4000));
+
+    // Many clients close the cursor after the first batch, so nothing is read
+    // ahead until they ask for a second one.
+    for (int i = 0; i < 3; ++i) {
+        const int64_t prefetched_before = get_cursor_stat("prefetched_batches");
+        ql::response_t response;
+        ASSERT_TRUE(stream_cache.serve(1, &response, &interruptor));
+        ASSERT_EQ(Response::SUCCESS_PARTIAL, response.pb().type());
+        EXPECT_EQ(prefetched_before + (i == 2 ? 1 : 0),
+                  get_cursor_stat("prefetched_batches"));
+        // Give a read-ahead the chance to finish.
+        nap(10);
+    }
+    stream_cache.erase(1);
+}
+
+TEST(StreamCache, ReadAheadStartsAtContinue) {
+    run_in_thread_pool(&run_read_ahead_start_test);
+}
+
+}  // namespace unittest
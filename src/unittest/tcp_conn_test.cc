@@ -0,0 +1,131 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/network.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// The byte at position `i` of the stream.
+char stream_byte(size_t i) {
+    return static_cast<char>(i % 251);
+}
+
+// Sends the stream with every kind of write, so that the write coroutine sees
+// buffers, vectors of buffers (more than `IOV_MAX` of them, too) and waiting
+// writers mixed together in its queue.
+void send_stream(size_t *sent, scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    scoped_ptr_t<tcp_conn_t> conn;
+    nconn->make_overcomplicated(&conn);
+    cond_t non_interruptor;
+
+    std::vector<char> data(200000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = stream_byte(i);
+    }
+    size_t pos = 0;
+
+    for (int i = 0; i < 1000; ++i) {
+        conn->write_buffered(data.data() + pos, 7, &non_interruptor);
+        pos += 7;
+    }
+
+    const size_t sizes[] = { 1, 0, 20000, 300 };
+    iovec iov[4];
+    for (size_t i = 0; i < 4; ++i) {
+        iov[i].iov_base = data.data() + pos;
+        iov[i].iov_len = sizes[i];
+        pos += sizes[i];
+    }
+    conn->writev(iov, 4, &non_interruptor);
+
+    conn->write(data.data() + pos, 5000, &non_interruptor);
+    pos += 5000;
+
+    std::vector<iovec> small_iovs(1500);
+    for (size_t i = 0; i < small_iovs.size(); ++i) {
+        small_iovs[i].iov_base = data.data() + pos;
+        small_iovs[i].iov_len = 3;
+        pos += 3;
+    }
+    conn->writev(small_iovs.data(), small_iovs.size(), &non_interruptor);
+
+    conn->write_buffered(data.data() + pos, 100, &non_interruptor);
+    pos += 100;
+    conn->flush_buffer(&non_interruptor);
+
+    *sent = pos;
+}
+
+// Reads the stream back with every kind of read, and checks each byte.
+void receive_stream(int port, size_t *received) {
+    sockaddr_in sin;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ip_address_t localhost(&sin);
+    cond_t non_interruptor;
+    tcp_conn_t conn(localhost, port, &non_interruptor);
+
+    size_t pos = 0;
+    char buf[4096];
+    try {
+        for (int round = 0; ; ++round) {
+            size_t n;
+            switch (round % 3) {
+            case 0: {
+                n = conn.read_some(buf, 10, &non_interruptor);
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT_EQ(stream_byte(pos + i), buf[i]);
+                }
+            } break;
+            case 1: {
+                if (conn.peek().end == conn.peek().beg) {
+                    conn.read_more_buffered(&non_interruptor);
+                }
+                const_charslice slice = conn.peek();
+                n = std::min<size_t>(20, slice.end - slice.beg);
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT_EQ(stream_byte(pos + i), slice.beg[i]);
+                }
+                conn.pop(n, &non_interruptor);
+            } break;
+            case 2: {
+                n = conn.read_some(buf, sizeof(buf), &non_interruptor);
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT_EQ(stream_byte(pos + i), buf[i]);
+                }
+            } break;
+            default: unreachable();
+            }
+            pos += n;
+        }
+    } catch (const tcp_conn_read_closed_exc_t &) {
+        // The sender has closed the connection.
+    }
+    *received = pos;
+}
+
+void run_write_read_test() {
+    std::vector<threadnum_t> threads(1, threadnum_t(0));
+    size_t sent = 0;
+    size_t received = 0;
+    {
+        threaded_tcp_listener_t listener(std::set<ip_address_t>(), ANY_PORT, threads,
+                                         boost::bind(&send_stream, &sent, _1));
+        receive_stream(listener.get_port(), &received);
+    }
+    EXPECT_EQ(sent, received);
+}
+
+TEST(TCPConnTest, WriteAndRead) {
+    run_in_thread_pool(&run_write_read_test);
+}
+
+}  // namespace unittest
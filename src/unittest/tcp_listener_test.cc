@@ -0,0 +1,119 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/network.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+const int CONNECTIONS_PER_CLIENT = 500;
+
+// Counts the connections each thread handles.  The counts are only written on
+// their own threads.
+struct accept_counts_t {
+    int counts[MAX_THREADS];
+};
+
+// Writes one byte to each new connection, so the client knows it got through.
+void greet_conn(accept_counts_t *accepted, scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    ++accepted->counts[get_thread_id().threadnum];
+    scoped_ptr_t<tcp_conn_t> conn;
+    nconn->make_overcomplicated(&conn);
+    cond_t non_interruptor;
+    try {
+        conn->write("!", 1, &non_interruptor);
+    } catch (const tcp_conn_write_closed_exc_t &) {
+    }
+}
+
+void connect_repeatedly(int port, int client) {
+    on_thread_t thread_switcher(threadnum_t(client % get_num_db_threads()));
+    sockaddr_in sin;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ip_address_t localhost(&sin);
+    cond_t non_interruptor;
+    for (int i = 0; i < CONNECTIONS_PER_CLIENT; ++i) {
+        tcp_conn_t conn(localhost, port, &non_interruptor);
+        char c;
+        conn.read(&c, 1, &non_interruptor);
+        ASSERT_EQ('!', c);
+    }
+}
+
+void run_accept_rate_test(int n_clients) {
+    std::vector<threadnum_t> threads;
+    for (int i = 0; i < get_num_db_threads(); ++i) {
+        threads.push_back(threadnum_t(i));
+    }
+
+    accept_counts_t accepted;
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        accepted.counts[i] = 0;
+    }
+    bool reuse_port;
+    ticks_t start = get_ticks();
+    {
+        threaded_tcp_listener_t listener(std::set<ip_address_t>(), ANY_PORT, threads,
+                                         boost::bind(&greet_conn, &accepted, _1));
+        reuse_port = listener.uses_reuse_port();
+        pmap(n_clients, boost::bind(&connect_repeatedly, listener.get_port(), _1));
+    }
+    double secs = ticks_to_secs(get_ticks() - start);
+
+    // Every connection is handled on one of the listener's threads.
+    int total = 0;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        total += accepted.counts[threads[i].threadnum];
+    }
+    EXPECT_EQ(n_clients * CONNECTIONS_PER_CLIENT, total);
+    printf("%d client(s), %s: %.0f connections per second\n",
+           n_clients, reuse_port ? "one socket per thread" : "one socket",
+           total / secs);
+}
+
+TEST(TCPListenerTest, AcceptRate) {
+    run_in_thread_pool(boost::bind(&run_accept_rate_test, 8), 4);
+}
+
+TEST(TCPListenerTest, AcceptRateReusePort) {
+    set_tcp_reuse_port(true);
+    run_in_thread_pool(boost::bind(&run_accept_rate_test, 8), 4);
+    set_tcp_reuse_port(false);
+}
+
+void run_port_conflict_test() {
+    std::vector<threadnum_t> threads;
+    for (int i = 0; i < get_num_db_threads(); ++i) {
+        threads.push_back(threadnum_t(i));
+    }
+
+    accept_counts_t accepted;
+    threaded_tcp_listener_t listener(std::set<ip_address_t>(), ANY_PORT, threads,
+                                     boost::bind(&greet_conn, &accepted, _1));
+
+    // A second listener can't share the port, even if both use SO_REUSEPORT.
+    EXPECT_THROW(threaded_tcp_listener_t(std::set<ip_address_t>(), listener.get_port(),
+                                         threads,
+                                         boost::bind(&greet_conn, &accepted, _1)),
+                 address_in_use_exc_t);
+}
+
+TEST(TCPListenerTest, PortConflict) {
+    run_in_thread_pool(&run_port_conflict_test, 4);
+}
+
+TEST(TCPListenerTest, PortConflictReusePort) {
+    set_tcp_reuse_port(true);
+    run_in_thread_pool(&run_port_conflict_test, 4);
+    set_tcp_reuse_port(false);
+}
+
+}  // namespace unittest
@@ -1,8 +1,18 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <stdio.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "unittest/gtest.hpp"
 
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/timer.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/pmap.hpp"
+#include "containers/intrusive_priority_queue.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "utils.hpp"
 
@@ -33,6 +43,72 @@ TEST(TimerTest, TestApproximateWaitTimes) {
     unittest::run_in_thread_pool(run_TestApproximateWaitTimes);
 }
 
+const int TIMER_CHURN_COUNT = 100000;
+
+class never_called_callback_t : public timer_callback_t {
+public:
+    void on_timer() {
+        ADD_FAILURE() << "A canceled timer rang.";
+    }
+};
+
+// What timers used to be kept in, for comparison.
+struct heap_timer_t : public intrusive_priority_queue_node_t<heap_timer_t> {
+    int64_t expiration;
+};
+
+bool left_is_higher_priority(const heap_timer_t *left, const heap_timer_t *right) {
+    return left->expiration < right->expiration;
+}
+
+// The timeouts are spread out, so that every level of the wheel gets used.
+int64_t churn_timeout(int i) {
+    return 1000 + (i * 7919) % 10000000;
+}
+
+void churn_timers(double *wheel_ns, double *heap_ns) {
+    never_called_callback_t callback;
+    std::vector<timer_token_t *> tokens(TIMER_CHURN_COUNT);
+    ticks_t start = get_ticks();
+    for (int i = 0; i < TIMER_CHURN_COUNT; ++i) {
+        tokens[i] = fire_timer_once(churn_timeout(i), &callback);
+    }
+    for (int i = 0; i < TIMER_CHURN_COUNT; ++i) {
+        cancel_timer(tokens[i]);
+    }
+    *wheel_ns = static_cast<double>(get_ticks() - start) / (2 * TIMER_CHURN_COUNT);
+
+    std::vector<heap_timer_t> nodes(TIMER_CHURN_COUNT);
+    intrusive_priority_queue_t<heap_timer_t> queue;
+    start = get_ticks();
+    for (int i = 0; i < TIMER_CHURN_COUNT; ++i) {
+        nodes[i].expiration = get_ticks() + churn_timeout(i) * MILLION;
+        queue.push(&nodes[i]);
+    }
+    for (int i = 0; i < TIMER_CHURN_COUNT; ++i) {
+        queue.remove(&nodes[i]);
+    }
+    *heap_ns = static_cast<double>(get_ticks() - start) / (2 * TIMER_CHURN_COUNT);
+}
+
+void churn_timers_on_thread(std::vector<double> *wheel_ns, std::vector<double> *heap_ns, int i) {
+    on_thread_t thread_switcher((threadnum_t(i)));
+    churn_timers(&(*wheel_ns)[i], &(*heap_ns)[i]);
+}
+
+void run_churn_test(int n_threads) {
+    std::vector<double> wheel_ns(n_threads), heap_ns(n_threads);
+    pmap(n_threads, boost::bind(&churn_timers_on_thread, &wheel_ns, &heap_ns, _1));
+    for (int i = 0; i < n_threads; ++i) {
+        printf("thread %d: %.0f ns per timer add or cancel, %.0f ns with a heap\n",
+               i, wheel_ns[i], heap_ns[i]);
+    }
+}
+
+TEST(TimerTest, AddAndCancelManyTimers) {
+    unittest::run_in_thread_pool(boost::bind(&run_churn_test, 4), 4);
+}
+
 
 
 
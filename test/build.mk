@@ -18,3 +18,12 @@ test: test-deps
 .PHONY: full-test
 full-test: TEST = all
 full-test: test
+
+# Prints the allocations per operation of an RDB stress workload.  Build with
+# ALLOC_COUNT=1 to count calls to operator new as well as slab allocations.
+.PHONY: alloc-per-op
+alloc-per-op: $(BUILD_DIR)/rethinkdb
+	$P MAKE -C $/drivers/python
+	$(EXTERN_MAKE) -C $/drivers/python -s
+	$P RUN alloc_per_op.py
+	RETHINKDB_BUILD_DIR=$(BUILD_DIR) $/test/rdb_workloads/alloc_per_op.py $(ALLOC_PER_OP_ARGS)
@@ -0,0 +1,93 @@
+#!/usr/bin/python
+# Copyright 2010-2013 RethinkDB, all rights reserved.
+
+""" Runs the RDB stress client against a fresh server and prints how many
+allocations each operation cost, from the server's `operator_new_calls` and
+`slab_allocator` stats.  `operator_new_calls` is only there in servers built
+with `ALLOC_COUNT=1`; `make alloc-per-op` runs this script. """
+
+import sys, os, re, subprocess
+from optparse import OptionParser
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, os.path.pardir, 'drivers', 'python')))
+import driver, http_admin
+import rethinkdb as r
+
+stress_script = os.path.join(os.path.dirname(__file__), "stress.py")
+
+parser = OptionParser()
+parser.add_option("--timeout", dest="timeout", metavar="SECONDS", default=30, type="int")
+parser.add_option("--clients", dest="clients", metavar="CLIENTS", default=16, type="int")
+parser.add_option("--workload", dest="workload", metavar="WRITES/DELETES/READS/SINDEX_READS/UPDATES/NON_ATOMIC_UPDATES", default="3/2/5/0/1/1", type="string")
+(options, args) = parser.parse_args()
+
+if len(args) != 0:
+    raise RuntimeError("No positional arguments supported")
+
+def get_alloc_stats(http):
+    stats = http.get_stat("")
+    machines = [machine_stats for (machine_id, machine_stats) in stats.items() if machine_id != "machines"]
+    slab_allocations = sum(int(m["slab_allocator"]["allocations"]) for m in machines)
+    if all("operator_new_calls" in m for m in machines):
+        new_calls = sum(int(m["operator_new_calls"]) for m in machines)
+    else:
+        new_calls = None
+    return (new_calls, slab_allocations)
+
+# Reads the "successes" column of the table `stress.py` prints at the end.
+def count_ops(stress_output):
+    ops = 0
+    in_table = False
+    for line in stress_output.splitlines():
+        if line.startswith("op type"):
+            in_table = True
+        elif in_table:
+            fields = line.split()
+            if len(fields) < 2 or not re.match("^[0-9]+$", fields[1]):
+                break
+            ops += int(fields[1])
+    return ops
+
+with driver.Metacluster() as metacluster:
+    cluster = driver.Cluster(metacluster)
+    print "Starting server..."
+    files = driver.Files(metacluster, log_path = os.path.join(metacluster.dbs_path, "create-output"))
+    process = driver.Process(cluster, files, log_path = os.path.join(metacluster.dbs_path, "serve-output"))
+    process.wait_until_started_up()
+
+    http = http_admin.ClusterAccess([("localhost", process.http_port)])
+
+    # Create the table up front, so that its allocations don't count.
+    with r.connect("localhost", process.driver_port) as connection:
+        if "test" not in r.db_list().run(connection):
+            r.db_create("test").run(connection)
+        r.db("test").table_create("alloc_per_op").run(connection)
+
+    (new_calls_before, slab_before) = get_alloc_stats(http)
+
+    stress_args = [stress_script,
+                   "--host", "localhost:%d" % process.driver_port,
+                   "--table", "test.alloc_per_op",
+                   "--timeout", str(options.timeout),
+                   "--clients", str(options.clients),
+                   "--workload", options.workload]
+    stress_output = subprocess.check_output(stress_args)
+    print stress_output
+
+    (new_calls_after, slab_after) = get_alloc_stats(http)
+    cluster.check_and_stop()
+
+ops = count_ops(stress_output)
+if ops == 0:
+    raise RuntimeError("The stress client didn't report any successful operations")
+
+slab_allocations = slab_after - slab_before
+print "Operations:                 %d" % ops
+print "Slab allocations per op:    %.2f" % (float(slab_allocations) / ops)
+if new_calls_before is None or new_calls_after is None:
+    print "operator new calls per op: not counted (build the server with ALLOC_COUNT=1)"
+else:
+    new_calls = new_calls_after - new_calls_before
+    print "operator new calls per op:  %.2f" % (float(new_calls) / ops)
+    print "Allocations per op:         %.2f" % (float(new_calls + slab_allocations) / ops)